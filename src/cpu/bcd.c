@@ -6,8 +6,12 @@
  * BCD (Binary Coded Decimal) arithmetic for the ND-100 Commercial Extended
  * (CE) instruction set: ADDD, SUBD, COMD, SHDE, PACK, UPACK.
  *
- * Approach: Convert BCD from memory to double, do arithmetic, convert back.
- * This matches the proven C# RetroCore implementation.
+ * Approach: Operands are loaded from memory into packed decimal numbers (one
+ * digit per nibble, 16 digits per 64-bit word) and all arithmetic is done
+ * digit by digit on those, so results are exact for the full 31 digit fields.
+ * How BCD fields are read and written matches the C# RetroCore implementation;
+ * ASCII fields (PACK, UPACK), illegal digit codes and overflow follow the
+ * ND-100 manual.
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,13 +22,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
-#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "cpu_types.h"
 #include "cpu_protos.h"
 
-extern struct CpuRegs *gReg;
 extern void setbit(ushort regnum, ushort stsbit, char val);
 
 /* Max BCD field length in nibbles */
@@ -36,6 +39,34 @@ extern void setbit(ushort regnum, ushort stsbit, char val);
 #define BCD_SIGN_NEG 0x0D
 #define BCD_SIGN_UNS 0x0F
 
+/* Sign representation, D2 bits 13-11. Bits 12-11 place the sign of an ASCII field
+ * (embedded or separate, trailing or leading); bit 13 makes any field unsigned. */
+#define BCD_SIGN_SEPARATE 0x01
+#define BCD_SIGN_LEADING  0x02
+#define BCD_SIGN_UNSIGNED 0x04
+
+/* ASCII codes. An embedded sign is the zone of the sign digit: 0011 plus, 0111 minus. */
+#define ASCII_PLUS      053
+#define ASCII_MINUS     055
+#define ASCII_ZONE      060
+#define ASCII_ZONE_NEG  0160
+
+/* Error codes in bits 0-4 of D (PACK, UPACK) */
+#define BCD_ERR_ILLEGAL  2
+#define BCD_ERR_OVERFLOW 3
+
+/* Packed decimal numbers. Two operands are added at the larger of their two
+ * scales, which needs up to 31 digits plus 30 digits of scaling. */
+#define BCD_DIGITS_PER_WORD 16
+#define BCD_NUM_WORDS       4
+#define BCD_NUM_DIGITS      (BCD_NUM_WORDS * BCD_DIGITS_PER_WORD)
+
+/* Packed decimal number: one digit per nibble, least significant digit in bits 3-0 of d[0] */
+typedef struct {
+    uint64_t d[BCD_NUM_WORDS];
+    bool negative;
+} BcdNumber;
+
 /* Internal BCD operand */
 typedef struct {
     ushort addr;            /* D1: word address */
@@ -46,13 +77,186 @@ typedef struct {
     int field_length;       /* D2 bits 4-0 */
     ushort words[BCD_MAX_WORDS]; /* raw memory words */
     int num_words;
-    double value;           /* numeric value */
-    bool is_negative;
-    bool error;
-    /* BCD digit string: digits + sign char, null-terminated */
-    char bcd_str[BCD_MAX_NIBBLES + 2];
+    BcdNumber num;          /* digits of the field, and its sign */
+    int scale;              /* digits of num after the decimal point */
+    bool has_sign;          /* a sign nibble ended the field */
+    bool error;             /* bad descriptor or illegal digit code */
 } BcdOperand;
 
+/* Digit add: index is a + b + carry, entry is the sum digit with the carry in bit 4 */
+static const uint8_t bcd_add_digit[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19,
+    0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15
+};
+
+/* Digit subtract: index is a - b - borrow + 16, entry is the difference digit with the borrow in bit 4 */
+static const uint8_t bcd_sub_digit[32] = {
+    0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x00, 0x01, 0x02, 0x03,
+    0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D,
+    0x0E, 0x0F
+};
+
+/* ================================================================ */
+/* Packed decimal helpers                                           */
+/* ================================================================ */
+static inline int bcd_digit(const BcdNumber *n, int i)
+{
+    return (int)((n->d[i / BCD_DIGITS_PER_WORD] >> ((i % BCD_DIGITS_PER_WORD) * 4)) & 0x0F);
+}
+
+static bool bcd_is_zero(const BcdNumber *n)
+{
+    for (int w = 0; w < BCD_NUM_WORDS; w++)
+        if (n->d[w]) return false;
+    return true;
+}
+
+/* Keep the lowest 'digits' digits */
+static void bcd_keep(BcdNumber *n, int digits)
+{
+    for (int w = 0; w < BCD_NUM_WORDS; w++) {
+        int lo = w * BCD_DIGITS_PER_WORD;
+        if (digits <= lo)
+            n->d[w] = 0;
+        else if (digits < lo + BCD_DIGITS_PER_WORD)
+            n->d[w] &= ((uint64_t)1 << ((digits - lo) * 4)) - 1;
+    }
+}
+
+/* Multiply by 10^digits, dropping digits shifted out of the top */
+static void bcd_shift_left(BcdNumber *n, int digits)
+{
+    if (digits <= 0) return;
+    if (digits >= BCD_NUM_DIGITS) {
+        memset(n->d, 0, sizeof(n->d));
+        return;
+    }
+
+    int words = digits / BCD_DIGITS_PER_WORD;
+    int bits = (digits % BCD_DIGITS_PER_WORD) * 4;
+    for (int w = BCD_NUM_WORDS - 1; w >= 0; w--) {
+        uint64_t v = (w >= words) ? n->d[w - words] << bits : 0;
+        if (bits && w > words)
+            v |= n->d[w - words - 1] >> (64 - bits);
+        n->d[w] = v;
+    }
+}
+
+/* Divide by 10^digits. Returns the most significant digit dropped. */
+static int bcd_shift_right(BcdNumber *n, int digits)
+{
+    if (digits <= 0) return 0;
+    int dropped = (digits <= BCD_NUM_DIGITS) ? bcd_digit(n, digits - 1) : 0;
+    if (digits >= BCD_NUM_DIGITS) {
+        memset(n->d, 0, sizeof(n->d));
+        return dropped;
+    }
+
+    int words = digits / BCD_DIGITS_PER_WORD;
+    int bits = (digits % BCD_DIGITS_PER_WORD) * 4;
+    for (int w = 0; w < BCD_NUM_WORDS; w++) {
+        uint64_t v = (w + words < BCD_NUM_WORDS) ? n->d[w + words] >> bits : 0;
+        if (bits && w + words + 1 < BCD_NUM_WORDS)
+            v |= n->d[w + words + 1] << (64 - bits);
+        n->d[w] = v;
+    }
+    return dropped;
+}
+
+/* Unsigned compare of two magnitudes: <0, 0, >0. Packed digits compare like binary. */
+static int bcd_cmp_mag(const BcdNumber *a, const BcdNumber *b)
+{
+    for (int w = BCD_NUM_WORDS - 1; w >= 0; w--) {
+        if (a->d[w] != b->d[w])
+            return (a->d[w] > b->d[w]) ? 1 : -1;
+    }
+    return 0;
+}
+
+/* r = a + b on magnitudes */
+static void bcd_add_mag(BcdNumber *r, const BcdNumber *a, const BcdNumber *b)
+{
+    int carry = 0;
+    for (int w = 0; w < BCD_NUM_WORDS; w++) {
+        uint64_t x = a->d[w], y = b->d[w], sum = 0;
+        if (!(x | y | (uint64_t)carry)) {
+            r->d[w] = 0;
+            continue;
+        }
+        for (int s = 0; s < 64; s += 4) {
+            uint8_t t = bcd_add_digit[((x >> s) & 0x0F) + ((y >> s) & 0x0F) + carry];
+            sum |= (uint64_t)(t & 0x0F) << s;
+            carry = t >> 4;
+        }
+        r->d[w] = sum;
+    }
+}
+
+/* r = a - b on magnitudes, a >= b */
+static void bcd_sub_mag(BcdNumber *r, const BcdNumber *a, const BcdNumber *b)
+{
+    int borrow = 0;
+    for (int w = 0; w < BCD_NUM_WORDS; w++) {
+        uint64_t x = a->d[w], y = b->d[w], diff = 0;
+        if (!(y | (uint64_t)borrow)) {
+            r->d[w] = x;
+            continue;
+        }
+        for (int s = 0; s < 64; s += 4) {
+            uint8_t t = bcd_sub_digit[((x >> s) & 0x0F) - ((y >> s) & 0x0F) - borrow + 16];
+            diff |= (uint64_t)(t & 0x0F) << s;
+            borrow = t >> 4;
+        }
+        r->d[w] = diff;
+    }
+}
+
+/* Add one to the magnitude */
+static void bcd_increment(BcdNumber *n)
+{
+    BcdNumber one = { { 1 }, false };
+    bcd_add_mag(n, n, &one);
+}
+
+/* Signed a + b, both at the same scale. A zero result is positive. */
+static BcdNumber bcd_sum(const BcdNumber *a, const BcdNumber *b)
+{
+    BcdNumber r;
+
+    if (a->negative == b->negative) {
+        bcd_add_mag(&r, a, b);
+        r.negative = a->negative;
+    } else if (bcd_cmp_mag(a, b) >= 0) {
+        bcd_sub_mag(&r, a, b);
+        r.negative = a->negative;
+    } else {
+        bcd_sub_mag(&r, b, a);
+        r.negative = b->negative;
+    }
+
+    if (bcd_is_zero(&r))
+        r.negative = false;
+    return r;
+}
+
+/* op1 + op2 (or op1 - op2), exact, at the larger of the two operand scales */
+static BcdNumber bcd_operand_sum(const BcdOperand *op1, const BcdOperand *op2, bool subtract, int *scale)
+{
+    BcdNumber a = op1->num;
+    BcdNumber b = op2->num;
+
+    *scale = (op1->scale > op2->scale) ? op1->scale : op2->scale;
+    bcd_shift_left(&a, *scale - op1->scale);
+    bcd_shift_left(&b, *scale - op2->scale);
+    if (subtract)
+        b.negative = !b.negative;
+
+    return bcd_sum(&a, &b);
+}
+
 /* ================================================================ */
 /* Parse descriptor from register values                            */
 /* ================================================================ */
@@ -69,34 +273,36 @@ static void bcd_parse(BcdOperand *op, ushort d1, ushort d2)
         op->field_length = BCD_MAX_NIBBLES;
 }
 
+/* The decimal point must be inside the field */
+static bool bcd_descriptor_ok(const BcdOperand *op)
+{
+    return op->decimal_point < op->field_length || op->decimal_point == 0;
+}
+
+/* Set the error code in bits 0-4 of D */
+static void bcd_report(int code)
+{
+    gD = (ushort)((gD & ~0x1F) | code);
+}
+
 /* ================================================================ */
-/* Load BCD operand from memory, convert to double                  */
+/* Load BCD operand from memory into a packed decimal number        */
 /* Matches C# LoadOperand + ConcatenateBCD + ConvertBCDToDouble     */
 /* ================================================================ */
-static void bcd_load(BcdOperand *op, bool is_ascii)
+static void bcd_load(BcdOperand *op)
 {
-    if (op->field_length == 0) {
-        op->value = 0.0;
+    if (op->field_length == 0)
         return;
-    }
 
-    /* Validate decimal_point vs field_length */
-    if (op->decimal_point >= op->field_length && op->decimal_point != 0) {
+    if (!bcd_descriptor_ok(op)) {
         op->error = true;
         return;
     }
 
-    /* Calculate words to read */
-    int mem_len;
-    if (!is_ascii) {
-        /* BCD: 4 nibbles per word */
-        mem_len = op->field_length >> 2;
-        if ((mem_len << 2) != op->field_length)
-            mem_len++;
-    } else {
-        /* ASCII: 2 bytes per word */
-        mem_len = op->field_length >> 1;
-    }
+    /* BCD: 4 nibbles per word */
+    int mem_len = op->field_length >> 2;
+    if ((mem_len << 2) != op->field_length)
+        mem_len++;
     if (mem_len == 0) mem_len = 1;
     if (mem_len > BCD_MAX_WORDS) mem_len = BCD_MAX_WORDS;
     op->num_words = mem_len;
@@ -105,177 +311,184 @@ static void bcd_load(BcdOperand *op, bool is_ascii)
         op->words[i] = MemoryRead((op->addr + i) & 0xFFFF, true);
     }
 
-    /* Extract nibbles from words into digit string.
-     * Matches C# PackedBCDToString: reads nibbles from each word LSB-first,
-     * inserting at front (which gives MSB-first order).
-     * Sign nibbles (C=+, D=-, F=unsigned) are detected inline. */
-    char digits[BCD_MAX_NIBBLES + 2];
-    int dpos = 0;
+    /* Take nibbles from the words, most significant first, up to field_length
+     * nibbles. A sign nibble (C=+, D=-, F=unsigned) ends the field; the nibbles
+     * to its right in the same word are not part of it. */
     int nibble_count = 0;
-    bool found_sign = false;
+    int digit_count = 0;
 
-    for (int w = 0; w < mem_len && nibble_count < op->field_length; w++) {
+    for (int w = 0; w < mem_len && nibble_count < op->field_length && !op->has_sign; w++) {
         ushort word = op->words[w];
+        int top = (w == 0 && op->right_byte) ? 2 : 4;
 
-        /* C# PackedBCDToString: reads nibbles i=0..3 (LSB first), Insert(0) each.
-         * We replicate by building a per-word string, then appending. */
-        char word_str[8];
-        int wpos = 0;
-        int nib_cnt = 4;
-        if (w == 0 && op->right_byte) nib_cnt = 2;
-
-        for (int i = 0; i < nib_cnt; i++) {
+        /* Leftmost sign nibble in the word, if any */
+        int sign_pos = -1;
+        for (int i = top - 1; i >= 0; i--) {
             int nibble = (word >> (i * 4)) & 0x0F;
+            if (nibble == BCD_SIGN_POS || nibble == BCD_SIGN_NEG || nibble == BCD_SIGN_UNS) {
+                sign_pos = i;
+                break;
+            }
+        }
 
-            switch (nibble) {
-                case BCD_SIGN_POS:
-                case BCD_SIGN_UNS:
-                    wpos = 0;  /* Clear (C# result.Clear + Insert) */
-                    word_str[wpos++] = '+';
-                    break;
-                case BCD_SIGN_NEG:
-                    wpos = 0;
-                    word_str[wpos++] = '-';
-                    break;
-                default:
-                    /* Insert digit at front */
-                    memmove(word_str + 1, word_str, wpos);
-                    word_str[0] = '0' + (nibble & 0x0F);
-                    wpos++;
-                    break;
+        for (int i = top - 1; i > sign_pos && nibble_count < op->field_length; i--) {
+            int nibble = (word >> (i * 4)) & 0x0F;
+            if (nibble > 9) {
+                /* Only the codes C, D and F are signs; A, B and E are illegal */
+                op->error = true;
+                return;
             }
+            bcd_shift_left(&op->num, 1);
+            op->num.d[0] |= nibble;
+            nibble_count++;
+            digit_count++;
         }
-        word_str[wpos] = '\0';
 
-        /* Append word_str to digits, up to field_length, stop on sign */
-        for (int j = 0; j < wpos && nibble_count < op->field_length && !found_sign; j++) {
-            digits[dpos++] = word_str[j];
-            if (word_str[j] == '+' || word_str[j] == '-')
-                found_sign = true;
+        if (sign_pos >= 0 && nibble_count < op->field_length) {
+            op->has_sign = true;
+            op->num.negative = (((word >> (sign_pos * 4)) & 0x0F) == BCD_SIGN_NEG);
             nibble_count++;
         }
     }
-    digits[dpos] = '\0';
 
-    /* Pad with leading zeros if needed (C# ConcatenateBCD) */
-    while (dpos < op->field_length) {
-        memmove(digits + 1, digits, dpos + 1);
-        digits[0] = '0';
-        dpos++;
-    }
+    /* The field is padded with leading zeros; the decimal point only counts when
+     * it falls inside the digits */
+    int npos = op->field_length - (op->has_sign ? 1 : 0);
+    if (digit_count > npos) npos = digit_count;
+    op->scale = (op->decimal_point > 0 && op->decimal_point < npos) ? op->decimal_point : 0;
+}
 
-    /* If no sign found, treat as unsigned/positive */
-    if (!found_sign) {
-        /* Operand has no valid sign nibble - treated as error for SHDE
-         * validation, but we still produce a value for other ops */
-        op->is_negative = false;
-    } else {
-        op->is_negative = (dpos > 0 && digits[dpos - 1] == '-');
-    }
+/* ================================================================ */
+/* ASCII fields: one digit per byte, with the sign as D2 bits 13-11 */
+/* say. Byte k of the field is in word addr + ((k + lr) >> 1), in   */
+/* the right byte when (k + lr) is odd.                             */
+/* ================================================================ */
+static ushort ascii_byte_addr(const BcdOperand *op, int k)
+{
+    return (ushort)(op->addr + ((k + op->right_byte) >> 1));
+}
 
-    /* Save BCD string for SHDE/UPACK */
-    strncpy(op->bcd_str, digits, sizeof(op->bcd_str) - 1);
-    op->bcd_str[sizeof(op->bcd_str) - 1] = '\0';
-
-    /* Build numeric string: remove sign char */
-    char num_str[BCD_MAX_NIBBLES + 4];
-    int npos = 0;
-    int len = (int)strlen(digits);
-    for (int i = 0; i < len; i++) {
-        if (digits[i] != '+' && digits[i] != '-')
-            num_str[npos++] = digits[i];
-    }
-    num_str[npos] = '\0';
+static bool ascii_byte_right(const BcdOperand *op, int k)
+{
+    return ((k + op->right_byte) & 1) != 0;
+}
 
-    /* Pad with leading zeros */
-    while (npos < op->field_length - 1) {
-        memmove(num_str + 1, num_str, npos + 1);
-        num_str[0] = '0';
-        npos++;
-    }
+static uint8_t ascii_read_byte(const BcdOperand *op, int k)
+{
+    ushort word = MemoryRead(ascii_byte_addr(op, k), true);
+    return ascii_byte_right(op, k) ? (uint8_t)word : (uint8_t)(word >> 8);
+}
 
-    /* Insert decimal point */
-    if (op->decimal_point > 0 && op->decimal_point < npos) {
-        int insert_pos = npos - op->decimal_point;
-        memmove(num_str + insert_pos + 1, num_str + insert_pos, npos - insert_pos + 1);
-        num_str[insert_pos] = '.';
-    }
+static void ascii_write_byte(const BcdOperand *op, int k, uint8_t value)
+{
+    MemoryWrite(value, ascii_byte_addr(op, k), true, ascii_byte_right(op, k) ? 1 : 0);
+}
 
-    /* Parse to double */
-    op->value = strtod(num_str, NULL);
-    if (op->is_negative)
-        op->value = -op->value;
+static bool ascii_signed(const BcdOperand *op)
+{
+    return !(op->sign_format & BCD_SIGN_UNSIGNED);
 }
 
-/* ================================================================ */
-/* Convert double back to BCD and store to memory                   */
-/* Matches C# ConvertDoubleToBCD + UpdateDecimalOperandsFromBCD     */
-/* ================================================================ */
-static void bcd_store_value(BcdOperand *op, double value)
+static bool ascii_separate(const BcdOperand *op)
 {
-    if (op->field_length == 0) return;
+    return ascii_signed(op) && (op->sign_format & BCD_SIGN_SEPARATE);
+}
 
-    bool is_neg = value < 0;
-    if (is_neg) value = -value;
+/* Byte holding the sign, a digit byte if the sign is embedded */
+static int ascii_sign_byte(const BcdOperand *op)
+{
+    return (op->sign_format & BCD_SIGN_LEADING) ? 0 : op->field_length - 1;
+}
 
-    /* Adjust for decimal point position */
-    value = round(value * pow(10.0, op->decimal_point)) ;
+/* Digit bytes of the field, and the first of them */
+static int ascii_digits(const BcdOperand *op)
+{
+    return op->field_length - (ascii_separate(op) ? 1 : 0);
+}
 
-    /* Convert integer part to digit string */
-    long long int_val = (long long)value;
-    int digit_slots = op->field_length - 1; /* reserve 1 for sign */
-    if (digit_slots < 0) digit_slots = 0;
+static int ascii_first_digit(const BcdOperand *op)
+{
+    return (ascii_separate(op) && ascii_sign_byte(op) == 0) ? 1 : 0;
+}
 
-    char num_str[BCD_MAX_NIBBLES + 2];
-    snprintf(num_str, sizeof(num_str), "%0*lld", digit_slots, int_val);
+/* Load an ASCII field. A byte that is neither a digit nor the sign is an illegal code. */
+static void bcd_load_ascii(BcdOperand *op)
+{
+    if (op->field_length == 0)
+        return;
 
-    /* Truncate if too long (take rightmost digits) */
-    int slen = (int)strlen(num_str);
-    char *start = num_str;
-    if (slen > digit_slots) {
-        start = num_str + (slen - digit_slots);
+    if (!bcd_descriptor_ok(op)) {
+        op->error = true;
+        return;
     }
 
-    /* Build BCD string: digits + sign */
-    char bcd[BCD_MAX_NIBBLES + 2];
-    int bpos = 0;
-    for (int i = 0; start[i] && bpos < digit_slots; i++) {
-        bcd[bpos++] = start[i];
+    int digits = ascii_digits(op);
+    int first = ascii_first_digit(op);
+    int sign = ascii_signed(op) ? ascii_sign_byte(op) : -1;
+
+    for (int k = first; k < first + digits; k++) {
+        uint8_t c = ascii_read_byte(op, k);
+        int zone = c & 0xF0;
+        if (k == sign && !ascii_separate(op) && zone == ASCII_ZONE_NEG)
+            op->num.negative = true;
+        else if (zone != ASCII_ZONE)
+            op->error = true;
+        if ((c & 0x0F) > 9)
+            op->error = true;
+
+        bcd_shift_left(&op->num, 1);
+        op->num.d[0] |= c & 0x0F;
     }
-    /* Pad if needed */
-    while (bpos < digit_slots) {
-        memmove(bcd + 1, bcd, bpos + 1);
-        bcd[0] = '0';
-        bpos++;
+
+    if (ascii_separate(op)) {
+        uint8_t c = ascii_read_byte(op, sign);
+        if (c == ASCII_MINUS)
+            op->num.negative = true;
+        else if (c != ASCII_PLUS)
+            op->error = true;
     }
-    bcd[bpos++] = is_neg ? '-' : '+';
-    bcd[bpos] = '\0';
 
-    /* Save for SHDE */
-    strncpy(op->bcd_str, bcd, sizeof(op->bcd_str) - 1);
+    op->has_sign = ascii_signed(op);
+    op->scale = (op->decimal_point > 0 && op->decimal_point < digits) ? op->decimal_point : 0;
+}
 
-    /* Pack BCD string into words */
+/* Write 'num' into an ASCII field: every digit byte in zone 0011, the sign as the field has it */
+static void bcd_write_ascii(BcdOperand *op, const BcdNumber *num)
+{
+    int digits = ascii_digits(op);
+    int first = ascii_first_digit(op);
+    int sign = ascii_signed(op) ? ascii_sign_byte(op) : -1;
+
+    for (int k = first; k < first + digits; k++) {
+        int digit = bcd_digit(num, first + digits - 1 - k);
+        int zone = (k == sign && !ascii_separate(op) && num->negative) ? ASCII_ZONE_NEG : ASCII_ZONE;
+        ascii_write_byte(op, k, (uint8_t)(zone | digit));
+    }
+
+    if (ascii_separate(op))
+        ascii_write_byte(op, sign, num->negative ? ASCII_MINUS : ASCII_PLUS);
+}
+
+/* ================================================================ */
+/* Write 'num' into a field: field_length-1 digits and a sign       */
+/* Matches C# UpdateDecimalOperandsFromBCD                          */
+/* ================================================================ */
+static void bcd_write(BcdOperand *op, const BcdNumber *num)
+{
     for (int i = 0; i < BCD_MAX_WORDS; i++)
         op->words[i] = 0;
 
-    int word_idx = 0;
-    int nibble_pos = 3; /* start at high nibble of first word */
-    int dcount = 0;
-
-    for (int i = 0; i < bpos && dcount < op->field_length; i++) {
+    int digit_slots = op->field_length - 1;
+    for (int k = 0; k < op->field_length; k++) {
         uint8_t nib;
-        if (bcd[i] == '+') nib = BCD_SIGN_POS;
-        else if (bcd[i] == '-') nib = BCD_SIGN_NEG;
-        else nib = bcd[i] - '0';
-
-        op->words[word_idx] |= (ushort)(nib << (nibble_pos * 4));
-        nibble_pos--;
-        dcount++;
-
-        if (nibble_pos < 0) {
-            word_idx++;
-            nibble_pos = 3;
-        }
+        if (k < digit_slots)
+            nib = (uint8_t)bcd_digit(num, digit_slots - 1 - k);
+        else if (op->sign_format & BCD_SIGN_UNSIGNED)
+            nib = BCD_SIGN_UNS;
+        else
+            nib = num->negative ? BCD_SIGN_NEG : BCD_SIGN_POS;
+
+        op->words[k >> 2] |= (ushort)(nib << ((3 - (k & 3)) * 4));
     }
 
     /* Write words to memory */
@@ -290,6 +503,38 @@ static void bcd_store_value(BcdOperand *op, double value)
     }
 }
 
+/* ================================================================ */
+/* Bring a value with 'scale' decimals to 'decimal_point' decimals, */
+/* rounding half away from zero, and keep its rightmost 'digits'    */
+/* digits. Returns false if significant digits were lost.           */
+/* ================================================================ */
+static bool bcd_fit(BcdNumber *n, const BcdNumber *value, int scale, int decimal_point, int digits)
+{
+    *n = *value;
+    n->negative = value->negative && !bcd_is_zero(value);
+    if (decimal_point >= scale) {
+        bcd_shift_left(n, decimal_point - scale);
+    } else if (bcd_shift_right(n, scale - decimal_point) >= 5) {
+        bcd_increment(n);
+    }
+
+    BcdNumber all = *n;
+    bcd_keep(n, digits);
+    return bcd_cmp_mag(n, &all) == 0;
+}
+
+/* Store a value with 'scale' decimals into the operand field.
+ * Returns false on overflow; the digits that fit are stored. */
+static bool bcd_store(BcdOperand *op, const BcdNumber *value, int scale)
+{
+    if (op->field_length == 0) return true;
+
+    BcdNumber n;
+    bool fits = bcd_fit(&n, value, scale, op->decimal_point, op->field_length - 1);
+    bcd_write(op, &n);
+    return fits;
+}
+
 /* ================================================================ */
 /* ADDD - Add Decimal                                               */
 /* ================================================================ */
@@ -301,10 +546,10 @@ void ndfunc_addd(ushort instr)
     bcd_parse(&op1, gA, gD);
     bcd_parse(&op2, gX, gT);
 
-    bcd_load(&op1, false);
+    bcd_load(&op1);
     if (op1.error) return;
 
-    bcd_load(&op2, false);
+    bcd_load(&op2);
     if (op2.error) return;
 
     if (op2.field_length > op1.field_length) {
@@ -312,8 +557,12 @@ void ndfunc_addd(ushort instr)
         return;
     }
 
-    double result = op1.value + op2.value;
-    bcd_store_value(&op1, result);
+    int scale;
+    BcdNumber result = bcd_operand_sum(&op1, &op2, false, &scale);
+    if (!bcd_store(&op1, &result, scale)) {
+        /* Overflow: a carry out of the field */
+        return;
+    }
 
     /* Success: skip return */
     gPC++;
@@ -330,18 +579,21 @@ void ndfunc_subd(ushort instr)
     bcd_parse(&op1, gA, gD);
     bcd_parse(&op2, gX, gT);
 
-    bcd_load(&op1, false);
+    bcd_load(&op1);
     if (op1.error) return;
 
-    bcd_load(&op2, false);
+    bcd_load(&op2);
     if (op2.error) return;
 
     if (op2.field_length > op1.field_length) {
         return;
     }
 
-    double result = op1.value - op2.value;
-    bcd_store_value(&op1, result);
+    int scale;
+    BcdNumber result = bcd_operand_sum(&op1, &op2, true, &scale);
+    if (!bcd_store(&op1, &result, scale)) {
+        return;
+    }
 
     gPC++;
 }
@@ -357,20 +609,21 @@ void ndfunc_comd(ushort instr)
     bcd_parse(&op1, gA, gD);
     bcd_parse(&op2, gX, gT);
 
-    bcd_load(&op1, false);
+    bcd_load(&op1);
     if (op1.error) return;
 
-    bcd_load(&op2, false);
+    bcd_load(&op2);
     if (op2.error) return;
 
-    double diff = op1.value - op2.value;
+    int scale;
+    BcdNumber diff = bcd_operand_sum(&op1, &op2, true, &scale);
 
-    if (diff > 0)
-        gA = 1;
-    else if (diff < 0)
+    if (bcd_is_zero(&diff))
+        gA = 0;
+    else if (diff.negative)
         gA = 0xFFFF;
     else
-        gA = 0;
+        gA = 1;
 
     gPC++;
 }
@@ -378,75 +631,44 @@ void ndfunc_comd(ushort instr)
 /* ================================================================ */
 /* SHDE - Decimal Shift                                             */
 /* Shift op1 by (op1.dp - op2.dp) places, store in op2              */
-/* Matches C# ShiftBCD logic                                        */
+/* Based on the C# ShiftBCD                                         */
 /* ================================================================ */
 
-static char *shift_bcd_string(const char *bcd, int orig_len, int shift_count,
-                              bool rounding, bool *out_error)
+/* Shift a field of 'ndigits' digits (plus sign, orig_len nibbles in all) right
+ * (shift_count > 0) or left, one digit at a time. Returns false if a left shift
+ * drops a significant digit. The field is cut to its rightmost orig_len nibbles. */
+static bool shift_bcd_field(BcdNumber *num, int *ndigits, int orig_len, int shift_count,
+                            bool rounding)
 {
-    static char result[BCD_MAX_NIBBLES + 4];
-    *out_error = false;
-
-    int len = (int)strlen(bcd);
-
-    /* Separate sign from digits */
-    bool is_neg = (len > 0 && bcd[len - 1] == '-');
-    char sign_char = is_neg ? '-' : '+';
-
-    char digits[BCD_MAX_NIBBLES + 2];
-    int dlen = 0;
-    for (int i = 0; i < len; i++) {
-        if (bcd[i] != '+' && bcd[i] != '-')
-            digits[dlen++] = bcd[i];
-    }
-    digits[dlen] = '\0';
+    bool ok = true;
 
-    if (shift_count == 0) {
-        snprintf(result, sizeof(result), "%s%c", digits, sign_char);
-        return result;
-    }
+    if (shift_count == 0)
+        return true;
 
     if (shift_count > 0) {
-        /* Shift right: drop rightmost digit, prepend '0' */
+        /* Shift right: drop rightmost digit, a zero comes in on the left */
         for (int i = 0; i < shift_count; i++) {
-            char last = (dlen > 0) ? digits[dlen - 1] : '0';
-            /* Shift all digits right by 1 position */
-            for (int j = dlen - 1; j > 0; j--)
-                digits[j] = digits[j - 1];
-            digits[0] = '0';
-            digits[dlen] = '\0';
-
-            if (rounding && last >= '5') {
-                long long num = strtoll(digits, NULL, 10);
-                num++;
-                snprintf(digits, sizeof(digits), "%0*lld", dlen, num);
-                digits[dlen] = '\0';
-            }
+            int last = bcd_shift_right(num, 1);
+            if (rounding && last >= 5)
+                bcd_increment(num);
         }
     } else {
-        /* Shift left: drop leftmost digit, append '0' */
-        int left_shift = -shift_count;
-        for (int i = 0; i < left_shift; i++) {
-            if (digits[0] != '0') {
-                *out_error = true;
-            }
-            /* Shift all digits left by 1 position */
-            for (int j = 0; j < dlen - 1; j++)
-                digits[j] = digits[j + 1];
-            digits[dlen - 1] = '0';
-            digits[dlen] = '\0';
+        /* Shift left: drop leftmost digit, append zero */
+        for (int i = 0; i < -shift_count; i++) {
+            if (*ndigits == 0 || bcd_digit(num, *ndigits - 1) != 0)
+                ok = false;
+            bcd_shift_left(num, 1);
+            bcd_keep(num, *ndigits);
         }
     }
 
-    snprintf(result, sizeof(result), "%s%c", digits, sign_char);
-
     /* Ensure result is correct length */
-    int rlen = (int)strlen(result);
-    if (rlen > orig_len) {
-        memmove(result, result + (rlen - orig_len), orig_len + 1);
+    if (*ndigits + 1 > orig_len) {
+        *ndigits = orig_len - 1;
+        bcd_keep(num, *ndigits);
     }
 
-    return result;
+    return ok;
 }
 
 void ndfunc_shde(ushort instr)
@@ -457,17 +679,14 @@ void ndfunc_shde(ushort instr)
     bcd_parse(&op1, gA, gD);
     bcd_parse(&op2, gX, gT);
 
-    bcd_load(&op1, false);
+    bcd_load(&op1);
     if (op1.error) return;
 
     /* ND-100 manual: "The sign and digits of the first operand are checked
      * before execution and any illegal digit codes reported."
      * No valid sign nibble found = illegal operand = error (no skip). */
-    {
-        int slen = (int)strlen(op1.bcd_str);
-        if (slen == 0 || (op1.bcd_str[slen-1] != '+' && op1.bcd_str[slen-1] != '-'))
-            return;
-    }
+    if (!op1.has_sign)
+        return;
 
     /* Don't need to load op2 data, just its descriptor */
     if (op2.field_length == 0) {
@@ -476,92 +695,20 @@ void ndfunc_shde(ushort instr)
 
     int shift_direction = op1.decimal_point - op2.decimal_point;
 
-    /* Start with op1's BCD string */
-    char work[BCD_MAX_NIBBLES + 4];
-    strncpy(work, op1.bcd_str, sizeof(work) - 1);
-    work[sizeof(work) - 1] = '\0';
+    /* Start with op1's digits, padded to op2 field_length if needed (C# PadLeft) */
+    BcdNumber work = op1.num;
+    int ndigits = ((op2.field_length > op1.field_length) ? op2.field_length : op1.field_length) - 1;
 
-    /* Pad to op2 field_length if needed (C# PadLeft) */
-    if (op2.field_length > op1.field_length) {
-        int wlen = (int)strlen(work);
-        while (wlen < op2.field_length) {
-            memmove(work + 1, work, wlen + 1);
-            work[0] = '0';
-            wlen++;
-        }
-    }
-
-    bool shift_error = false;
-    char *newbcd = work;
-
-    /* Adjust decimals - Left shift case (C# lines 1144-1152) */
-    if (shift_direction < 0 && op1.decimal_point > 0 &&
-        op1.decimal_point != op2.decimal_point) {
-        int numShift = op1.decimal_point - op2.decimal_point;
-        newbcd = shift_bcd_string(newbcd, op2.field_length, numShift, false, &shift_error);
-        /* Copy result to work buffer for next call */
-        strncpy(work, newbcd, sizeof(work) - 1);
-        work[sizeof(work) - 1] = '\0';
-        newbcd = work;
-    }
-
-    /* Adjust decimals - Right shift case (C# lines 1155-1163) */
-    if (shift_direction >= 0 && op2.decimal_point > 0 &&
-        op1.decimal_point != op2.decimal_point) {
-        int numShift = op1.decimal_point - op2.decimal_point;
-        newbcd = shift_bcd_string(newbcd, op2.field_length, numShift, false, &shift_error);
-        strncpy(work, newbcd, sizeof(work) - 1);
-        work[sizeof(work) - 1] = '\0';
-        newbcd = work;
-    }
-
-    /* Main shift (C# line 1165) */
-    char *shifted = shift_bcd_string(newbcd, op2.field_length, shift_direction,
-                                     op2.rounding, &shift_error);
-
-    if (shift_error) {
+    /* One shift by the difference of the decimal points. The C# code shifted by it
+     * once more when either operand had decimals, moving the decimal point twice. */
+    if (!shift_bcd_field(&work, &ndigits, op2.field_length, shift_direction, op2.rounding)) {
         /* Error: significant digits lost on left shift - no skip */
         return;
     }
 
-    /* Trim to field_length if needed (C# lines 1173-1178) */
-    int slen = (int)strlen(shifted);
-    if (slen > op2.field_length) {
-        int trim = slen - op2.field_length;
-        memmove(shifted, shifted + trim, op2.field_length + 1);
-    }
-
-    /* Pack the shifted BCD string directly into op2 words and write to memory */
-    for (int i = 0; i < BCD_MAX_WORDS; i++) op2.words[i] = 0;
-
-    int word_idx = 0;
-    int nibble_pos = 3;
-    int dcount = 0;
-
-    for (int i = 0; i < slen && dcount < op2.field_length; i++) {
-        uint8_t nib;
-        if (shifted[i] == '+') nib = BCD_SIGN_POS;
-        else if (shifted[i] == '-') nib = BCD_SIGN_NEG;
-        else nib = shifted[i] - '0';
-
-        op2.words[word_idx] |= (ushort)(nib << (nibble_pos * 4));
-        nibble_pos--;
-        dcount++;
-
-        if (nibble_pos < 0) {
-            word_idx++;
-            nibble_pos = 3;
-        }
-    }
-
-    int mem_len = op2.field_length >> 2;
-    if ((mem_len << 2) != op2.field_length) mem_len++;
-    if (mem_len == 0) mem_len = 1;
-    if (mem_len > BCD_MAX_WORDS) mem_len = BCD_MAX_WORDS;
-
-    for (int i = 0; i < mem_len; i++) {
-        MemoryWrite(op2.words[i], (op2.addr + i) & 0xFFFF, true, 2);
-    }
+    /* Trim to field_length (C# lines 1173-1178) and write to op2 */
+    bcd_keep(&work, op2.field_length - 1);
+    bcd_write(&op2, &work);
 
     gPC++;
 }
@@ -577,13 +724,16 @@ void ndfunc_pack(ushort instr)
     bcd_parse(&op1, gA, gD);
     bcd_parse(&op2, gX, gT);
 
-    bcd_load(&op1, true); /* ASCII mode */
-    if (op1.error) return;
-
-    bcd_load(&op2, false); /* BCD mode */
-    if (op2.error) return;
+    bcd_load_ascii(&op1);
+    if (op1.error || !bcd_descriptor_ok(&op2)) {
+        bcd_report(BCD_ERR_ILLEGAL);
+        return;
+    }
 
-    bcd_store_value(&op2, op1.value);
+    if (!bcd_store(&op2, &op1.num, op1.scale)) {
+        bcd_report(BCD_ERR_OVERFLOW);
+        return;
+    }
 
     gPC++;
 }
@@ -599,17 +749,21 @@ void ndfunc_unpack(ushort instr)
     bcd_parse(&op1, gA, gD);
     bcd_parse(&op2, gX, gT);
 
-    bcd_load(&op1, false); /* BCD source */
-    if (op1.error) {
-        gD = (gD & 0xFFF0) | 2;
+    bcd_load(&op1); /* BCD source */
+    if (op1.error || !bcd_descriptor_ok(&op2)) {
+        bcd_report(BCD_ERR_ILLEGAL);
         return;
     }
 
     if (op2.field_length == 0) return;
 
-    /* For now, simple ASCII conversion - store digits as ASCII bytes */
-    /* TODO: full ASCII sign format support */
-    bcd_store_value(&op2, op1.value);
+    BcdNumber n;
+    bool fits = bcd_fit(&n, &op1.num, op1.scale, op2.decimal_point, ascii_digits(&op2));
+    bcd_write_ascii(&op2, &n);
+    if (!fits) {
+        bcd_report(BCD_ERR_OVERFLOW);
+        return;
+    }
 
     gPC++;
 }
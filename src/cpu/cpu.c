@@ -55,6 +55,7 @@ static uint64_t throttle_get_ns(void) {
 }
 
 
+#include <limits.h>
 #include <string.h>
 #include <setjmp.h>
 #ifndef __EMSCRIPTEN__
@@ -64,43 +65,99 @@ static uint64_t throttle_get_ns(void) {
 
 #include "cpu_types.h"
 #include "cpu_protos.h"
+#include "../ndlib/hostwait.h"
 
 /* Forward declarations for ring buffer diagnostics */
-static uint16_t last_device_irq_bits = 0;
 void ring_dump(void);
 
+/* Ring buffer for last N instructions before exit */
+#define RING_SIZE 512
+struct RingEntry {
+    unsigned short pc;
+    unsigned short opcode;
+    unsigned char  pil;
+    unsigned short a_reg;
+    unsigned short sts;
+    unsigned short pid;
+    unsigned short pie;
+    unsigned short iid;
+    unsigned short iie;
+    unsigned short devbits;  /* device interrupt bits from last IO_Tick */
+};
 
 
 #ifdef WITH_DEBUGGER
 	void stop_debugger_thread();
 	extern void start_debugger();
 
-#ifdef __EMSCRIPTEN__
-	/* WASM: single-threaded, no atomics needed */
-	int cpu_run_mode;
-	int cpu_stop_reason;
-	bool debugger_request_pause;
-	bool debugger_control_granted;
-#elif defined(_WIN32)
+#if !defined(__EMSCRIPTEN__) && defined(_WIN32)
     #include <windows.h>
-	volatile LONG cpu_run_mode;
-	volatile LONG cpu_stop_reason;
-	volatile LONG debugger_request_pause;
-	volatile LONG debugger_control_granted;
-#else
+#elif !defined(__EMSCRIPTEN__)
     #include <stdatomic.h>
 	#include <pthread.h>
-
-	atomic_int cpu_run_mode;           // CPURunMode
-	atomic_int cpu_stop_reason;     // CpuStopReason
-	atomic_bool debugger_request_pause; // set by DAP thread to request pause
-	atomic_bool debugger_control_granted; // set by CPU thread when paused and debugger can access
+#endif
 #endif
 
+// Run loop state of one machine (CpuState.run). The debugger thread shares the run mode
+// and the pause handshake with the CPU thread.
+struct CpuRunState {
+#ifdef WITH_DEBUGGER
+#ifdef __EMSCRIPTEN__
+	/* WASM: single-threaded, no atomics needed */
+	int runMode;
+	int stopReason;
+	bool requestPause;
+	bool controlGranted;
+#elif defined(_WIN32)
+	volatile LONG runMode;
+	volatile LONG stopReason;
+	volatile LONG requestPause;
+	volatile LONG controlGranted;
+#else
+	atomic_int runMode;             // CPURunMode
+	atomic_int stopReason;          // CpuStopReason
+	atomic_bool requestPause;       // set by DAP thread to request pause
+	atomic_bool controlGranted;     // set by CPU thread when paused and debugger can access
+#endif
+	uint32_t dbgPollCtr;            // emulated-instruction counter for async pause poll
 #else
-int CurrentCPURunMode;
+	int runMode;
 #endif
 
+	// Idle loop detection, see cpu_idle_check()
+	ushort idleLoopHead;
+	uint64_t idleLoopSeen;
+	int idleLoopHits;
+	ushort idleLoopRegs[16];				// Level 0 register row at the last pass through idleLoopHead
+	ushort idleLoopSTS;						// reg_STS at the last pass
+	uint32_t idleLoopWrites;					// cpu_mem_writes at the last pass
+
+	// CPU throttle
+	uint64_t throttleStartNs;
+	uint64_t throttleInstrCount;
+
+	uint16_t lastDeviceIrqBits;
+	struct RingEntry ringBuf[RING_SIZE];
+	int ringIdx;
+};
+
+#define cpu_run_mode                (gCpu->run->runMode)
+#define cpu_stop_reason             (gCpu->run->stopReason)
+#define debugger_request_pause      (gCpu->run->requestPause)
+#define debugger_control_granted    (gCpu->run->controlGranted)
+#define CurrentCPURunMode           (gCpu->run->runMode)
+#define throttle_start_ns           (gCpu->run->throttleStartNs)
+#define throttle_instr_count        (gCpu->run->throttleInstrCount)
+#define idleLoopHead                (gCpu->run->idleLoopHead)
+#define idleLoopSeen                (gCpu->run->idleLoopSeen)
+#define idleLoopHits                (gCpu->run->idleLoopHits)
+#define idleLoopRegs                (gCpu->run->idleLoopRegs)
+#define idleLoopSTS                 (gCpu->run->idleLoopSTS)
+#define idleLoopWrites              (gCpu->run->idleLoopWrites)
+#define last_device_irq_bits        (gCpu->run->lastDeviceIrqBits)
+#define ring_buf                    (gCpu->run->ringBuf)
+#define ring_idx                    (gCpu->run->ringIdx)
+
 #include "../machine/machine_types.h"
 #include "../machine/machine_protos.h"
 
@@ -111,16 +168,10 @@ void debugger_update_jpl_entrypoint(uint16_t ea);
 //#define DEBUG_TRAP
 
 // Global CPU variable definitions
-_NDRAM_ VolatileMemory;
+_Thread_local struct CpuState *gCpu = NULL;
 CpuType CurrentCPUType;
 
-
-struct CpuRegs *gReg = NULL;
-
-uint64_t  instr_counter = 0;
-ushort STARTADDR = 0;
 int DISASM = 0;
-int gCpuExitCode = 0;
 int CPU_TRACE = 0;
 
 /*
@@ -150,10 +201,6 @@ int CPU_RING_DUMP_SIZE = 0;
 
 
 
-// Used for TRAP handling to exit an instruction that fails
-jmp_buf cpu_jmp_buf;
-
-
 
 void do_op(ushort operand, bool isEXR)
 {
@@ -171,6 +218,8 @@ void do_op(ushort operand, bool isEXR)
 				   this way we are as flexible as possible as we
 				   implement io calls. */
 
+	STS_SYNC();
+
 }
 
 
@@ -258,20 +307,13 @@ ushort New_GetEffectiveAddr(ushort instr, bool *use_apt)
 ///  ----+----------+----------+------------------------------------------------------------------------
 ushort calcIIC()
 {
-	ushort priorityCode = gIID & gIIE;
+	ushort priorityCode = gIID & gIIE & 0x07FF; // Only sources 0-10 exist
 	if (priorityCode == 0)
 		return 0;
 
 	// printf("IID=0x%x, IIE=0x%x, priorityCode=0x%x\r\n", gIID, gIIE, priorityCode);
 
-	for (int i = 10; i >= 0; i--)
-	{
-		if ((priorityCode & (1 << i)) != 0)
-		{
-			return (ushort)i;
-		}
-	}
-	return 0;
+	return (ushort)highest_bit(priorityCode);
 }
 
 
@@ -302,25 +344,10 @@ void recalcInternalInterruptBits()
 // Calculate PK based on PID and PIE
 void calcPK()
 {
-	// Recalculate PK based on PID and PIE
-	int s;
-	ushort lvl;
-	ushort i;
-	gPK = 0;
-	i = gPIE & gPID;
-		
-	if (i)
-	{
-		// Check for detected and enabled bits. Highest bits has highest priority
-		for (lvl = 15; lvl >= 0; lvl--)
-		{
-			if (i & 1 << lvl)
-			{
-				gPK = lvl;
-				return;
-			}
-		}
-	}
+	// Detected and enabled levels. Highest bit has highest priority
+	ushort pending = gPIE & gPID;
+
+	gPK = pending ? highest_bit(pending) : 0;
 }
 
 /*
@@ -340,10 +367,7 @@ void interrupt(ushort lvl, ushort sub)
 		static const char *iic_names[] = {
 			"n/a", "MC", "MPV", "PF", "II", "Z", "PI", "IOX", "PTY", "MOR", "POW"
 		};
-		int iic_bit = -1;
-		for (int b = 10; b >= 0; b--) {
-			if (sub & (1 << b)) { iic_bit = b; break; }
-		}
+		int iic_bit = (sub & 0x07FF) ? highest_bit(sub & 0x07FF) : -1;
 		const char *iic_name = (iic_bit >= 0 && iic_bit <= 10) ? iic_names[iic_bit] : "?";
 
 		// Log internal interrupts on device levels (12-15) that cause TDTLEV ERRFATAL
@@ -479,6 +503,14 @@ ushort MemoryRead(ushort addr, bool UseAPT)
 
 ushort MemoryFetch(ushort addr, bool UseAPT)
 {
+	// Still on the page of the last fetch (see MapFetchAddress)
+	if (!UseAPT && FETCH_PAGE_HIT(addr)
+#ifdef WITH_DEBUGGER
+	    && (phys_watchpoint_count == 0)
+#endif
+	   )
+		return gCpu->fetchPage.mem[addr & 0x3FF];
+
 	return FetchVirtualMemory(addr, UseAPT); // in cpu_mms.c
 }
 
@@ -507,7 +539,7 @@ bool checkAndSwitch()
 			bool isRTC = ((gPVL == 13) || (gPIL == 13));
 			if (!isRTC)
 			{
-				printf("Switched from %d P[%6o] to %d P[%6o]\r\n", gPVL, gReg->reg[gPVL][_P], gPIL, gReg->reg[gPIL][_P]);
+				printf("Switched from %d P[%6o] to %d P[%6o]\r\n", gPVL, gReg->reg[gPVL][_P], gPIL, gLevelRegs[_P]);
 				printf("New pc after switch %6o\r\n", gPC);
 			}
 #endif
@@ -519,15 +551,19 @@ bool checkAndSwitch()
 
 
 
-// To reduce host load, we enable sleeping when the ND CPU is idle
-// The ND CPU is idle when running in level 0 in SINTRAN.
-// We detect that the CPU is idle by checking the gPIL register is == 0
-// But we only activate sleep when the CPU is idle for a while, and after it has been in another PIL level to achieve a quick boot.
-ushort lvlcnt=0;
-bool activateSleep = false;
-
-// allocate once
-ushort operand;
+// Idle detection.
+// The CPU is idle when it executed WAIT on level 0 (it then waits for an interrupt), or when
+// it runs the level 0 idle loop of an interrupt driven OS like SINTRAN. The idle loop is
+// recognized once the CPU has been on a higher level (to keep boot at full speed), and keeps
+// returning to the same address on level 0 within IDLE_LOOP_MAX_INSTR instructions without
+// changing memory, any level 0 register or STS. A loop that computes anything fails that
+// test and runs at full speed.
+// While idle, virtual time is fast-forwarded to the next device event and the host sleeps
+// for the same amount of wall clock time, or until HostWait_Signal() reports new input.
+#define IDLE_LOOP_MAX_INSTR	64
+#define IDLE_LOOP_MIN_HITS	8
+#define IDLE_MAX_SKIP		1125000		/* ~1s at 1.125 MHz, if no device has an event pending */
+#define IDLE_MIN_SLEEP_NS	50000		/* Shorter idle spans are skipped without sleeping */
 
 /// @brief CPU tick function - DO NOT CALL THIS DIRECT AS IT NEES setjmp() setup correctly
 /// @details This function is called every CPU tick. It fetches the next instruction, executes it, and handles interrupts.
@@ -540,7 +576,8 @@ void private_cpu_tick()
 	gReg->myreg_PFB = MemoryFetch(gPC, false); //TODO: Remove this  step?
 	gReg->myreg_IR = gReg->myreg_PFB;
 
-	operand = gReg->myreg_IR;	
+	ushort operand = gReg->myreg_IR;
+	gCpu->operand = operand;
 
 
 	// Dissasemble ?
@@ -589,24 +626,6 @@ void private_cpu_tick()
 		return;
 	}
 
-	if (gPIL>0)
-		activateSleep = true;
-
-
-	if (activateSleep)
-	{
-		// Check if we need to sleep
-		lvlcnt = (gPIL == 0) ? (lvlcnt + 1) : 0;
-
-		if (lvlcnt > 10000)
-		{
-#ifndef __EMSCRIPTEN__
-			sleep_ms(1); // Sleep 1 ms - skip on WASM to avoid blocking browser
-#endif
-			lvlcnt = 0;
-		}
-	}
-
 #ifdef WITH_DEBUGGER
 	if (gDebuggerEnabled)
 	{
@@ -633,6 +652,167 @@ void private_cpu_tick()
 #endif
 }
 
+/// @brief Production variant of private_cpu_tick, with the tracing and debugging hooks left out
+/// @details Only called from cpu_run_lean, when cpu_instrumented() is false.
+static void cpu_tick_lean()
+{
+	checkAndSwitch();
+
+	ushort operand = MemoryFetch(gPC, false);
+	gReg->myreg_PFB = operand;
+	gReg->myreg_IR = operand;
+	gCpu->operand = operand;
+
+	instr_counter++;
+	do_op(operand, false);
+}
+
+/// @brief Check if instructions can run through the block runner
+/// @details Any tracing, debugging or throttling needs the per-instruction path in private_cpu_tick.
+static inline bool cpu_block_run_allowed()
+{
+	return !DISASM && !CPU_TRACE && !BSD_DEBUG && !CPU_BREAKPOINT_ENABLED
+		&& (CPU_RING_DUMP_SIZE <= 0) && !cpu_throttle_enabled && !gDebuggerEnabled;
+}
+
+/// @brief Check if any setting needs the instrumented run loop
+/// @details Tracing, debugging, throttling, the instruction limit or the ring buffer dump.
+static inline bool cpu_instrumented()
+{
+	return !cpu_block_run_allowed() || (CPU_MAX_INSTR > 0);
+}
+
+/// @brief Check if the CPU is idle on level 0 with no interrupt pending
+/// @details Called between blocks (or single instructions) from cpu_run.
+static inline bool cpu_idle_check()
+{
+	if (gPIL > 0)
+	{
+		activateSleep = true;
+		cpu_wait_idle = false;
+		idleLoopHits = 0;
+		return false;
+	}
+
+	if (gCHKIT || !STS_IONI || ((gPID & gPIE) & 0xFFFE))
+		return false;
+
+	if (cpu_wait_idle)
+		return true;
+
+	if (!activateSleep)
+		return false;
+
+	if (gPC == idleLoopHead)
+	{
+		bool same = (instr_counter - idleLoopSeen <= IDLE_LOOP_MAX_INSTR)
+			&& (cpu_mem_writes == idleLoopWrites)
+			&& (gReg->reg_STS == idleLoopSTS)
+			&& (memcmp(gLevelRegs, idleLoopRegs, sizeof(idleLoopRegs)) == 0);
+		idleLoopHits = same ? (idleLoopHits + 1) : 0;
+	}
+	else if (instr_counter - idleLoopSeen > IDLE_LOOP_MAX_INSTR)
+	{
+		// Not back at the old head in time, start over from here
+		idleLoopHead = gPC;
+		idleLoopHits = 0;
+	}
+	else
+		return idleLoopHits >= IDLE_LOOP_MIN_HITS;
+
+	// Start of a pass: compare the next one against this state
+	idleLoopSeen = instr_counter;
+	idleLoopWrites = cpu_mem_writes;
+	idleLoopSTS = gReg->reg_STS;
+	memcpy(idleLoopRegs, gLevelRegs, sizeof(idleLoopRegs));
+
+	return idleLoopHits >= IDLE_LOOP_MIN_HITS;
+}
+
+/// @brief Fast-forward virtual time while the CPU is idle
+/// @details Advances instr_counter to the next device event (or by 'budget'), sleeping the host
+/// for the matching wall clock time at the throttle rate. If woken by host input, only the time
+/// actually slept is skipped, but at least up to the next device poll so the input is picked up.
+/// @param budget Maximum number of ticks to skip
+/// @return Number of ticks skipped
+static int cpu_idle_skip(int budget)
+{
+	if ((budget <= 0) || (io_next_event <= instr_counter))
+		return 0;
+
+	uint64_t span = io_next_event - instr_counter;
+	if (span > IDLE_MAX_SKIP)
+		span = IDLE_MAX_SKIP;
+	if (span > (uint64_t)budget)
+		span = (uint64_t)budget;
+	if (CPU_MAX_INSTR > 0)
+	{
+		uint64_t left = (CPU_MAX_INSTR > instr_counter) ? (CPU_MAX_INSTR - instr_counter) : 0;
+		if (left < span)
+			span = left;
+	}
+
+	uint64_t sleep_ns = (uint64_t)(span * 1000.0 / cpu_throttle_mhz);
+	if (sleep_ns >= IDLE_MIN_SLEEP_NS)
+	{
+		uint64_t start_ns = throttle_get_ns();
+		if (HostWait_Sleep(sleep_ns))
+		{
+			uint64_t slept = (uint64_t)((throttle_get_ns() - start_ns) * cpu_throttle_mhz / 1000.0);
+			uint64_t to_poll = (io_next_tick > instr_counter) ? (io_next_tick - instr_counter) : 0;
+			uint64_t advance = (slept > to_poll) ? slept : to_poll;
+			if (advance < span)
+				span = advance;
+		}
+	}
+
+	instr_counter += span;
+	return (int)span;
+}
+
+/// @brief Run pre-decoded instructions until the end of a basic block
+/// @details Stops after a branch, IOX or other level/IO changing instruction, when a level
+/// switch is pending (gCHKIT), when a device deadline is reached or after 'budget' instructions.
+/// Behaves as repeated calls to private_cpu_tick with tracing and debugging disabled.
+/// Builds with CPU_THREADED_DISPATCH run the block through Dispatch_RunBlock (cpu_instr.c).
+/// @param budget Maximum number of instructions to execute
+/// @return Number of instructions executed (0 if a level switch check is pending)
+static int cpu_run_block(int budget)
+{
+	int count = 0;
+
+#ifdef CPU_THREADED_DISPATCH
+	count = Dispatch_RunBlock(budget);
+#else
+	while (count < budget)
+	{
+		// checkAndSwitch() is a no-op unless gCHKIT is set; let the normal path handle it
+		if (gCHKIT)
+			break;
+
+		DecodedInstr *di = DecodeCache_Fetch(gPC);
+		ushort op = di->operand;
+		InstrFunc handler = di->handler;
+		bool blockEnd = (di->flags & DC_BLOCK_END) != 0;
+
+		gReg->myreg_PFB = op;
+		gReg->myreg_IR = op;
+		gCpu->operand = op;
+
+		instr_counter++;
+		count++;
+		gPC++;
+		handler(op);
+
+		if (blockEnd || (instr_counter >= io_next_tick))
+			break;
+	}
+#endif
+
+	STS_SYNC();
+	return count;
+}
+
 /// @brief Helper function for debugger to check if the next instruction is a jump, conditional jump or skp 
 /// @return true if the next instruction is a jump, jaf, or similar, false otherwise
 bool cpu_instruction_is_jump()
@@ -680,22 +860,6 @@ bool cpu_instruction_is_jump()
 
 /// @brief run the CPU for a number of ticks. 
 /// @details This function runs the CPU for a number of ticks. It handles interrupts and checks for level switches.
-/* Ring buffer for last N instructions before exit */
-#define RING_SIZE 512
-static struct {
-    unsigned short pc;
-    unsigned short opcode;
-    unsigned char  pil;
-    unsigned short a_reg;
-    unsigned short sts;
-    unsigned short pid;
-    unsigned short pie;
-    unsigned short iid;
-    unsigned short iie;
-    unsigned short devbits;  /* device interrupt bits from last IO_Tick */
-} ring_buf[RING_SIZE];
-static int ring_idx = 0;
-
 static void ring_record(unsigned short pc, unsigned char pil, unsigned short opcode) {
     if (CPU_RING_DUMP_SIZE <= 0) return;
     ring_buf[ring_idx].pc = pc;
@@ -752,12 +916,49 @@ void ring_dump(void) {
     }
 }
 
+/// @brief Production run loop, without any of the tracing, debugging or throttling checks
+/// @details Returns when the CPU leaves CPU_RUNNING, when 'ticks' is used up, or when a setting
+/// calls for the instrumented loop in cpu_run. The settings can change from the menu or the DAP
+/// thread, they are checked again every time the devices are ticked.
+/// @param ticks Number of ticks to run the CPU. Use -1 for infinite.
+/// @return Returns the number of ticks left to run.
+static int cpu_run_lean(int ticks)
+{
+	while ((ticks != 0) && (get_cpu_run_mode() == CPU_RUNNING))
+	{
+		int executed = cpu_run_block((ticks > 0) ? ticks : INT_MAX);
+
+		if (executed == 0)
+		{
+			cpu_tick_lean();
+			executed = 1;
+		}
+
+		// Idle on level 0: skip ahead to the next device event instead of running the idle loop
+		if (cpu_idle_check())
+			executed += cpu_idle_skip((ticks > 0) ? (ticks - executed) : INT_MAX);
+
+		if (ticks > 0)
+			ticks -= executed;
+
+		// Tick IO devices when the earliest device deadline has passed
+		if (instr_counter >= io_next_tick)
+		{
+			IO_Tick();
+
+			if (cpu_instrumented())
+				break;
+		}
+	}
+
+	return ticks;
+}
+
 /// @param ticks Number of ticks to run the CPU. Use -1 for infinite.
 /// @return Returns the number of ticks left to run.
 int cpu_run(int ticks)
 {
 #ifdef WITH_DEBUGGER
-	static uint32_t dbg_poll_ctr = 0;   // emulated-instruction counter for async pause poll
 	if (get_debugger_control_granted()) {
 #ifndef __EMSCRIPTEN__
 		sleep_ms(100); // Portable (POSIX nanosleep / Windows Sleep)
@@ -787,31 +988,61 @@ int cpu_run(int ticks)
 #ifdef DEBUG_TRAP
 		printf("CPU: Interrupt handler returned, PC=%06o, PGS=%04x\n", gPC, gPGS);
 #endif
+		STS_SYNC(); // The faulting block did not get to write its flags
 	}
 
 	
 	while (ticks !=0 )
 	{
+		// Run without the per block checks below, until one of them is switched on
+		if (!cpu_instrumented())
+		{
+			ticks = cpu_run_lean(ticks);
+			if (ticks == 0)
+				break;
+		}
+
 		CPURunMode current_run_mode = get_cpu_run_mode();
 
 
         
 		if (current_run_mode == CPU_RUNNING) // Including Normal and Paused (=debugger mode)
 		{
+			int executed = 0;
+
+			if (cpu_block_run_allowed())
+			{
+				int budget = (ticks > 0) ? ticks : INT_MAX;
+
+				if (CPU_MAX_INSTR > 0)
+				{
+					uint64_t left = (CPU_MAX_INSTR > instr_counter) ? (CPU_MAX_INSTR - instr_counter) : 0;
+					if (left < (uint64_t)budget)
+						budget = (int)left;
+				}
+
+				executed = cpu_run_block(budget);
+			}
+
+			if (executed == 0)
 			{
 				ushort pre_pc = gPC;
 				ushort pre_pil = gPIL;
 				private_cpu_tick();
-				ring_record(pre_pc, pre_pil, operand);
+				ring_record(pre_pc, pre_pil, gCpu->operand);
+				executed = 1;
 			}
 
-			// Tick IO devices pr cpu tick
-			IO_Tick();
+			// Idle on level 0: skip ahead to the next device event instead of running the idle loop
+			if (cpu_idle_check())
+				executed += cpu_idle_skip((ticks > 0) ? (ticks - executed) : INT_MAX);
+
+			// Tick IO devices when the earliest device deadline has passed
+			if (instr_counter >= io_next_tick)
+				IO_Tick();
 
 			// CPU throttle: sleep if running ahead of target speed
 			if (cpu_throttle_enabled) {
-				static uint64_t throttle_start_ns = 0;
-				static uint64_t throttle_instr_count = 0;
 				#define THROTTLE_CHECK_INTERVAL 10550  // Check every RTC period
 
 				if (throttle_start_ns == 0) {
@@ -842,7 +1073,7 @@ int cpu_run(int ticks)
 
 			if (ticks > 0)
 			{
-				ticks--;
+				ticks -= executed;
 			}
 
 #ifdef WITH_DEBUGGER
@@ -881,8 +1112,8 @@ int cpu_run(int ticks)
 		// emulated time. Running faster than real-time only shortens the wall-clock
 		// latency, never lengthens it, so this is robust to any throttle/"max" speed.
 		#define DBG_POLL_INSTR (10550 * 10)
-		if (gDebuggerEnabled && ++dbg_poll_ctr >= DBG_POLL_INSTR) {
-			dbg_poll_ctr = 0;
+		if (gDebuggerEnabled && ++gCpu->run->dbgPollCtr >= DBG_POLL_INSTR) {
+			gCpu->run->dbgPollCtr = 0;
 			if (get_debugger_request_pause()) {
 				// return ASAP, let the caller handle the debugger request
 				return ticks;
@@ -894,14 +1125,57 @@ int cpu_run(int ticks)
 	return ticks;	
 }
 
+#if !defined(__EMSCRIPTEN__) && defined(_WIN32)
+#include <windows.h>
+
+static BOOL CALLBACK setup_instructions_cb(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+	(void)once; (void)param; (void)context;
+	Setup_Instructions();
+	return TRUE;
+}
+#elif !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#endif
+
+/// @brief Build the instruction tables once per process
+/// @details instr_funcs and the dispatch slots are shared by every machine. Machines
+/// started on other threads must not rebuild them while another machine is running.
+static void setup_instructions_once(void)
+{
+#if defined(_WIN32) && !defined(__EMSCRIPTEN__)
+	static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+	InitOnceExecuteOnce(&once, setup_instructions_cb, NULL, NULL);
+#elif !defined(__EMSCRIPTEN__)
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+	pthread_once(&once, Setup_Instructions);
+#else
+	static bool done = false;
+	if (!done)
+	{
+		Setup_Instructions();
+		done = true;
+	}
+#endif
+}
 
 void cpu_init(bool debuggerEnabled, int debuggerPort)
 {
 	/* initialize an empty register set */
-	gReg = calloc(1, sizeof(struct CpuRegs));
+	gCpu = calloc(1, sizeof(struct CpuState));
+	if (gCpu)
+		gCpu->run = calloc(1, sizeof(struct CpuRunState));
+	if (!gCpu || !gCpu->run)
+	{
+		fprintf(stderr, "Unable to allocate the CPU state\n");
+		exit(EXIT_FAILURE);
+	}
+	gMachine->cpu = gCpu;
+	SyncLevelRegs();
 
-	/* Initialize volatile memory to zero */
-	memset(&VolatileMemory, 0, sizeof(VolatileMemory));
+	/* Allocate volatile memory, zero filled */
+	cpu_memory_init();
+	DecodeCache_Flush();
 
 	// setbit(_STS, _O, 1);
 	setbit_STS_MSB(_N100, 1);
@@ -915,7 +1189,7 @@ void cpu_init(bool debuggerEnabled, int debuggerPort)
 	CreatePagingTables();
 
 	/* OK lets set up the parsing for our current cpu before we start it. */
-	Setup_Instructions();
+	setup_instructions_once();
 
 	gALD = 01560; // oct 1560 (ALD position 4, Binary load from 1560) // Floppy
 
@@ -945,13 +1219,16 @@ void cpu_reset()
 {
 
 	/* Initialize volatile memory to zero */
-	memset(&VolatileMemory, 0, sizeof(VolatileMemory));
+	cpu_memory_clear();
+	DecodeCache_Flush();
 
 	// Reset registers (preserve debugger state across reset)
 #ifdef WITH_DEBUGGER
 	bool saved_debugger_enabled = gDebuggerEnabled;
 #endif
 	memset(gReg, 0, sizeof(struct CpuRegs));
+	memset(&gCpu->lazyFlags, 0, sizeof(LazyFlags));
+	SyncLevelRegs();
 #ifdef WITH_DEBUGGER
 	gDebuggerEnabled = saved_debugger_enabled;
 #endif
@@ -968,15 +1245,21 @@ void cpu_reset()
 
 
 	set_cpu_run_mode(CPU_RUNNING);
-	instr_counter = 0;
+
+	// instr_counter is NOT cleared here. It is the device scheduler's clock, and the
+	// devices keep their deadlines across a CPU reset.
 }
 
 /// @brief Cleanup the CPU
-/// @details This function cleans up the CPU. It destroys the paging tables and stops the debugger thread.
+/// @details This function cleans up the CPU. It destroys the paging tables, stops the debugger thread
+/// and frees the CPU state of the current machine.
 void cleanup_cpu()
 {
+	if (!gCpu) return;
+
 	// Destroy paging tables
 	DestroyPagingTables();
+	DecodeCache_Destroy();
 
 #ifdef WITH_DEBUGGER
 	if (gDebuggerEnabled)
@@ -985,6 +1268,12 @@ void cleanup_cpu()
     }
 #endif
 
+	cpu_memory_free();
+	free(gCpu->run);
+	free(gCpu);
+	gCpu = NULL;
+	gMachine->cpu = NULL;
+
 }
 
 
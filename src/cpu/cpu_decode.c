@@ -0,0 +1,135 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_types.h"
+#include "cpu_protos.h"
+
+// Lowest address that can be page table shadow memory (MMS-2 with SEXI)
+#define DC_SHADOW_LOW 0xF800
+
+// The cache of the current machine is CpuState.decodeCache. Fetches that can not be
+// cached (shadow memory, out of range) are decoded into its uncachedInstr scratch entry.
+#define uncachedInstr (gCpu->uncachedInstr)
+
+/// @brief Check if an instruction can transfer control, or change level or IO state
+/// @details The block runner returns to cpu_run after these so the normal checkpoints run.
+static bool IsBlockEnd(ushort op)
+{
+	if ((op & 0xF800) == 0124000) return true;	// JMP
+	if ((op & 0xF800) == 0134000) return true;	// JPL
+	if ((op & 0xF800) == 0130000) return true;	// CJP (JAP..JXN)
+	if ((op & 0xF8C0) == 0140000) return true;	// SKP
+	if ((op & 0xFFC0) == 0140600) return true;	// EXR
+	if ((op & 0xFFC0) == 0143600) return true;	// IDENT
+	if ((op & 0xF800) == 0144000 && (op & 07) == _P) return true; // ROP with P as destination
+	if ((op & 0xFC00) == 0150000) return true;	// TRA/TRR/MST/MCL/IOXT/WAIT/ION/IOF/PON/POF/SEX/REX ...
+	if ((op & 0xF800) == 0164000) return true;	// IOX
+	return false;
+}
+
+static void DecodeInstr(DecodedInstr *di, ushort op)
+{
+	di->operand = op;
+	di->flags = IsBlockEnd(op) ? DC_BLOCK_END : 0;
+
+	if (instr_funcs[op] != NULL)
+	{
+		di->handler = instr_funcs[op];
+		di->dispatch = dispatch_slot[op];
+	}
+	else
+	{
+		di->handler = illegal_instr;
+		di->dispatch = 0;
+		di->flags |= DC_BLOCK_END;
+	}
+}
+
+/// @brief Fetch the instruction at a virtual address through the decode cache
+/// @details Translation and fault handling are exactly as for MemoryFetch.
+/// @return The decoded instruction. Only valid until the next fetch.
+DecodedInstr *DecodeCache_Fetch(ushort addr)
+{
+	// Still on the page of the last fetch
+	FetchPage *fp = &gCpu->fetchPage;
+	if (FETCH_PAGE_HIT(addr) && fp->decoded)
+	{
+		DecodedInstr *di = &fp->decoded->instr[addr & 0x3FF];
+		if (!di->handler)
+			DecodeInstr(di, fp->mem[addr & 0x3FF]);
+
+		return di;
+	}
+
+	int pa = MapFetchAddress(addr);
+
+	if ((pa < 0) || (pa >= (int)ND_Memsize) || ((pa >= DC_SHADOW_LOW) && (pa <= 0xFFFF)))
+	{
+		// Same result as FetchVirtualMemory, but not kept
+		DecodeInstr(&uncachedInstr, (pa < 0) ? 0 : ReadPhysicalMemory(pa, false));
+		return &uncachedInstr;
+	}
+
+	DecodedPage *page = decodeCache.pages[pa >> 10];
+	if (!page)
+	{
+		page = calloc(1, sizeof(DecodedPage));
+		if (!page)
+		{
+			DecodeInstr(&uncachedInstr, VolatileMemory.n_Array[pa]);
+			return &uncachedInstr;
+		}
+		decodeCache.pages[pa >> 10] = page;
+	}
+	if (FETCH_PAGE_HIT(addr))
+		fp->decoded = page;
+
+	DecodedInstr *di = &page->instr[pa & 0x3FF];
+	if (!di->handler)
+		DecodeInstr(di, VolatileMemory.n_Array[pa]);
+
+	return di;
+}
+
+/// @brief Drop all pre-decoded instructions (memory cleared or loaded in bulk)
+void DecodeCache_Flush()
+{
+	for (int i = 0; i < MEMPTSIZE; i++)
+	{
+		if (decodeCache.pages[i])
+			memset(decodeCache.pages[i], 0, sizeof(DecodedPage));
+	}
+}
+
+/// @brief Free the decode cache pages
+void DecodeCache_Destroy()
+{
+	for (int i = 0; i < MEMPTSIZE; i++)
+	{
+		free(decodeCache.pages[i]);
+		decodeCache.pages[i] = NULL;
+	}
+	gCpu->fetchPage.decoded = NULL;
+}
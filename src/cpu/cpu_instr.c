@@ -30,6 +30,7 @@
 
 #include "cpu_types.h"
 #include "cpu_protos.h"
+#include "float48.h"
 
 
 // Initialize the instruction function array
@@ -79,28 +80,21 @@ short signExtend(ushort x)
 }
 
 
+/// @brief Add with carry in, setting C, O and Q lazily
+/// @details The flags are written to STS by STS_SYNC(), see STS_Materialize.
 ushort do_add(ushort a, ushort b, ushort k)
 {
-	int tmp;
-	bool is_diff;
-	tmp = ((int)a) + ((int)b) + ((int)k);
-	/* C (carry) */
-	if (tmp & 0xffff0000)
-		setbit(_STS, _C, 1);
-	else
-		setbit(_STS, _C, 0);
-	/* O(static overflow), Q (dynamic overflow) */
-	is_diff = (((1 << 15) & a) ^ ((1 << 15) & b)); /* is bit 15 of the two operands different? */
-	if (!(is_diff) && (((1 << 15) & a) ^ ((1 << 15) & tmp)))
-	{						 /* if equal and result is different... */
-		setbit(_STS, _O, 1); // Static overflow
-		setbit(_STS, _Q, 1); // Dynamic overflow (Instruction test shows Q must be set)
-	}
-	else
-	{
-		setbit(_STS, _Q, 0);
-		//setbit(_STS, _O, 0); NO!
-	}
+	LazyFlags *lf = &gCpu->lazyFlags;
+	int tmp = ((int)a) + ((int)b) + ((int)k);
+
+	// O (static overflow) is never cleared, keep it from an add that was not written yet
+	if (lf->pending && ADD_OVERFLOW(lf->a, lf->b, lf->sum))
+		lf->overflow = true;
+
+	lf->a = a;
+	lf->b = b;
+	lf->sum = tmp;
+	lf->pending = true;
 	return (ushort)tmp;
 }
 
@@ -472,6 +466,123 @@ void ndfunc_skp(ushort operand)
 		gPC++;
 }
 
+/*
+ * Byte fields (BFILL, MOVB, MOVBF).
+ * Byte i of a field starting at word 'base' is in word base + ((i + lr) >> 1), in the right
+ * half (LSB) when (i + lr) is odd.
+ *
+ * The first byte on each source and destination page goes through MemoryRead/MemoryWrite, so
+ * page faults, MPVs, PTE bits and shadow memory are handled at exactly the same byte as in a
+ * byte by byte loop. The rest of the bytes on those pages are moved directly in physical
+ * memory (see MapSpanPage), a whole word at a time where both halves come from one word.
+ */
+#define FIELD_WORD(base, lr, i) ((ushort)((base) + (((i) + (lr)) >> 1)))
+
+// Fill 'len' bytes of a field with 'thebyte'
+static void FillField(ushort dest, ushort lr, bool apt, ushort thebyte, int len)
+{
+	int i = 0;
+	while (i < len)
+	{
+		ushort addr = FIELD_WORD(dest, lr, i);
+		MemoryWrite(thebyte, addr, apt, ((i + lr) & 1));
+		i++;
+
+		ushort *page = MapSpanPage(addr, WRITE, apt);
+		if (!page)
+			continue;
+
+		uint pa = (uint)(page - VolatileMemory.n_Array);
+		ushort vpn = addr >> 10;
+		MEM_MARK_DIRTY(pa);
+		cpu_mem_writes++;	// The direct stores below bypass WritePhysicalMemoryWM
+
+		for (; i < len; i++)
+		{
+			addr = FIELD_WORD(dest, lr, i);
+			if ((addr >> 10) != vpn)
+				break;
+
+			ushort *w = &page[addr & 0x3FF];
+			DC_INVALIDATE(pa + (addr & 0x3FF));
+			if ((i + lr) & 1)
+			{
+				*w = (*w & 0xFF00) | thebyte;
+			}
+			else if (i + 1 < len)
+			{
+				*w = thebyte | (thebyte << 8);
+				i++;
+			}
+			else
+			{
+				*w = (*w & 0x00FF) | (thebyte << 8);
+			}
+		}
+	}
+}
+
+// Move 'len' bytes from one field to another, from the last byte down when 'descending'.
+// The source byte is picked with the destination byte position, as MOVB/MOVBF always did.
+static void MoveField(ushort source, ushort s_lr, bool s_apt, ushort dest, ushort d_lr, bool d_apt, int len, bool descending)
+{
+	int step = descending ? -1 : 1;
+	int i = descending ? len - 1 : 0;
+	int left = len;
+
+	while (left > 0)
+	{
+		ushort addr_s = FIELD_WORD(source, s_lr, i);
+		ushort addr_d = FIELD_WORD(dest, d_lr, i);
+		ushort thebyte = MemoryRead(addr_s, s_apt);
+		thebyte = ((i + d_lr) & 1) ? thebyte : (thebyte >> 8) & 0xff; /* right, LSB : left, MSB */
+		MemoryWrite(thebyte, addr_d, d_apt, ((i + d_lr) & 1));
+		i += step;
+		left--;
+
+		ushort *spage = MapSpanPage(addr_s, READ, s_apt);
+		ushort *dpage = spage ? MapSpanPage(addr_d, WRITE, d_apt) : NULL;
+		if (!dpage)
+			continue;
+
+		uint dpa = (uint)(dpage - VolatileMemory.n_Array);
+		ushort s_vpn = addr_s >> 10;
+		ushort d_vpn = addr_d >> 10;
+		MEM_MARK_DIRTY(dpa);
+		cpu_mem_writes++;	// The direct stores below bypass WritePhysicalMemoryWM
+
+		// Both halves of a destination word come from the same source word when the fields line up
+		int pairStart = descending ? 1 : 0;
+
+		for (; left > 0; i += step, left--)
+		{
+			addr_s = FIELD_WORD(source, s_lr, i);
+			addr_d = FIELD_WORD(dest, d_lr, i);
+			if (((addr_s >> 10) != s_vpn) || ((addr_d >> 10) != d_vpn))
+				break;
+
+			ushort *ws = &spage[addr_s & 0x3FF];
+			ushort *wd = &dpage[addr_d & 0x3FF];
+			DC_INVALIDATE(dpa + (addr_d & 0x3FF));
+
+			if ((s_lr == d_lr) && (left >= 2) && (((i + d_lr) & 1) == pairStart))
+			{
+				*wd = *ws;
+				i += step;
+				left--;
+			}
+			else if ((i + d_lr) & 1)
+			{
+				*wd = (*wd & 0xFF00) | (*ws & 0xFF);
+			}
+			else
+			{
+				*wd = (*wd & 0x00FF) | (*ws & 0xFF00);
+			}
+		}
+	}
+}
+
 /// <summary>
 /// BFILL - Byte Fill
 /// Code: 140 130
@@ -512,20 +623,16 @@ void ndfunc_bfill_new(ushort operand)
 
 void ndfunc_bfill(ushort operand)
 {
-	ushort d1, d2, len, addr, i;
+	ushort d1, len, i;
 	ushort right = (gT & ((ushort)1 << 15)) ? 1 : 0;	   /* Start with right byte? (LSB) */
 	bool is_apt = (gT & ((ushort)1 << 14)) ? true : false; /* Use APT or not? */
 	ushort thebyte = gA & 0xff;
 	len = gT & 0x0fff; /* Number of bytes to do */
-	addr = gX;		   /* just in case we do 0 bytes */
 	d1 = gX;
-	d2 = gT;
 	
-	for (i = 0; i < len; i++)
-	{
-		addr = d1 + ((i + right) >> 1); /* Word adress of byte to write */
-		MemoryWrite(thebyte, addr, is_apt, ((i + right) & 1));
-	}
+	FillField(d1, right, is_apt, thebyte, len);
+	i = len;
+
 	gT &= 0x7000;				   /* Null number of bytes, as per manual, also null bit 15 */
 	gT |= ((i + right) & 1) << 15; /* set bit 15 to point to next free byte */
 	gX = d1 + ((i + right) >> 1);
@@ -829,87 +936,63 @@ void ndfunc_ora(ushort operand)
 	gA = gA | MemoryRead(gEA, gUseAPT);
 }
 
+/* Read a 48-bit floating number from three words in memory */
+static inline uint64_t ReadFloat48(ushort addr, bool UseAPT)
+{
+	ushort t = MemoryRead(addr, UseAPT);
+	ushort a = MemoryRead(addr + 1, UseAPT);
+	ushort d = MemoryRead(addr + 2, UseAPT);
+	return ND48(t, a, d);
+}
+
+/* Floating accumulator {T,A,D} */
+static inline void SetFloatAcc(uint64_t f)
+{
+	gT = ND48_T(f);
+	gA = ND48_A(f);
+	gD = ND48_D(f);
+}
+
 /* FAD
  */
 void ndfunc_fad(ushort operand)
 {
 	gEA = New_GetEffectiveAddr(operand, &gUseAPT);
-
-	ushort a[3], b[3], r[3];
-
-	a[0] = gT;
-	a[1] = gA;
-	a[2] = gD;
-	b[0] = MemoryRead(gEA + 0, gUseAPT);
-	b[1] = MemoryRead(gEA + 1, gUseAPT);
-	b[2] = MemoryRead(gEA + 2, gUseAPT);
-	NDFloat_Add(a, b, r);
-	gT = r[0];
-	gA = r[1];
-	gD = r[2];
+	uint64_t b = ReadFloat48(gEA, gUseAPT);
+	SetFloatAcc(NDFloat48_Add(ND48(gT, gA, gD), b));
 }
 
 /* FSB
  */
 void ndfunc_fsb(ushort operand)
 {
-	ushort a[3], b[3], r[3];
-
 	gEA = New_GetEffectiveAddr(operand, &gUseAPT);
-
-	a[0] = gT;
-	a[1] = gA;
-	a[2] = gD;
-	b[0] = MemoryRead(gEA + 0, gUseAPT);
-	b[1] = MemoryRead(gEA + 1, gUseAPT);
-	b[2] = MemoryRead(gEA + 2, gUseAPT);
-	NDFloat_Sub(a, b, r);
-	gT = r[0];
-	gA = r[1];
-	gD = r[2];
+	uint64_t b = ReadFloat48(gEA, gUseAPT);
+	SetFloatAcc(NDFloat48_Sub(ND48(gT, gA, gD), b));
 }
 
 /* FMU
  */
 void ndfunc_fmu(ushort operand)
 {
-	ushort a[3], b[3], r[3];
-
 	gEA = New_GetEffectiveAddr(operand, &gUseAPT);
-
-	a[0] = gT;
-	a[1] = gA;
-	a[2] = gD;
-	b[0] = MemoryRead(gEA + 0, gUseAPT);
-	b[1] = MemoryRead(gEA + 1, gUseAPT);
-	b[2] = MemoryRead(gEA + 2, gUseAPT);
-	NDFloat_Mul(a, b, r);
-	gT = r[0];
-	gA = r[1];
-	gD = r[2];
+	uint64_t b = ReadFloat48(gEA, gUseAPT);
+	SetFloatAcc(NDFloat48_Mul(ND48(gT, gA, gD), b));
 }
 
 /* FDV
  */
 void ndfunc_fdv(ushort operand)
 {
-	ushort a[3], b[3], r[3];
+	uint64_t r;
 
 	gEA = New_GetEffectiveAddr(operand, &gUseAPT);
-
-	a[0] = gT;
-	a[1] = gA;
-	a[2] = gD;
-	b[0] = MemoryRead(gEA + 0, gUseAPT);
-	b[1] = MemoryRead(gEA + 1, gUseAPT);
-	b[2] = MemoryRead(gEA + 2, gUseAPT);
-	if (NDFloat_Div(a, b, r)) {
+	uint64_t b = ReadFloat48(gEA, gUseAPT);
+	if (!NDFloat48_Div(ND48(gT, gA, gD), b, &r)) {
 		/* Division by zero - set error indicator Z */
 		setbit(_STS, _Z, 1);
 	}
-	gT = r[0];
-	gA = r[1];
-	gD = r[2];
+	SetFloatAcc(r);
 }
 
 /* JMP
@@ -991,7 +1074,8 @@ bool UpdateMemoryIO()
 		// Test #5 in "MEMORY - Version: D00 - 1986-10-30" fails, because it expects and interrupt - but at the moment I dont know why..
 		if (gECCR != gA)
 		{
-			gECCR = gA;			
+			gECCR = gA;
+			gPT.tlbEpoch++; // ECC simulation must see every fetch
 		}
 		return true;
 	default:
@@ -1110,6 +1194,7 @@ void ndfunc_irw(ushort operand)
 	if (dr == _STS)
 	{
 		// Update STS lower bits (which is unique for each runlevel)
+		STS_SYNC();
 		gReg->reg[level][_STS] = (gA & 0x00FF);
 	}
 	else
@@ -1136,6 +1221,7 @@ void ndfunc_irr(ushort operand)
 
 	if (sr == 0) // STS
 	{
+		STS_SYNC();
 		gA = gReg->reg[level][_STS] & 0xFF; // read only lower 8 bits
 	}
 	else
@@ -1539,7 +1625,8 @@ void ndfunc_init(ushort operand)
 		gPC += 5;
 		return;
 	}
-	if ((flag & 0x01) != (gReg->reg[gPIL][_STS] & 0x01))
+	STS_SYNC();
+	if ((flag & 0x01) != (gLevelRegs[_STS] & 0x01))
 	{
 		gPC += 5;
 		return;
@@ -1696,8 +1783,8 @@ void regop(ushort operand)
 	sr = ((operand & 0x0038) >> 3);
 	dr = (operand & 0x0007);
 
-	source = (sr == 0) ? 0 : gReg->reg[CurrLEVEL][sr] & 0xFFFF;	 /* handles special case when sr=STS reg */
-	destination = (CLD) ? 0 : gReg->reg[CurrLEVEL][dr] & 0xFFFF; // Get destination value
+	source = (sr == 0) ? 0 : gLevelRegs[sr] & 0xFFFF;	 /* handles special case when sr=STS reg */
+	destination = (CLD) ? 0 : gLevelRegs[dr] & 0xFFFF; // Get destination value
 
 	switch (RAD)
 	{
@@ -1707,19 +1794,21 @@ void regop(ushort operand)
 			switch ((operand & 0x0300) >> 8)
 			{
 			case 0:								/* SWAP */
-				tmp = gReg->reg[CurrLEVEL][dr]; /* temp if we need to do the swap */
-				gReg->reg[CurrLEVEL][dr] = (CM1) ? ~source : source;
-				gReg->reg[CurrLEVEL][sr] = (CLD) ? 0 : (ushort)(tmp & 0xFFFF);
+				if (sr == 0)
+					STS_SYNC();
+				tmp = gLevelRegs[dr]; /* temp if we need to do the swap */
+				gLevelRegs[dr] = (CM1) ? ~source : source;
+				gLevelRegs[sr] = (CLD) ? 0 : (ushort)(tmp & 0xFFFF);
 				break;
 			case 1: /* RAND */
-				gReg->reg[CurrLEVEL][dr] &= (CM1) ? ~source : source;
-				gReg->reg[CurrLEVEL][dr] = (CLD) ? 0 : gReg->reg[CurrLEVEL][dr];
+				gLevelRegs[dr] &= (CM1) ? ~source : source;
+				gLevelRegs[dr] = (CLD) ? 0 : gLevelRegs[dr];
 				break;
 			case 2: /* REXO */
-				gReg->reg[CurrLEVEL][dr] = (CLD) ? ((CM1) ? ~source : source) : ((CM1) ? gReg->reg[CurrLEVEL][dr] ^ ~source : gReg->reg[CurrLEVEL][dr] ^ source);
+				gLevelRegs[dr] = (CLD) ? ((CM1) ? ~source : source) : ((CM1) ? gLevelRegs[dr] ^ ~source : gLevelRegs[dr] ^ source);
 				break;
 			case 3: /* RORA */
-				gReg->reg[CurrLEVEL][dr] = (CLD) ? ((CM1) ? ~source : source) : ((CM1) ? gReg->reg[CurrLEVEL][dr] | ~source : gReg->reg[CurrLEVEL][dr] | source);
+				gLevelRegs[dr] = (CLD) ? ((CM1) ? ~source : source) : ((CM1) ? gLevelRegs[dr] | ~source : gLevelRegs[dr] | source);
 				break;
 			}
 		}
@@ -1727,7 +1816,7 @@ void regop(ushort operand)
 	case 1: /* Arithmetic operation - RADD RCLR EXIT RDCR RINC RSUB */
 		if (dr != 0)
 		{
-			tmp = gReg->reg[CurrLEVEL][dr]; /* use this insted of (dr) as we need to check for carry and things */
+			tmp = gLevelRegs[dr]; /* use this insted of (dr) as we need to check for carry and things */
 			switch ((operand & 0x0380) >> 7)
 			{
 			case 0: /* RADD */
@@ -1753,7 +1842,7 @@ void regop(ushort operand)
 			case 7: /* NOOP */
 				break;
 			}
-			gReg->reg[CurrLEVEL][dr] = (ushort)(tmp & 0xFFFF);
+			gLevelRegs[dr] = (ushort)(tmp & 0xFFFF);
 		}
 		else
 		{
@@ -1789,7 +1878,8 @@ void DoMCL(ushort instr)
 	switch (instr & 0x0F)
 	{
 	case 01: // STS
-		gReg->reg[CurrLEVEL][_STS] &= ~(gA & 0x00FF);
+		STS_SYNC();
+		gLevelRegs[_STS] &= ~(gA & 0x00FF);
 		break;
 	case 06: // PID
 		/* This affects interrupt, so do locking and checking. */
@@ -1826,7 +1916,8 @@ void DoMST(ushort instr)
 	switch (instr & 0x0F)
 	{
 	case 01: // STS
-		gReg->reg[CurrLEVEL][0] |= (gA & 0x00ff);
+		STS_SYNC();
+		gLevelRegs[0] |= (gA & 0x00ff);
 		break;
 	case 06: // PID
 		/* This affects interrupt, so do locking and checking. */
@@ -1867,7 +1958,8 @@ void DoTRA(ushort instr)
 		gA = gPANS;
 		break;
 	case 01:								 /* TRA STS */
-		gA = gReg->reg[gPIL][_STS] & 0x00FF; /* Only lower 8 bits */
+		STS_SYNC();
+		gA = gLevelRegs[_STS] & 0x00FF; /* Only lower 8 bits */
 		gA |= gReg->reg_STS & 0xFF00;		 /* Upper 8 bits - SYSTEM bits*/
 
 		break;
@@ -1954,7 +2046,7 @@ void DoEXR(ushort instr)
 	char disasm_str[256];
 	sr = (instr >> 3) & 0x07;
 	if (sr)
-		exr_instr = gReg->reg[CurrLEVEL][sr];
+		exr_instr = gLevelRegs[sr];
 	else
 		exr_instr = 0;
 
@@ -1987,7 +2079,7 @@ void DoWAIT(ushort instr)
 		// If the interrupt system is OFF
 		// The ND-110 stops with the program counter (P register) pointing at the instruction after the WAIT and the front panel RUN indicator is turned off.
 		// To restart the system, type ! on the console terminal
-		printf("\r\nWAIT when IONI is off PIL[%d] PC[%6o] PID[0x%4X] PIE[0x%4X] IONI[%d] PONI[%d] STS_HI[%4X] STS_LO[%4X] A[%6o]\r\n", gPIL, gPC, gPID, gPIE, STS_IONI, STS_PONI, gReg->reg_STS, gReg->reg[gPIL][_STS], gA);
+		printf("\r\nWAIT when IONI is off PIL[%d] PC[%6o] PID[0x%4X] PIE[0x%4X] IONI[%d] PONI[%d] STS_HI[%4X] STS_LO[%4X] A[%6o]\r\n", gPIL, gPC, gPID, gPIE, STS_IONI, STS_PONI, gReg->reg_STS, gLevelRegs[_STS], gA);
 		gCpuExitCode = (int)(short)gA;
 		set_cpu_run_mode(CPU_STOPPED);		
 		return;
@@ -1995,7 +2087,8 @@ void DoWAIT(ushort instr)
 
 	if (CurrLEVEL == 0)
 	{
-		// Cant go lower
+		// Cant go lower. The CPU now waits for an interrupt; cpu_run fast-forwards to it.
+		cpu_wait_idle = true;
 		return;
 	}
 	
@@ -2062,7 +2155,8 @@ void DoTRR(ushort instr)
 		break;
 	case 01: // TRR STS
 		/* ND-06.029.1 ND-110 Instruction Set, lists only lower 8 bits as changeable... */
-		gReg->reg[CurrLEVEL][_STS] = (gReg->reg[CurrLEVEL][_STS] & 0xff00) | (gA & 0x00ff); /* Only change LSB  */
+		STS_SYNC();
+		gLevelRegs[_STS] = (gLevelRegs[_STS] & 0xff00) | (gA & 0x00ff); /* Only change LSB  */
 		break;
 	case 02: // TRR LMP
 		gLMP = gA;        
@@ -2078,6 +2172,7 @@ void DoTRR(ushort instr)
 		}
 		/* PCR0_WRITE tracing removed - was temporary overlay debugging */
 		gReg->reg_PCR[level] = temp;
+		FlushTLBLevel(level); // New PT/APT/ring for this level
 
 		break;
 	case 05: // TRR IIE
@@ -2106,6 +2201,7 @@ void DoTRR(ushort instr)
 		break;
 	case 015: /* TRR ECCR (ND110 only??) */
 		gECCR = gA;
+		gPT.tlbEpoch++; // ECC simulation must see every fetch
 		break;
 	case 017: /* TRR CS (ND110 only) */
 		break;
@@ -2132,6 +2228,7 @@ void DoSRB(ushort operand)
 	lvl = ((operand & 0x0078) >> 3);
 	addr = gX;
 
+    STS_SYNC();
     sts_temp = gReg->reg[lvl][_STS] & 0x00ff;
 
 	// If the current program level is specified, the stored P register points to the instruction following SRB.
@@ -2189,6 +2286,7 @@ void DoLRB(ushort operand)
 	gReg->reg[lvl][_A] = MemoryRead(addr + 3, true);
 	gReg->reg[lvl][_D] = MemoryRead(addr + 4, true);
 	gReg->reg[lvl][_L] = MemoryRead(addr + 5, true);
+	STS_SYNC();
 	gReg->reg[lvl][_STS] = (gReg->reg[lvl][_STS] & 0xff00) | (MemoryRead(addr + 6, true) & 0x00ff); /* Only load LSB STS */	
 	gReg->reg[lvl][_B] = MemoryRead(addr + 7, true);
 	
@@ -2201,8 +2299,8 @@ bool IsSkip(ushort instr)
 	char z, o, c, s;
 	sr = (instr >> 3) & 0x07;
 	dr = (instr >> 0) & 0x07;
-	source = (0 == sr) ? 0 : gReg->reg[CurrLEVEL][sr]; /* Never use STS reg but zero value instead */
-	desti = (0 == dr) ? 0 : gReg->reg[CurrLEVEL][dr];  /* Never use STS reg but zero value instead */
+	source = (0 == sr) ? 0 : gLevelRegs[sr]; /* Never use STS reg but zero value instead */
+	desti = (0 == dr) ? 0 : gLevelRegs[dr];  /* Never use STS reg but zero value instead */
 	ss = (signed short)source;
 	sd = (signed short)desti;
 
@@ -2595,7 +2693,6 @@ void DoMOVB(ushort instr)
 	ushort source, dest, lens, lend, len, s_lr, d_lr, s_apt, d_apt;
 	int dir; /* direction, 0=low to high, 1 = high to low */
 	int i;
-	ushort thebyte;
 	ushort addr_d, addr_s;
 
 	addr_d = 0;
@@ -2624,29 +2721,14 @@ void DoMOVB(ushort instr)
 	}
 
 	/* COPY */
-	if (dir)
-	{ /* high to low */
-		for (i = len - 1; i >= 0; i--)
-		{
-			addr_s = source + ((i + s_lr) >> 1); /* Word adress of byte to read */
-			thebyte = MemoryRead(addr_s, s_apt);
-			thebyte = ((i + d_lr) & 1) ? thebyte : (thebyte >> 8) & 0xff; /* right, LSB : left, MSB */
-			addr_d = dest + ((i + d_lr) >> 1);							  /* Word adress of byte to write */
-			MemoryWrite(thebyte, addr_d, d_apt, ((i + d_lr) & 1));
-		}
-		i = 0;
-	}
-	else
-	{ /* low to high */
-		for (i = 0; i < len; i++)
-		{
-			addr_s = source + ((i + s_lr) >> 1); /* Word adress of byte to read */
-			thebyte = MemoryRead(addr_s, s_apt);
-			thebyte = ((i + d_lr) & 1) ? thebyte : (thebyte >> 8) & 0xff; /* right, LSB : left, MSB */
-			addr_d = dest + ((i + d_lr) >> 1);							  /* Word adress of byte to write */
-			MemoryWrite(thebyte, addr_d, d_apt, ((i + d_lr) & 1));
-		}
+	MoveField(source, s_lr, s_apt, dest, d_lr, d_apt, len, dir);
+	if (len > 0)
+	{
+		i = dir ? 0 : len - 1;				 /* Last byte moved */
+		addr_s = source + ((i + s_lr) >> 1); /* Word adress of last byte read */
+		addr_d = dest + ((i + d_lr) >> 1);	 /* Word adress of last byte written */
 	}
+	i = dir ? 0 : len;
 
 	gD &= 0x7000;				  /* Null number of bytes, as per manual, also null bit 15 */
 	gT &= 0x7000;				  /* Null number of bytes, also null bit 15 */
@@ -2667,14 +2749,10 @@ void DoMOVBF(ushort instr)
 {
 	ushort source, dest, lens, lend, len, s_lr, d_lr, s_apt, d_apt;
 	int i;
-	ushort thebyte;
-	ushort addr_d, addr_s;
 	source = gA;
 	dest = gX;
 	bool overlap;
 
-	addr_d = 0;
-	addr_s = 0;
 	lens = gD & 0x0fff;
 	lend = gT & 0x0fff;
 	s_lr = ((gD >> 15) & 1);
@@ -2691,16 +2769,10 @@ void DoMOVBF(ushort instr)
 	else
 		overlap = false;
 
-	for (i = 0; i < len; i++)
-	{
-		addr_s = source + ((i + s_lr) >> 1); /* Word adress of byte to read */
-		thebyte = MemoryRead(addr_s, s_apt);
-		thebyte = ((i + d_lr) & 1) ? thebyte : (thebyte >> 8) & 0xff; /* right, LSB : left, MSB */
-		addr_d = dest + ((i + d_lr) >> 1);							  /* Word adress of byte to write */
-		MemoryWrite(thebyte, addr_d, d_apt, ((i + d_lr) & 1));
-		lens--;
-		lend--;
-	}
+	MoveField(source, s_lr, s_apt, dest, d_lr, d_apt, len, false);
+	i = len;
+	lens -= len;
+	lend -= len;
 
 	gA = source + ((len + s_lr) >> 1);
 	gX = dest + ((len + d_lr) >> 1);
@@ -2952,7 +3024,7 @@ void rdiv_org(ushort instr)
 	/* :TODO: Apparently Carry can be set too. CHECK that... Might be RAD=1??? */
 	/* Overflow and division with zero also need to be fixed!! */
 	/* :NOTE: The way it is described in the manual, we assume this is a fraction (numerator/denominator and return a quotient and remainder as per manual */
-	divider = ((instr & 0x0038) >> 3) ? (sshort)gReg->reg[gPIL][((instr & 0x0038) >> 3)] : 0;
+	divider = ((instr & 0x0038) >> 3) ? (sshort)gLevelRegs[((instr & 0x0038) >> 3)] : 0;
 
 	if (divider == 0)
 	{
@@ -2990,7 +3062,7 @@ void rdiv_org(ushort instr)
 void rdiv(ushort instr)
 {
 	int dividend = ((int)gA << 16) | gD;
-	short divisor = ((instr & 0x0038) >> 3) ? (short)gReg->reg[gPIL][((instr & 0x0038) >> 3)] : 0;
+	short divisor = ((instr & 0x0038) >> 3) ? (short)gLevelRegs[((instr & 0x0038) >> 3)] : 0;
 
 	if (divisor == 0)
 	{
@@ -3024,8 +3096,8 @@ void rmpy_org(ushort instr)
 {
 	/* :TODO: Apparently Carry can be set too. CHECK that... Might be RAD=1??? */
 	int a, b, result;
-	a = ((instr & 0x0038) >> 3) ? (int)gReg->reg[gPIL][((instr & 0x0038) >> 3)] : 0;
-	b = (instr & 0x0007) ? (int)gReg->reg[gPIL][(instr & 0x0007)] : 0;
+	a = ((instr & 0x0038) >> 3) ? (int)gLevelRegs[((instr & 0x0038) >> 3)] : 0;
+	b = (instr & 0x0007) ? (int)gLevelRegs[(instr & 0x0007)] : 0;
 	result = a * b;
 	if (abs(result) > INT_MAX)
 	{ /* Set O and Q */
@@ -3061,8 +3133,8 @@ void rmpy_org(ushort instr)
 void rmpy(ushort instr)
 {
 	int minusCnt = 0;
-	short source_value = (short)((instr & 0x0038) >> 3) ? (short)gReg->reg[gPIL][((instr & 0x0038) >> 3)] : 0;
-	short dest_value = (short)(instr & 0x0007) ? (short)gReg->reg[gPIL][(instr & 0x0007)] : 0;
+	short source_value = (short)((instr & 0x0038) >> 3) ? (short)gLevelRegs[((instr & 0x0038) >> 3)] : 0;
+	short dest_value = (short)(instr & 0x0007) ? (short)gLevelRegs[(instr & 0x0007)] : 0;
 
 	// Use int for absolute values to avoid overflow when negating -32768
 	int abs_src = (int)source_value;
@@ -3495,4 +3567,112 @@ void Setup_Instructions()
 
 	Instruction_Add_Range(0174000, 0177777, &do_bops); /* Bit Operation Instructions */
 													   /* Bit operations, 16 of them, 4 BSET,4 BSKP and 8 others */
+
+	Dispatch_Build();
+}
+
+/*************************** THREADED DISPATCH ***************************/
+
+// Handlers with a label of their own in Dispatch_RunBlock. Each label carries its own copy of
+// the dispatch tail, so the host predicts the next handler per handler instead of from one
+// shared call site. All other instructions go through the generic label and di->handler.
+#define DISPATCH_HANDLERS(X) \
+	X(ndfunc_stz) X(ndfunc_sta) X(ndfunc_stt) X(ndfunc_stx) X(ndfunc_std) X(ndfunc_ldd) \
+	X(ndfunc_stf) X(ndfunc_ldf) X(ndfunc_min) X(ndfunc_lda) X(ndfunc_ldt) X(ndfunc_ldx) \
+	X(ndfunc_add) X(ndfunc_sub) X(ndfunc_and) X(ndfunc_ora) X(mpy) \
+	X(ndfunc_jmp) X(ndfunc_jpl) X(ndfunc_jap) X(ndfunc_jan) X(ndfunc_jaz) X(ndfunc_jaf) \
+	X(ndfunc_jpc) X(ndfunc_jnc) X(ndfunc_jxz) X(ndfunc_jxn) X(ndfunc_skp) \
+	X(ndfunc_lbyt) X(ndfunc_sbyt) X(ndfunc_ldatx) X(ndfunc_ldxtx) X(ndfunc_lddtx) \
+	X(ndfunc_ldbtx) X(ndfunc_statx) X(ndfunc_stztx) X(ndfunc_stdtx) \
+	X(regop) X(ndfunc_shifts) X(do_bops) \
+	X(ndfunc_sab) X(ndfunc_saa) X(ndfunc_sat) X(ndfunc_sax) \
+	X(ndfunc_aab) X(ndfunc_aaa) X(ndfunc_aat) X(ndfunc_aax)
+
+// Label slot per opcode, 0 = generic. Filled from instr_funcs, which stays the only opcode table.
+uint8_t dispatch_slot[65536];
+
+/// @brief Map every opcode in instr_funcs to its label slot in Dispatch_RunBlock
+/// @details Called at the end of Setup_Instructions. DecodeInstr (cpu_decode.c) copies the slot into
+/// the decoded entry.
+void Dispatch_Build()
+{
+#define DISPATCH_ENTRY(fn) fn,
+	static const InstrFunc handlers[] = { DISPATCH_HANDLERS(DISPATCH_ENTRY) };
+#undef DISPATCH_ENTRY
+	int count = sizeof(handlers) / sizeof(handlers[0]);
+
+	for (int op = 0; op <= 0xFFFF; op++)
+	{
+		dispatch_slot[op] = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (instr_funcs[op] == handlers[i])
+			{
+				dispatch_slot[op] = (uint8_t)(i + 1);
+				break;
+			}
+		}
+	}
 }
+
+#ifdef CPU_THREADED_DISPATCH
+/// @brief Run pre-decoded instructions until the end of a basic block, using computed goto
+/// @details Same contract as the interpreter loop in cpu_run_block (cpu.c), which calls this
+/// instead. Built with -DTHREADED_DISPATCH=ON (GCC and Clang only).
+/// @param budget Maximum number of instructions to execute
+/// @return Number of instructions executed (0 if a level switch check is pending)
+int Dispatch_RunBlock(int budget)
+{
+#define DISPATCH_LABEL(fn) &&op_##fn,
+	static void *const labels[] = { &&op_generic, DISPATCH_HANDLERS(DISPATCH_LABEL) };
+#undef DISPATCH_LABEL
+	int count = 0;
+	DecodedInstr *di;
+	ushort op;
+	bool blockEnd;
+
+	// checkAndSwitch() is a no-op unless gCHKIT is set; let the normal path handle it
+	if ((budget <= 0) || gCHKIT)
+		return 0;
+
+	// Latch the entry before the handler runs, a store may clear it
+#define DISPATCH_ENTER() \
+	op = di->operand; \
+	blockEnd = (di->flags & DC_BLOCK_END) != 0; \
+	gReg->myreg_PFB = op; \
+	gReg->myreg_IR = op; \
+	gCpu->operand = op; \
+	instr_counter++; \
+	count++; \
+	gPC++
+
+#define DISPATCH_NEXT() \
+	if (blockEnd || (instr_counter >= io_next_tick) || (count >= budget) || gCHKIT) \
+		return count; \
+	di = DecodeCache_Fetch(gPC); \
+	goto *labels[di->dispatch]
+
+	di = DecodeCache_Fetch(gPC);
+	goto *labels[di->dispatch];
+
+op_generic:
+	{
+		InstrFunc handler = di->handler;
+		DISPATCH_ENTER();
+		handler(op);
+		DISPATCH_NEXT();
+	}
+
+#define DISPATCH_CASE(fn) \
+op_##fn: \
+	DISPATCH_ENTER(); \
+	fn(op); \
+	DISPATCH_NEXT();
+
+	DISPATCH_HANDLERS(DISPATCH_CASE)
+
+#undef DISPATCH_CASE
+#undef DISPATCH_NEXT
+#undef DISPATCH_ENTER
+}
+#endif
@@ -21,6 +21,18 @@
  */
 
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__EMSCRIPTEN__)
+// Plain heap allocation
+#elif defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #include "cpu_types.h"
 #include "cpu_protos.h"
 
@@ -29,35 +41,35 @@
 
 // Global MMS type variable definition
 MMSType mmsType = MMS2; // Change this to force MMS type to 1 or 2
-PagingTables pt; // Global paging tables structure
 
 
 // Create and initialize PagingTables
 // MUST!!!! to be called before using the PagingTables
 bool CreatePagingTables()
 {    
-    pt.mmsType = mmsType;
+    gPT.mmsType = mmsType;
     
     // Allocate shadow RAM based on MMS type
     if (mmsType == MMS1)
     {
-        pt.shadowRamSize = 512;  // 4 page tables = 2 x 64 bit * 4 = 512 Words
-        pt.shadowRamAddress = SHADOW_RAM_EXTENDED_MODE_4PT;
+        gPT.shadowRamSize = 512;  // 4 page tables = 2 x 64 bit * 4 = 512 Words
+        gPT.shadowRamAddress = SHADOW_RAM_EXTENDED_MODE_4PT;
     }
     else
     {
-        pt.shadowRamSize = 2048; // 16 page tables = 16 x 64 bit * 4 = 2048 Words
-        pt.shadowRamAddress = SHADOW_RAM_EXTENDED_MODE_16PT;
+        gPT.shadowRamSize = 2048; // 16 page tables = 16 x 64 bit * 4 = 2048 Words
+        gPT.shadowRamAddress = SHADOW_RAM_EXTENDED_MODE_16PT;
     }
 
-    pt.shadowRam = (ushort*)calloc(pt.shadowRamSize, sizeof(ushort));
-    if (!pt.shadowRam)
+    gPT.shadowRam = (ushort*)calloc(gPT.shadowRamSize, sizeof(ushort));
+    if (!gPT.shadowRam)
     {
         printf("Failed to allocate shadow RAM\n");
         return false;
     }
 
-    pt.isInitialized = 1;
+    gPT.isInitialized = 1;
+    FlushTLB();
     return true;
 }
 
@@ -84,7 +96,7 @@ static uint CalcPageTableAddress(uint address)
     if (STS_SEXI)
     {
         // Extended, check if we have MM-1 or MM-II
-        if (pt.mmsType == MMS1)
+        if (gPT.mmsType == MMS1)
         {
             // 4 page tables start at 177000 (0xFE00)                    
             pageTableAddress = ((address - SHADOW_RAM_EXTENDED_MODE_4PT) & 0x1FF) >> 1;
@@ -107,9 +119,9 @@ static uint CalcPageTableAddress(uint address)
 // Clean up PagingTables
 void DestroyPagingTables()
 {
-    if (pt.shadowRam)
+    if (gPT.shadowRam)
     {
-        free(pt.shadowRam);
+        free(gPT.shadowRam);
     }
 }
 
@@ -125,17 +137,17 @@ ushort GetPTShadowAddress(uint pageTable, uint VPN, PageTableMode ptm)
         switch (ptm)
         {
             case Four:
-                offset = SHADOW_RAM_EXTENDED_MODE_4PT - pt.shadowRamAddress;
+                offset = SHADOW_RAM_EXTENDED_MODE_4PT - gPT.shadowRamAddress;
                 break;
             case Sixteen: // ONLY for MMS2
-                offset = SHADOW_RAM_EXTENDED_MODE_16PT - pt.shadowRamAddress;
+                offset = SHADOW_RAM_EXTENDED_MODE_16PT - gPT.shadowRamAddress;
                 break;
         }
     }
     else
     {
         // Normal mode
-        offset = SHADOW_RAM_NORMAL_MODE_4PT - pt.shadowRamAddress;
+        offset = SHADOW_RAM_NORMAL_MODE_4PT - gPT.shadowRamAddress;
     }
 
     uint pageTableAddress = (pageTable << 6) | VPN;
@@ -152,13 +164,17 @@ ushort GetPTShadowAddress(uint pageTable, uint VPN, PageTableMode ptm)
 // Write to page tables
 void PT_Write(uint address, ushort value)
 {
-    if (!pt.shadowRam) return;
-    if ((address < pt.shadowRamAddress) || (address > 0xFFFF)) return;
+    if (!gPT.shadowRam) return;
+    if ((address < gPT.shadowRamAddress) || (address > 0xFFFF)) return;
 
-    uint offset = address - pt.shadowRamAddress;
+    uint offset = address - gPT.shadowRamAddress;
 
 
-    pt.shadowRam[offset] = value;
+    gPT.shadowRam[offset] = value;
+
+    // A page table entry the TLB has cached translations from is changing
+    if (gPT.tlbShadowRef[offset >> 3] & (1 << (offset & 7)))
+        FlushTLB();
 
 #ifdef DEBUG_MMS
     uint pageTableEntry;
@@ -174,12 +190,12 @@ void PT_Write(uint address, ushort value)
         if ((address & 0x01) == 0)
         {
             // Even address
-            pageTableEntry = (uint)(value << 16 | pt.shadowRam[offset + 1]);
+            pageTableEntry = (uint)(value << 16 | gPT.shadowRam[offset + 1]);
         }
         else
         {
             // Odd address
-            pageTableEntry = (uint)(pt.shadowRam[offset - 1] << 16 | value);
+            pageTableEntry = (uint)(gPT.shadowRam[offset - 1] << 16 | value);
         }
     }
     printf("PT W A=%o PT=%d VPN=%d SEXI=%d V=%o => 0x%08X (%s)\n",  address, pageTable, pageTableAddress & 0x3F, STS_SEXI, value,  pageTableEntry, GetPageTableEntryDebugInfo(pageTableEntry));
@@ -189,11 +205,11 @@ void PT_Write(uint address, ushort value)
 // Read from shadow mem/pagetables
 ushort PT_Read(uint address)
 {
-    if (!pt.shadowRam) return 0;
-    if ((address < pt.shadowRamAddress) || (address > 0xFFFF)) return 0;
+    if (!gPT.shadowRam) return 0;
+    if ((address < gPT.shadowRamAddress) || (address > 0xFFFF)) return 0;
 
-    uint offset = address - pt.shadowRamAddress;
-    ushort res = pt.shadowRam[offset];
+    uint offset = address - gPT.shadowRamAddress;
+    ushort res = gPT.shadowRam[offset];
 
 #ifdef DEBUG_CPU
     uint pageTableEntry;
@@ -225,10 +241,38 @@ ushort PT_Read(uint address)
     return res;
 }
 
+// Drop every cached translation (PT_Write to a cached entry, PONI/SEXI change, reset)
+void FlushTLB()
+{
+    gPT.tlbEpoch++; // Also ends identity mapped fetch pages (PONI change)
+    if (!gPT.tlbInUse) return;
+
+    memset(gPT.tlb, 0, sizeof(gPT.tlb));
+    memset(gPT.tlbShadowRef, 0, sizeof(gPT.tlbShadowRef));
+    gPT.tlbInUse = false;
+}
+
+// Drop the cached translations of one level (PCR write for that level)
+void FlushTLBLevel(uint level)
+{
+    if (level >= TLB_LEVELS) return;
+
+    // tlbShadowRef is left as is; a stale bit only costs a spurious full flush later
+    memset(gPT.tlb[level], 0, sizeof(gPT.tlb[level]));
+    gPT.tlbEpoch++;
+}
+
+// Remember that a shadow RAM word backs a TLB slot, so PT_Write knows to flush
+static inline void MarkTLBShadowRef(uint offset)
+{
+    if (offset < (uint)(sizeof(gPT.tlbShadowRef) * 8))
+        gPT.tlbShadowRef[offset >> 3] |= (uint8_t)(1 << (offset & 7));
+}
+
 // Get page table entry
 uint GetPageTableEntry(uint pageTable, uint VPN,PageTableMode ptm)
 {
-    if (!pt.shadowRam) return 0;
+    if (!gPT.shadowRam) return 0;
     if (pageTable >= 16) return 0;
 
     uint PTe = 0;
@@ -236,13 +280,13 @@ uint GetPageTableEntry(uint pageTable, uint VPN,PageTableMode ptm)
 
     if (STS_SEXI)
     {
-        PTe = (uint)(pt.shadowRam[pageTableAddress] << 16 | pt.shadowRam[pageTableAddress + 1]);
+        PTe = (uint)(gPT.shadowRam[pageTableAddress] << 16 | gPT.shadowRam[pageTableAddress + 1]);
     }
     else
     {
         if (pageTable <= 3)
         {
-            PTe = ConvertFrom16BitPTE(pt.shadowRam[pageTableAddress]);
+            PTe = ConvertFrom16BitPTE(gPT.shadowRam[pageTableAddress]);
         }
     }
 
@@ -266,7 +310,7 @@ uint GetPageTableEntry(uint pageTable, uint VPN,PageTableMode ptm)
 // read all page tables regardless of which level happens to be active.
 uint GetPageTableEntryForDebugger(uint pageTable, uint VPN, PageTableMode ptm)
 {
-    if (!pt.shadowRam) return 0;
+    if (!gPT.shadowRam) return 0;
     if (pageTable >= 16) return 0;
 
     uint PTe = 0;
@@ -274,78 +318,44 @@ uint GetPageTableEntryForDebugger(uint pageTable, uint VPN, PageTableMode ptm)
     if (mmsType == MMS2)
     {
         // MMS2 hardware: always 32-bit PTEs in extended 16PT area
-        uint offset = SHADOW_RAM_EXTENDED_MODE_16PT - pt.shadowRamAddress;
+        uint offset = SHADOW_RAM_EXTENDED_MODE_16PT - gPT.shadowRamAddress;
         uint pageTableAddress = ((pageTable << 6) | VPN) << 1;
         pageTableAddress += offset;
-        PTe = (uint)(pt.shadowRam[pageTableAddress] << 16 | pt.shadowRam[pageTableAddress + 1]);
+        PTe = (uint)(gPT.shadowRam[pageTableAddress] << 16 | gPT.shadowRam[pageTableAddress + 1]);
     }
     else
     {
         // MMS1 hardware: only 4 page tables, 16-bit PTEs
         if (pageTable <= 3)
         {
-            uint offset = SHADOW_RAM_NORMAL_MODE_4PT - pt.shadowRamAddress;
+            uint offset = SHADOW_RAM_NORMAL_MODE_4PT - gPT.shadowRamAddress;
             uint pageTableAddress = (pageTable << 6) | VPN;
             pageTableAddress += offset;
-            PTe = ConvertFrom16BitPTE(pt.shadowRam[pageTableAddress]);
+            PTe = ConvertFrom16BitPTE(gPT.shadowRam[pageTableAddress]);
         }
     }
 
     return PTe;
 }
 
-// Update page table entry
-bool UpdatePageTableEntry(uint pageTable, uint VPN, PageTableMode ptm, uint PTe)
+// Set the page used flag, and for writes the written flag.
+// The entry is only written back to shadow RAM when one of them was clear.
+uint SetPageAccessed(uint pageTable, uint VPN, PageTableMode ptm, uint PTe, bool written)
 {
-    if (!pt.shadowRam) return false;
-    if (pageTable >= 16) return false;
-
-    int pageTableAddress = GetPTShadowAddress(pageTable, VPN, ptm);
-
-    if (STS_SEXI)
-    {
-        pt.shadowRam[pageTableAddress] = (ushort)(PTe >> 16);
-        pt.shadowRam[pageTableAddress + 1] = (ushort)(PTe);
-    }
-    else
-    {
-        pt.shadowRam[pageTableAddress] = ConvertTo16BitPTE(PTe);
-    }
-
-    return true;
-}
-
-// Set page used flag
-uint SetPageUsed(uint pageTable, uint VPN, PageTableMode ptm, uint PTe)
-{    
-    if ((PTe & PGU_FLAG) == 0)
-    {
-        PTe |= PGU_FLAG;
-        UpdatePageTableEntry(pageTable, VPN, ptm, PTe);
-
-#ifdef DEBUG_MMS
-        printf("PageTable PGU - PT=%d VPN=%d => Entry=0x%08X (%s)\n",  pageTable, VPN, PTe, GetPageTableEntryDebugInfo(PTe));
-#endif
-    }
-    return PTe;
-}
-
-// Set page written flag
-uint SetPageWritten(uint pageTable, uint VPN,PageTableMode ptm, uint PTe)
-{
-    if (!pt.shadowRam) return PTe;
+    uint flags = PGU_FLAG | (written ? WIP_FLAG : 0);
+    if ((PTe & flags) == flags) return PTe;
 
+    PTe |= flags;
+    if (!gPT.shadowRam) return PTe;
     if (pageTable >= 16) return PTe;
 
-    if ((PTe & WIP_FLAG) == 0)
-    {
-        PTe |= WIP_FLAG;
-        UpdatePageTableEntry( pageTable, VPN, ptm, PTe);
+    // PGU and WIP are in the first word; the PPN word is left as it is
+    int pageTableAddress = GetPTShadowAddress(pageTable, VPN, ptm);
+    gPT.shadowRam[pageTableAddress] = STS_SEXI ? (ushort)(PTe >> 16) : ConvertTo16BitPTE(PTe);
 
 #ifdef DEBUG_MMS
-        printf("PageTable WIP - PT=%d VPN=%d => Entry=0x%08X (%s)\n",  pageTable, VPN, PTe, GetPageTableEntryDebugInfo(PTe));
+    printf("PageTable %s - PT=%d VPN=%d => Entry=0x%08X (%s)\n", written ? "WIP" : "PGU", pageTable, VPN, PTe, GetPageTableEntryDebugInfo(PTe));
 #endif
-    }
     return PTe;
 }
 
@@ -394,12 +404,27 @@ char* GetPageTableEntryDebugInfo(ulong PTe)
 }
 
 
+// TLB slot index for each AccessMode value
+static const uint8_t tlbKind[8] = {
+    0,  // -
+    0,  // READ
+    1,  // WRITE
+    1,  // -
+    2,  // FETCH
+    3,  // READ_FETCH
+    1,  // -
+    1,  // -
+};
+
+// ECC error simulation must run on every access, so the TLB is bypassed while it is armed
+#define ECC_SIMULATION_ACTIVE (((gECCR & (1 << 3)) == 0) && ((gECCR & ((1 << 0) | (1 << 1) | (1 << 4))) != 0))
+
 // Map virtual address to physical address
 int mapVirtualToPhysical(uint virtualAddress, AccessMode am, bool UseAPT)
 {
     
     
-    if (!pt.isInitialized)
+    if (!gPT.isInitialized)
     {
         printf("FATAL! PagingTables not initialized\n");
         exit(1);
@@ -425,6 +450,15 @@ int mapVirtualToPhysical(uint virtualAddress, AccessMode am, bool UseAPT)
     uint DIP = virtualAddress & 0x3FF; // lower 10 bits - Displacement
     uint VPN = (virtualAddress >> 10) & 0x3F; // upper 6 bits - Virtual Page number
 
+    // TLB lookup. A slot is only filled after all checks below passed and PGU (and WIP for
+    // writes) is already set in the PTE, so a hit has nothing left to do.
+    uint32_t *tlbSlot = &gPT.tlb[CurrLEVEL][(STS_PTM && UseAPT) ? 1 : 0][tlbKind[am & 7]][VPN];
+    if (*tlbSlot & TLB_VALID)
+    {
+        if (!ECC_SIMULATION_ACTIVE)
+            return (int)((*tlbSlot & ~0x3FFu) | DIP);
+    }
+
     PageTableMode ptm = Four; // Default to four page tables
 
     // Find PageTable Number and identify if we have the optional 16 page-table mode
@@ -489,6 +523,7 @@ int mapVirtualToPhysical(uint virtualAddress, AccessMode am, bool UseAPT)
         degrade_count++;
         ring = pageTableRing;
         gReg->reg_PCR[CurrLEVEL] = (gReg->reg_PCR[CurrLEVEL] & 0xFFFC) | ring;
+        FlushTLBLevel(CurrLEVEL);
     }
 #endif
 
@@ -541,13 +576,8 @@ int mapVirtualToPhysical(uint virtualAddress, AccessMode am, bool UseAPT)
         return -1;
     }
 
-    // Mark page used
-    pageTableEntry = SetPageUsed(pageTable, VPN, ptm, pageTableEntry);
-    if (am == WRITE)
-    {
-        // Mark page as "written to"
-        pageTableEntry = SetPageWritten(pageTable, VPN, ptm, pageTableEntry);
-    }
+    // Mark page used, and "written to" for writes
+    pageTableEntry = SetPageAccessed(pageTable, VPN, ptm, pageTableEntry, am == WRITE);
 
     // Check for ECC Memory Parity
     if ((gECCR & (1 << 3)) == 0) // If Bit 3 is set, ECC is disabled
@@ -596,9 +626,85 @@ int mapVirtualToPhysical(uint virtualAddress, AccessMode am, bool UseAPT)
         printf("mapVirtualToPhysical - PT=%d VPN=%d => Entry=0x%08X (%s)\n",  pageTable, VPN, pageTableEntry, GetPageTableEntryDebugInfo(pageTableEntry));
     }
 #endif
+
+    // Cache the translation, and remember which shadow RAM word(s) it came from
+    if (!ECC_SIMULATION_ACTIVE)
+    {
+        uint ptOffset = GetPTShadowAddress(pageTable, VPN, ptm);
+        MarkTLBShadowRef(ptOffset);
+        if (STS_SEXI) MarkTLBShadowRef(ptOffset + 1);
+
+        *tlbSlot = ((uint32_t)physicalAddress & ~0x3FFu) | TLB_VALID;
+        gPT.tlbInUse = true;
+    }
+
     return (int)physicalAddress;
 }
 
+/// @brief Physical memory behind a virtual page that was just accessed
+/// @details For instructions working through long byte fields (MOVB, MOVBF, BFILL). Only a
+/// TLB hit is used, which proves the access checks passed and the PTE used/written bits are
+/// set, so the rest of the page can be accessed without translating each word again.
+/// @return First word of the physical page, or NULL when the page must be accessed word by word
+/// (not in the TLB, shadow memory, ECC simulation, watchpoints or disassembly)
+ushort *MapSpanPage(uint virtualAddress, AccessMode am, bool UseAPT)
+{
+    if (DISASM || ECC_SIMULATION_ACTIVE)
+        return NULL;
+#ifdef WITH_DEBUGGER
+    if ((watchpoint_count > 0) || (phys_watchpoint_count > 0))
+        return NULL;
+#endif
+
+    virtualAddress &= 0xFFFF;
+    uint page;
+    if (!STS_PONI)
+    {
+        page = virtualAddress & ~0x3FFu;
+    }
+    else
+    {
+        uint VPN = (virtualAddress >> 10) & 0x3F;
+        uint32_t slot = gPT.tlb[CurrLEVEL][(STS_PTM && UseAPT) ? 1 : 0][tlbKind[am & 7]][VPN];
+        if (!(slot & TLB_VALID))
+            return NULL;
+        page = slot & ~0x3FFu;
+    }
+
+    // Page table shadow memory sits at the top of the first 64K, physical or (ring 3) virtual
+    if (((page >= 0xF800) && (page <= 0xFFFF)) || (virtualAddress >= 0xF800))
+        return NULL;
+
+    if (page + 0x400 > ND_Memsize)
+        return NULL;
+
+    return &VolatileMemory.n_Array[page];
+}
+
+/// @brief Translate an instruction fetch, and make its page the fetch page
+/// @details Same result and faults as mapVirtualToPhysical(virtualAddress, FETCH, false). If the
+/// page can be accessed directly (see MapSpanPage), the next fetches on it are served from
+/// gCpu->fetchPage until P leaves the page, the level changes or the TLB is flushed.
+int MapFetchAddress(uint virtualAddress)
+{
+    int pa = mapVirtualToPhysical(virtualAddress, FETCH, false);
+    if (pa < 0)
+        return pa;
+
+    ushort *mem = MapSpanPage(virtualAddress, FETCH, false);
+    if (mem)
+    {
+        FetchPage *fp = &gCpu->fetchPage;
+        fp->mem = mem;
+        fp->base = (uint)pa & ~0x3FFu;
+        fp->decoded = decodeCache.pages[fp->base >> 10];
+        fp->vpn = (virtualAddress & 0xFFFF) >> 10;
+        fp->level = CurrLEVEL;
+        fp->epoch = gPT.tlbEpoch;
+    }
+    return pa;
+}
+
 // Update PGS (Page Status) register
 void UpdatePGS(uint pageTable, uint VPN, AccessMode am, bool permitViolation)
 {
@@ -691,7 +797,7 @@ bool checkPageProtection(uint VPN, uint pageTable, ulong pageTableEntry, bool Us
 
 // Check if address is in shadow memory
 // Flag set by Device_DMARead/Write to bypass shadow memory for DMA bus transfers
-bool gDMAAccess = false;
+_Thread_local bool gDMAAccess = false;
 
 bool IsAddressShadowMemory(uint addr, bool privileged)
 {
@@ -762,7 +868,7 @@ int ReadIndirectVirtualMemory(uint virtualAddress, bool UseAPT)
 // Fetch from virtual memory
 int FetchVirtualMemory(uint virtualAddress, bool UseAPT)
 {
-    int pa = mapVirtualToPhysical(virtualAddress, FETCH, UseAPT);
+    int pa = UseAPT ? mapVirtualToPhysical(virtualAddress, FETCH, true) : MapFetchAddress(virtualAddress);
     if (pa == -1) return 0;
     return ReadPhysicalMemory(pa, false);
 }
@@ -782,6 +888,116 @@ void WriteVirtualMemory(uint virtualAddress, ushort value, bool UseAPT, WriteMod
 
 
 
+static void memory_alloc(uint32_t pages);
+
+/// @brief Set the installed physical memory of the current machine
+/// @details Call after machine_init() and before anything is loaded, the memory is
+/// allocated again and zero filled.
+/// @param kwords Size in K words (1..16384)
+/// @return false if the size is out of range
+bool cpu_memory_set_size(int kwords)
+{
+    if ((kwords <= 0) || (kwords > MEMPTSIZE))
+        return false;
+
+    if (VolatileMemory.pages != (uint32_t)kwords)
+    {
+        cpu_memory_free();
+        memory_alloc((uint32_t)kwords);
+        DecodeCache_Flush();
+    }
+    return true;
+}
+
+// Map zero filled host memory. With 'fixed' set, the pages at that address are replaced
+// with fresh zero pages, which gives their host memory back instead of writing zeros.
+static void *memory_map(void *fixed, size_t bytes)
+{
+#if defined(__EMSCRIPTEN__)
+    if (fixed)
+    {
+        memset(fixed, 0, bytes);
+        return fixed;
+    }
+    return calloc(1, bytes);
+#elif defined(_WIN32) || defined(_WIN64)
+    // Committed pages are zero and only get physical memory when first touched
+    if (fixed)
+    {
+        VirtualFree(fixed, bytes, MEM_DECOMMIT);
+        return VirtualAlloc(fixed, bytes, MEM_COMMIT, PAGE_READWRITE);
+    }
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void *mem = mmap(fixed, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | (fixed ? MAP_FIXED : 0), -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    // Fewer TLB misses on the host for a machine that uses most of its memory
+    madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+    return mem;
+#endif
+}
+
+// Allocate zero filled physical memory of 'pages' 1K word pages
+static void memory_alloc(uint32_t pages)
+{
+    size_t bytes = ((size_t)pages << 10) * sizeof(ushort);
+    VolatileMemory.n_Array = memory_map(NULL, bytes);
+    if (!VolatileMemory.n_Array)
+    {
+        fprintf(stderr, "Unable to allocate %u KW of physical memory\n", pages);
+        exit(1);
+    }
+    VolatileMemory.pages = pages;
+    memset(memDirtyPages, 0xFF, sizeof(memDirtyPages));
+}
+
+/// @brief Allocate the physical memory, MEMPAGES_DEFAULT until cpu_memory_set_size() changes it
+void cpu_memory_init(void)
+{
+    if (VolatileMemory.n_Array)
+    {
+        cpu_memory_clear();
+        return;
+    }
+
+    memory_alloc(MEMPAGES_DEFAULT);
+}
+
+/// @brief Give the physical memory back to the host
+void cpu_memory_free(void)
+{
+    if (!VolatileMemory.n_Array)
+        return;
+
+#if defined(__EMSCRIPTEN__)
+    free(VolatileMemory.n_Array);
+#elif defined(_WIN32) || defined(_WIN64)
+    VirtualFree(VolatileMemory.n_Array, 0, MEM_RELEASE);
+#else
+    munmap(VolatileMemory.n_Array, ND_Memsize * sizeof(ushort));
+#endif
+    VolatileMemory.n_Array = NULL;
+    VolatileMemory.pages = 0;
+    gPT.tlbEpoch++; // The fetch page pointed into it
+}
+
+/// @brief Set all physical memory to zero
+void cpu_memory_clear(void)
+{
+    size_t bytes = ND_Memsize * sizeof(ushort);
+    if (memory_map(VolatileMemory.n_Array, bytes) != VolatileMemory.n_Array)
+    {
+        // Could not replace the mapping, clear it the slow way
+        memset(VolatileMemory.n_Array, 0, bytes);
+    }
+    memset(memDirtyPages, 0xFF, sizeof(memDirtyPages));
+}
+
+
 // Read from physical memory
 int ReadPhysicalMemory(int physicalAddress, bool privileged)
 {
@@ -836,6 +1052,7 @@ void WritePhysicalMemoryWM(int physicalAddress, uint16_t value, bool privileged,
 
     if (IsAddressShadowMemory(physicalAddress, privileged))
     {
+        cpu_mem_writes++;
         switch (wm)
         {
         case WRITEMODE_MSB:
@@ -865,23 +1082,31 @@ void WritePhysicalMemoryWM(int physicalAddress, uint16_t value, bool privileged,
         return;
     }
 
+    DC_INVALIDATE(physicalAddress);
+    MEM_MARK_DIRTY(physicalAddress);
+
     ushort *p_phy_addr;
     p_phy_addr = &VolatileMemory.n_Array[physicalAddress];
 
+	ushort old = *p_phy_addr;
 	switch (wm)
 	{
 	case WRITEMODE_MSB: /* Even, which means MSB byte, or bits 15-8 */
-		*p_phy_addr = (*p_phy_addr & 0xFF) | (value << 8);
+		value = (old & 0xFF) | (value << 8);
 		break;
 	case WRITEMODE_LSB: /*Odd, which means LSB byte, or bits 7-0 */
-		*p_phy_addr = (*p_phy_addr & 0xFF00) | (value & 0xFF);
+		value = (old & 0xFF00) | (value & 0xFF);
 		break;
     case WRITEMODE_WORD: // full word
 	default:
-		*p_phy_addr = value;
 		break;
 	}
 
+	// Only writes that change memory count, an idle loop may keep storing the same flag
+	if (value != old)
+		cpu_mem_writes++;
+	*p_phy_addr = value;
+
 /*
 
 	ushort *p_phy_addr;
@@ -890,6 +1115,65 @@ void WritePhysicalMemoryWM(int physicalAddress, uint16_t value, bool privileged,
  */
 }
 
+/// @brief Number of words from a physical address that a DMA block transfer can access directly
+/// @details DMA never sees shadow memory, so only the memory size and armed physical watchpoints
+/// (which must see each word) limit the span.
+/// @return 0 when the word at physicalAddress must go through Read/WritePhysicalMemory
+uint PhysicalBlockSpan(uint physicalAddress, uint words)
+{
+    if (physicalAddress >= ND_Memsize)
+        return 0;
+
+    uint span = ND_Memsize - physicalAddress;
+#ifdef WITH_DEBUGGER
+    if (phys_watchpoint_count > 0)
+    {
+        if (phys_watchpoint_page_armed(physicalAddress))
+            return 0;
+        span = 0x400 - (physicalAddress & 0x3FF); // Next page may be armed
+    }
+#endif
+    return (words < span) ? words : span;
+}
+
+/// @brief DMA of big-endian words from a device buffer into physical memory
+/// @details The range must be accepted by PhysicalBlockSpan. Same result as a
+/// WritePhysicalMemory per word, including the decode cache, dirty page tracking and
+/// the write count cpu_idle_check looks at.
+void WritePhysicalBlock(uint physicalAddress, const uint8_t *restrict src, uint words)
+{
+    ushort *restrict dst = &VolatileMemory.n_Array[physicalAddress];
+    for (uint i = 0; i < words; i++)
+        dst[i] = (ushort)((src[2 * i] << 8) | src[2 * i + 1]);
+    cpu_mem_writes++;
+
+    uint end = physicalAddress + words;
+    for (uint page = physicalAddress >> 10; page <= ((end - 1) >> 10); page++)
+    {
+        uint lo = (page << 10 > physicalAddress) ? page << 10 : physicalAddress;
+        uint hi = ((page + 1) << 10 < end) ? (page + 1) << 10 : end;
+
+        MEM_MARK_DIRTY(lo);
+        if (decodeCache.pages[page])
+        {
+            for (uint pa = lo; pa < hi; pa++)
+                DC_INVALIDATE(pa);
+        }
+    }
+}
+
+/// @brief DMA of physical memory into a device buffer of big-endian words
+/// @details The range must be accepted by PhysicalBlockSpan.
+void ReadPhysicalBlock(uint physicalAddress, uint8_t *restrict dst, uint words)
+{
+    const ushort *restrict src = &VolatileMemory.n_Array[physicalAddress];
+    for (uint i = 0; i < words; i++)
+    {
+        dst[2 * i] = (uint8_t)(src[i] >> 8);
+        dst[2 * i + 1] = (uint8_t)src[i];
+    }
+}
+
 // Handle memory out of range error
 extern void ring_dump(void);
 
@@ -960,6 +1244,8 @@ int Dbg_WritePhysicalMemory(uint32_t physicalAddress, uint16_t value)
 {
     if (physicalAddress >= (uint32_t)ND_Memsize)
         return -1;
+    DC_INVALIDATE(physicalAddress);
+    MEM_MARK_DIRTY(physicalAddress);
     VolatileMemory.n_Array[physicalAddress] = value;
     return 0;
 }
@@ -980,7 +1266,7 @@ static int Dbg_MapVirtualToPhysical(uint virtualAddress, bool useAPT, int8_t pil
 {
     virtualAddress &= 0xFFFF;
 
-    if (!pt.isInitialized)
+    if (!gPT.isInitialized)
         return -1;
 
     int level = (pil >= 0 && pil <= 15) ? pil : CurrLEVEL;
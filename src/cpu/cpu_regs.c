@@ -38,13 +38,23 @@ bool setPIL(char newLevel)
 	if (newLevel == gPIL)
 		return true; // already set
 
+	STS_SYNC(); // Lazy flags belong to the level we leave
 	gPVL = gPIL; /* Save current runlevel */
 
 	// Update SYSTEM bits - PIL
 	gReg->reg_STS = (gReg->reg_STS & 0xF000) | ((newLevel & 0x0f) << 8);
+	SyncLevelRegs();
 	return true;
 }
 
+/// @brief Point gLevelRegs at the register row of the current level
+/// @details Needed after the PIL bits of reg_STS are changed other than through setPIL
+/// (cpu reset, snapshot restore, debugger writes).
+void SyncLevelRegs()
+{
+	gCpu->levelRegs = gReg->reg[gPIL];
+}
+
 // Set and lock PEA
 void setPEA(ushort pea)
 {
@@ -81,11 +91,12 @@ void setreg(int r, int val)
 {
 	if (r == _STS)
 	{
-		gReg->reg[CurrLEVEL][r] = (ushort)(val & 0x00FF); // Only lower 8 bits
+		STS_SYNC();
+		gLevelRegs[r] = (ushort)(val & 0x00FF); // Only lower 8 bits
 	}
 	else
 	{
-		gReg->reg[CurrLEVEL][r] = (ushort)(val & 0xFFFF);
+		gLevelRegs[r] = (ushort)(val & 0xFFFF);
 	}
 }
 
@@ -95,11 +106,12 @@ ushort getbit(ushort regnum, ushort stsbit)
 	if (regnum == _STS)
 	{
 		// Undoocumented, but all 16 STS bits are read
+		STS_SYNC();
 		tmp = gSTSr;
 	}
 	else
 	{
-		tmp = gReg->reg[CurrLEVEL][regnum];
+		tmp = gLevelRegs[regnum];
 	}
 	result = (tmp >> stsbit) & 1;
 	return result;
@@ -108,8 +120,10 @@ ushort getbit(ushort regnum, ushort stsbit)
 void clrbit(ushort regnum, ushort stsbit)
 {
 	ushort thebit;
+	if (regnum == _STS)
+		STS_SYNC();
 	thebit = (1 << stsbit) ^ 0xFFFF;
-	gReg->reg[CurrLEVEL][regnum] = (thebit & gReg->reg[CurrLEVEL][regnum]);
+	gLevelRegs[regnum] = (thebit & gLevelRegs[regnum]);
 }
 
 /*
@@ -121,6 +135,10 @@ void setbit_STS_MSB(ushort stsbit, char val)
 {
 	ushort thebit = 0;
 
+	// Turning paging or extended addressing on/off changes every translation
+	if (((stsbit == _PONI) || (stsbit == _SEXI)) && (((gReg->reg_STS >> stsbit) & 1) != (val ? 1 : 0)))
+		FlushTLB();
+
 	if (val)
 	{
 		thebit = (1 << stsbit);
@@ -144,11 +162,14 @@ void setbit(ushort regnum, ushort stsbit, char val)
 		return;
 	}
 
+	if (regnum == _STS)
+		STS_SYNC();
+
 	ushort thebit = 0;
 	if (val)
 	{
 		thebit = (1 << stsbit);
-		gReg->reg[CurrLEVEL][regnum] = (thebit | gReg->reg[CurrLEVEL][regnum]);
+		gLevelRegs[regnum] = (thebit | gLevelRegs[regnum]);
 
 		if (stsbit == _Z) // error bit is set
 		{
@@ -158,11 +179,31 @@ void setbit(ushort regnum, ushort stsbit, char val)
 	else
 	{
 		thebit = (1 << stsbit) ^ 0xFFFF;
-		gReg->reg[CurrLEVEL][regnum] = (thebit & gReg->reg[CurrLEVEL][regnum]);
+		gLevelRegs[regnum] = (thebit & gLevelRegs[regnum]);
 	}
 }
 
 
+/// @brief Write the lazy C, O and Q flags of the last do_add to STS
+/// @details Only call through STS_SYNC(), when CpuState.lazyFlags is pending.
+void STS_Materialize()
+{
+	LazyFlags *lf = &gCpu->lazyFlags;
+	ushort sts = gLevelRegs[_STS] & ~((1 << _C) | (1 << _Q));
+
+	if (lf->sum & 0xFFFF0000)
+		sts |= (1 << _C);
+
+	if (ADD_OVERFLOW(lf->a, lf->b, lf->sum))
+		sts |= (1 << _O) | (1 << _Q); // Static and dynamic overflow
+	else if (lf->overflow)
+		sts |= (1 << _O);
+
+	gLevelRegs[_STS] = sts;
+	lf->overflow = false;
+	lf->pending = false;
+}
+
 void AdjustSTS(ushort reg_a, ushort operand, int result)
 {
 	/* C (carry) */
@@ -27,6 +27,9 @@
 #include <stdio.h>
 #include <math.h>
 #include <limits.h>
+#include <setjmp.h>
+
+#include "../machine/machine_context.h"
 
 // Sleep function for Windows and Linux.
 //
@@ -139,6 +142,15 @@ typedef enum {
     WRITEMODE_WORD    // Full word
 } WriteMode;
 
+// Software TLB in front of mapVirtualToPhysical.
+// One slot per (level, PT/APT, access kind, VPN). A slot holds the physical page base
+// with TLB_VALID in bit 0 (the page base always has the 10 DIP bits clear).
+#define TLB_LEVELS 16
+#define TLB_TABLES 2     // 0 = PT, 1 = APT (only selected when STS_PTM is set)
+#define TLB_KINDS  4     // READ, WRITE, FETCH, READ_FETCH
+#define TLB_VPNS   64
+#define TLB_VALID  1
+
 // Paging Tables structure
 typedef struct {
     MMSType mmsType;           // What kind of MMS is this
@@ -146,16 +158,22 @@ typedef struct {
     uint shadowRamAddress;     // Start address of Shadow RAM
     uint16_t shadowRamSize;      // Size of shadow RAM array
     bool isInitialized;        // Whether the paging tables have been initialized
+
+    uint32_t tlb[TLB_LEVELS][TLB_TABLES][TLB_KINDS][TLB_VPNS]; // Cached translations
+    uint8_t tlbShadowRef[2048 / 8]; // Shadow RAM words backing at least one TLB slot
+    bool tlbInUse;             // Any slot filled since the last full flush
+    uint32_t tlbEpoch;         // Bumped on every flush, see FetchPage
 } PagingTables;
 
 
 extern MMSType mmsType; // What MMS type is currently in use
-extern PagingTables pt; // Global paging tables structure
+#define gPT (gCpu->pt)  // Paging tables of the current machine
 
 /********************* CPU *********************/
 
 typedef void (*InstrFunc)(unsigned short);
 extern InstrFunc instr_funcs[65536];
+extern uint8_t dispatch_slot[65536];   // instr_funcs entry -> threaded dispatch label, see Dispatch_Build
 
 
 
@@ -253,25 +271,81 @@ extern InstrFunc instr_funcs[65536];
 /* NEW ORGANIZATION OF MEMORY AND REGISTERS!!    */
 /*************************************************/
 
-/* Lets use the full 16MWord space now (32MB ram in host)*/
-//#define MEMPTSIZE 16384
-
-// Lets just use 4MW (8MB) for now.. seems like 'CONFIG' is having some strange issues with 16MW (32MB) - at least detection is saying  "Total memory size....: 65504.000 Mbytes"
-#define MEMPTSIZE 1024*2
+/* Physical memory is sized at startup (--memory=KW), in 1K word pages.
+ * The maximum is the full 16 MWord (24-bit) address space. The default is 2048 KW (4 MB);
+ * 'CONFIG' has some strange issues with 16MW - at least detection is saying
+ * "Total memory size....: 65504.000 Mbytes"
+ */
+#define MEMPTSIZE 16384             // Maximum number of 1K pages
+#define MEMPAGES_DEFAULT (1024*2)   // Default number of 1K pages
 
 /* Volatile Memory
- * Fixed to MEMPTSIZE KWords for now.
+ * One anonymous mapping allocated by cpu_memory_init(). Pages the guest never writes
+ * are never backed by host memory.
  */
-typedef union ndram {
-	unsigned char	c_Array[MEMPTSIZE*1024*2];
-	ushort		n_Array[MEMPTSIZE*1024];
-	ushort		n_Pages[MEMPTSIZE][1024];
+typedef struct ndram {
+	ushort		*n_Array;   // ND_Memsize words
+	uint32_t	pages;      // Size in 1K word pages
 } _NDRAM_ ;
 
+// Installed memory in words
+#define ND_Memsize	((size_t)VolatileMemory.pages << 10)
+
+// Start of a 1K word page
+#define ND_Page(page)	(&VolatileMemory.n_Array[(size_t)(page) << 10])
+
+
+// Pages written since the last snapshot checkpoint, one bit per 1K page (see machine/snapshot.c).
+// Every write that bypasses WritePhysicalMemoryWM must mark its page too.
+#define MEM_DIRTY_BYTES (MEMPTSIZE / 8)
+#define MEM_MARK_DIRTY(addr) \
+    (memDirtyPages[(uint)(addr) >> 13] |= (uint8_t)(1 << (((uint)(addr) >> 10) & 7)))
+
+
+// Pre-decoded instruction cache, keyed by physical page.
+// Each word that has been fetched as an instruction keeps its handler and operand, so the
+// block runner can skip the physical read and the instr_funcs lookup. Any write to a word
+// (CPU or DMA) clears its handler, forcing a fresh decode on the next fetch.
+#define DC_PAGE_WORDS 1024
+#define DC_BLOCK_END  1     // Instruction may change P or program level; end the block after it
+
+typedef struct {
+    InstrFunc handler;      // NULL = not decoded
+    ushort operand;         // Instruction word
+    ushort flags;           // DC_xxx
+    ushort dispatch;        // Label slot of the handler in the threaded dispatcher (cpu_instr.c), 0 = call through handler
+} DecodedInstr;
+
+typedef struct {
+    DecodedInstr instr[DC_PAGE_WORDS];
+} DecodedPage;
+
+typedef struct {
+    DecodedPage *pages[MEMPTSIZE]; // Allocated on first fetch from the page
+} DecodeCache;
 
-// Maximum memory size (8 MWords / 16 MBytes)
-// Note: Max memory could be 16MW/32MB with 24-bit addressing, but this configuration is not commonly used
-#define ND_Memsize	(sizeof(VolatileMemory)/sizeof(ushort))
+// Code page of the last instruction fetch, filled by MapFetchAddress (cpu_mms.c).
+// While P stays on the page, on the same level, and no TLB flush happened since it was
+// filled, a fetch needs neither translation nor checks.
+typedef struct {
+    ushort *mem;            // Physical memory of the page
+    DecodedPage *decoded;   // Its decode cache page, NULL until DecodeCache_Fetch allocates it
+    uint base;              // Physical address of the page
+    uint vpn;               // Virtual page number
+    uint level;             // Program level
+    uint32_t epoch;         // gPT.tlbEpoch when filled
+} FetchPage;
+
+#define FETCH_PAGE_HIT(addr) \
+    ((gCpu->fetchPage.epoch == gPT.tlbEpoch) && (gCpu->fetchPage.vpn == ((uint)(addr) >> 10)) && \
+     (gCpu->fetchPage.level == CurrLEVEL))
+
+// Drop the pre-decoded instruction (if any) at a physical address
+#define DC_INVALIDATE(addr) \
+    do { \
+        DecodedPage *dcPage_ = decodeCache.pages[(uint)(addr) >> 10]; \
+        if (dcPage_) dcPage_->instr[(addr) & 0x3FF].handler = NULL; \
+    } while (0)
 
 
 struct CpuRegs {
@@ -351,13 +425,17 @@ typedef enum {
 
 typedef enum {ND1, ND4, ND10, ND100, ND100CE, ND100CX, ND110, ND110CE, ND110CX, ND110PCX} CpuType;
 
-#define gPC	gReg->reg[gPIL][_P]
-#define gA	gReg->reg[gPIL][_A]
-#define gT	gReg->reg[gPIL][_T]
-#define gB	gReg->reg[gPIL][_B]
-#define gD	gReg->reg[gPIL][_D]
-#define gX	gReg->reg[gPIL][_X]
-#define gL	gReg->reg[gPIL][_L]
+// Register row of the current level, gReg->reg[gPIL]. Kept by setPIL; anything else that
+// changes the PIL bits of reg_STS must call SyncLevelRegs().
+#define gLevelRegs	(gCpu->levelRegs)
+
+#define gPC	gLevelRegs[_P]
+#define gA	gLevelRegs[_A]
+#define gT	gLevelRegs[_T]
+#define gB	gLevelRegs[_B]
+#define gD	gLevelRegs[_D]
+#define gX	gLevelRegs[_X]
+#define gL	gLevelRegs[_L]
 
 #define gPANC	gReg->reg_PANC
 #define gPANS	gReg->reg_PANS
@@ -396,8 +474,42 @@ typedef enum {ND1, ND4, ND10, ND100, ND100CE, ND100CX, ND110, ND110CE, ND110CX,
 /* Should CPU levels be checked ? */
 #define gCHKIT	gReg->chkit
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// @brief Number of the highest set bit, used to pick the interrupt level (PID & PIE) and
+/// internal interrupt source (IID & IIE) with the highest priority
+/// @param mask Bits to scan, must not be 0
+static inline int highest_bit(unsigned int mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return 31 - __builtin_clz(mask);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return (int)index;
+#else
+	int bit = 0;
+	while (mask >>= 1)
+		bit++;
+	return bit;
+#endif
+}
+
 /* The complete Status register both MSB and LSB for current runlevel. Read only MACRO */
-#define gSTSr		((gReg->reg_STS & 0xFF00) | (gReg->reg[gPIL][_STS] & 0x00FF))
+#define gSTSr		((gReg->reg_STS & 0xFF00) | (gLevelRegs[_STS] & 0x00FF))
+
+// Lazy C, O and Q flags (cpu_regs.c). do_add only records its operands and sum in
+// CpuState.lazyFlags. STS_SYNC() writes the flags to the STS of the current level; it is
+// called before anything reads or changes STS inside an instruction, before a level switch,
+// and when the block runner or do_op returns. Outside cpu_run the flags are always in STS.
+#define ADD_OVERFLOW(a, b, sum)	(!(((a) ^ (b)) & 0x8000) && (((a) ^ (sum)) & 0x8000))
+#define STS_SYNC() \
+	do { \
+		if (gCpu->lazyFlags.pending) \
+			STS_Materialize(); \
+	} while (0)
 
 #define InstructionRegister	gReg->myreg_IR
 #define PrefetchBuffer		gReg->myreg_PFB
@@ -405,14 +517,14 @@ typedef enum {ND1, ND4, ND10, ND100, ND100CE, ND100CX, ND110, ND110CE, ND110CX,
 #define gEA                 gReg->effectiveAddress
 #define gUseAPT             gReg->useAPT
 
-#define STS_PTM  ((gReg->reg[gPIL][_STS]>>0) & 0x01)	/* */
-#define STS_TG   ((gReg->reg[gPIL][_STS]>>1) & 0x01)	/* */
-#define STS_K    ((gReg->reg[gPIL][_STS]>>2) & 0x01)	/* */
-#define STS_Z    ((gReg->reg[gPIL][_STS]>>3) & 0x01)	/* */
-#define STS_Q    ((gReg->reg[gPIL][_STS]>>4) & 0x01)	/* */
-#define STS_O    ((gReg->reg[gPIL][_STS]>>5) & 0x01)	/* */
-#define STS_C    ((gReg->reg[gPIL][_STS]>>6) & 0x01)	/* */
-#define STS_M    ((gReg->reg[gPIL][_STS]>>7) & 0x01)	/* */
+#define STS_PTM  ((gLevelRegs[_STS]>>0) & 0x01)	/* */
+#define STS_TG   ((gLevelRegs[_STS]>>1) & 0x01)	/* */
+#define STS_K    ((gLevelRegs[_STS]>>2) & 0x01)	/* */
+#define STS_Z    ((gLevelRegs[_STS]>>3) & 0x01)	/* */
+#define STS_Q    ((gLevelRegs[_STS]>>4) & 0x01)	/* */
+#define STS_O    ((gLevelRegs[_STS]>>5) & 0x01)	/* */
+#define STS_C    ((gLevelRegs[_STS]>>6) & 0x01)	/* */
+#define STS_M    ((gLevelRegs[_STS]>>7) & 0x01)	/* */
 
 #define STS_PL   ((gReg->reg_STS >>8  ) & 0x0F)	/* Program runlevel */
 #define STS_N100 ((gReg->reg_STS >>12 ) & 0x01)	/* Nord 100 indicator */
@@ -470,15 +582,55 @@ extern DisasmArray* p_DIS;
 
 
 
-// Global CPU variable definitions
-extern struct CpuRegs *gReg;
-extern _NDRAM_ VolatileMemory;
-extern CpuType CurrentCPUType;
+// CPU state of one machine (Machine.cpu, see machine/machine_context.h).
+// gCpu is the cpu of the calling thread's machine; the names below are kept as macros on it.
+struct CpuRunState;     // cpu.c: run mode, debugger handshake, idle and throttle bookkeeping
+
+typedef struct {
+	ushort a;           // Operands of the last do_add (b already complemented for subtract)
+	ushort b;
+	int sum;            // a + b + carry in, bit 16 is C
+	bool overflow;      // An earlier add, not yet written to STS, set the sticky O
+	bool pending;       // a, b and sum are not yet written to STS
+} LazyFlags;
+
+struct CpuState {
+	struct CpuRegs regs;
+	ushort *levelRegs;                      // regs.reg[PIL], see gLevelRegs
+	_NDRAM_ memory;
+	PagingTables pt;
+	DecodeCache decodeCache;
+	DecodedInstr uncachedInstr;             // Decode scratch for words outside the cache
+	FetchPage fetchPage;                    // See FETCH_PAGE_HIT
+	uint8_t dirtyPages[MEM_DIRTY_BYTES];    // See MEM_MARK_DIRTY
+
+	jmp_buf jmpBuf;                         // Exit from a faulting instruction back to cpu_run
+	ushort operand;                         // Instruction being executed
+	ushort startAddress;
+	int exitCode;                           // A register of the last WAIT/exit
+	bool waitIdle;                          // WAIT executed on level 0, cleared by the next level switch
+	bool activateSleep;                     // The CPU has been above level 0, level 0 is now the idle level
+	uint32_t memWrites;                     // Writes that changed memory, lets cpu_idle_check tell idle from compute loops
+	LazyFlags lazyFlags;                    // See STS_SYNC
+
+	struct CpuRunState *run;
+};
+
+extern _Thread_local struct CpuState *gCpu;
 
-extern uint64_t  instr_counter ;
-extern ushort STARTADDR;
+#define gReg            (&gCpu->regs)
+#define VolatileMemory  (gCpu->memory)
+#define decodeCache     (gCpu->decodeCache)
+#define memDirtyPages   (gCpu->dirtyPages)
+#define cpu_jmp_buf     (gCpu->jmpBuf)
+#define STARTADDR       (gCpu->startAddress)
+#define gCpuExitCode    (gCpu->exitCode)
+#define cpu_wait_idle   (gCpu->waitIdle)
+#define activateSleep   (gCpu->activateSleep)
+#define cpu_mem_writes  (gCpu->memWrites)
+
+extern CpuType CurrentCPUType;
 extern int DISASM;
-extern int gCpuExitCode;
 extern int CPU_TRACE;
 extern int BSD_DEBUG;
 extern uint64_t CPU_MAX_INSTR;
@@ -0,0 +1,159 @@
+/*
+ * float48.h - ND-100 48-bit floating point on host integers
+ *
+ * A floating number is kept in the low 48 bits of a uint64_t, in the same order
+ * as the floating accumulator {T,A,D}:
+ *   bit 47      sign
+ *   bits 46-32  exponent (biased 16384)
+ *   bits 31-0   mantissa, normalized: 0.5 <= |mantissa| < 1.0 (bit 31 set)
+ *
+ * FAD, FSB, FMU and FDV call these directly. The results are bit for bit those
+ * of the SIMH derived routines float.c used before (tests/test_float.c keeps
+ * them as the reference), including the guard bit, the wrap of exponent
+ * overflow into the sign and the flush of underflow to zero.
+ */
+
+#ifndef FLOAT48_H
+#define FLOAT48_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu_types.h"
+
+#define ND48(t, a, d)   (((uint64_t)(uint16_t)(t) << 32) | ((uint64_t)(uint16_t)(a) << 16) | (uint16_t)(d))
+#define ND48_T(f)       ((uint16_t)((f) >> 32))
+#define ND48_A(f)       ((uint16_t)((f) >> 16))
+#define ND48_D(f)       ((uint16_t)(f))
+
+#define ND48_SIGN(f)    ((int)((f) >> 47) & 1)
+#define ND48_EXP(f)     ((int)(((f) >> 32) & 0x7FFF) - 16384)
+#define ND48_MANT(f)    ((f) & 0xFFFFFFFFull)
+
+/* Pack sign, unbiased exponent and 32-bit mantissa. The exponent word is cut to
+ * 16 bits, so an out of range exponent spills into the sign as on the old code. */
+static inline uint64_t nd48_pack(int s, int e, uint64_t m)
+{
+	return ((uint64_t)(uint16_t)((e + 16384) | (s << 15)) << 32) | (m & 0xFFFFFFFFull);
+}
+
+/* a + b, both with the same sign */
+static inline uint64_t nd48_add_mag(uint64_t a, uint64_t b)
+{
+	/* a gets the larger exponent */
+	if (ND48_EXP(b) > ND48_EXP(a)) {
+		uint64_t t = a; a = b; b = t;
+	}
+
+	int e = ND48_EXP(a);
+	int scale = e - ND48_EXP(b);
+	uint64_t m = ND48_MANT(a);
+
+	if (scale <= 31) {
+		uint64_t mb = ND48_MANT(b);
+		uint64_t gbit = (mb & ((1ull << scale) - 1)) != 0; /* shifted out guard bit */
+		m = (m + (mb >> scale)) | gbit;
+		if (m > 0xFFFFFFFFull) {
+			m >>= 1;
+			e++;
+		}
+	}
+
+	return nd48_pack(ND48_SIGN(a), e, m);
+}
+
+/* a + b, with different signs */
+static inline uint64_t nd48_sub_mag(uint64_t a, uint64_t b)
+{
+	/* a gets the larger exponent */
+	if (ND48_EXP(b) > ND48_EXP(a)) {
+		uint64_t t = a; a = b; b = t;
+	}
+
+	int e = ND48_EXP(a);
+	int scale = e - ND48_EXP(b);
+	int s = ND48_SIGN(a);
+	uint64_t m = ND48_MANT(a);
+
+	if (scale <= 31) {
+		uint64_t ma = m;
+		uint64_t mb = ND48_MANT(b);
+		uint64_t gbit = (mb & ((1ull << scale) - 1)) != 0; /* shifted out sticky bit */
+		mb >>= scale;
+
+		/* The larger mantissa decides the sign */
+		if (mb > ma) {
+			m = (mb - ma) | gbit;
+			s = ND48_SIGN(b);
+		} else {
+			m = (ma - mb) | gbit;
+		}
+
+		if (m == 0)
+			return 0;
+
+		/* normalize */
+		int shift = 31 - highest_bit((unsigned int)m);
+		m <<= shift;
+		e -= shift;
+	}
+
+	return nd48_pack(s, e, m);
+}
+
+static inline uint64_t NDFloat48_Add(uint64_t a, uint64_t b)
+{
+	return (ND48_SIGN(a) ^ ND48_SIGN(b)) ? nd48_sub_mag(a, b) : nd48_add_mag(a, b);
+}
+
+static inline uint64_t NDFloat48_Sub(uint64_t a, uint64_t b)
+{
+	return NDFloat48_Add(a, b ^ (1ull << 47));
+}
+
+static inline uint64_t NDFloat48_Mul(uint64_t a, uint64_t b)
+{
+	uint64_t m = ND48_MANT(a) * ND48_MANT(b);
+	int e = ND48_EXP(a) + ND48_EXP(b);
+
+	/* normalize (if needed) */
+	if ((m & (1ull << 63)) == 0) {
+		m <<= 1;
+		e--;
+	}
+
+	if (m == 0 || e < -16383)
+		return 0;
+	return nd48_pack(ND48_SIGN(a) ^ ND48_SIGN(b), e, m >> 32);
+}
+
+/* a / b. Returns false on division by zero, with the largest number of a's sign in *r. */
+static inline bool NDFloat48_Div(uint64_t a, uint64_t b, uint64_t *r)
+{
+	uint64_t divisor = ND48_MANT(b);
+	uint64_t dividend = ND48_MANT(a) << 32;
+
+	if (divisor == 0) {
+		*r = ND48(ND48_T(a) | 0x7FFF, 0xFFFF, 0xFFFF);
+		return false;
+	}
+
+	int e = ND48_EXP(a) - ND48_EXP(b);
+	uint64_t m = dividend / divisor;
+	if (dividend % divisor) /* "guard" bit */
+		m++;
+
+	/* normalize (if needed) */
+	if (m >= (1ull << 32)) {
+		m >>= 1;
+		e++;
+	}
+
+	if (dividend == 0 || e < -16383)
+		*r = 0;
+	else
+		*r = nd48_pack(ND48_SIGN(a) ^ ND48_SIGN(b), e, m);
+	return true;
+}
+
+#endif /* FLOAT48_H */
@@ -237,7 +237,9 @@ static void debugger_signal_handler(int sig)
 
 void *debugger_thread(void *arg)
 {
-    (void)arg;
+    // The debugger inspects and controls the machine that started it
+    machine_bind((Machine *)arg);
+
 #ifdef _WIN32
     // Windows: plain signal() — no sigaction on MinGW CRT.
     signal(SIGINT, debugger_signal_handler);
@@ -292,7 +294,7 @@ void start_debugger()
 {
     // Start the debugger thread via pthreads (libpthread on POSIX,
     // winpthreads on MinGW-w64 under Windows).
-    pthread_create(&p_debugger_thread, NULL, debugger_thread, NULL);
+    pthread_create(&p_debugger_thread, NULL, debugger_thread, gMachine);
 }
 
 /// @brief Terminate the DAP server
@@ -0,0 +1,309 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Block I/O workers
+//
+// Disk controllers hand the host side of a transfer (the block callbacks, normally
+// machine_block_read/machine_block_write) to a small pool of host threads, and keep
+// the CPU running meanwhile. The controller queues its completion with
+// Device_QueueBlockIODelay(), which fires once the emulated delay has passed AND the
+// worker is done. The completion callback collects the result with BlockIO_Finish().
+//
+// A device has at most one transfer on the workers. Data in memory is only touched on
+// the machine thread: a read is moved to memory by the completion callback, a write is
+// taken from memory before it is submitted.
+//
+// The workers bind the machine of the request while they run the block callback, and
+// wake an idle CPU with HostWait_Signal() when they are done. They live as long as the
+// process and are shared by all machines.
+//
+// WASM: single threaded, BlockIO_Submit() always declines and the controllers do the
+// transfer synchronously as before.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "devices_types.h"
+#include "devices_protos.h"
+
+#include "../ndlib/hostwait.h"
+
+#if !defined(__EMSCRIPTEN__)
+#define BLOCKIO_THREADS
+#include <pthread.h>
+#endif
+
+static bool blockIOEnabled = true;
+
+#ifdef BLOCKIO_THREADS
+static pthread_mutex_t blockIOMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workCond = PTHREAD_COND_INITIALIZER;   // A request was queued
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;   // A request finished
+static BlockIORequest *queueHead = NULL;
+static BlockIORequest *queueTail = NULL;
+static int inFlight = 0;            // Requests queued or running
+static int workerCount = 0;
+static bool workersStarted = false;
+
+static void *blockio_worker(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&blockIOMutex);
+    for (;;)
+    {
+        while (!queueHead)
+            pthread_cond_wait(&workCond, &blockIOMutex);
+
+        BlockIORequest *req = queueHead;
+        queueHead = req->next;
+        if (!queueHead)
+            queueTail = NULL;
+        pthread_mutex_unlock(&blockIOMutex);
+
+        // The block callbacks find the drives through the current machine
+        gMachine = req->machine;
+        Device *dev = req->device;
+        if (req->write)
+            req->result = dev->blockCallbacks.writeFunc(dev, req->buffer, req->blocks, req->blockAddress, req->unit);
+        else
+            req->result = dev->blockCallbacks.readFunc(dev, req->buffer, req->blocks, req->blockAddress, req->unit);
+        gMachine = NULL;
+
+        // The device may free the request as soon as it sees 'done'
+        pthread_mutex_lock(&blockIOMutex);
+        atomic_store(&req->done, true);
+        inFlight--;
+        pthread_cond_broadcast(&doneCond);
+        pthread_mutex_unlock(&blockIOMutex);
+
+        HostWait_Signal(); // Wake an idle CPU waiting for the completion
+
+        pthread_mutex_lock(&blockIOMutex);
+    }
+    return NULL;
+}
+
+// Start the workers on first use. Returns false if not even one could be started.
+static bool start_workers(void)
+{
+    pthread_mutex_lock(&blockIOMutex);
+    if (!workersStarted)
+    {
+        workersStarted = true;
+        for (int i = 0; i < BLOCKIO_WORKERS; i++)
+        {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, blockio_worker, NULL) != 0)
+                break;
+            pthread_detach(thread);
+            workerCount++;
+        }
+        if (workerCount == 0)
+            fprintf(stderr, "BlockIO: Failed to create worker threads, disk transfers stay synchronous\n");
+    }
+    pthread_mutex_unlock(&blockIOMutex);
+    return workerCount > 0;
+}
+#endif
+
+/// @brief Turn the I/O workers on or off for new transfers
+/// @details Off, the controllers do all host I/O in the machine thread (deterministic timing).
+void BlockIO_SetEnabled(bool enabled)
+{
+    blockIOEnabled = enabled;
+}
+
+/// @brief Hand a block transfer to the I/O workers
+/// @details The request takes 'buffer' (malloc'd, blocks * blockSizeBytes) until
+/// BlockIO_Finish() hands it back. For a write it must already hold the data.
+/// @return false if the workers are not available; the caller does the transfer itself
+bool BlockIO_Submit(Device *dev, bool write, uint8_t *buffer, size_t blocks, uint32_t blockAddress, int unit)
+{
+#ifdef BLOCKIO_THREADS
+    if (!dev || !buffer || !blockIOEnabled)
+        return false;
+    if (!start_workers())
+        return false;
+
+    BlockIORequest *req = (BlockIORequest *)calloc(1, sizeof(BlockIORequest));
+    if (!req)
+        return false;
+
+    // One transfer per device; one whose completion never ran (device reset) is dropped
+    BlockIO_Discard(dev);
+
+    req->device = dev;
+    req->machine = gMachine;
+    req->write = write;
+    req->buffer = buffer;
+    req->blocks = blocks;
+    req->blockAddress = blockAddress;
+    req->unit = unit;
+    req->result = -1;
+    atomic_init(&req->done, false);
+    dev->blockIO = req;
+
+    pthread_mutex_lock(&blockIOMutex);
+    if (queueTail)
+        queueTail->next = req;
+    else
+        queueHead = req;
+    queueTail = req;
+    inFlight++;
+    pthread_cond_signal(&workCond);
+    pthread_mutex_unlock(&blockIOMutex);
+    return true;
+#else
+    (void)dev; (void)write; (void)buffer; (void)blocks; (void)blockAddress; (void)unit;
+    return false;
+#endif
+}
+
+/// @brief True while the device has a transfer the workers have not finished
+bool BlockIO_Busy(Device *dev)
+{
+    return dev && dev->blockIO && !atomic_load(&dev->blockIO->done);
+}
+
+/// @brief Wait for the host side of the device's transfer to finish
+void BlockIO_Wait(Device *dev)
+{
+#ifdef BLOCKIO_THREADS
+    if (!BlockIO_Busy(dev))
+        return;
+
+    pthread_mutex_lock(&blockIOMutex);
+    while (!atomic_load(&dev->blockIO->done))
+        pthread_cond_wait(&doneCond, &blockIOMutex);
+    pthread_mutex_unlock(&blockIOMutex);
+#else
+    (void)dev;
+#endif
+}
+
+/// @brief Collect the device's transfer, waiting for it if needed
+/// @param buffer Gets the buffer given to BlockIO_Submit (NULL if there was no transfer)
+/// @return The number of blocks transferred, or -1 if the transfer failed, was short or did not exist
+int BlockIO_Finish(Device *dev, uint8_t **buffer)
+{
+    *buffer = NULL;
+    if (!dev || !dev->blockIO)
+        return -1;
+
+    BlockIO_Wait(dev);
+
+    BlockIORequest *req = dev->blockIO;
+    int result = (req->result == (int)req->blocks) ? req->result : -1;
+    *buffer = req->buffer;
+    dev->blockIO = NULL;
+    free(req);
+    return result;
+}
+
+/// @brief Drop the device's transfer, after waiting for the host side to finish
+void BlockIO_Discard(Device *dev)
+{
+    uint8_t *buffer;
+    if (!dev || !dev->blockIO)
+        return;
+    BlockIO_Finish(dev, &buffer);
+    free(buffer);
+}
+
+/// @brief Wait until the workers are idle
+/// @details For code that changes the drives behind the block callbacks (mount, unmount).
+void BlockIO_Drain(void)
+{
+#ifdef BLOCKIO_THREADS
+    pthread_mutex_lock(&blockIOMutex);
+    while (inFlight > 0)
+        pthread_cond_wait(&doneCond, &blockIOMutex);
+    pthread_mutex_unlock(&blockIOMutex);
+#endif
+}
+
+// Snapshot: the transfer of a device, finished first, with the data a read brought in
+#define BLOCKIO_STATE_VERSION 1
+
+bool BlockIO_SaveState(Device *dev, FILE *f)
+{
+    StateRecord rec;
+    BlockIORequest *req = dev->blockIO;
+
+    BlockIO_Wait(dev);
+    StateRecord_Begin(&rec, BLOCKIO_STATE_VERSION);
+    StateRecord_PutBool(&rec, req != NULL);
+    if (req)
+    {
+        StateRecord_PutBool(&rec, req->write);
+        StateRecord_PutU32(&rec, (uint32_t)req->blocks);
+        StateRecord_PutU32(&rec, req->blockAddress);
+        StateRecord_PutInt(&rec, req->unit);
+        StateRecord_PutInt(&rec, req->result);
+        StateRecord_PutBytes(&rec, req->buffer, req->blocks * dev->blockSizeBytes);
+    }
+    return StateRecord_Write(&rec, f);
+}
+
+// Restore a transfer saved by BlockIO_SaveState as one that has finished
+bool BlockIO_LoadState(Device *dev, FILE *f)
+{
+    StateRecord rec;
+
+    BlockIO_Discard(dev);
+    if (!StateRecord_Read(&rec, f, BLOCKIO_STATE_VERSION))
+        return false;
+    if (!StateRecord_GetBool(&rec))
+        return StateRecord_End(&rec);
+
+    BlockIORequest *req = (BlockIORequest *)calloc(1, sizeof(BlockIORequest));
+    if (!req)
+    {
+        StateRecord_End(&rec);
+        return false;
+    }
+    req->write = StateRecord_GetBool(&rec);
+    req->blocks = StateRecord_GetU32(&rec);
+    req->blockAddress = StateRecord_GetU32(&rec);
+    req->unit = StateRecord_GetInt(&rec);
+    req->result = StateRecord_GetInt(&rec);
+
+    size_t bytes;
+    const uint8_t *data = StateRecord_GetData(&rec, &bytes);
+    req->buffer = (uint8_t *)malloc(bytes ? bytes : 1);
+    if (req->buffer && data)
+        memcpy(req->buffer, data, bytes);
+    if (!StateRecord_End(&rec) || !req->buffer || bytes != req->blocks * dev->blockSizeBytes)
+    {
+        free(req->buffer);
+        free(req);
+        return false;
+    }
+
+    req->device = dev;
+    req->machine = gMachine;
+    atomic_init(&req->done, true);
+    dev->blockIO = req;
+    return true;
+}
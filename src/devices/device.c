@@ -28,6 +28,7 @@
 
 #include "devices_types.h"
 #include "devices_protos.h"
+#include "../ndlib/ndlib_protos.h"
 
 #define INITIAL_IO_DELAY_CAPACITY 16
 
@@ -72,6 +73,8 @@ void Device_Init(Device *dev, uint8_t thumbwheel, DeviceClass deviceClass, size_
     dev->interruptLevel = 0;
     dev->identCode = 0;
     dev->deviceClass = deviceClass;
+    dev->nextTick = DEVICE_NO_TICK;
+    dev->nextEvent = DEVICE_NO_TICK;
 
     // Initialize IO delay array
     dev->ioDelays = malloc(sizeof(DelayedIoInfo) * INITIAL_IO_DELAY_CAPACITY);
@@ -108,6 +111,8 @@ void Device_Destroy(Device *dev)
         return;
     
     // Call device-specific cleanup if it exists
+    BlockIO_Discard(dev);
+
     if (dev->Destroy)
     {
         dev->Destroy(dev);
@@ -140,6 +145,38 @@ uint16_t Device_Tick(Device *dev)
     return dev->Tick(dev);
 }
 
+// Ask for this device's Tick to run no later than 'ticks' instructions from now.
+// Deadlines only move earlier; a device ticked before its own deadline just re-arms.
+void Device_ScheduleTick(Device *dev, uint64_t ticks)
+{
+    if (!dev)
+        return;
+
+    uint64_t due = instr_counter + ticks;
+    if (due < dev->nextTick)
+        dev->nextTick = due;
+    if (due < dev->nextEvent)
+        dev->nextEvent = due;
+    if (due < io_next_tick)
+        io_next_tick = due;
+    if (due < io_next_event)
+        io_next_event = due;
+}
+
+// As Device_ScheduleTick, for polling that only looks for input arriving from the host.
+// An idle CPU does not wait for these; the input source wakes it with HostWait_Signal().
+void Device_SchedulePoll(Device *dev, uint64_t ticks)
+{
+    if (!dev)
+        return;
+
+    uint64_t due = instr_counter + ticks;
+    if (due < dev->nextTick)
+        dev->nextTick = due;
+    if (due < io_next_tick)
+        io_next_tick = due;
+}
+
 // Loads boot code from disk to memory. Returns the boot address, or -1 if error
 int32_t Device_Boot(Device *dev, uint16_t device_id)
 {
@@ -205,36 +242,72 @@ void Device_QueueIODelay(Device *dev, uint16_t ticks, IODelayedCallback cb, int
 
     // Add new delay
     DelayedIoInfo *delay = &dev->ioDelays[dev->ioDelayCount++];
-    delay->delayTicks = ticks;
+    delay->dueTick = instr_counter + ticks;
     delay->callback = cb;
     delay->context = dev;
     delay->parameter = param;
     delay->level = irqlevel;
+    delay->waitBlockIO = false;
+
+    Device_ScheduleTick(dev, ticks);
+}
+
+// As Device_QueueIODelay, for the completion of a transfer handed to BlockIO_Submit().
+// The callback runs once the delay has passed and the I/O workers have finished the transfer.
+void Device_QueueBlockIODelay(Device *dev, uint16_t ticks, IODelayedCallback cb, int param, uint8_t irqlevel)
+{
+    if (!dev || !dev->ioDelays)
+        return;
+
+    int count = dev->ioDelayCount;
+    Device_QueueIODelay(dev, ticks, cb, param, irqlevel);
+    if (dev->ioDelayCount > count)
+        dev->ioDelays[count].waitBlockIO = true;
 }
 
+// Run the callbacks of all delays that are due, and re-arm the device for the next one
 void Device_TickIODelay(Device *dev)
 {
     if (!dev || !dev->ioDelays)
         return;
 
+    bool waiting = false;
     for (int i = 0; i < dev->ioDelayCount; i++)
     {
-        DelayedIoInfo *delay = &dev->ioDelays[i];
-        delay->delayTicks--;
-
-        if (delay->delayTicks <= 0)
+        if (dev->ioDelays[i].dueTick <= instr_counter)
         {
-            bool triggered = delay->callback(delay->context, delay->parameter);            
-            if (triggered && delay->level > 0)
+            // Due, but the host side of the transfer is still running
+            if (dev->ioDelays[i].waitBlockIO && BlockIO_Busy(dev))
             {
-                Device_GenerateInterrupt(dev, delay->level);
+                waiting = true;
+                continue;
             }
+
+            // Copy out first, the callback may queue a new delay and realloc the array
+            DelayedIoInfo delay = dev->ioDelays[i];
+
             // Remove this delay by shifting remaining ones
             memmove(&dev->ioDelays[i], &dev->ioDelays[i + 1], (dev->ioDelayCount - i - 1) * sizeof(DelayedIoInfo));
             dev->ioDelayCount--;
             i--; // Recheck this position
+
+            bool triggered = delay.callback(delay.context, delay.parameter);
+            if (triggered && delay.level > 0)
+            {
+                Device_GenerateInterrupt(dev, delay.level);
+            }
         }
     }
+
+    for (int i = 0; i < dev->ioDelayCount; i++)
+    {
+        if (!dev->ioDelays[i].waitBlockIO || dev->ioDelays[i].dueTick > instr_counter)
+            Device_ScheduleTick(dev, dev->ioDelays[i].dueTick - instr_counter);
+    }
+
+    // Look again soon; an idle CPU sleeps until the worker wakes it
+    if (waiting)
+        Device_SchedulePoll(dev, BLOCKIO_POLL_TICKS);
 }
 
 void Device_ClearInterrupt(Device *dev, uint16_t level)
@@ -364,7 +437,7 @@ int32_t Device_IO_BufferWriteWord(Device *dev,uint8_t *buf, int32_t word_offset,
 
 // DMA bypasses shadow memory (page tables) — it's a physical bus transfer.
 // Set gDMAAccess flag so IsAddressShadowMemory skips the shadow check.
-extern bool gDMAAccess;
+extern _Thread_local bool gDMAAccess;
 
 const char *gDMADeviceName = "?";
 
@@ -382,6 +455,59 @@ int32_t Device_DMARead(uint32_t coreAddress)
     return result;
 }
 
+// DMA of a block of big-endian words from a device buffer to memory, from coreAddress on.
+// Same result as Device_DMAWrite per word; the runs PhysicalBlockSpan accepts are copied in bulk.
+void Device_DMAWriteBlock(uint32_t coreAddress, const uint8_t *buf, uint32_t words)
+{
+    while (words > 0)
+    {
+        uint32_t address = coreAddress & 0xFFFFFF;
+        uint32_t run = (words < 0x1000000 - address) ? words : 0x1000000 - address;
+        run = PhysicalBlockSpan(address, run);
+
+        if (run > 0)
+        {
+            WritePhysicalBlock(address, buf, run);
+        }
+        else
+        {
+            Device_DMAWrite(address, (uint16_t)((buf[0] << 8) | buf[1]));
+            run = 1;
+        }
+
+        buf += run * 2;
+        coreAddress += run;
+        words -= run;
+    }
+}
+
+// DMA of a block of memory words to a device buffer, stored big-endian
+void Device_DMAReadBlock(uint32_t coreAddress, uint8_t *buf, uint32_t words)
+{
+    while (words > 0)
+    {
+        uint32_t address = coreAddress & 0xFFFFFF;
+        uint32_t run = (words < 0x1000000 - address) ? words : 0x1000000 - address;
+        run = PhysicalBlockSpan(address, run);
+
+        if (run > 0)
+        {
+            ReadPhysicalBlock(address, buf, run);
+        }
+        else
+        {
+            uint16_t data = (uint16_t)Device_DMARead(address);
+            buf[0] = (uint8_t)(data >> 8);
+            buf[1] = (uint8_t)data;
+            run = 1;
+        }
+
+        buf += run * 2;
+        coreAddress += run;
+        words -= run;
+    }
+}
+
 // Character Device Functions
 
 // Set character device output handler
@@ -473,4 +599,371 @@ int Device_WriteBlock(Device *dev, const uint8_t *buffer, size_t size, uint32_t
         
     // The controller must pass the correct size for the current transfer
     return dev->blockCallbacks.writeFunc(dev, buffer, size, blockAddress, unit);
-}
\ No newline at end of file
+}
+// Snapshot support
+
+// Records are a length and then the bytes added, all values little endian.
+bool Device_WriteStateU32(FILE *f, uint32_t value)
+{
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    return fwrite(bytes, sizeof(bytes), 1, f) == 1;
+}
+
+bool Device_ReadStateU32(FILE *f, uint32_t *value)
+{
+    uint8_t bytes[4];
+    if (fread(bytes, sizeof(bytes), 1, f) != 1)
+        return false;
+    *value = bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+// Bulk 16 bit words such as memory pages, written outside a record
+bool Device_WriteStateWords(FILE *f, const uint16_t *words, size_t count)
+{
+    uint8_t bytes[1024];
+    while (count > 0)
+    {
+        size_t n = (count < sizeof(bytes) / 2) ? count : sizeof(bytes) / 2;
+        for (size_t i = 0; i < n; i++)
+        {
+            bytes[2 * i] = (uint8_t)words[i];
+            bytes[2 * i + 1] = (uint8_t)(words[i] >> 8);
+        }
+        if (fwrite(bytes, 2, n, f) != n)
+            return false;
+        words += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool Device_ReadStateWords(FILE *f, uint16_t *words, size_t count)
+{
+    uint8_t bytes[1024];
+    while (count > 0)
+    {
+        size_t n = (count < sizeof(bytes) / 2) ? count : sizeof(bytes) / 2;
+        if (fread(bytes, 2, n, f) != n)
+            return false;
+        for (size_t i = 0; i < n; i++)
+            words[i] = (uint16_t)(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+        words += n;
+        count -= n;
+    }
+    return true;
+}
+
+static bool record_reserve(StateRecord *rec, size_t size)
+{
+    if (!rec->ok)
+        return false;
+    if (rec->length + size <= rec->capacity)
+        return true;
+
+    size_t capacity = rec->capacity ? rec->capacity : 256;
+    while (capacity < rec->length + size)
+        capacity *= 2;
+    uint8_t *data = realloc(rec->data, capacity);
+    if (!data)
+    {
+        rec->ok = false;
+        return false;
+    }
+    rec->data = data;
+    rec->capacity = capacity;
+    return true;
+}
+
+static void record_put(StateRecord *rec, uint64_t value, int bytes)
+{
+    if (!record_reserve(rec, (size_t)bytes))
+        return;
+    for (int i = 0; i < bytes; i++)
+        rec->data[rec->length++] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t record_get(StateRecord *rec, int bytes)
+{
+    if (!rec->ok || rec->length - rec->position < (size_t)bytes)
+    {
+        rec->ok = false;
+        return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)rec->data[rec->position++] << (8 * i);
+    return value;
+}
+
+// Start a record to write. Raise 'version' when the fields change, and keep reading the old ones.
+void StateRecord_Begin(StateRecord *rec, uint16_t version)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->ok = true;
+    rec->version = version;
+    record_put(rec, version, 2);
+}
+
+void StateRecord_PutU8(StateRecord *rec, uint8_t value)   { record_put(rec, value, 1); }
+void StateRecord_PutU16(StateRecord *rec, uint16_t value) { record_put(rec, value, 2); }
+void StateRecord_PutU32(StateRecord *rec, uint32_t value) { record_put(rec, value, 4); }
+void StateRecord_PutU64(StateRecord *rec, uint64_t value) { record_put(rec, value, 8); }
+void StateRecord_PutBool(StateRecord *rec, bool value)    { record_put(rec, value ? 1 : 0, 1); }
+
+// Signed values, including enums, are stored as 32 bits
+void StateRecord_PutInt(StateRecord *rec, int32_t value)  { record_put(rec, (uint32_t)value, 4); }
+
+// A byte count, then the bytes
+void StateRecord_PutBytes(StateRecord *rec, const void *data, size_t size)
+{
+    record_put(rec, size, 4);
+    if (size > 0 && record_reserve(rec, size))
+    {
+        memcpy(rec->data + rec->length, data, size);
+        rec->length += size;
+    }
+}
+
+void StateRecord_PutString(StateRecord *rec, const char *text)
+{
+    StateRecord_PutBytes(rec, text, strlen(text));
+}
+
+// A word count, then the words
+void StateRecord_PutWords(StateRecord *rec, const uint16_t *words, size_t count)
+{
+    record_put(rec, count, 4);
+    for (size_t i = 0; i < count; i++)
+        record_put(rec, words[i], 2);
+}
+
+// Write the record and free it
+bool StateRecord_Write(StateRecord *rec, FILE *f)
+{
+    bool ok = rec->ok && rec->length <= UINT32_MAX &&
+              Device_WriteStateU32(f, (uint32_t)rec->length) &&
+              (fwrite(rec->data, rec->length, 1, f) == 1);
+    free(rec->data);
+    memset(rec, 0, sizeof(*rec));
+    return ok;
+}
+
+// Read a record written with format 'version' or an older one; rec->version tells which
+bool StateRecord_Read(StateRecord *rec, FILE *f, uint16_t version)
+{
+    uint32_t length;
+
+    memset(rec, 0, sizeof(*rec));
+    if (!Device_ReadStateU32(f, &length) || length < 2)
+        return false;
+    rec->data = malloc(length);
+    if (!rec->data)
+        return false;
+    rec->length = rec->capacity = length;
+    rec->ok = (fread(rec->data, length, 1, f) == 1);
+    rec->version = (uint16_t)record_get(rec, 2);
+
+    if (rec->ok && rec->version >= 1 && rec->version <= version)
+        return true;
+    StateRecord_End(rec);
+    return false;
+}
+
+uint8_t StateRecord_GetU8(StateRecord *rec)   { return (uint8_t)record_get(rec, 1); }
+uint16_t StateRecord_GetU16(StateRecord *rec) { return (uint16_t)record_get(rec, 2); }
+uint32_t StateRecord_GetU32(StateRecord *rec) { return (uint32_t)record_get(rec, 4); }
+uint64_t StateRecord_GetU64(StateRecord *rec) { return record_get(rec, 8); }
+bool StateRecord_GetBool(StateRecord *rec)    { return record_get(rec, 1) != 0; }
+int32_t StateRecord_GetInt(StateRecord *rec)  { return (int32_t)(uint32_t)record_get(rec, 4); }
+
+// Bytes added with StateRecord_PutBytes, left in the record. NULL if there are none.
+const uint8_t *StateRecord_GetData(StateRecord *rec, size_t *size)
+{
+    size_t length = (size_t)record_get(rec, 4);
+    *size = 0;
+    if (!rec->ok || rec->length - rec->position < length)
+    {
+        rec->ok = false;
+        return NULL;
+    }
+    const uint8_t *data = rec->data + rec->position;
+    rec->position += length;
+    *size = length;
+    return length ? data : NULL;
+}
+
+// Bytes into a buffer of a fixed size; the record must hold exactly that many
+void StateRecord_GetBytes(StateRecord *rec, void *data, size_t size)
+{
+    size_t length;
+    const uint8_t *bytes = StateRecord_GetData(rec, &length);
+    if (length != size)
+        rec->ok = false;
+    else if (bytes)
+        memcpy(data, bytes, size);
+}
+
+// A string into 'text' of 'size' bytes, terminated
+void StateRecord_GetString(StateRecord *rec, char *text, size_t size)
+{
+    size_t length;
+    const uint8_t *bytes = StateRecord_GetData(rec, &length);
+    if (length >= size)
+    {
+        rec->ok = false;
+        length = 0;
+    }
+    if (bytes)
+        memcpy(text, bytes, length);
+    text[length] = '\0';
+}
+
+void StateRecord_GetWords(StateRecord *rec, uint16_t *words, size_t count)
+{
+    if (record_get(rec, 4) != count)
+        rec->ok = false;
+    for (size_t i = 0; rec->ok && i < count; i++)
+        words[i] = (uint16_t)record_get(rec, 2);
+}
+
+// Free the record. For a record read, true if it was read to the end without errors.
+bool StateRecord_End(StateRecord *rec)
+{
+    bool ok = rec->ok && rec->position == rec->length;
+    free(rec->data);
+    memset(rec, 0, sizeof(*rec));
+    return ok;
+}
+
+// Generic device state: the scheduler, the pending IO delays with their callback IDs,
+// then the block transfer and the device specific records
+#define DEVICE_STATE_VERSION 1
+#define IO_DELAY_STATE_BYTES 16     // Bytes a pending IO delay takes in the record
+
+static uint16_t io_delay_callback_id(const Device *dev, IODelayedCallback callback)
+{
+    for (const IODelayCallbackId *entry = dev->ioDelayCallbacks; entry && entry->callback; entry++)
+    {
+        if (entry->callback == callback)
+            return entry->id;
+    }
+    return 0;
+}
+
+static IODelayedCallback io_delay_callback(const Device *dev, uint16_t id)
+{
+    for (const IODelayCallbackId *entry = dev->ioDelayCallbacks; entry && entry->callback; entry++)
+    {
+        if (entry->id == id)
+            return entry->callback;
+    }
+    return NULL;
+}
+
+// Save the scheduler state, pending IO delays and device specific data of a device
+bool Device_SaveState(Device *dev, FILE *f)
+{
+    if (!dev || !f)
+        return false;
+
+    StateRecord rec;
+    StateRecord_Begin(&rec, DEVICE_STATE_VERSION);
+    StateRecord_PutU16(&rec, dev->interruptBits);
+    StateRecord_PutU64(&rec, dev->nextTick);
+    StateRecord_PutU64(&rec, dev->nextEvent);
+    StateRecord_PutU32(&rec, (uint32_t)dev->ioDelayCount);
+
+    for (int i = 0; i < dev->ioDelayCount; i++)
+    {
+        uint16_t id = io_delay_callback_id(dev, dev->ioDelays[i].callback);
+        if (id == 0)
+        {
+            Log(LOG_ERROR, "Snapshot: %s has an IO delay callback without an ID\n", dev->memoryName);
+            StateRecord_End(&rec);
+            return false;
+        }
+        StateRecord_PutU64(&rec, dev->ioDelays[i].dueTick);
+        StateRecord_PutU16(&rec, id);
+        StateRecord_PutInt(&rec, dev->ioDelays[i].parameter);
+        StateRecord_PutU8(&rec, dev->ioDelays[i].level);
+        StateRecord_PutBool(&rec, dev->ioDelays[i].waitBlockIO);
+    }
+    if (!StateRecord_Write(&rec, f))
+        return false;
+
+    if (!BlockIO_SaveState(dev, f))
+        return false;
+
+    if (dev->SaveState)
+        return dev->SaveState(dev, f);
+    return true;
+}
+
+// Restore the state written by Device_SaveState
+bool Device_LoadState(Device *dev, FILE *f)
+{
+    if (!dev || !f)
+        return false;
+
+    StateRecord rec;
+    if (!StateRecord_Read(&rec, f, DEVICE_STATE_VERSION))
+        return false;
+
+    uint16_t interruptBits = StateRecord_GetU16(&rec);
+    uint64_t nextTick = StateRecord_GetU64(&rec);
+    uint64_t nextEvent = StateRecord_GetU64(&rec);
+    uint32_t count = StateRecord_GetU32(&rec);
+    if (!rec.ok || count > (rec.length - rec.position) / IO_DELAY_STATE_BYTES)
+    {
+        StateRecord_End(&rec);
+        return false;
+    }
+
+    if ((int)count > dev->ioDelayCapacity)
+    {
+        DelayedIoInfo *newDelays = realloc(dev->ioDelays, sizeof(DelayedIoInfo) * count);
+        if (!newDelays)
+        {
+            StateRecord_End(&rec);
+            return false;
+        }
+        dev->ioDelays = newDelays;
+        dev->ioDelayCapacity = (int)count;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        DelayedIoInfo *delay = &dev->ioDelays[i];
+        delay->dueTick = StateRecord_GetU64(&rec);
+        uint16_t id = StateRecord_GetU16(&rec);
+        delay->parameter = StateRecord_GetInt(&rec);
+        delay->level = StateRecord_GetU8(&rec);
+        delay->waitBlockIO = StateRecord_GetBool(&rec);
+        delay->context = dev;
+        delay->callback = io_delay_callback(dev, id);
+        if (!delay->callback)
+        {
+            Log(LOG_ERROR, "Snapshot: %s has no IO delay callback with ID %u\n", dev->memoryName, id);
+            rec.ok = false;
+            break;
+        }
+    }
+    if (!StateRecord_End(&rec))
+    {
+        dev->ioDelayCount = 0;
+        return false;
+    }
+    dev->ioDelayCount = (int)count;
+
+    dev->interruptBits = interruptBits;
+    dev->nextTick = nextTick;
+    dev->nextEvent = nextEvent;
+
+    if (!BlockIO_LoadState(dev, f))
+        return false;
+
+    if (dev->LoadState)
+        return dev->LoadState(dev, f);
+    return true;
+}
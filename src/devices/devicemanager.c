@@ -42,10 +42,18 @@
 
 // Define the level strings array
 
-static DeviceManager deviceManager = {0}; // Initialize to zero
+// Device manager of the current machine (Machine.devices)
+#define deviceManager (*gMachine->devices)
 
 void DeviceManager_Init(LogLevel level)
 {
+    gMachine->devices = calloc(1, sizeof(DeviceManager));
+    if (!gMachine->devices)
+    {
+        Log(LOG_ERROR, "Failed to allocate the device manager\n");
+        exit(1);
+    }
+
     // Set the minimum log level    
     deviceManager.minLogLevel = level;
     Log_SetMinLevel(level);
@@ -88,8 +96,41 @@ void DeviceManager_Destroy(void)
         deviceManager.devices = NULL;
     }
 
-    deviceManager.deviceCount = 0;
-    deviceManager.deviceCapacity = 0;
+    free(deviceManager.panel);
+    deviceManager.panel = NULL;
+
+    free(gMachine->devices);
+    gMachine->devices = NULL;
+}
+
+// Rebuild the IO address decode table from the device list.
+// On overlapping ranges the first device added wins, as with the old linear scan.
+void DeviceManager_RebuildIODecode(void)
+{
+    memset(deviceManager.ioDecode, 0, sizeof(deviceManager.ioDecode));
+
+    for (int i = deviceManager.deviceCount - 1; i >= 0; i--)
+    {
+        Device *dev = deviceManager.devices[i].device;
+        if (!dev || dev->startAddress >= IO_ADDRESS_SPACE)
+            continue;
+
+        uint32_t end = (dev->endAddress < IO_ADDRESS_SPACE) ? dev->endAddress : IO_ADDRESS_SPACE - 1;
+        for (uint32_t address = dev->startAddress; address <= end; address++)
+        {
+            deviceManager.ioDecode[address] = (uint8_t)(i + 1);
+        }
+    }
+}
+
+// O(1) lookup of the device at an IO address
+static inline Device *DecodeIOAddress(uint32_t address)
+{
+    if (address >= IO_ADDRESS_SPACE)
+        return NULL;
+
+    uint8_t index = deviceManager.ioDecode[address];
+    return index ? deviceManager.devices[index - 1].device : NULL;
 }
 
 void DeviceManager_AddAllDevices(void)
@@ -277,6 +318,7 @@ bool DeviceManager_AddDevice(DeviceType type, uint8_t thumbwheel)
             Device_SetBlockDiskInfo(dev, (BlockDeviceDiskInfoFunc)machine_block_disk_info, NULL);
         }
         deviceManager.deviceCount++;
+        DeviceManager_RebuildIODecode();
         return true;
     }
     else
@@ -289,16 +331,13 @@ bool DeviceManager_AddDevice(DeviceType type, uint8_t thumbwheel)
 
 uint16_t DeviceManager_Read(uint32_t address)
 {
-    for (int i = 0; i < deviceManager.deviceCount; i++)
+    Device *dev = DecodeIOAddress(address);
+    if (dev)
     {
-
-        Device *dev = deviceManager.devices[i].device;
-
-        if (dev && Device_IsInAddress(dev, address))
-        {
-            // Log(LOG_DEBUG, "Device found for READ address: %o\n", address);
-            return Device_Read(dev, address);
-        }
+        // Log(LOG_DEBUG, "Device found for READ address: %o\n", address);
+        uint16_t value = dev->Read ? dev->Read(dev, address) : 0;
+        Device_ScheduleTick(dev, 0); // Tick after this IOX to pick up state and interrupt changes
+        return value;
     }
 
     interrupt(14, 1 << 7); /* IOX error lvl14 */
@@ -310,21 +349,14 @@ uint16_t DeviceManager_Read(uint32_t address)
 
 void DeviceManager_Write(uint32_t address, uint16_t value)
 {
-    for (int i = 0; i < deviceManager.deviceCount; i++)
+    Device *dev = DecodeIOAddress(address);
+    if (dev)
     {
-        Device *dev = deviceManager.devices[i].device;
-        if (!dev)
-        {
-            Log(LOG_ERROR, "Device at index %d is NULL\n", i);
-            continue;
-        }
-
-        if (Device_IsInAddress(dev, address))
-        {
-            //Log(LOG_DEBUG, "Device found for WRITE address: %o\n", address);
-            Device_Write(dev, address, value);
-            return;
-        }
+        //Log(LOG_DEBUG, "Device found for WRITE address: %o\n", address);
+        if (dev->Write)
+            dev->Write(dev, address, value);
+        Device_ScheduleTick(dev, 0); // Tick after this IOX to pick up state and interrupt changes
+        return;
     }
 
     interrupt(14, 1 << 7); /* IOX error lvl14 */
@@ -343,6 +375,7 @@ int DeviceManager_Ident(uint16_t level)
             uint16_t id = Device_Ident(dev, level);
             if (id > 0)
             {
+                Device_ScheduleTick(dev, 0); // Interrupt bits changed
                 return id;
             }
         }
@@ -356,32 +389,45 @@ int DeviceManager_Ident(uint16_t level)
     return 0;
 }
 
+// Tick the devices whose deadline has passed, and collect interrupt bits from all of them.
+// Called from IO_Tick only when instr_counter has reached io_next_tick.
 uint16_t DeviceManager_Tick(void)
 {
     uint16_t interruptBits = 0;
     for (int i = 0; i < deviceManager.deviceCount; i++)
     {
         Device *dev = deviceManager.devices[i].device;
-        if (dev)
+        if (dev && (dev->nextTick <= instr_counter))
         {
-            interruptBits |= Device_Tick(dev);
+            dev->nextTick = DEVICE_NO_TICK; // Tick re-arms it if it has more to do
+            dev->nextEvent = DEVICE_NO_TICK;
+            Device_Tick(dev);
         }
     }
 
-    return interruptBits;
-}
-Device *DeviceManager_GetDeviceByAddress(uint32_t address)
-{
+    // Find the next deadline (after all ticks, as a device may schedule another)
+    uint64_t next = DEVICE_NO_TICK;
+    uint64_t nextEvent = DEVICE_NO_TICK;
     for (int i = 0; i < deviceManager.deviceCount; i++)
     {
         Device *dev = deviceManager.devices[i].device;
-        if (dev && Device_IsInAddress(dev, address))
+        if (dev)
         {
-            return dev;
+            interruptBits |= dev->interruptBits;
+            if (dev->nextTick < next)
+                next = dev->nextTick;
+            if (dev->nextEvent < nextEvent)
+                nextEvent = dev->nextEvent;
         }
     }
+    io_next_tick = next;
+    io_next_event = nextEvent;
 
-    return NULL;
+    return interruptBits;
+}
+Device *DeviceManager_GetDeviceByAddress(uint32_t address)
+{
+    return DecodeIOAddress(address);
 }
 
 int DeviceManager_GetDeviceCount(void)
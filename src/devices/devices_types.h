@@ -27,9 +27,11 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 
 #include "../ndlib/ndlib_types.h" // for LogLevel def
+#include "../machine/machine_context.h" // instr_counter, io_next_tick, io_next_event
 
 // External function declaration
 
@@ -38,6 +40,9 @@ void interrupt(uint16_t lvl, uint16_t sub); // cpu.c
 // Physical memory functions in cpu_mms.c
 extern int ReadPhysicalMemory(int physicalAddress, bool privileged);
 extern void WritePhysicalMemory(int physicalAddress, uint16_t value, bool privileged);
+extern unsigned int PhysicalBlockSpan(unsigned int physicalAddress, unsigned int words);
+extern void WritePhysicalBlock(unsigned int physicalAddress, const uint8_t *src, unsigned int words);
+extern void ReadPhysicalBlock(unsigned int physicalAddress, uint8_t *dst, unsigned int words);
 
 // ** Device **
 
@@ -55,6 +60,14 @@ extern void WritePhysicalMemory(int physicalAddress, uint16_t value, bool privil
 #define IODELAY_SCSI_SHORT 10
 #define IODELAY_SCSI_TIMEOUT 0xFFFF
 
+// Device scheduler: value of Device.nextTick when the device has nothing pending
+#define DEVICE_NO_TICK UINT64_MAX
+
+// Block I/O workers (blockio.c): number of host threads, and how often a device whose
+// completion is due polls for its transfer to finish
+#define BLOCKIO_WORKERS 2
+#define BLOCKIO_POLL_TICKS 100
+
 // Parity table size
 #define PARITY_TABLE_SIZE 256
 extern const uint8_t Device_OddParityTable[PARITY_TABLE_SIZE];
@@ -102,13 +115,50 @@ typedef bool (*IODelayedCallback)(void *context, int param);
 
 // IO Delay information structure
 typedef struct {
-    int delayTicks;
+    uint64_t dueTick;         // instr_counter at which the callback fires
     IODelayedCallback callback;
     void *context;
     int parameter;
     uint8_t level;
+    bool waitBlockIO;         // Also wait for the device's block transfer (Device_QueueBlockIODelay)
 } DelayedIoInfo;
 
+// A callback a device queues as an IO delay, with the ID snapshots store it by.
+// IDs are part of the snapshot format: never renumber or reuse one.
+typedef struct {
+    uint16_t id;              // 1 and up, per device
+    IODelayedCallback callback;
+} IODelayCallbackId;
+
+// Snapshot state record (device.c). Fields are added one by one after a format
+// version and stored little endian, so a record does not depend on the struct
+// layout or the host of the build that wrote it.
+typedef struct StateRecord {
+    uint8_t *data;
+    size_t length;            // Bytes added, or bytes in a record read
+    size_t capacity;
+    size_t position;          // Next byte to get
+    uint16_t version;         // Format version of the record
+    bool ok;                  // Cleared by a failed allocation, or by getting past the end
+} StateRecord;
+
+struct Device;
+
+// Block transfer running on the I/O workers (blockio.c). The device owns it from
+// BlockIO_Submit() until BlockIO_Finish(); only 'done' is shared with the worker.
+typedef struct BlockIORequest {
+    struct Device *device;
+    Machine *machine;         // Machine of the submitting thread, the block callbacks run on it
+    bool write;
+    uint8_t *buffer;
+    size_t blocks;
+    uint32_t blockAddress;
+    int unit;
+    int result;               // Return value of the block callback
+    atomic_bool done;
+    struct BlockIORequest *next;
+} BlockIORequest;
+
 // Device types
 typedef enum {
     DEVICE_TYPE_NONE = 0,
@@ -144,6 +194,17 @@ typedef struct Device {
     DelayedIoInfo *ioDelays;
     int ioDelayCount;
     int ioDelayCapacity;
+    const IODelayCallbackId *ioDelayCallbacks;  // Callbacks the device queues, ended by a NULL callback
+
+    // Scheduler: Tick is only called once instr_counter reaches nextTick.
+    // Devices re-arm it with Device_ScheduleTick() from Tick or their IO handlers.
+    uint64_t nextTick;
+    // Earliest deadline armed with Device_ScheduleTick(). Deadlines armed with
+    // Device_SchedulePoll() only move nextTick, and can be skipped by an idle CPU.
+    uint64_t nextEvent;
+
+    // Block transfer on the I/O workers, NULL if none (blockio.c)
+    BlockIORequest *blockIO;
     
     // Device functions
     void (*Reset)(struct Device *self);
@@ -154,7 +215,12 @@ typedef struct Device {
     uint16_t (*Ident)(struct Device *self, uint16_t level);
 
     void (*Destroy)(struct Device *self);
-    
+
+    // Snapshot: write/read the device specific state (deviceData) as StateRecords. NULL if there
+    // is none. Pointers and host resources in deviceData are kept on load.
+    bool (*SaveState)(struct Device *self, FILE *f);
+    bool (*LoadState)(struct Device *self, FILE *f);
+
     // Device classification
     DeviceClass deviceClass;  // Type of device (standard, character, block, RTC)
     
@@ -184,12 +250,19 @@ typedef struct {
     Device *device;
 } DeviceInfo;
 
-// Device manager structure
-typedef struct {
+// IOX/IOXT address space covered by the decode table
+#define IO_ADDRESS_SPACE 0x10000
+
+// Device manager structure, one per machine (Machine.devices)
+typedef struct DeviceManager {
     DeviceInfo *devices;
     int deviceCount;
     int deviceCapacity;
     LogLevel minLogLevel;  // Minimum log level for filtering messages
+    struct display_panel *panel;  // Panel processor state (panel.c)
+
+    // IO address -> device index + 1 (0 = no device). Rebuilt when devices are added or removed.
+    uint8_t ioDecode[IO_ADDRESS_SPACE];
 } DeviceManager;
 
 
@@ -279,6 +279,9 @@ static void ExecuteFloppyGo(Device *self)
     if (!data)
         return;
 
+    // The image must not change under a transfer still on the I/O workers
+    BlockIO_Wait(self);
+
     // Set Default floppy values
     uint32_t sector = 1;
     uint32_t track = 0;
@@ -373,7 +376,6 @@ static void ExecuteFloppyGo(Device *self)
 
     // Number of blocks to transfer where each block is blockSizeBytes bytes (typically 512/1024)
     uint32_t blockCounter = (wordsToRead * 2) / self->blockSizeBytes;
-    uint32_t buffer_ptr = 0;
 
     uint8_t *buffer = NULL;
     int blocksRead = -1;
@@ -409,6 +411,15 @@ static void ExecuteFloppyGo(Device *self)
 
         if (buffer)
         {
+            // Let the I/O workers read it, ReadTransferEnd moves it to memory
+            if (BlockIO_Submit(self, false, buffer, blockCounter, data->commandBlock.fields.diskAddress, data->drive))
+            {
+                buffer = NULL; // Owned by the transfer now
+                data->transferWords = wordsToRead;
+                Device_QueueBlockIODelay(self, IODELAY_FLOPPY, (IODelayedCallback)ReadTransferEnd, data->drive, self->interruptLevel);
+                break;
+            }
+
             // Read all blocks from floppy  disk file into buffer
             blocksRead = self->blockCallbacks.readFunc(self, buffer, blockCounter, data->commandBlock.fields.diskAddress, data->drive);
             if ((blocksRead < 0) || (blocksRead != blockCounter))
@@ -419,20 +430,20 @@ static void ExecuteFloppyGo(Device *self)
                 // Device_SetInterruptStatus(self, data->status1.bits.interruptEnabled && data->status1.bits.readyForTransfer, self->interruptLevel);
             }
 
-            while (wordsToRead > 0)
+            // DMA Write to RAM memory (or 0 if no blocks was read to buffer)
+            if (blocksRead > 0)
             {
-                // Read word from disk buffer (or 0 if no blocks was read to buffer)
-                uint32_t readData = 0;
-                if (blocksRead > 0)
-                    readData = Device_IO_BufferReadWord(self, buffer, buffer_ptr++);
-
-                // DMA Write to RAM memory
-                Device_DMAWrite(memAddress, (uint16_t)readData);
-
-                memAddress++;
-                wordsToRead--;
-                wordsTransfered++;
+                Device_DMAWriteBlock(memAddress, buffer, wordsToRead);
             }
+            else
+            {
+                for (uint32_t i = 0; i < wordsToRead; i++)
+                    Device_DMAWrite(memAddress + i, 0);
+            }
+
+            memAddress += wordsToRead;
+            wordsTransfered += wordsToRead;
+            wordsToRead = 0;
         }
         Device_QueueIODelay(self, IODELAY_FLOPPY, (IODelayedCallback)ReadEnd, data->drive, self->interruptLevel);
         break;
@@ -455,23 +466,19 @@ static void ExecuteFloppyGo(Device *self)
         {
             if (buffer)
             {
-                while (wordsToRead > 0)
+                // DMA Read from RAM memory to disk buffer
+                Device_DMAReadBlock(memAddress, buffer, wordsToRead);
+
+                memAddress += wordsToRead;
+                wordsTransfered += wordsToRead;
+                wordsToRead = 0;
+
+                // Let the I/O workers write it
+                if (BlockIO_Submit(self, true, buffer, blockCounter, data->commandBlock.fields.diskAddress, data->drive))
                 {
-                    uint16_t word = Device_DMARead(memAddress);
-
-                    // Write word to disk buffer
-                    if (Device_IO_BufferWriteWord(self, buffer, buffer_ptr++, (uint16_t)word) < 0)
-                    {
-                        data->status1.bits.errorCode = DRIVE_NOT_READY;
-                        data->status1.bits.deviceActive = false;
-                        data->status1.bits.readyForTransfer = true;
-                        Device_SetInterruptStatus(self, data->status1.bits.interruptEnabled && data->status1.bits.readyForTransfer, self->interruptLevel);
-                        break;
-                    }
-
-                    memAddress++;
-                    wordsToRead--;
-                    wordsTransfered++;
+                    buffer = NULL; // Owned by the transfer now
+                    Device_QueueBlockIODelay(self, IODELAY_FLOPPY, (IODelayedCallback)WriteTransferEnd, data->drive, self->interruptLevel);
+                    break;
                 }
 
                 // Write all blocks to floppy disk file from buffer
@@ -636,6 +643,55 @@ static bool ReadEnd(Device *self, int drive)
     return false;
 }
 
+// Completion of a read done by the I/O workers: move the data to memory and report
+// the last memory address and the word count in the command block
+static bool ReadTransferEnd(Device *self, int drive)
+{
+    FloppyDMAData *data = (FloppyDMAData *)self->deviceData;
+    if (!data)
+        return false;
+
+    uint32_t memAddress = data->commandBlock.fields.memoryAddressLo | (data->commandBlock.fields.memoryAddressHi << 16);
+    uint32_t words = data->transferWords;
+
+    // DMA Write to RAM memory (or 0 if no blocks was read to buffer)
+    uint8_t *buffer;
+    if (BlockIO_Finish(self, &buffer) < 0)
+    {
+        data->status1.bits.errorCode = DRIVE_NOT_READY;
+        for (uint32_t i = 0; i < words; i++)
+            Device_DMAWrite(memAddress + i, 0);
+    }
+    else
+    {
+        Device_DMAWriteBlock(memAddress, buffer, words);
+    }
+    free(buffer);
+
+    memAddress += words;
+    Device_DMAWrite(data->commandBlockAddress + 8, (uint16_t)((memAddress >> 16) & 0xFF)); // HI
+    Device_DMAWrite(data->commandBlockAddress + 9, (uint16_t)(memAddress & 0xFFFF));       // LO
+    Device_DMAWrite(data->commandBlockAddress + 10, (uint16_t)((words >> 16) & 0xFF));     // HI
+    Device_DMAWrite(data->commandBlockAddress + 11, (uint16_t)(words & 0xFFFF));           // LO
+
+    return ReadEnd(self, drive);
+}
+
+// Completion of a write done by the I/O workers
+static bool WriteTransferEnd(Device *self, int drive)
+{
+    FloppyDMAData *data = (FloppyDMAData *)self->deviceData;
+    if (!data)
+        return false;
+
+    uint8_t *buffer;
+    if (BlockIO_Finish(self, &buffer) < 0)
+        data->status1.bits.errorCode = DRIVE_NOT_READY;
+    free(buffer);
+
+    return ReadEnd(self, drive);
+}
+
 static bool AutoLoadEnd(Device *self, int drive)
 {
     FloppyDMAData *data = (FloppyDMAData *)self->deviceData;
@@ -648,6 +704,71 @@ static bool AutoLoadEnd(Device *self, int drive)
     return false;
 }
 
+// Snapshot: controller registers and the command block of the running command
+#define FLOPPYDMA_STATE_VERSION 1
+
+// IO delay callbacks by snapshot ID
+static const IODelayCallbackId floppyDMADelayCallbacks[] = {
+    { 1, (IODelayedCallback)AutoLoadEnd },
+    { 2, (IODelayedCallback)ReadEnd },
+    { 3, (IODelayedCallback)ReadTransferEnd },
+    { 4, (IODelayedCallback)WriteTransferEnd },
+    { 0, NULL }
+};
+
+static bool FloppyDMA_SaveState(Device *self, FILE *f)
+{
+    FloppyDMAData *data = (FloppyDMAData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, FLOPPYDMA_STATE_VERSION);
+    StateRecord_PutU16(&rec, data->status1.raw);
+    StateRecord_PutU16(&rec, data->status2.raw);
+    StateRecord_PutU16(&rec, data->controlWord.raw);
+    StateRecord_PutU32(&rec, data->commandBlockAddress);
+    StateRecord_PutWords(&rec, data->commandBlock.raw, 12);
+    StateRecord_PutU8(&rec, data->data);
+    StateRecord_PutU8(&rec, data->sector);
+    StateRecord_PutU8(&rec, data->track);
+    StateRecord_PutU8(&rec, data->drive);
+    StateRecord_PutInt(&rec, data->errorCode);
+    StateRecord_PutInt(&rec, data->command);
+    StateRecord_PutU32(&rec, data->pointerHI);
+    StateRecord_PutU32(&rec, data->pointerLO);
+    StateRecord_PutU16(&rec, data->readFormat);
+    StateRecord_PutU64(&rec, (uint64_t)data->diskFileSize);
+    StateRecord_PutBool(&rec, data->readOnly);
+    StateRecord_PutU32(&rec, data->transferWords);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool FloppyDMA_LoadState(Device *self, FILE *f)
+{
+    FloppyDMAData *data = (FloppyDMAData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, FLOPPYDMA_STATE_VERSION))
+        return false;
+    data->status1.raw = StateRecord_GetU16(&rec);
+    data->status2.raw = StateRecord_GetU16(&rec);
+    data->controlWord.raw = StateRecord_GetU16(&rec);
+    data->commandBlockAddress = StateRecord_GetU32(&rec);
+    StateRecord_GetWords(&rec, data->commandBlock.raw, 12);
+    data->data = StateRecord_GetU8(&rec);
+    data->sector = StateRecord_GetU8(&rec);
+    data->track = StateRecord_GetU8(&rec);
+    data->drive = StateRecord_GetU8(&rec);
+    data->errorCode = (FloppyError)StateRecord_GetInt(&rec);
+    data->command = (FloppyFunction)StateRecord_GetInt(&rec);
+    data->pointerHI = StateRecord_GetU32(&rec);
+    data->pointerLO = StateRecord_GetU32(&rec);
+    data->readFormat = StateRecord_GetU16(&rec);
+    data->diskFileSize = (long)StateRecord_GetU64(&rec);
+    data->readOnly = StateRecord_GetBool(&rec);
+    data->transferWords = StateRecord_GetU32(&rec);
+    return StateRecord_End(&rec);
+}
+
 Device *CreateFloppyDMADevice(uint8_t thumbwheel)
 {
     Device *dev = (Device *)malloc(sizeof(Device));
@@ -701,6 +822,9 @@ Device *CreateFloppyDMADevice(uint8_t thumbwheel)
     dev->Tick = FloppyDMA_Tick;
     dev->Reset = FloppyDMA_Reset;
     dev->Ident = FloppyDMA_Ident;
+    dev->ioDelayCallbacks = floppyDMADelayCallbacks;
+    dev->SaveState = FloppyDMA_SaveState;
+    dev->LoadState = FloppyDMA_LoadState;
     dev->deviceData = data;
 
     printf("Floppy DMA [%s] Device object created. Address[%o-%o] Ident code: [%o] Level: [%d]\n", dev->memoryName, dev->startAddress, dev->endAddress, dev->identCode, dev->interruptLevel);
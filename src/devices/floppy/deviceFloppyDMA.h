@@ -376,6 +376,7 @@ typedef struct
     uint16_t readFormat;    // Format read from disk
     long diskFileSize;      // Size of floppy disk file
     bool readOnly;          // Read-only flag
+    uint32_t transferWords; // Words of the read on the I/O workers (ReadTransferEnd)
 } FloppyDMAData;
 
 
@@ -388,5 +389,7 @@ static void ExecuteAutoload(Device *self, int drive);
 
 static bool AutoLoadEnd(Device *self, int drive);
 static bool ReadEnd(Device *self, int drive);
+static bool ReadTransferEnd(Device *self, int drive);
+static bool WriteTransferEnd(Device *self, int drive);
 
 #endif /* DEVICE_FLOPPY_DMA_H */
\ No newline at end of file
@@ -614,6 +614,77 @@ void FloppyPIO_ExecuteGo(Device *self, FloppyPIOCommand command) {
 
 
 
+// Snapshot: controller registers and sector buffer. The image file belongs to the
+// machine's drive table, the live handle is kept.
+#define FLOPPYPIO_STATE_VERSION 1
+
+// IO delay callbacks by snapshot ID
+static const IODelayCallbackId floppyPIODelayCallbacks[] = {
+    { 1, (IODelayedCallback)FloppyPIO_ReadEnd },
+    { 2, (IODelayedCallback)FloppyPIO_SeekEnd },
+    { 3, (IODelayedCallback)FloppyPIO_RecalibrateEnd },
+    { 0, NULL }
+};
+
+static bool FloppyPIO_SaveState(Device *self, FILE *f) {
+    FloppyPIOData *data = (FloppyPIOData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, FLOPPYPIO_STATE_VERSION);
+    StateRecord_PutWords(&rec, data->dataBuffer, 1024);
+    StateRecord_PutU16(&rec, (uint16_t)data->loadDriveAddress);
+    StateRecord_PutU16(&rec, data->sector);
+    StateRecord_PutU16(&rec, data->track);
+    StateRecord_PutU16(&rec, data->bufferPointer);
+    StateRecord_PutInt(&rec, data->selectedDrive);
+    StateRecord_PutInt(&rec, data->bytes_pr_sector);
+    StateRecord_PutInt(&rec, data->sectors_pr_track);
+    StateRecord_PutU8(&rec, data->testByte);
+    StateRecord_PutBool(&rec, data->sectorAutoIncrement);
+    StateRecord_PutInt(&rec, data->testmodeByte);
+    StateRecord_PutBool(&rec, data->deletedRecord);
+    for (int t = 0; t < 100; t++)
+        for (int s = 0; s < 100; s++)
+            StateRecord_PutBool(&rec, data->deletedSector[t][s]);
+    StateRecord_PutU16(&rec, data->status1.raw);
+    StateRecord_PutU16(&rec, data->control.raw);
+    StateRecord_PutU16(&rec, data->status2.raw);
+    StateRecord_PutU16(&rec, data->driveAddress.raw);
+    StateRecord_PutU16(&rec, data->sectorControl.raw);
+    StateRecord_PutInt(&rec, data->command);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool FloppyPIO_LoadState(Device *self, FILE *f) {
+    FloppyPIOData *data = (FloppyPIOData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, FLOPPYPIO_STATE_VERSION))
+        return false;
+    StateRecord_GetWords(&rec, data->dataBuffer, 1024);
+    data->loadDriveAddress = (int16_t)StateRecord_GetU16(&rec);
+    data->sector = StateRecord_GetU16(&rec);
+    data->track = StateRecord_GetU16(&rec);
+    data->bufferPointer = StateRecord_GetU16(&rec);
+    data->selectedDrive = StateRecord_GetInt(&rec);
+    data->bytes_pr_sector = StateRecord_GetInt(&rec);
+    data->sectors_pr_track = StateRecord_GetInt(&rec);
+    data->testByte = StateRecord_GetU8(&rec);
+    data->sectorAutoIncrement = StateRecord_GetBool(&rec);
+    data->testmodeByte = StateRecord_GetInt(&rec);
+    data->deletedRecord = StateRecord_GetBool(&rec);
+    for (int t = 0; t < 100; t++)
+        for (int s = 0; s < 100; s++)
+            data->deletedSector[t][s] = StateRecord_GetBool(&rec);
+    data->status1.raw = StateRecord_GetU16(&rec);
+    data->control.raw = StateRecord_GetU16(&rec);
+    data->status2.raw = StateRecord_GetU16(&rec);
+    data->driveAddress.raw = StateRecord_GetU16(&rec);
+    data->sectorControl.raw = StateRecord_GetU16(&rec);
+    data->command = (FloppyPIOCommand)StateRecord_GetInt(&rec);
+    return StateRecord_End(&rec);
+}
+
 Device* CreateFloppyPIODevice(uint8_t thumbwheel) {
     Device *dev = malloc(sizeof(Device));
     if (!dev) return NULL;
@@ -683,6 +754,9 @@ Device* CreateFloppyPIODevice(uint8_t thumbwheel) {
     dev->Read = FloppyPIO_Read;
     dev->Write = FloppyPIO_Write;
     dev->Ident = FloppyPIO_Ident;
+    dev->ioDelayCallbacks = floppyPIODelayCallbacks;
+    dev->SaveState = FloppyPIO_SaveState;
+    dev->LoadState = FloppyPIO_LoadState;
     dev->deviceData = data;
 
     printf("FloppyPIO object created.\n");
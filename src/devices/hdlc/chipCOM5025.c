@@ -40,22 +40,20 @@ static void COM5025_TransmitByteOutput(COM5025State *chip, uint8_t data, bool is
 static void COM5025_SendOneByte(COM5025State *chip, uint8_t data);
 static bool COM5025_TSR_Empty(COM5025State *chip);
 static uint8_t COM5025_MapBits2CharLen(uint8_t bits);
-// Global state for the chip (could be per-device instance)
-static COM5025Registers registers;
 
 void COM5025_Init(COM5025State *chip)
 {
     if (!chip) return;
 
     memset(chip, 0, sizeof(COM5025State));
-    COM5025Registers_Init(&registers);
+    COM5025Registers_Init(&chip->registerFile);
 
     chip->mode = COM5025_MODE_BOP;
     chip->characterLength = 8;
     chip->crcRegister = 0xFFFF;
 
     // Initialize register pointer
-    chip->registers = &registers;
+    chip->registers = &chip->registerFile;
 }
 
 void COM5025_Reset(COM5025State *chip)
@@ -67,7 +65,7 @@ void COM5025_Reset(COM5025State *chip)
     // status conditions, set TBMT = 1, TSO = 1 and place the device in the primary
     // BOP mode with 8 bit TX/ RX data length, CRC CCITT initialized to all 1's.
 
-    COM5025Registers_Clear(&registers);
+    COM5025Registers_Clear(&chip->registerFile);
 
     // Clear input pins
     COM5025_ClearAllInputPins(chip);
@@ -101,30 +99,30 @@ uint8_t COM5025_ReadByte(COM5025State *chip, COM5025RegistersByte reg)
 
     switch (reg) {
         case COM5025_REG_BYTE_RECEIVER_DATA_BUFFER:
-            data = (uint8_t)registers.receiverDataBuffer;
+            data = (uint8_t)chip->registerFile.receiverDataBuffer;
             COM5025_SetOutputPin(chip, COM5025_PIN_OUT_RDA, false); // turn off "Receiver Data Available"
             break;
 
         case COM5025_REG_BYTE_RECEIVER_STATUS:
-            data = (uint8_t)(registers.receiverStatus >> 8);
-            COM5025_SetReceiverStatus(chip, registers.receiverStatus & COM5025_RX_STATUS_MASK_CLEAR_ON_RSR);
+            data = (uint8_t)(chip->registerFile.receiverStatus >> 8);
+            COM5025_SetReceiverStatus(chip, chip->registerFile.receiverStatus & COM5025_RX_STATUS_MASK_CLEAR_ON_RSR);
             COM5025_SetOutputPin(chip, COM5025_PIN_OUT_RSA, false);
             break;
 
         case COM5025_REG_BYTE_TRANSMITTER_DATA:
-            data = registers.transmitterDataBuffer;
+            data = chip->registerFile.transmitterDataBuffer;
             break;
 
         case COM5025_REG_BYTE_TRANSMITTER_STATUS_CONTROL:
-            data = (uint8_t)(registers.txStatusAndControl >> 8);
+            data = (uint8_t)(chip->registerFile.txStatusAndControl >> 8);
             break;
 
         case COM5025_REG_BYTE_SYNC_ADDRESS:
-            data = registers.syncSecondaryAddress;
+            data = chip->registerFile.syncSecondaryAddress;
             break;
 
         case COM5025_REG_BYTE_MODE_CONTROL:
-            data = (uint8_t)(registers.modeControl >> 8);
+            data = (uint8_t)(chip->registerFile.modeControl >> 8);
             break;
 
         case COM5025_REG_BYTE_NOT_USED:
@@ -132,7 +130,7 @@ uint8_t COM5025_ReadByte(COM5025State *chip, COM5025RegistersByte reg)
             break;
 
         case COM5025_REG_BYTE_DATA_LENGTH_SELECT:
-            data = (uint8_t)(registers.dataLengthSelect >> 8);
+            data = (uint8_t)(chip->registerFile.dataLengthSelect >> 8);
             break;
 
         default:
@@ -162,32 +160,32 @@ void COM5025_WriteByte(COM5025State *chip, COM5025RegistersByte reg, uint8_t val
         case COM5025_REG_BYTE_TRANSMITTER_STATUS_CONTROL:
             // TERR bit is READ ONLY
             value &= 0x7F;
-            if (registers.txStatusAndControl & COM5025_TX_STATUS_TERR)
+            if (chip->registerFile.txStatusAndControl & COM5025_TX_STATUS_TERR)
                 value |= 1 << 7;
 
-            registers.txStatusAndControl = (uint16_t)value << 8;
+            chip->registerFile.txStatusAndControl = (uint16_t)value << 8;
 
-            if (registers.txStatusAndControl & COM5025_TX_STATUS_TSOM) {
+            if (chip->registerFile.txStatusAndControl & COM5025_TX_STATUS_TSOM) {
                 COM5025_SetOutputPin(chip, COM5025_PIN_OUT_TSA, false); // Clear underflow
-                registers.txStatusAndControl &= ~COM5025_TX_STATUS_TERR;
+                chip->registerFile.txStatusAndControl &= ~COM5025_TX_STATUS_TERR;
             }
             break;
 
         case COM5025_REG_BYTE_SYNC_ADDRESS:
-            registers.syncSecondaryAddress = value;
+            chip->registerFile.syncSecondaryAddress = value;
             break;
 
         case COM5025_REG_BYTE_MODE_CONTROL:
-            COM5025Registers_SetModeControl(&registers, (uint16_t)value << 8);
+            COM5025Registers_SetModeControl(&chip->registerFile, (uint16_t)value << 8);
             break;
 
         case COM5025_REG_BYTE_NOT_USED:
             break;
 
         case COM5025_REG_BYTE_DATA_LENGTH_SELECT:
-            registers.dataLengthSelect = (uint16_t)value << 8;
-            registers.txdl = COM5025_MapBits2CharLen((value >> 5) & 0x07);
-            registers.rxdl = COM5025_MapBits2CharLen(value & 0x07);
+            chip->registerFile.dataLengthSelect = (uint16_t)value << 8;
+            chip->registerFile.txdl = COM5025_MapBits2CharLen((value >> 5) & 0x07);
+            chip->registerFile.rxdl = COM5025_MapBits2CharLen(value & 0x07);
             break;
 
         default:
@@ -203,21 +201,21 @@ uint16_t COM5025_ReadWord(COM5025State *chip, COM5025RegistersWord reg)
 
     switch (reg) {
         case COM5025_REG_WORD_RECEIVER_STATUS:
-            data = (uint16_t)(registers.receiverStatus | registers.receiverDataBuffer);
+            data = (uint16_t)(chip->registerFile.receiverStatus | chip->registerFile.receiverDataBuffer);
             COM5025_SetOutputPin(chip, COM5025_PIN_OUT_RDA, false); // turn off "Receiver Data Available"
             COM5025_SetOutputPin(chip, COM5025_PIN_OUT_RSA, false); // turn off "Receiver Status Available"
             break;
 
         case COM5025_REG_WORD_TRANSMITTER_STATUS:
-            data = (uint16_t)(registers.txStatusAndControl | (uint8_t)registers.transmitterDataBuffer);
+            data = (uint16_t)(chip->registerFile.txStatusAndControl | (uint8_t)chip->registerFile.transmitterDataBuffer);
             break;
 
         case COM5025_REG_WORD_MODE_CONTROL_SYNC_ADDRESS:
-            data = (uint16_t)(registers.modeControl | registers.syncSecondaryAddress);
+            data = (uint16_t)(chip->registerFile.modeControl | chip->registerFile.syncSecondaryAddress);
             break;
 
         case COM5025_REG_WORD_DATA_LENGTH_SELECT:
-            data = registers.dataLengthSelect;
+            data = chip->registerFile.dataLengthSelect;
             break;
 
         default:
@@ -244,21 +242,21 @@ void COM5025_WriteWord(COM5025State *chip, COM5025RegistersWord reg, uint16_t va
 
             // TERR bit is READ ONLY - make sure it doesn't change
             uint16_t flags = hi;
-            if (registers.txStatusAndControl & COM5025_TX_STATUS_TERR)
+            if (chip->registerFile.txStatusAndControl & COM5025_TX_STATUS_TERR)
                 flags |= COM5025_TX_STATUS_TERR;
             else
                 flags &= ~COM5025_TX_STATUS_TERR;
 
-            registers.txStatusAndControl = flags;
+            chip->registerFile.txStatusAndControl = flags;
             break;
 
         case COM5025_REG_WORD_MODE_CONTROL_SYNC_ADDRESS:
-            registers.syncSecondaryAddress = lo;
-            COM5025Registers_SetModeControl(&registers, hi);
+            chip->registerFile.syncSecondaryAddress = lo;
+            COM5025Registers_SetModeControl(&chip->registerFile, hi);
             break;
 
         case COM5025_REG_WORD_DATA_LENGTH_SELECT:
-            registers.dataLengthSelect = hi;
+            chip->registerFile.dataLengthSelect = hi;
             break;
     }
 }
@@ -285,7 +283,7 @@ void COM5025_SetInputPin(COM5025State *chip, COM5025SignalPinIn pin, bool value)
                 COM5025_SetOutputPin(chip, COM5025_PIN_OUT_RSA, false);
                 COM5025_SetOutputPin(chip, COM5025_PIN_OUT_RXACT, false);
 
-                COM5025_SetReceiverStatus(chip, registers.receiverStatus & COM5025_RX_STATUS_MASK_CLEAR_ON_RECEIVER_DISABLE);
+                COM5025_SetReceiverStatus(chip, chip->registerFile.receiverStatus & COM5025_RX_STATUS_MASK_CLEAR_ON_RECEIVER_DISABLE);
             }
             break;
 
@@ -342,42 +340,42 @@ void COM5025_ClockTransmitter(COM5025State *chip)
             }
         }
 
-        if (registers.transmitterShiftRegisterBit > 0) {
+        if (chip->registerFile.transmitterShiftRegisterBit > 0) {
             // Check for five consecutive 1s for bit stuffing
-            bool found5ones = (registers.tsrCountOnes == 5);
+            bool found5ones = (chip->registerFile.tsrCountOnes == 5);
 
             // Send LSB
-            bool transmitSerialOutputPin = (registers.transmitterShiftRegister & 1) != 0;
+            bool transmitSerialOutputPin = (chip->registerFile.transmitterShiftRegister & 1) != 0;
 
             // If we are sending DATA, bit-stuffing is enabled. When sending Flags not.
-            if (registers.tsrEnableBitStuffing) {
+            if (chip->registerFile.tsrEnableBitStuffing) {
                 if (transmitSerialOutputPin) {
-                    registers.tsrCountOnes++;
+                    chip->registerFile.tsrCountOnes++;
                 } else {
-                    registers.tsrCountOnes = 0;
+                    chip->registerFile.tsrCountOnes = 0;
                 }
             }
 
             if (found5ones) {
                 // Send a Zero!
-                registers.tsrCountOnes = 0;
+                chip->registerFile.tsrCountOnes = 0;
                 COM5025_SetOutputPin(chip, COM5025_PIN_OUT_TSO, false);
             } else {
                 // Normal shift
                 COM5025_SetOutputPin(chip, COM5025_PIN_OUT_TSO, transmitSerialOutputPin);
 
                 // shift TSR
-                registers.transmitterShiftRegister = (uint8_t)(registers.transmitterShiftRegister >> 1);
+                chip->registerFile.transmitterShiftRegister = (uint8_t)(chip->registerFile.transmitterShiftRegister >> 1);
 
                 // Reduce remaining number of bits to send
-                registers.transmitterShiftRegisterBit--;
+                chip->registerFile.transmitterShiftRegisterBit--;
 
-                if (registers.transmitterShiftRegisterBit == 0) {
+                if (chip->registerFile.transmitterShiftRegisterBit == 0) {
                     // Clear shift register
-                    registers.transmitterShiftRegister = 0;
+                    chip->registerFile.transmitterShiftRegister = 0;
 
                     // trigger DMA after SYN byte has been sent
-                    if (!registers.tsrEnableBitStuffing) {
+                    if (!chip->registerFile.tsrEnableBitStuffing) {
                         COM5025_SetOutputPin(chip, COM5025_PIN_OUT_TBMT, true);
                     }
                 }
@@ -437,7 +435,7 @@ void COM5025_ReceiveData(COM5025State *chip, const uint8_t *data, int length)
 
     for (int i = 0; i < length; i++) {
         uint8_t byte = data[i];
-        COM5025Registers_QueueReceivedData(&registers, byte);
+        COM5025Registers_QueueReceivedData(&chip->registerFile, byte);
     }
 }
 
@@ -493,7 +491,7 @@ static void COM5025_SetUnderflow(COM5025State *chip)
 {
     if (!chip) return;
     // Underflow, set high when TDB not loaded in time to maintain continuous transmission
-    registers.txStatusAndControl |= COM5025_TX_STATUS_TERR;
+    chip->registerFile.txStatusAndControl |= COM5025_TX_STATUS_TERR;
     COM5025_SetOutputPin(chip, COM5025_PIN_OUT_TSA, true);
 }
 
@@ -501,7 +499,7 @@ static void COM5025_WriteTransmitterDataBuffer(COM5025State *chip, uint8_t data)
 {
     if (!chip) return;
 
-    registers.transmitterDataBuffer = data;
+    chip->registerFile.transmitterDataBuffer = data;
 
     // When you write a byte to the Transmitter Data Buffer (TDB), the TBMT signal is cleared
     // TBMT = 0 on any write access to TDB or 'TX Status and Control Register'
@@ -512,8 +510,8 @@ static void COM5025_MoveTDBtoTSR(COM5025State *chip)
 {
     if (!chip) return;
 
-    COM5025_WriteDataToTSR(chip, registers.transmitterDataBuffer);
-    registers.transmitterDataBuffer = 0;
+    COM5025_WriteDataToTSR(chip, chip->registerFile.transmitterDataBuffer);
+    chip->registerFile.transmitterDataBuffer = 0;
 
     // Tell host that TDB is empty and ready to accept the next byte
     COM5025_SetTransmitterBufferEmpty(chip);
@@ -527,10 +525,10 @@ static void COM5025_WriteDataToTSR(COM5025State *chip, uint8_t data)
     COM5025_TransmitByteOutput(chip, data, true);
 
     // Shift register logic starts here
-    registers.transmitterShiftRegister = data;
-    registers.transmitterShiftRegisterBit = 8;
-    registers.tsrCountOnes = 0;
-    registers.tsrEnableBitStuffing = true; // enable bit stuffing
+    chip->registerFile.transmitterShiftRegister = data;
+    chip->registerFile.transmitterShiftRegisterBit = 8;
+    chip->registerFile.tsrCountOnes = 0;
+    chip->registerFile.tsrEnableBitStuffing = true; // enable bit stuffing
 }
 
 static void COM5025_WriteFlagToTSR(COM5025State *chip, uint8_t flagByte)
@@ -541,10 +539,10 @@ static void COM5025_WriteFlagToTSR(COM5025State *chip, uint8_t flagByte)
     COM5025_TransmitByteOutput(chip, flagByte, false);
 
     // Shift register logic starts here
-    registers.transmitterShiftRegister = flagByte;
-    registers.transmitterShiftRegisterBit = 8;
-    registers.tsrCountOnes = 0;
-    registers.tsrEnableBitStuffing = false; // disable bit stuffing
+    chip->registerFile.transmitterShiftRegister = flagByte;
+    chip->registerFile.transmitterShiftRegisterBit = 8;
+    chip->registerFile.tsrCountOnes = 0;
+    chip->registerFile.tsrEnableBitStuffing = false; // disable bit stuffing
 
     // NOTE! Do not set TDR empty flag, writing FLAG doesn't touch the TDR register
 }
@@ -554,12 +552,12 @@ static void COM5025_TransmitByteOutput(COM5025State *chip, uint8_t data, bool is
     if (!chip) return;
 
     if (isData)
-        COM5025Registers_AggregateTXCrc(&registers, data);
+        COM5025Registers_AggregateTXCrc(&chip->registerFile, data);
 
     // if we are sending data, we might need to do byte stuffing
     if (isData) {
         // If the byte is a control octet (Frame Boundary or Escape Octet), it needs to be escaped
-        if ((COM5025Registers_IsProtocolModeCCP(&registers) == false) &&
+        if ((COM5025Registers_IsProtocolModeCCP(&chip->registerFile) == false) &&
             (data == HDLC_FRAME_DELIMITER || data == HDLC_ASYNC_ESCAPE_OCTET)) {
             // Send Escape Octet
             COM5025_SendOneByte(chip, HDLC_ASYNC_ESCAPE_OCTET);
@@ -581,7 +579,7 @@ static void COM5025_SendOneByte(COM5025State *chip, uint8_t data)
 
     // Loopback?
     if (chip->inputPins[COM5025_PIN_IN_MSEL]) { // maintenance mode?
-        COM5025Registers_QueueReceivedData(&registers, data);
+        COM5025Registers_QueueReceivedData(&chip->registerFile, data);
     }
 
     // Send it! (even if maintenance mode is enabled, we want to know the output)
@@ -593,7 +591,7 @@ static void COM5025_SendOneByte(COM5025State *chip, uint8_t data)
 static bool COM5025_TSR_Empty(COM5025State *chip)
 {
     if (!chip) return true;
-    return registers.transmitterShiftRegisterBit == 0;
+    return chip->registerFile.transmitterShiftRegisterBit == 0;
 }
 
 static uint8_t COM5025_MapBits2CharLen(uint8_t bits)
@@ -609,13 +607,13 @@ void COM5025_SetReceiverStatus(COM5025State *chip, uint16_t newRxStatus)
     if (!chip) return;
 
     // Apply the mask to ignore RSOM in both statuses
-    uint16_t maskedOriginalStatus = registers.receiverStatus & ~COM5025_RX_STATUS_RSOM;
+    uint16_t maskedOriginalStatus = chip->registerFile.receiverStatus & ~COM5025_RX_STATUS_RSOM;
     uint16_t maskedNewStatus = newRxStatus & ~COM5025_RX_STATUS_RSOM;
 
     // Find bits that were 0 and are now 1, excluding RSOM
     uint16_t bitsFrom0To1 = (~maskedOriginalStatus & maskedNewStatus);
 
-    COM5025Registers_SetReceiverStatus(&registers, newRxStatus);
+    COM5025Registers_SetReceiverStatus(&chip->registerFile, newRxStatus);
 
     // Do we have bits going to 1?
     if (bitsFrom0To1 != 0) {
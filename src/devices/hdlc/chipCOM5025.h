@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "hdlc_constants.h"
+#include "chipCOM5025Registers.h"
 
 // Register address selection where "BYTE OP" = 0 (data port 16 bits wide)
 // Ignores A0
@@ -260,8 +261,9 @@ typedef struct COM5025State {
     bool flagDetected;
     bool abortDetected;
 
-    // Register state pointer
+    // Register state pointer, to this chip's registerFile
     void *registers;
+    COM5025Registers registerFile;
 
     // Callback function pointers
     void (*onTransmitterOutput)(void *context, uint8_t data);
@@ -236,11 +236,16 @@ static void HDLC_Reset(Device *self)
     // Initialize clock timing
     data->cpuTicks = 0;
     data->cpuTicksPerTx = 625; // Default timing divider
+    data->lastTick = instr_counter;
+    Device_ScheduleTick(self, 0);
 
     // Set default baud rate based on thumbwheel
     data->baudRate = HDLC_BAUD_9600; // Default to 9600 bps
 }
 
+// Modem/DMA poll interval. Receiver and transmitter delays are 10+ ticks, so this keeps their pacing.
+#define HDLC_POLL_TICKS 10
+
 static uint16_t HDLC_Tick(Device *self)
 {
     if (!self) return 0;
@@ -248,6 +253,10 @@ static uint16_t HDLC_Tick(Device *self)
     HDLCData *data = (HDLCData *)self->deviceData;
     if (!data) return 0;
 
+    // CPU ticks since the previous call
+    uint32_t ticks = (uint32_t)(instr_counter - data->lastTick);
+    data->lastTick = instr_counter;
+
     // Process I/O delays
     Device_TickIODelay(self);
 
@@ -256,13 +265,14 @@ static uint16_t HDLC_Tick(Device *self)
         Modem_Tick(data->modem);
     }
     if (data->dmaEngine) {
-        DMAEngine_Tick(data->dmaEngine);
+        DMAEngine_Tick(data->dmaEngine, ticks);
     }
 
     // Clock COM5025 only before DMA is initialized (needed for maintenance test).
     // After INITIALIZE, burst/DMA mode handles all framing — COM5025 is unused.
+    uint32_t nextTick = HDLC_POLL_TICKS;
     if (!data->dmaEngine->enabled) {
-        data->cpuTicks++;
+        data->cpuTicks += ticks;
         if (data->cpuTicks >= data->cpuTicksPerTx) {
             data->cpuTicks = 0;
             if (data->com5025) {
@@ -273,6 +283,16 @@ static uint16_t HDLC_Tick(Device *self)
                 COM5025Registers_Clock((COM5025Registers *)data->com5025->registers);
             }
         }
+        if ((uint32_t)(data->cpuTicksPerTx - data->cpuTicks) < nextTick)
+            nextTick = data->cpuTicksPerTx - data->cpuTicks;
+        Device_ScheduleTick(self, nextTick);
+    }
+    else if (DMAEngine_HasPendingWork(data->dmaEngine)) {
+        Device_ScheduleTick(self, nextTick);
+    }
+    else {
+        // Nothing in flight: only poll the modem. Its worker wakes an idle CPU on received data.
+        Device_SchedulePoll(self, nextTick);
     }
 
     return self->interruptBits;
@@ -597,6 +617,327 @@ static void HDLC_Destroy(Device *self)
     // Base Device_Destroy will handle freeing deviceData
 }
 
+// Snapshot: the controller record, then the COM5025, modem and DMA engine records.
+// Sockets, worker threads and callbacks belong to this process; the link is
+// re-established after a restore.
+#define HDLC_STATE_VERSION 1
+#define COM5025_STATE_VERSION 1
+
+static void HDLC_PutTimerState(const COM5025IOTimer *timer, StateRecord *rec)
+{
+    StateRecord_PutInt(rec, timer->ticks);
+    StateRecord_PutInt(rec, timer->param);
+    StateRecord_PutBool(rec, timer->active);
+    StateRecord_PutInt(rec, timer->clockSpeed);
+}
+
+static void HDLC_GetTimerState(COM5025IOTimer *timer, StateRecord *rec)
+{
+    timer->ticks = StateRecord_GetInt(rec);
+    timer->param = StateRecord_GetInt(rec);
+    timer->active = StateRecord_GetBool(rec);
+    timer->clockSpeed = StateRecord_GetInt(rec);
+}
+
+// The register file, the receive queue oldest first
+static void HDLC_PutCOM5025Registers(COM5025Registers *regs, StateRecord *rec)
+{
+    StateRecord_PutU16(rec, regs->receiverStatus);
+    StateRecord_PutU16(rec, regs->txStatusAndControl);
+    StateRecord_PutU16(rec, regs->modeControl);
+    StateRecord_PutU16(rec, regs->dataLengthSelect);
+    StateRecord_PutU8(rec, regs->txdl);
+    StateRecord_PutU8(rec, regs->rxdl);
+    StateRecord_PutU16(rec, regs->receiverDataBuffer);
+    StateRecord_PutU16(rec, regs->dataFromReceiveQueue);
+    StateRecord_PutU8(rec, regs->transmitterDataBuffer);
+    StateRecord_PutU8(rec, regs->transmitterShiftRegister);
+    StateRecord_PutU8(rec, regs->transmitterShiftRegisterBit);
+    StateRecord_PutBool(rec, regs->tsrEnableBitStuffing);
+    StateRecord_PutU8(rec, regs->tsrCountOnes);
+    StateRecord_PutU8(rec, regs->syncSecondaryAddress);
+    StateRecord_PutInt(rec, regs->transmitterState);
+    StateRecord_PutInt(rec, regs->receiverState);
+    StateRecord_PutInt(rec, regs->crcMode);
+    HDLC_PutTimerState(&regs->txTimer, rec);
+    HDLC_PutTimerState(&regs->rxTimer, rec);
+    StateRecord_PutInt(rec, regs->rorCount);
+    StateRecord_PutBool(rec, regs->byteStuffingDetected);
+    StateRecord_PutU16(rec, regs->rxCrc);
+    StateRecord_PutU16(rec, regs->txCrc);
+
+    StateRecord_PutU32(rec, (uint32_t)regs->receiveQueue.count);
+    for (COM5025ReceiveQueueNode *node = regs->receiveQueue.head; node; node = node->next)
+        StateRecord_PutU16(rec, node->data);
+}
+
+// Restore the register file, rebuilding the receive queue
+static void HDLC_GetCOM5025Registers(COM5025Registers *regs, StateRecord *rec)
+{
+    regs->receiverStatus = StateRecord_GetU16(rec);
+    regs->txStatusAndControl = StateRecord_GetU16(rec);
+    regs->modeControl = StateRecord_GetU16(rec);
+    regs->dataLengthSelect = StateRecord_GetU16(rec);
+    regs->txdl = StateRecord_GetU8(rec);
+    regs->rxdl = StateRecord_GetU8(rec);
+    regs->receiverDataBuffer = StateRecord_GetU16(rec);
+    regs->dataFromReceiveQueue = StateRecord_GetU16(rec);
+    regs->transmitterDataBuffer = StateRecord_GetU8(rec);
+    regs->transmitterShiftRegister = StateRecord_GetU8(rec);
+    regs->transmitterShiftRegisterBit = StateRecord_GetU8(rec);
+    regs->tsrEnableBitStuffing = StateRecord_GetBool(rec);
+    regs->tsrCountOnes = StateRecord_GetU8(rec);
+    regs->syncSecondaryAddress = StateRecord_GetU8(rec);
+    regs->transmitterState = (COM5025TXState)StateRecord_GetInt(rec);
+    regs->receiverState = (COM5025RXState)StateRecord_GetInt(rec);
+    regs->crcMode = (COM5025CrcMode)StateRecord_GetInt(rec);
+    HDLC_GetTimerState(&regs->txTimer, rec);
+    HDLC_GetTimerState(&regs->rxTimer, rec);
+    regs->rorCount = StateRecord_GetInt(rec);
+    regs->byteStuffingDetected = StateRecord_GetBool(rec);
+    regs->rxCrc = StateRecord_GetU16(rec);
+    regs->txCrc = StateRecord_GetU16(rec);
+
+    COM5025Registers_Destroy(regs);
+    regs->receiveQueue.head = NULL;
+    regs->receiveQueue.tail = NULL;
+    regs->receiveQueue.count = 0;
+
+    uint32_t count = StateRecord_GetU32(rec);
+    if (count > HDLC_MAX_RECEIVE_QUEUE_SIZE)
+        rec->ok = false;
+    for (uint32_t i = 0; rec->ok && i < count; i++) {
+        COM5025ReceiveQueueNode *node = malloc(sizeof(COM5025ReceiveQueueNode));
+        if (!node) {
+            rec->ok = false;
+            break;
+        }
+        node->data = StateRecord_GetU16(rec);
+        node->next = NULL;
+        if (regs->receiveQueue.tail) {
+            regs->receiveQueue.tail->next = node;
+        } else {
+            regs->receiveQueue.head = node;
+        }
+        regs->receiveQueue.tail = node;
+        regs->receiveQueue.count++;
+    }
+}
+
+// The chip and its register file; its callbacks are kept
+static bool HDLC_SaveCOM5025(COM5025State *chip, FILE *f)
+{
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, COM5025_STATE_VERSION);
+    StateRecord_PutU8(&rec, chip->receiverDataBuffer);
+    StateRecord_PutU16(&rec, chip->receiverStatusRegister);
+    StateRecord_PutU8(&rec, chip->transmitterDataRegister);
+    StateRecord_PutU16(&rec, chip->transmitterStatusControlRegister);
+    StateRecord_PutU8(&rec, chip->syncAddressRegister);
+    StateRecord_PutU16(&rec, chip->modeControlRegister);
+    StateRecord_PutU16(&rec, chip->dataLengthSelectRegister);
+    for (int i = 0; i < COM5025_MAX_IN_PINS; i++)
+        StateRecord_PutBool(&rec, chip->inputPins[i]);
+    for (int i = 0; i < COM5025_MAX_OUT_PINS; i++)
+        StateRecord_PutBool(&rec, chip->outputPins[i]);
+    StateRecord_PutInt(&rec, chip->mode);
+    StateRecord_PutBool(&rec, chip->maintenanceMode);
+    StateRecord_PutU16(&rec, chip->crcRegister);
+    StateRecord_PutU8(&rec, chip->receiverShiftRegister);
+    StateRecord_PutU8(&rec, chip->transmitterShiftRegister);
+    StateRecord_PutInt(&rec, chip->bitCounter);
+    StateRecord_PutInt(&rec, chip->characterLength);
+    StateRecord_PutInt(&rec, chip->clockCounter);
+    StateRecord_PutBool(&rec, chip->flagDetected);
+    StateRecord_PutBool(&rec, chip->abortDetected);
+    HDLC_PutCOM5025Registers(&chip->registerFile, &rec);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool HDLC_LoadCOM5025(COM5025State *chip, FILE *f)
+{
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, COM5025_STATE_VERSION))
+        return false;
+    chip->receiverDataBuffer = StateRecord_GetU8(&rec);
+    chip->receiverStatusRegister = StateRecord_GetU16(&rec);
+    chip->transmitterDataRegister = StateRecord_GetU8(&rec);
+    chip->transmitterStatusControlRegister = StateRecord_GetU16(&rec);
+    chip->syncAddressRegister = StateRecord_GetU8(&rec);
+    chip->modeControlRegister = StateRecord_GetU16(&rec);
+    chip->dataLengthSelectRegister = StateRecord_GetU16(&rec);
+    for (int i = 0; i < COM5025_MAX_IN_PINS; i++)
+        chip->inputPins[i] = StateRecord_GetBool(&rec);
+    for (int i = 0; i < COM5025_MAX_OUT_PINS; i++)
+        chip->outputPins[i] = StateRecord_GetBool(&rec);
+    chip->mode = (COM5025MPCCMode)StateRecord_GetInt(&rec);
+    chip->maintenanceMode = StateRecord_GetBool(&rec);
+    chip->crcRegister = StateRecord_GetU16(&rec);
+    chip->receiverShiftRegister = StateRecord_GetU8(&rec);
+    chip->transmitterShiftRegister = StateRecord_GetU8(&rec);
+    chip->bitCounter = StateRecord_GetInt(&rec);
+    chip->characterLength = StateRecord_GetInt(&rec);
+    chip->clockCounter = StateRecord_GetInt(&rec);
+    chip->flagDetected = StateRecord_GetBool(&rec);
+    chip->abortDetected = StateRecord_GetBool(&rec);
+    HDLC_GetCOM5025Registers(&chip->registerFile, &rec);
+    return StateRecord_End(&rec);
+}
+
+static bool HDLC_SaveState(Device *self, FILE *f)
+{
+    HDLCData *data = (HDLCData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, HDLC_STATE_VERSION);
+    StateRecord_PutInt(&rec, data->baudRate);
+    StateRecord_PutU16(&rec, data->rxTransferStatus.raw);
+    StateRecord_PutU16(&rec, data->rxTransferControl.raw);
+    StateRecord_PutU16(&rec, data->txTransferStatus.raw);
+    StateRecord_PutU16(&rec, data->txTransferControl.raw);
+    StateRecord_PutU16(&rec, data->dmaAddress);
+    StateRecord_PutU8(&rec, data->dmaBankBits);
+    StateRecord_PutU8(&rec, data->dmaCommand);
+    StateRecord_PutInt(&rec, data->txState);
+    StateRecord_PutInt(&rec, data->blockState);
+    StateRecord_PutU8(&rec, data->rxDataRegister);
+    StateRecord_PutU8(&rec, data->rxStatusRegister);
+    StateRecord_PutU8(&rec, data->txDataRegister);
+    StateRecord_PutU8(&rec, data->txStatusRegister);
+    StateRecord_PutU8(&rec, data->parameterControlRegister);
+    StateRecord_PutU8(&rec, data->syncAddressRegister);
+    StateRecord_PutU8(&rec, data->characterLength);
+    StateRecord_PutU8(&rec, data->txControlRegister);
+    StateRecord_PutBool(&rec, data->deviceActive);
+    StateRecord_PutBool(&rec, data->maintenanceMode);
+    StateRecord_PutInt(&rec, data->tickCounter);
+    StateRecord_PutU16(&rec, data->rxModemFlags.raw);
+    StateRecord_PutU16(&rec, data->txModemFlags.raw);
+    StateRecord_PutU16(&rec, data->rxModemFlagsMask.raw);
+    StateRecord_PutU16(&rec, data->txModemFlagsMask.raw);
+    StateRecord_PutInt(&rec, data->cpuTicks);
+    StateRecord_PutInt(&rec, data->cpuTicksPerTx);
+    StateRecord_PutU64(&rec, data->lastTick);
+
+    StateRecord_PutU64(&rec, data->framesTx);
+    StateRecord_PutU64(&rec, data->framesRx);
+    StateRecord_PutU64(&rec, data->framesRxErrors);
+    StateRecord_PutU64(&rec, data->txStarts);
+    StateRecord_PutU64(&rec, data->txSendCalls);
+    StateRecord_PutU64(&rec, data->txAlreadySent);
+    StateRecord_PutU32(&rec, data->txLastListPtr);
+    StateRecord_PutU16(&rec, data->txLastKeyBefore);
+    StateRecord_PutU64(&rec, data->dcbTxMarked);
+    StateRecord_PutU64(&rec, data->dcbRxMarked);
+    StateRecord_PutU64(&rec, data->identCount12);
+    StateRecord_PutU64(&rec, data->identCount13);
+    StateRecord_PutU64(&rec, data->irq12Count);
+    StateRecord_PutU64(&rec, data->irq13Count);
+    StateRecord_PutU64(&rec, data->irq13_dataAvail);
+    StateRecord_PutU64(&rec, data->irq13_statusAvail);
+    StateRecord_PutU64(&rec, data->irq13_modem);
+    StateRecord_PutU64(&rec, data->irq13_dma);
+    StateRecord_PutU64(&rec, data->iox13WriteCount);
+    StateRecord_PutU64(&rec, data->iox11WriteCount);
+
+    StateRecord_PutU32(&rec, HDLC_TX_HISTORY_SIZE);
+    for (int i = 0; i < HDLC_TX_HISTORY_SIZE; i++) {
+        StateRecord_PutU32(&rec, data->txHistory[i].listPtr);
+        StateRecord_PutU32(&rec, data->txHistory[i].dataAddr);
+        StateRecord_PutU16(&rec, data->txHistory[i].byteCount);
+        StateRecord_PutU16(&rec, data->txHistory[i].keyBefore);
+        StateRecord_PutU16(&rec, data->txHistory[i].frameSize);
+        StateRecord_PutBytes(&rec, data->txHistory[i].data, HDLC_TX_HISTORY_DATA_SIZE);
+        StateRecord_PutU8(&rec, data->txHistory[i].dataLen);
+    }
+    StateRecord_PutInt(&rec, data->txHistoryIdx);
+
+    return StateRecord_Write(&rec, f) &&
+           HDLC_SaveCOM5025(data->com5025, f) &&
+           Modem_SaveState(data->modem, f) &&
+           DMAEngine_SaveState(data->dmaEngine, f);
+}
+
+static bool HDLC_LoadState(Device *self, FILE *f)
+{
+    HDLCData *data = (HDLCData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, HDLC_STATE_VERSION))
+        return false;
+    data->baudRate = (HDLCBaudRate)StateRecord_GetInt(&rec);
+    data->rxTransferStatus.raw = StateRecord_GetU16(&rec);
+    data->rxTransferControl.raw = StateRecord_GetU16(&rec);
+    data->txTransferStatus.raw = StateRecord_GetU16(&rec);
+    data->txTransferControl.raw = StateRecord_GetU16(&rec);
+    data->dmaAddress = StateRecord_GetU16(&rec);
+    data->dmaBankBits = StateRecord_GetU8(&rec);
+    data->dmaCommand = StateRecord_GetU8(&rec);
+    data->txState = (HDLCDMATxState)StateRecord_GetInt(&rec);
+    data->blockState = (HDLCDMABlockState)StateRecord_GetInt(&rec);
+    data->rxDataRegister = StateRecord_GetU8(&rec);
+    data->rxStatusRegister = StateRecord_GetU8(&rec);
+    data->txDataRegister = StateRecord_GetU8(&rec);
+    data->txStatusRegister = StateRecord_GetU8(&rec);
+    data->parameterControlRegister = StateRecord_GetU8(&rec);
+    data->syncAddressRegister = StateRecord_GetU8(&rec);
+    data->characterLength = StateRecord_GetU8(&rec);
+    data->txControlRegister = StateRecord_GetU8(&rec);
+    data->deviceActive = StateRecord_GetBool(&rec);
+    data->maintenanceMode = StateRecord_GetBool(&rec);
+    data->tickCounter = StateRecord_GetInt(&rec);
+    data->rxModemFlags.raw = StateRecord_GetU16(&rec);
+    data->txModemFlags.raw = StateRecord_GetU16(&rec);
+    data->rxModemFlagsMask.raw = StateRecord_GetU16(&rec);
+    data->txModemFlagsMask.raw = StateRecord_GetU16(&rec);
+    data->cpuTicks = StateRecord_GetInt(&rec);
+    data->cpuTicksPerTx = StateRecord_GetInt(&rec);
+    data->lastTick = StateRecord_GetU64(&rec);
+
+    data->framesTx = StateRecord_GetU64(&rec);
+    data->framesRx = StateRecord_GetU64(&rec);
+    data->framesRxErrors = StateRecord_GetU64(&rec);
+    data->txStarts = StateRecord_GetU64(&rec);
+    data->txSendCalls = StateRecord_GetU64(&rec);
+    data->txAlreadySent = StateRecord_GetU64(&rec);
+    data->txLastListPtr = StateRecord_GetU32(&rec);
+    data->txLastKeyBefore = StateRecord_GetU16(&rec);
+    data->dcbTxMarked = StateRecord_GetU64(&rec);
+    data->dcbRxMarked = StateRecord_GetU64(&rec);
+    data->identCount12 = StateRecord_GetU64(&rec);
+    data->identCount13 = StateRecord_GetU64(&rec);
+    data->irq12Count = StateRecord_GetU64(&rec);
+    data->irq13Count = StateRecord_GetU64(&rec);
+    data->irq13_dataAvail = StateRecord_GetU64(&rec);
+    data->irq13_statusAvail = StateRecord_GetU64(&rec);
+    data->irq13_modem = StateRecord_GetU64(&rec);
+    data->irq13_dma = StateRecord_GetU64(&rec);
+    data->iox13WriteCount = StateRecord_GetU64(&rec);
+    data->iox11WriteCount = StateRecord_GetU64(&rec);
+
+    if (StateRecord_GetU32(&rec) != HDLC_TX_HISTORY_SIZE)
+        rec.ok = false;
+    for (int i = 0; rec.ok && i < HDLC_TX_HISTORY_SIZE; i++) {
+        data->txHistory[i].listPtr = StateRecord_GetU32(&rec);
+        data->txHistory[i].dataAddr = StateRecord_GetU32(&rec);
+        data->txHistory[i].byteCount = StateRecord_GetU16(&rec);
+        data->txHistory[i].keyBefore = StateRecord_GetU16(&rec);
+        data->txHistory[i].frameSize = StateRecord_GetU16(&rec);
+        StateRecord_GetBytes(&rec, data->txHistory[i].data, HDLC_TX_HISTORY_DATA_SIZE);
+        data->txHistory[i].dataLen = StateRecord_GetU8(&rec);
+    }
+    data->txHistoryIdx = StateRecord_GetInt(&rec);
+    if (data->txHistoryIdx < 0)
+        rec.ok = false;
+
+    return StateRecord_End(&rec) &&
+           HDLC_LoadCOM5025(data->com5025, f) &&
+           Modem_LoadState(data->modem, f) &&
+           DMAEngine_LoadState(data->dmaEngine, f);
+}
+
 Device* CreateHDLCDevice(uint8_t thumbwheel)
 {
     // Validate thumbwheel value
@@ -683,6 +1024,8 @@ Device* CreateHDLCDevice(uint8_t thumbwheel)
     dev->Write = HDLC_Write;
     dev->Ident = HDLC_Ident;
     dev->Destroy = HDLC_Destroy;
+    dev->SaveState = HDLC_SaveState;
+    dev->LoadState = HDLC_LoadState;
     dev->Boot = NULL; // HDLC devices don't support booting
 
     // Link device data
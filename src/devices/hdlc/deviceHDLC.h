@@ -283,6 +283,7 @@ typedef struct {
     // Clock timing
     int cpuTicks;
     int cpuTicksPerTx;
+    uint64_t lastTick;          // instr_counter at the previous HDLC_Tick
 
     // Statistics
     uint64_t framesTx;
@@ -38,6 +38,7 @@
 #include "dmaEnum.h"
 #include "hdlc_constants.h"
 #include "../devices_types.h"
+#include "../devices_protos.h"
 
 // Debug flags (convert from C# #define)
 // #define DEBUG_DETAIL
@@ -184,21 +185,38 @@ void DMAEngine_Clear(DMAEngine *dma)
     }
 }
 
-void DMAEngine_Tick(DMAEngine *dma)
+// ticks: CPU instructions elapsed since the previous call
+void DMAEngine_Tick(DMAEngine *dma, uint32_t ticks)
 {
     if (!dma) return;
 
     // RX MUST tick BEFORE TX so that incoming ACKs (RR frames) are delivered
     // to SINTRAN before SINTRAN's T1 timer fires and triggers retransmissions.
     if (dma->receiver) {
-        DMAReceiver_Tick(dma->receiver);
+        DMAReceiver_Tick(dma->receiver, ticks);
     }
 
     if (dma->transmitter) {
-        DMATransmitter_Tick(dma->transmitter);
+        DMATransmitter_Tick(dma->transmitter, ticks);
     }
 }
 
+// True while the receiver has buffered data or the transmitter has a block waiting.
+// The HDLC device then schedules its polls as events, so an idle CPU does not sleep past them.
+bool DMAEngine_HasPendingWork(DMAEngine *dma)
+{
+    if (!dma) return false;
+
+    if (dma->receiver && TcpReceiveBuffer_Available(&dma->receiver->tcpReceiveBuffer) > 0)
+        return true;
+
+    if (dma->dmaCB && dma->dmaCB->dmaSenderState == DMA_SENDER_BLOCK_READY_TO_SEND &&
+        dma->dmaCB->dmaWaitTicks >= 0)
+        return true;
+
+    return false;
+}
+
 // Memory access functions - forward to callbacks
 
 int DMAEngine_DMARead(DMAEngine *dma, uint32_t address)
@@ -670,6 +688,186 @@ void DMAEngine_SetClearCommandCallback(DMAEngine *dma, DMAClearCommandCallback c
     dma->onClearCommand = callback;
 }
 
+// Snapshot support. Hardware references and callbacks belong to this process and are kept.
+
+#define DMA_ENGINE_STATE_VERSION 1
+
+static void DCB_PutState(const HdlcDCB *dcb, StateRecord *rec)
+{
+    StateRecord_PutBool(rec, dcb != NULL);
+    if (!dcb)
+        return;
+    StateRecord_PutU32(rec, dcb->bufferAddress);
+    StateRecord_PutU16(rec, dcb->offsetFromLP);
+    StateRecord_PutU16(rec, dcb->keyValue);
+    StateRecord_PutU16(rec, dcb->byteCount);
+    StateRecord_PutU16(rec, dcb->mostAddress);
+    StateRecord_PutU16(rec, dcb->leastAddress);
+    StateRecord_PutU16(rec, dcb->displacement);
+    StateRecord_PutU32(rec, dcb->listPointer);
+    StateRecord_PutU32(rec, dcb->dmaAddress);
+    StateRecord_PutInt(rec, dcb->dmaBytesRead);
+    StateRecord_PutInt(rec, dcb->dmaBytesWritten);
+    StateRecord_PutInt(rec, dcb->dmaReadData);
+}
+
+// Restore a buffer description, allocating or freeing it to match the snapshot
+static void DCB_GetState(HdlcDCB **dcbp, StateRecord *rec)
+{
+    if (!StateRecord_GetBool(rec)) {
+        free(*dcbp);
+        *dcbp = NULL;
+        return;
+    }
+    if (!*dcbp)
+        *dcbp = malloc(sizeof(HdlcDCB));
+    HdlcDCB *dcb = *dcbp;
+    if (!dcb) {
+        rec->ok = false;
+        return;
+    }
+    dcb->bufferAddress = StateRecord_GetU32(rec);
+    dcb->offsetFromLP = StateRecord_GetU16(rec);
+    dcb->keyValue = StateRecord_GetU16(rec);
+    dcb->byteCount = StateRecord_GetU16(rec);
+    dcb->mostAddress = StateRecord_GetU16(rec);
+    dcb->leastAddress = StateRecord_GetU16(rec);
+    dcb->displacement = StateRecord_GetU16(rec);
+    dcb->listPointer = StateRecord_GetU32(rec);
+    dcb->dmaAddress = StateRecord_GetU32(rec);
+    dcb->dmaBytesRead = StateRecord_GetInt(rec);
+    dcb->dmaBytesWritten = StateRecord_GetInt(rec);
+    dcb->dmaReadData = StateRecord_GetInt(rec);
+}
+
+bool DMAEngine_SaveState(DMAEngine *dma, FILE *f)
+{
+    StateRecord rec;
+    const ParameterBuffer *params = &dma->parameterBuffer;
+    const DMAControlBlocks *cb = dma->dmaCB;
+    const HDLCFrame *frame = cb->hdlcReceiveFrame;
+    const TcpReceiveBuffer *tcp = &dma->receiver->tcpReceiveBuffer;
+
+    StateRecord_Begin(&rec, DMA_ENGINE_STATE_VERSION);
+    StateRecord_PutBool(&rec, dma->enabled);
+    StateRecord_PutWords(&rec, dma->dmaRegisters, 256);
+    StateRecord_PutU32(&rec, dma->currentDMAAddress);
+    StateRecord_PutInt(&rec, params->parameterControlRegister);
+    StateRecord_PutInt(&rec, params->syncAddressRegister);
+    StateRecord_PutInt(&rec, params->characterLength);
+    StateRecord_PutInt(&rec, params->displacement1);
+    StateRecord_PutInt(&rec, params->displacement2);
+    StateRecord_PutInt(&rec, params->maxReceiverBlockLength);
+    StateRecord_PutInt(&rec, params->receiverStatusReg);
+    StateRecord_PutInt(&rec, params->transmitterStatusReg);
+    StateRecord_PutInt(&rec, params->dmaBankBits);
+
+    // Control blocks
+    StateRecord_PutBytes(&rec, cb->outboundBuffer, (size_t)cb->outboundBufferSize);
+    DCB_PutState(cb->txDCB, &rec);
+    DCB_PutState(cb->rxDCB, &rec);
+    StateRecord_PutU32(&rec, cb->txListPointer);
+    StateRecord_PutInt(&rec, cb->txListPointerOffset);
+    StateRecord_PutU32(&rec, cb->rxListPointer);
+    StateRecord_PutInt(&rec, cb->rxListPointerOffset);
+    StateRecord_PutInt(&rec, cb->dmaSenderState);
+    StateRecord_PutInt(&rec, cb->dmaSendBlockState);
+    StateRecord_PutInt(&rec, cb->dmaWaitTicks);
+
+    // Frame being received
+    StateRecord_PutInt(&rec, frame->state);
+    StateRecord_PutBytes(&rec, frame->frameBuffer, sizeof(frame->frameBuffer));
+    StateRecord_PutU8(&rec, frame->prevByte);
+    StateRecord_PutInt(&rec, frame->frameLength);
+    StateRecord_PutU16(&rec, frame->crc);
+    StateRecord_PutBool(&rec, frame->frameComplete);
+    StateRecord_PutBool(&rec, frame->crcValid);
+
+    StateRecord_PutBool(&rec, dma->transmitter->active);
+    StateRecord_PutInt(&rec, dma->transmitter->bytesSent);
+    StateRecord_PutInt(&rec, dma->receiver->bytesReceived);
+    StateRecord_PutInt(&rec, dma->receiver->processTcpBufDelay);
+
+    // Received bytes not yet taken, oldest first
+    StateRecord_PutU32(&rec, (uint32_t)tcp->count);
+    for (int i = 0; i < tcp->count; i++)
+        StateRecord_PutU8(&rec, tcp->buffer[(tcp->tail + i) % tcp->capacity]);
+
+    return StateRecord_Write(&rec, f);
+}
+
+bool DMAEngine_LoadState(DMAEngine *dma, FILE *f)
+{
+    StateRecord rec;
+    ParameterBuffer *params = &dma->parameterBuffer;
+    DMAControlBlocks *cb = dma->dmaCB;
+    HDLCFrame *frame = cb->hdlcReceiveFrame;
+    TcpReceiveBuffer *tcp = &dma->receiver->tcpReceiveBuffer;
+    const uint8_t *bytes;
+    size_t size;
+
+    if (!StateRecord_Read(&rec, f, DMA_ENGINE_STATE_VERSION))
+        return false;
+    dma->enabled = StateRecord_GetBool(&rec);
+    StateRecord_GetWords(&rec, dma->dmaRegisters, 256);
+    dma->currentDMAAddress = StateRecord_GetU32(&rec);
+    params->parameterControlRegister = StateRecord_GetInt(&rec);
+    params->syncAddressRegister = StateRecord_GetInt(&rec);
+    params->characterLength = StateRecord_GetInt(&rec);
+    params->displacement1 = StateRecord_GetInt(&rec);
+    params->displacement2 = StateRecord_GetInt(&rec);
+    params->maxReceiverBlockLength = StateRecord_GetInt(&rec);
+    params->receiverStatusReg = StateRecord_GetInt(&rec);
+    params->transmitterStatusReg = StateRecord_GetInt(&rec);
+    params->dmaBankBits = StateRecord_GetInt(&rec);
+
+    bytes = StateRecord_GetData(&rec, &size);
+    if (size > (size_t)cb->outboundBufferCapacity) {
+        rec.ok = false;
+    } else {
+        if (bytes)
+            memcpy(cb->outboundBuffer, bytes, size);
+        cb->outboundBufferSize = (int)size;
+    }
+    DCB_GetState(&cb->txDCB, &rec);
+    DCB_GetState(&cb->rxDCB, &rec);
+    cb->txListPointer = StateRecord_GetU32(&rec);
+    cb->txListPointerOffset = StateRecord_GetInt(&rec);
+    cb->rxListPointer = StateRecord_GetU32(&rec);
+    cb->rxListPointerOffset = StateRecord_GetInt(&rec);
+    cb->dmaSenderState = StateRecord_GetInt(&rec);
+    cb->dmaSendBlockState = StateRecord_GetInt(&rec);
+    cb->dmaWaitTicks = StateRecord_GetInt(&rec);
+
+    frame->state = (HDLCReceiveState)StateRecord_GetInt(&rec);
+    StateRecord_GetBytes(&rec, frame->frameBuffer, sizeof(frame->frameBuffer));
+    frame->prevByte = StateRecord_GetU8(&rec);
+    frame->frameLength = StateRecord_GetInt(&rec);
+    frame->crc = StateRecord_GetU16(&rec);
+    frame->frameComplete = StateRecord_GetBool(&rec);
+    frame->crcValid = StateRecord_GetBool(&rec);
+    if (frame->frameLength < 0 || frame->frameLength > HDLC_MAX_FRAME_SIZE)
+        rec.ok = false;
+
+    dma->transmitter->active = StateRecord_GetBool(&rec);
+    dma->transmitter->bytesSent = StateRecord_GetInt(&rec);
+    dma->receiver->bytesReceived = StateRecord_GetInt(&rec);
+    dma->receiver->processTcpBufDelay = StateRecord_GetInt(&rec);
+
+    uint32_t count = StateRecord_GetU32(&rec);
+    if (count > (uint32_t)tcp->capacity) {
+        rec.ok = false;
+    } else {
+        for (uint32_t i = 0; i < count; i++)
+            tcp->buffer[i] = StateRecord_GetU8(&rec);
+        tcp->tail = 0;
+        tcp->count = (int)count;
+        tcp->head = (count == (uint32_t)tcp->capacity) ? 0 : tcp->count;
+    }
+
+    return StateRecord_End(&rec);
+}
+
 // Debug functions
 
 void DMAEngine_Log(DMAEngine *dma, const char *format, ...)
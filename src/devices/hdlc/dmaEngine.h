@@ -23,6 +23,7 @@
 #ifndef DMA_ENGINE_H
 #define DMA_ENGINE_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "dmaParamBuf.h"
@@ -88,7 +89,8 @@ typedef struct DMAEngine {
 void DMAEngine_Init(DMAEngine *dma, bool burstMode, struct Device *hdlcDevice, void *modem, void *com5025);
 void DMAEngine_Destroy(DMAEngine *dma);
 void DMAEngine_Clear(DMAEngine *dma);
-void DMAEngine_Tick(DMAEngine *dma);
+void DMAEngine_Tick(DMAEngine *dma, uint32_t ticks);
+bool DMAEngine_HasPendingWork(DMAEngine *dma);
 
 // DMA Command execution
 void DMAEngine_ExecuteCommand(DMAEngine *dma);
@@ -126,6 +128,10 @@ void DMAEngine_SetSendFrameCallback(DMAEngine *dma, DMASendFrameCallback callbac
 void DMAEngine_SetUpdateReceiverStatusCallback(DMAEngine *dma, DMAUpdateReceiverStatusCallback callback);
 void DMAEngine_SetClearCommandCallback(DMAEngine *dma, DMAClearCommandCallback callback);
 
+// Snapshot support
+bool DMAEngine_SaveState(DMAEngine *dma, FILE *f);
+bool DMAEngine_LoadState(DMAEngine *dma, FILE *f);
+
 // Debug functions
 void DMAEngine_Log(DMAEngine *dma, const char *format, ...);
 
@@ -73,18 +73,18 @@ void DMAReceiver_Clear(DMAReceiver *receiver)
 }
 
 // ---------------------------------------------------------------------------
-// Tick: called every CPU cycle from DMAEngine_Tick.
+// Tick: called from DMAEngine_Tick with the CPU ticks elapsed since last call.
 // Processes ONE complete HDLC frame per call.
 // Adaptive delay: short delay (50 ticks) when queue is backing up,
 // normal delay (500 ticks) when queue is manageable.
 // ---------------------------------------------------------------------------
-void DMAReceiver_Tick(DMAReceiver *receiver)
+void DMAReceiver_Tick(DMAReceiver *receiver, uint32_t ticks)
 {
     if (!receiver) return;
 
     // Simple delay to avoid busy looping when no data available
     if (receiver->processTcpBufDelay > 0) {
-        receiver->processTcpBufDelay--;
+        receiver->processTcpBufDelay -= (ticks < (uint32_t)receiver->processTcpBufDelay) ? (int)ticks : receiver->processTcpBufDelay;
         return;
     }
 
@@ -70,7 +70,7 @@ typedef struct DMAReceiver {
 void DMAReceiver_Init(DMAReceiver *receiver, void *com5025, DMAControlBlocks *dmaCB, struct Device *hdlcDevice);
 void DMAReceiver_Destroy(DMAReceiver *receiver);
 void DMAReceiver_Clear(DMAReceiver *receiver);
-void DMAReceiver_Tick(DMAReceiver *receiver);
+void DMAReceiver_Tick(DMAReceiver *receiver, uint32_t ticks);
 
 // State management
 void DMAReceiver_SetReceiverState(DMAReceiver *receiver);
@@ -70,7 +70,7 @@ void DMATransmitter_Clear(DMATransmitter *transmitter)
 // Tick: burst mode transmit state machine.
 // Waits for DMA+TX enabled, rate-limits with dmaWaitTicks, sends all buffers.
 // ---------------------------------------------------------------------------
-void DMATransmitter_Tick(DMATransmitter *transmitter)
+void DMATransmitter_Tick(DMATransmitter *transmitter, uint32_t ticks)
 {
     if (!transmitter || !transmitter->dmaCB || !transmitter->hdlcDevice) return;
 
@@ -88,7 +88,7 @@ void DMATransmitter_Tick(DMATransmitter *transmitter)
                 hdlcData->txTransferControl.bits.enableTransmitterDMA) {
 
                 if (dmaCB->dmaWaitTicks > 0) {
-                    dmaCB->dmaWaitTicks--;
+                    dmaCB->dmaWaitTicks -= (ticks < (uint32_t)dmaCB->dmaWaitTicks) ? (int)ticks : dmaCB->dmaWaitTicks;
                 }
 
                 if (dmaCB->dmaWaitTicks == 0) {
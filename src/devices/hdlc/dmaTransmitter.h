@@ -57,7 +57,7 @@ typedef struct DMATransmitter {
 void DMATransmitter_Init(DMATransmitter *transmitter, void *com5025, DMAControlBlocks *dmaCB, struct Device *hdlcDevice);
 void DMATransmitter_Destroy(DMATransmitter *transmitter);
 void DMATransmitter_Clear(DMATransmitter *transmitter);
-void DMATransmitter_Tick(DMATransmitter *transmitter);
+void DMATransmitter_Tick(DMATransmitter *transmitter, uint32_t ticks);
 
 // State management
 void DMATransmitter_SetSenderState(DMATransmitter *transmitter, int senderState);
@@ -25,6 +25,7 @@
 
 #include "modem.h"
 #include "../devices_types.h"
+#include "../devices_protos.h"
 
 #if defined(__EMSCRIPTEN__)
 /* nd100wasm.c — ring buffer consumed by HDLC_PollTxFrame in the JS worker */
@@ -39,6 +40,7 @@ void HDLC_QueueTxFrame(int channel, const uint8_t *data, int length);
 #include "../../ndlib/net_compat.h"   /* sockets, poll, WSAStartup */
 #endif
 #include "../../cpu/cpu_types.h"       /* sleep_ms() — portable Sleep/nanosleep */
+#include "../../ndlib/hostwait.h"      /* HostWait_Signal() — wake the idle CPU */
 
 #ifdef MODEM_HAS_NETWORKING
 #  ifdef _WIN32
@@ -352,6 +354,7 @@ static void *server_worker(void *arg)
                 int n = recv(ND_SOCK_NATIVE(clientFd), (char *)buf, (int)sizeof(buf), 0);
                 if (n <= 0) break; // disconnect or error
                 queue_write_all(&modem->rxQueue, buf, n, &modem->rxDropped);
+                HostWait_Signal(); // Wake an idle CPU so Modem_Tick drains it
             }
 
             // Write TX queue -> socket
@@ -436,6 +439,7 @@ static void *client_worker(void *arg)
                 int n = recv(ND_SOCK_NATIVE(clientFd), (char *)buf, (int)sizeof(buf), 0);
                 if (n <= 0) break;
                 queue_write_all(&modem->rxQueue, buf, n, &modem->rxDropped);
+                HostWait_Signal(); // Wake an idle CPU so Modem_Tick drains it
             }
 
             if (fds.revents & POLLOUT) {
@@ -643,6 +647,51 @@ void Modem_SetCTS(ModemState *modem, bool value)
     if (modem->onClearToSend) modem->onClearToSend(modem->hdlcDevice, value);
 }
 
+// ============================================================================
+// Snapshot support — the line signals and counters. The connection, queues
+// and worker thread belong to this process and are left as they are.
+// ============================================================================
+
+#define MODEM_STATE_VERSION 1
+
+bool Modem_SaveState(ModemState *modem, FILE *f)
+{
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, MODEM_STATE_VERSION);
+    StateRecord_PutBool(&rec, modem->ringIndicator);
+    StateRecord_PutBool(&rec, modem->dataSetReady);
+    StateRecord_PutBool(&rec, modem->signalDetector);
+    StateRecord_PutBool(&rec, modem->clearToSend);
+    StateRecord_PutBool(&rec, modem->requestToSend);
+    StateRecord_PutBool(&rec, modem->dataTerminalReady);
+    StateRecord_PutU64(&rec, modem->bytesTx);
+    StateRecord_PutU64(&rec, modem->bytesRx);
+    StateRecord_PutU64(&rec, modem->rxDropped);
+    StateRecord_PutU64(&rec, modem->txDropped);
+    return StateRecord_Write(&rec, f);
+}
+
+// The HDLC device state restores its own view of the signals, so no callbacks are made
+bool Modem_LoadState(ModemState *modem, FILE *f)
+{
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, MODEM_STATE_VERSION))
+        return false;
+    modem->ringIndicator = StateRecord_GetBool(&rec);
+    modem->dataSetReady = StateRecord_GetBool(&rec);
+    modem->signalDetector = StateRecord_GetBool(&rec);
+    modem->clearToSend = StateRecord_GetBool(&rec);
+    modem->requestToSend = StateRecord_GetBool(&rec);
+    modem->dataTerminalReady = StateRecord_GetBool(&rec);
+    modem->bytesTx = StateRecord_GetU64(&rec);
+    modem->bytesRx = StateRecord_GetU64(&rec);
+    modem->rxDropped = StateRecord_GetU64(&rec);
+    modem->txDropped = StateRecord_GetU64(&rec);
+    return StateRecord_End(&rec);
+}
+
 // ============================================================================
 // Callback setup
 // ============================================================================
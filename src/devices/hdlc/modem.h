@@ -23,6 +23,7 @@
 #ifndef MODEM_H
 #define MODEM_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -139,6 +140,9 @@ void Modem_SetClearToSendCallback(ModemState *modem, ModemSignalCallback callbac
 void Modem_SetRequestToSendCallback(ModemState *modem, ModemSignalCallback callback);
 void Modem_SetDataTerminalReadyCallback(ModemState *modem, ModemSignalCallback callback);
 
+bool Modem_SaveState(ModemState *modem, FILE *f);
+bool Modem_LoadState(ModemState *modem, FILE *f);
+
 #if defined(__EMSCRIPTEN__)
 void Modem_SetWasmBridgeChannel(ModemState *modem, int channel);
 void Modem_StartWasmBridge(ModemState *modem);
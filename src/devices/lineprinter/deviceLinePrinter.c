@@ -153,6 +153,34 @@ static uint16_t LinePrinter_Ident(Device *self, uint16_t level)
     return 0;
 }
 
+// Snapshot: printer registers
+#define LINEPRINTER_STATE_VERSION 1
+
+static bool LinePrinter_SaveState(Device *self, FILE *f)
+{
+    LinePrinterData *data = (LinePrinterData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, LINEPRINTER_STATE_VERSION);
+    StateRecord_PutU8(&rec, data->characterBuffer);
+    StateRecord_PutU16(&rec, data->statusRegister.raw);
+    StateRecord_PutU16(&rec, data->controlWord.raw);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool LinePrinter_LoadState(Device *self, FILE *f)
+{
+    LinePrinterData *data = (LinePrinterData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, LINEPRINTER_STATE_VERSION))
+        return false;
+    data->characterBuffer = StateRecord_GetU8(&rec);
+    data->statusRegister.raw = StateRecord_GetU16(&rec);
+    data->controlWord.raw = StateRecord_GetU16(&rec);
+    return StateRecord_End(&rec);
+}
+
 Device* CreateLinePrinterDevice(uint8_t thumbwheel)
 {
     Device *dev = malloc(sizeof(Device));
@@ -202,6 +230,8 @@ Device* CreateLinePrinterDevice(uint8_t thumbwheel)
     dev->Read = LinePrinter_Read;
     dev->Write = LinePrinter_Write;
     dev->Ident = LinePrinter_Ident;
+    dev->SaveState = LinePrinter_SaveState;
+    dev->LoadState = LinePrinter_LoadState;
     dev->deviceData = data;
 
     printf("Line Printer device created: %s CODE[%o] ADDRESS[%o-%o]\n",
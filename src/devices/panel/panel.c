@@ -37,7 +37,8 @@
 
 #include "panel.h"
 
-struct display_panel *gPAP;
+// Panel processor state lives in the machine's device manager
+#define gPAP (gMachine->devices->panel)
 
 
 void setup_pap()
@@ -230,6 +231,16 @@ void ProcessTerminalLamp()
 	// read gLMP
 	gPANS = 0x0000;
 }
+// localtime() shares one buffer between threads; each machine may run on its own
+static struct tm *panel_localtime(const time_t *t, struct tm *buf)
+{
+#ifdef _WIN32
+	return localtime_s(buf, t) == 0 ? buf : NULL;
+#else
+	return localtime_r(t, buf);
+#endif
+}
+
 /// <summary>
 /// Calculate HW clock info
 ///
@@ -242,7 +253,8 @@ void UpdateMachineTime()
 	time_t now = time(NULL);	
 	
 	// Set base time to 1979-01-01 00:00:00 CET
-	struct tm *tm_base = localtime(&tbase);
+	struct tm tm_base_buf, tm_now_buf, tm_midnight_buf;
+	struct tm *tm_base = panel_localtime(&tbase, &tm_base_buf);
 	tm_base->tm_year = 79;  // Years since 1900, so 79 = 1979	
 	tm_base->tm_mon = 0;    // Months are 0-based, so 0 = January
 	tm_base->tm_mday = 1;   // Day of month
@@ -251,7 +263,7 @@ void UpdateMachineTime()
 	tm_base->tm_sec = 0;
 	tbase = mktime(tm_base);
 
-	struct tm *tm_now = localtime(&now);	
+	struct tm *tm_now = panel_localtime(&now, &tm_now_buf);
 	
 
 	// Sintran doesn't support Y2K (without patches) so stay in year before 2000...
@@ -261,7 +273,7 @@ void UpdateMachineTime()
 	now = mktime(tm_now);
 
 	time_t midnight = now;
-	struct tm *tm_midnight = localtime(&midnight);	
+	struct tm *tm_midnight = panel_localtime(&midnight, &tm_midnight_buf);	
 
 	// Calculate days difference from TBASE
 	int days_diff = (int)(difftime(now, tbase) / (24.0 * 3600.0));
@@ -279,7 +291,7 @@ void UpdateMachineTime()
 		midnight = mktime(tm_midnight);
 
 		// Now counting since noon
-		struct tm *tm_now = localtime(&now);	
+		struct tm *tm_now = panel_localtime(&now, &tm_now_buf);	
 		tm_now->tm_hour -= 12;;
 		now = mktime(tm_now);
 	}
@@ -175,6 +175,57 @@ static void PaperTape_Destroy(Device *self)
     }
 }
 
+// Snapshot: reader registers and the loaded tape, so a restored read continues where it was
+#define PAPERTAPE_STATE_VERSION 1
+
+static bool PaperTape_SaveState(Device *self, FILE *f)
+{
+    PaperTapeData *data = (PaperTapeData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, PAPERTAPE_STATE_VERSION);
+    StateRecord_PutU8(&rec, data->characterBuffer);
+    StateRecord_PutU16(&rec, data->statusRegister.raw);
+    StateRecord_PutU16(&rec, data->controlWord.raw);
+    StateRecord_PutU64(&rec, data->tapePosition);
+    StateRecord_PutBytes(&rec, data->tapeData, data->tapeData ? data->tapeLength : 0);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool PaperTape_LoadState(Device *self, FILE *f)
+{
+    PaperTapeData *data = (PaperTapeData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, PAPERTAPE_STATE_VERSION))
+        return false;
+    uint8_t characterBuffer = StateRecord_GetU8(&rec);
+    uint16_t status = StateRecord_GetU16(&rec);
+    uint16_t control = StateRecord_GetU16(&rec);
+    uint64_t position = StateRecord_GetU64(&rec);
+
+    size_t length;
+    const uint8_t *bytes = StateRecord_GetData(&rec, &length);
+    uint8_t *tape = NULL;
+    if (length > 0) {
+        tape = malloc(length);
+        if (tape) memcpy(tape, bytes, length);
+    }
+    if (!StateRecord_End(&rec) || (length > 0 && !tape) || position > length) {
+        free(tape);
+        return false;
+    }
+
+    free(data->tapeData);
+    data->characterBuffer = characterBuffer;
+    data->statusRegister.raw = status;
+    data->controlWord.raw = control;
+    data->tapeData = tape;
+    data->tapeLength = length;
+    data->tapePosition = (size_t)position;
+    return true;
+}
+
 // Load tape data into the reader's memory buffer
 void PaperTape_LoadTape(Device *self, const uint8_t *data, size_t length)
 {
@@ -249,6 +300,8 @@ Device* CreatePaperTapeDevice(uint8_t thumbwheel)
     dev->Read = PaperTape_Read;
     dev->Write = PaperTape_Write;
     dev->Ident = PaperTape_Ident;
+    dev->SaveState = PaperTape_SaveState;
+    dev->LoadState = PaperTape_LoadState;
     dev->Destroy = PaperTape_Destroy;
     dev->deviceData = data;
 
@@ -227,6 +227,65 @@ const uint8_t* PaperTapeWriter_GetTapeData(Device *self, size_t *length)
     return data->tapeBuffer;
 }
 
+// Snapshot: punch registers and the bytes punched so far
+#define PAPERTAPEWRITER_STATE_VERSION 1
+
+// IO delay callbacks by snapshot ID
+static const IODelayCallbackId paperTapeWriterDelayCallbacks[] = {
+    { 1, PunchEnd },
+    { 0, NULL }
+};
+
+static bool PaperTapeWriter_SaveState(Device *self, FILE *f)
+{
+    PaperTapeWriterData *data = (PaperTapeWriterData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, PAPERTAPEWRITER_STATE_VERSION);
+    StateRecord_PutU8(&rec, data->characterBuffer);
+    StateRecord_PutU16(&rec, data->statusRegister.raw);
+    StateRecord_PutU16(&rec, data->controlWord.raw);
+    StateRecord_PutBool(&rec, data->tapeBuffer != NULL);
+    StateRecord_PutU64(&rec, data->tapeCapacity);
+    StateRecord_PutBytes(&rec, data->tapeBuffer, data->tapeBuffer ? data->tapePosition : 0);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool PaperTapeWriter_LoadState(Device *self, FILE *f)
+{
+    PaperTapeWriterData *data = (PaperTapeWriterData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, PAPERTAPEWRITER_STATE_VERSION))
+        return false;
+    uint8_t characterBuffer = StateRecord_GetU8(&rec);
+    uint16_t status = StateRecord_GetU16(&rec);
+    uint16_t control = StateRecord_GetU16(&rec);
+    bool hasBuffer = StateRecord_GetBool(&rec);
+    uint64_t capacity = StateRecord_GetU64(&rec);
+
+    size_t position;
+    const uint8_t *punched = StateRecord_GetData(&rec, &position);
+    uint8_t *buffer = NULL;
+    if (hasBuffer && rec.ok && capacity >= position && capacity <= SIZE_MAX) {
+        buffer = malloc((size_t)capacity);
+        if (buffer && punched) memcpy(buffer, punched, position);
+    }
+    if (!StateRecord_End(&rec) || (hasBuffer && !buffer)) {
+        free(buffer);
+        return false;
+    }
+
+    free(data->tapeBuffer);
+    data->characterBuffer = characterBuffer;
+    data->statusRegister.raw = status;
+    data->controlWord.raw = control;
+    data->tapeBuffer = buffer;
+    data->tapePosition = buffer ? position : 0;
+    data->tapeCapacity = buffer ? (size_t)capacity : 0;
+    return true;
+}
+
 Device* CreatePaperTapeWriterDevice(uint8_t thumbwheel)
 {
     Device *dev = malloc(sizeof(Device));
@@ -274,6 +333,9 @@ Device* CreatePaperTapeWriterDevice(uint8_t thumbwheel)
     dev->Read = PaperTapeWriter_Read;
     dev->Write = PaperTapeWriter_Write;
     dev->Ident = PaperTapeWriter_Ident;
+    dev->ioDelayCallbacks = paperTapeWriterDelayCallbacks;
+    dev->SaveState = PaperTapeWriter_SaveState;
+    dev->LoadState = PaperTapeWriter_LoadState;
     dev->Destroy = PaperTapeWriter_Destroy;
     dev->deviceData = data;
 
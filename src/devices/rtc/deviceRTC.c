@@ -40,19 +40,22 @@ static void RTC_Reset(Device *self) {
     if (!data) return;
 
     // Clear all registers and status
-    data->rtcCounter = 0;
+    data->nextClockPulse = instr_counter;
     data->divisionNumberN = TICKS_20MS;
     data->register1 = 0;
 
     data->statusRegister.raw = 0;
     data->controlRegister.raw = 0;
+
+    Device_ScheduleTick(self, 0);
 }
 
 static void RTC_ClearClockTicks(Device *self) {
     RTCData *data = (RTCData *)self->deviceData;
     if (!data) return;
 
-    data->rtcCounter = data->divisionNumberN;
+    data->nextClockPulse = instr_counter + data->divisionNumberN;
+    Device_ScheduleTick(self, data->divisionNumberN);
 }
 
 static uint16_t RTC_Tick(Device *self) {
@@ -64,16 +67,18 @@ static uint16_t RTC_Tick(Device *self) {
     // Process I/O delays
     Device_TickIODelay(self);
 
-    // Count down the timer
-    data->rtcCounter--;
-
-    if (data->rtcCounter <= 0) {
+    // Clock pulse due?
+    if (instr_counter >= data->nextClockPulse) {
         data->statusRegister.bits.readyForTransfer = true;
         if (data->statusRegister.bits.interruptEnabled) {
             Device_SetInterruptStatus(self, true, self->interruptLevel);
         }
         RTC_ClearClockTicks(self);
     }
+    else {
+        // Ticked early (after an IOX); keep the pulse scheduled
+        Device_ScheduleTick(self, data->nextClockPulse - instr_counter);
+    }
 
     return self->interruptBits;
 }
@@ -87,7 +92,7 @@ static uint16_t RTC_Read(Device *self, uint32_t address) {
 
     switch (reg) {
         case RTC_READ_DATA_REGISTER:
-            value = (uint16_t)data->rtcCounter;
+            value = (data->nextClockPulse > instr_counter) ? (uint16_t)(data->nextClockPulse - instr_counter) : 0;
             break;
 
         case RTC_READ_STATUS:
@@ -148,7 +153,7 @@ static void RTC_Write(Device *self, uint32_t address, uint16_t value) {
 
             // Restart clock if requested
             if (data->controlRegister.bits.restartClock) {            
-                data->rtcCounter = data->divisionNumberN;
+                RTC_ClearClockTicks(self);
                 data->clockCountingStarted = true;
             }
             break;
@@ -183,6 +188,44 @@ static uint16_t RTC_Ident(Device *self, uint16_t level) {
     return 0;
 }
 
+// Snapshot: clock registers and the time of the next pulse
+#define RTC_STATE_VERSION 1
+
+static bool RTC_SaveState(Device *self, FILE *f) {
+    RTCData *data = (RTCData *)self->deviceData;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, RTC_STATE_VERSION);
+    StateRecord_PutU64(&rec, data->nextClockPulse);
+    StateRecord_PutInt(&rec, data->divisionNumberN);
+    StateRecord_PutU16(&rec, data->register1);
+    StateRecord_PutBool(&rec, data->externalHoldEnabled);
+    StateRecord_PutBool(&rec, data->externalHoldSignal);
+    StateRecord_PutBool(&rec, data->clockCountingStarted);
+    StateRecord_PutU16(&rec, data->controlRegister.raw);
+    StateRecord_PutU16(&rec, data->statusRegister.raw);
+    StateRecord_PutInt(&rec, data->selectedFrequency);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool RTC_LoadState(Device *self, FILE *f) {
+    RTCData *data = (RTCData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, RTC_STATE_VERSION))
+        return false;
+    data->nextClockPulse = StateRecord_GetU64(&rec);
+    data->divisionNumberN = StateRecord_GetInt(&rec);
+    data->register1 = StateRecord_GetU16(&rec);
+    data->externalHoldEnabled = StateRecord_GetBool(&rec);
+    data->externalHoldSignal = StateRecord_GetBool(&rec);
+    data->clockCountingStarted = StateRecord_GetBool(&rec);
+    data->controlRegister.raw = StateRecord_GetU16(&rec);
+    data->statusRegister.raw = StateRecord_GetU16(&rec);
+    data->selectedFrequency = (RTCFrequency)StateRecord_GetInt(&rec);
+    return StateRecord_End(&rec);
+}
+
 Device* CreateRTCDevice(uint8_t thumbwheel) {
     Device *dev = malloc(sizeof(Device));
     if (!dev) return NULL;
@@ -235,6 +278,8 @@ Device* CreateRTCDevice(uint8_t thumbwheel) {
     dev->Read = RTC_Read;
     dev->Write = RTC_Write;
     dev->Ident = RTC_Ident;
+    dev->SaveState = RTC_SaveState;
+    dev->LoadState = RTC_LoadState;
     dev->deviceData = data;
 
     printf("RTC device created: %s\n", dev->memoryName);
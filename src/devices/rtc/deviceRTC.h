@@ -76,7 +76,7 @@ typedef union {
 
 // RTC device data structure
 typedef struct {
-    int rtcCounter;
+    uint64_t nextClockPulse;    // instr_counter at which the next clock pulse occurs
     int divisionNumberN;
     uint16_t register1;
         
@@ -43,7 +43,10 @@ static void ExecuteGO(Device *self);
 static long ConvertCHStoLBA(ControllerRegs *regs, int cylinder, int head, int sector);
 static uint32_t IncrementCoreAddress(ControllerRegs *regs);
 static uint32_t DecrementWordCounter(ControllerRegs *regs);
+static void AdvanceTransfer(ControllerRegs *regs, uint32_t words);
 static bool SMDReadEnd(Device *self, int drive);
+static bool SMDReadTransferEnd(Device *self, int drive);
+static bool SMDWriteTransferEnd(Device *self, int drive);
 
 static const char *SMD_OpName(DeviceOperation op) {
     switch (op) {
@@ -686,6 +689,8 @@ static int SMD_Boot(Device *self, uint16_t device_id)
 
     if ((!self->blockCallbacks.readFunc) || (!self->blockCallbacks.writeFunc)) return -1; // Need callbacks hooked up
 
+    BlockIO_Wait(self); // The image must not change under the boot read
+
     regs->selectedUnit = 0;
     regs->selectedDisk = &regs->disks[regs->selectedUnit];
 
@@ -740,14 +745,8 @@ static int SMD_Boot(Device *self, uint16_t device_id)
         }
     }
 
-    for (int i = 0; i < wordCounter; i++)
-    {
-        // Read word from disk buffer
-        uint32_t readData = Device_IO_BufferReadWord(self, buffer, i);
-
-        // Write to memory (DMA)
-        Device_DMAWrite(i, (uint16_t)readData);
-    }
+    // Write to memory (DMA)
+    Device_DMAWriteBlock(coreAddress, buffer, wordCounter);
 
     free(buffer);
 
@@ -776,6 +775,9 @@ static void ExecuteGO(Device *self)
         return;
     ControllerRegs *regs = &data->regs;
 
+    // The synchronous operations below must not race a transfer still on the I/O workers
+    BlockIO_Wait(self);
+
     // Get information on file size and readonly
     if (self->blockCallbacks.diskInfoFunc)
     {
@@ -893,6 +895,13 @@ static void ExecuteGO(Device *self)
             return;
         }
 
+        // Let the I/O workers read it, SMDReadTransferEnd moves it to memory
+        if (BlockIO_Submit(self, false, buffer, blockCounter, lba, data->regs.selectedDisk->unit))
+        {
+            Device_QueueBlockIODelay(self, IODELAY_HDD_SMD, (IODelayedCallback)SMDReadTransferEnd, data->regs.selectedDisk->unit, self->interruptLevel);
+            break;
+        }
+
         // Read all blocks from SMD disk file into buffer
         blocksRead = self->blockCallbacks.readFunc(self, buffer, blockCounter, lba, data->regs.selectedDisk->unit);
         if ((blocksRead < 0) || (blocksRead != blockCounter))
@@ -903,17 +912,8 @@ static void ExecuteGO(Device *self)
         }
 
         // DMA transfer to memory
-        while (wordCounter > 0)
-        {
-            // Read word from disk
-            uint32_t readData = Device_IO_BufferReadWord(self, buffer, buffer_ptr++);
-
-            // Write to memory (DMA)
-            Device_DMAWrite(coreAddress, (uint16_t)readData);
-
-            coreAddress = IncrementCoreAddress(regs);
-            wordCounter = DecrementWordCounter(regs);
-        }
+        Device_DMAWriteBlock(coreAddress, buffer, wordCounter);
+        AdvanceTransfer(regs, wordCounter);
 
         free(buffer);
         Device_QueueIODelay(self, IODELAY_HDD_SMD, (IODelayedCallback)SMDReadEnd, data->regs.selectedDisk->unit, self->interruptLevel);
@@ -933,27 +933,14 @@ static void ExecuteGO(Device *self)
         }
 
         // DMA transfer from RAM to buffer
-        while (wordCounter > 0)
-        {
-            // Read from memory (DMA)
-            uint32_t readData = Device_DMARead(coreAddress);
+        Device_DMAReadBlock(coreAddress, buffer, wordCounter);
+        AdvanceTransfer(regs, wordCounter);
 
-            if (readData < 0)
-            {
-                HandleError(self, DISK_ERR_READ_ERROR); // DMA READ ERROR??
-                free(buffer);
-                return;
-            }
-            // Write word to disk buffer
-            if (Device_IO_BufferWriteWord(self, buffer, buffer_ptr++, (uint16_t)readData) < 0)
-            {
-                HandleError(self, DISK_ERR_READ_ERROR); // WRITE_ERROR
-                free(buffer);
-                return;
-            }
-
-            coreAddress = IncrementCoreAddress(regs);
-            wordCounter = DecrementWordCounter(regs);
+        // Let the I/O workers write it
+        if (BlockIO_Submit(self, true, buffer, blockCounter, lba, data->regs.selectedDisk->unit))
+        {
+            Device_QueueBlockIODelay(self, IODELAY_HDD_SMD, (IODelayedCallback)SMDWriteTransferEnd, data->regs.selectedDisk->unit, self->interruptLevel);
+            break;
         }
 
         // Write all blocks to SMD disk file from buffer
@@ -1143,6 +1130,46 @@ static bool SMDReadEnd(Device *self, int drive)
     return false;
 }
 
+// Completion of a read done by the I/O workers: move the data to memory
+static bool SMDReadTransferEnd(Device *self, int drive)
+{
+    SMDData *data = (SMDData *)self->deviceData;
+    if (!data)
+        return false;
+    ControllerRegs *regs = &data->regs;
+
+    uint8_t *buffer;
+    if (BlockIO_Finish(self, &buffer) < 0)
+    {
+        HandleError(self, DISK_ERR_READ_ERROR); // READ_ERROR
+        free(buffer);
+        return false;
+    }
+
+    uint32_t wordCounter = (uint32_t)(regs->wordCounterHI << 16 | regs->wordCounter);
+    uint32_t coreAddress = (uint32_t)(regs->coreAddressHiBits << 16 | regs->coreAddress);
+    Device_DMAWriteBlock(coreAddress, buffer, wordCounter);
+    AdvanceTransfer(regs, wordCounter);
+    free(buffer);
+
+    return SMDReadEnd(self, drive);
+}
+
+// Completion of a write done by the I/O workers
+static bool SMDWriteTransferEnd(Device *self, int drive)
+{
+    uint8_t *buffer;
+    int blocksWrite = BlockIO_Finish(self, &buffer);
+    free(buffer);
+    if (blocksWrite < 0)
+    {
+        HandleError(self, DISK_ERR_WRITE_ERROR);
+        return false;
+    }
+
+    return SMDReadEnd(self, drive);
+}
+
 static void ClearFlipFlops(ControllerRegs *regs)
 {
     regs->wcwFlipFlop = false;
@@ -1256,6 +1283,165 @@ static uint32_t DecrementWordCounter(ControllerRegs *regs)
     return counter;
 }
 
+// Move the core address and word counter past a block of transferred words
+static void AdvanceTransfer(ControllerRegs *regs, uint32_t words)
+{
+    if (!regs)
+        return;
+    uint32_t address = ((regs->coreAddressHiBits << 16) | regs->coreAddress) + words;
+    regs->coreAddress = address & 0xFFFF;
+    regs->coreAddressHiBits = (address >> 16) & 0xFF;
+
+    uint32_t counter = ((regs->wordCounterHI << 16) | regs->wordCounter) - words;
+    regs->wordCounter = counter & 0xFFFF;
+    regs->wordCounterHI = (counter >> 16) & 0xFF;
+}
+
+// Snapshot: controller data, the per unit disk info, and the selected disk as a unit index
+#define SMD_STATE_VERSION 1
+
+// IO delay callbacks by snapshot ID
+static const IODelayCallbackId smdDelayCallbacks[] = {
+    { 1, (IODelayedCallback)SMDReadEnd },
+    { 2, (IODelayedCallback)SMDReadTransferEnd },
+    { 3, (IODelayedCallback)SMDWriteTransferEnd },
+    { 0, NULL }
+};
+
+static bool SMD_SaveState(Device *self, FILE *f)
+{
+    SMDData *data = (SMDData *)self->deviceData;
+    ControllerRegs *regs = &data->regs;
+    StateRecord rec;
+
+    StateRecord_Begin(&rec, SMD_STATE_VERSION);
+    StateRecord_PutWords(&rec, data->dataBuffer, 1024);
+    StateRecord_PutU16(&rec, (uint16_t)data->loadDriveAddress);
+    StateRecord_PutU16(&rec, data->sector);
+    StateRecord_PutU16(&rec, data->track);
+    StateRecord_PutU16(&rec, data->bufferPointer);
+    StateRecord_PutInt(&rec, data->selectedDrive);
+    StateRecord_PutInt(&rec, data->bytes_pr_sector);
+    StateRecord_PutInt(&rec, data->sectors_pr_track);
+    StateRecord_PutU8(&rec, data->testByte);
+    StateRecord_PutBool(&rec, data->sectorAutoIncrement);
+    StateRecord_PutInt(&rec, data->testmodeByte);
+    StateRecord_PutU16(&rec, data->statusRegister.raw);
+    StateRecord_PutU16(&rec, data->controlRegister.raw);
+    StateRecord_PutU16(&rec, data->errorRegister.raw);
+    StateRecord_PutU16(&rec, data->driveAddress.raw);
+    StateRecord_PutU16(&rec, data->seekCondition.raw);
+    StateRecord_PutInt(&rec, data->controllerType);
+
+    StateRecord_PutBool(&rec, regs->hasFlipFlops);
+    StateRecord_PutBool(&rec, regs->wcwFlipFlop);
+    StateRecord_PutBool(&rec, regs->wcrFlipFlop);
+    StateRecord_PutBool(&rec, regs->wcEccwFlipFlop);
+    StateRecord_PutBool(&rec, regs->mawFlipFlop);
+    StateRecord_PutBool(&rec, regs->marFlipFlop);
+    StateRecord_PutU8(&rec, regs->selectedUnit);
+    StateRecord_PutU16(&rec, regs->blockAddressI);
+    StateRecord_PutU16(&rec, regs->blockAddressII);
+    StateRecord_PutU16(&rec, regs->coreAddress);
+    StateRecord_PutU16(&rec, regs->coreAddressHiBits);
+    StateRecord_PutU16(&rec, regs->wordCounter);
+    StateRecord_PutU16(&rec, regs->wordCounterHI);
+    StateRecord_PutU16(&rec, regs->eccControl);
+    StateRecord_PutU16(&rec, regs->eccControlHI);
+    StateRecord_PutU16(&rec, regs->eccPatternRegister);
+    StateRecord_PutU16(&rec, regs->eccCount);
+
+    StateRecord_PutInt(&rec, regs->maxUnits);
+    for (int unit = 0; unit < regs->maxUnits; unit++)
+    {
+        DiskInfo *disk = &regs->disks[unit];
+        StateRecord_PutBool(&rec, disk->diskUnitNotReady);
+        StateRecord_PutBool(&rec, disk->onCylinder);
+        StateRecord_PutBool(&rec, disk->diskIsWriteProtected);
+        StateRecord_PutInt(&rec, disk->bytesPrSector);
+        StateRecord_PutInt(&rec, disk->headsPrCylinder);
+        StateRecord_PutInt(&rec, disk->sectorsPrTrack);
+        StateRecord_PutInt(&rec, disk->maxCylinders);
+        StateRecord_PutInt(&rec, disk->maxWordCount);
+        StateRecord_PutU8(&rec, disk->unit);
+        StateRecord_PutInt(&rec, disk->diskType);
+        StateRecord_PutU64(&rec, (uint64_t)disk->diskFileSize);
+        StateRecord_PutBool(&rec, disk->readOnly);
+    }
+    StateRecord_PutInt(&rec, regs->selectedDisk ? (int32_t)(regs->selectedDisk - regs->disks) : -1);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool SMD_LoadState(Device *self, FILE *f)
+{
+    SMDData *data = (SMDData *)self->deviceData;
+    ControllerRegs *regs = &data->regs;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, SMD_STATE_VERSION))
+        return false;
+    StateRecord_GetWords(&rec, data->dataBuffer, 1024);
+    data->loadDriveAddress = (int16_t)StateRecord_GetU16(&rec);
+    data->sector = StateRecord_GetU16(&rec);
+    data->track = StateRecord_GetU16(&rec);
+    data->bufferPointer = StateRecord_GetU16(&rec);
+    data->selectedDrive = StateRecord_GetInt(&rec);
+    data->bytes_pr_sector = StateRecord_GetInt(&rec);
+    data->sectors_pr_track = StateRecord_GetInt(&rec);
+    data->testByte = StateRecord_GetU8(&rec);
+    data->sectorAutoIncrement = StateRecord_GetBool(&rec);
+    data->testmodeByte = StateRecord_GetInt(&rec);
+    data->statusRegister.raw = StateRecord_GetU16(&rec);
+    data->controlRegister.raw = StateRecord_GetU16(&rec);
+    data->errorRegister.raw = StateRecord_GetU16(&rec);
+    data->driveAddress.raw = StateRecord_GetU16(&rec);
+    data->seekCondition.raw = StateRecord_GetU16(&rec);
+    data->controllerType = (ControllerType)StateRecord_GetInt(&rec);
+
+    regs->hasFlipFlops = StateRecord_GetBool(&rec);
+    regs->wcwFlipFlop = StateRecord_GetBool(&rec);
+    regs->wcrFlipFlop = StateRecord_GetBool(&rec);
+    regs->wcEccwFlipFlop = StateRecord_GetBool(&rec);
+    regs->mawFlipFlop = StateRecord_GetBool(&rec);
+    regs->marFlipFlop = StateRecord_GetBool(&rec);
+    regs->selectedUnit = StateRecord_GetU8(&rec);
+    regs->blockAddressI = StateRecord_GetU16(&rec);
+    regs->blockAddressII = StateRecord_GetU16(&rec);
+    regs->coreAddress = StateRecord_GetU16(&rec);
+    regs->coreAddressHiBits = StateRecord_GetU16(&rec);
+    regs->wordCounter = StateRecord_GetU16(&rec);
+    regs->wordCounterHI = StateRecord_GetU16(&rec);
+    regs->eccControl = StateRecord_GetU16(&rec);
+    regs->eccControlHI = StateRecord_GetU16(&rec);
+    regs->eccPatternRegister = StateRecord_GetU16(&rec);
+    regs->eccCount = StateRecord_GetU16(&rec);
+
+    // The units come from the configured controller, the snapshot must have as many
+    if (StateRecord_GetInt(&rec) != regs->maxUnits)
+        rec.ok = false;
+    for (int unit = 0; rec.ok && unit < regs->maxUnits; unit++)
+    {
+        DiskInfo *disk = &regs->disks[unit];
+        disk->diskUnitNotReady = StateRecord_GetBool(&rec);
+        disk->onCylinder = StateRecord_GetBool(&rec);
+        disk->diskIsWriteProtected = StateRecord_GetBool(&rec);
+        disk->bytesPrSector = StateRecord_GetInt(&rec);
+        disk->headsPrCylinder = StateRecord_GetInt(&rec);
+        disk->sectorsPrTrack = StateRecord_GetInt(&rec);
+        disk->maxCylinders = StateRecord_GetInt(&rec);
+        disk->maxWordCount = StateRecord_GetInt(&rec);
+        disk->unit = StateRecord_GetU8(&rec);
+        disk->diskType = (DiskType)StateRecord_GetInt(&rec);
+        disk->diskFileSize = (long)StateRecord_GetU64(&rec);
+        disk->readOnly = StateRecord_GetBool(&rec);
+    }
+    int32_t selected = StateRecord_GetInt(&rec);
+    if (selected >= regs->maxUnits)
+        rec.ok = false;
+    regs->selectedDisk = (rec.ok && selected >= 0) ? &regs->disks[selected] : NULL;
+    return StateRecord_End(&rec);
+}
+
 Device *CreateSMDDevice(uint8_t thumbwheel)
 {
     Device *dev = (Device *)malloc(sizeof(Device));
@@ -1297,6 +1483,9 @@ Device *CreateSMDDevice(uint8_t thumbwheel)
     dev->Tick = SMD_Tick;
     dev->Reset = SMD_Reset;
     dev->Ident = SMD_Ident;
+    dev->ioDelayCallbacks = smdDelayCallbacks;
+    dev->SaveState = SMD_SaveState;
+    dev->LoadState = SMD_LoadState;
     dev->Boot = SMD_Boot;
     dev->Destroy = SMD_Destroy;
     // Initialize device state
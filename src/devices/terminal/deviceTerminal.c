@@ -29,6 +29,7 @@
 #include "../devices_protos.h"
 
 #include "deviceTerminal.h"
+#include "../../ndlib/hostwait.h"
 
 
 // Device definitions array
@@ -125,6 +126,9 @@ static void Terminal_Reset(Device *self)
     // Clear other
     // data->noCarrier = false;
     // data->uartInputBuf = 0;
+
+    // Start polling the input queue
+    Device_ScheduleTick(self, 0);
 }
 
 static uint16_t Terminal_Tick(Device *self)
@@ -139,12 +143,10 @@ static uint16_t Terminal_Tick(Device *self)
     // Process I/O delays
     Device_TickIODelay(self);
 
-    // Check for new incoming characters
-
-    data->checkInputQueueTick++;
-    if (data->checkInputQueueTick > MAX_TICKS)
+    // Check for new incoming characters (polled, as keys are queued from outside the CPU loop)
+    if (instr_counter >= data->nextInputCheck)
     {
-        data->checkInputQueueTick = 0;
+        data->nextInputCheck = instr_counter + MAX_TICKS + 1;
 
         if ((data->inputQueue.count > 0) &&
             (!data->inputStatus.bits.deviceReadyForTransfer) &&
@@ -192,6 +194,11 @@ static uint16_t Terminal_Tick(Device *self)
             Device_SetInterruptStatus(self, data->inputStatus.bits.interruptEnabled && data->inputStatus.bits.deviceReadyForTransfer, 12);
         }
     }
+    // Queued input is an event; an empty queue is only polled, Terminal_QueueKeyCode wakes an idle CPU
+    if (data->inputQueue.count > 0)
+        Device_ScheduleTick(self, data->nextInputCheck - instr_counter);
+    else
+        Device_SchedulePoll(self, data->nextInputCheck - instr_counter);
 
     return self->interruptBits;
 }
@@ -377,7 +384,7 @@ static bool WriteEnd(void *context, int param)
         return false;
 
     data->outputStatus.bits.readyForTransfer = true;
-    data->checkInputQueueTick = 0; // Make sure input check is delayed
+    data->nextInputCheck = instr_counter + MAX_TICKS + 1; // Make sure input check is delayed
 
     Device_SetInterruptStatus(self,
                               data->outputStatus.bits.interruptEnabled && data->outputStatus.bits.readyForTransfer,
@@ -408,6 +415,9 @@ void Terminal_QueueKeyCode(Device *self, uint8_t keycode)
     data->inputQueue.tail = (data->inputQueue.tail + 1) % TERMINAL_QUEUE_SIZE;
     data->inputQueue.count++;
 
+    // Keys are queued from the main loop or telnet threads; end an idle sleep
+    HostWait_Signal();
+
     // printf("Terminal_QueueKeyCode: %c, count: %ld IRQ[%d]\n", (char)keycode, data->inputQueue.count, data->inputStatus.bits.interruptEnabled);
 }
 
@@ -418,6 +428,65 @@ static void Terminal_InputFunction(Device *device, char c) {
 }
 
 
+// Snapshot: UART registers and the keys queued but not yet read, oldest first
+#define TERMINAL_STATE_VERSION 1
+
+// IO delay callbacks by snapshot ID
+static const IODelayCallbackId terminalDelayCallbacks[] = {
+    { 1, WriteEnd },
+    { 0, NULL }
+};
+
+static bool Terminal_SaveState(Device *self, FILE *f)
+{
+    TerminalData *data = (TerminalData *)self->deviceData;
+    uint8_t keys[TERMINAL_QUEUE_SIZE];
+    size_t count = data->inputQueue.count;
+    StateRecord rec;
+
+    for (size_t i = 0; i < count; i++)
+        keys[i] = data->inputQueue.buffer[(data->inputQueue.head + i) % TERMINAL_QUEUE_SIZE];
+
+    StateRecord_Begin(&rec, TERMINAL_STATE_VERSION);
+    StateRecord_PutBool(&rec, data->noCarrier);
+    StateRecord_PutU16(&rec, data->uartInputBuf);
+    StateRecord_PutU64(&rec, data->nextInputCheck);
+    StateRecord_PutBytes(&rec, keys, count);
+    StateRecord_PutU16(&rec, data->inputStatus.raw);
+    StateRecord_PutU16(&rec, data->inputControl.raw);
+    StateRecord_PutU16(&rec, data->outputStatus.raw);
+    StateRecord_PutU16(&rec, data->outputControl.raw);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool Terminal_LoadState(Device *self, FILE *f)
+{
+    TerminalData *data = (TerminalData *)self->deviceData;
+    StateRecord rec;
+
+    if (!StateRecord_Read(&rec, f, TERMINAL_STATE_VERSION))
+        return false;
+    data->noCarrier = StateRecord_GetBool(&rec);
+    data->uartInputBuf = StateRecord_GetU16(&rec);
+    data->nextInputCheck = StateRecord_GetU64(&rec);
+
+    size_t count;
+    const uint8_t *keys = StateRecord_GetData(&rec, &count);
+    if (count > TERMINAL_QUEUE_SIZE)
+        rec.ok = false;
+    else if (keys)
+        memcpy(data->inputQueue.buffer, keys, count);
+    data->inputQueue.head = 0;
+    data->inputQueue.tail = count % TERMINAL_QUEUE_SIZE;
+    data->inputQueue.count = rec.ok ? count : 0;
+
+    data->inputStatus.raw = StateRecord_GetU16(&rec);
+    data->inputControl.raw = StateRecord_GetU16(&rec);
+    data->outputStatus.raw = StateRecord_GetU16(&rec);
+    data->outputControl.raw = StateRecord_GetU16(&rec);
+    return StateRecord_End(&rec);
+}
+
 Device *CreateTerminalDevice(uint8_t thumbwheel)
 {
     Device *dev = malloc(sizeof(Device));
@@ -468,6 +537,9 @@ Device *CreateTerminalDevice(uint8_t thumbwheel)
     dev->Read = Terminal_Read;
     dev->Write = Terminal_Write;
     dev->Ident = Terminal_Ident;
+    dev->ioDelayCallbacks = terminalDelayCallbacks;
+    dev->SaveState = Terminal_SaveState;
+    dev->LoadState = Terminal_LoadState;
     dev->deviceData = data;
 
     // Initialize input queue
@@ -130,7 +130,7 @@ typedef struct {
     bool noCarrier;
     // UART input buffer
     uint16_t uartInputBuf;
-    int checkInputQueueTick;    
+    uint64_t nextInputCheck;    // instr_counter at which the input queue is checked next
 
     // Add input queue
     CircularBuffer inputQueue;
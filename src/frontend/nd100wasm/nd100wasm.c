@@ -79,6 +79,7 @@ static int initialized = 0;
 static int running = 0;
 static int js_terminal_handler_enabled = 0;
 static int dbg_paused = 0;
+static double lastWritebackTime = 0;    // emscripten_get_now() of the last drive cache write-back
 
 // Print job manager for PDF generation in WASM
 static PrintJob *wasmPrintJob = NULL;
@@ -532,6 +533,23 @@ EMSCRIPTEN_EXPORT void Step(int steps)
         return;
     }        
     machine_run(steps);
+
+    // Gateway and OPFS blocks written by the OS go out in batches, not one round trip each
+    double now = emscripten_get_now();
+    if (now - lastWritebackTime >= DRIVE_CACHE_WRITEBACK_SECONDS * 1000.0) {
+        machine_writeback_drives();
+        lastWritebackTime = now;
+    }
+}
+
+// Write the blocks held in the drive cache to the OPFS and gateway images now,
+// e.g. before the page goes away
+EMSCRIPTEN_EXPORT void FlushDrives(void)
+{
+    if (!initialized) {
+        return;
+    }
+    machine_flush_drives();
 }
 
 // Stop the emulation
@@ -547,6 +565,35 @@ EMSCRIPTEN_EXPORT int IsInitialized(void)
     return initialized;
 }
 
+// Save the machine state to a MEMFS file (e.g. "/SNAPSHOT.SNP"). Returns 0 on success.
+EMSCRIPTEN_EXPORT int SaveSnapshot(const char *path)
+{
+    if (!initialized || !path) {
+        return -1;
+    }
+    return machine_save_snapshot(path) ? 0 : -1;
+}
+
+// Append the memory pages and state changed since the last save or restore to the
+// snapshot file. Writes a full snapshot if 'path' is not the file last used.
+EMSCRIPTEN_EXPORT int CheckpointSnapshot(const char *path)
+{
+    if (!initialized || !path) {
+        return -1;
+    }
+    return machine_checkpoint_snapshot(path) ? 0 : -1;
+}
+
+// Restore the machine state from a MEMFS file written by SaveSnapshot().
+// Mounted drives must match the ones in use when the snapshot was taken.
+EMSCRIPTEN_EXPORT int RestoreSnapshot(const char *path)
+{
+    if (!initialized || !path) {
+        return -1;
+    }
+    return machine_restore_snapshot(path) ? 0 : -1;
+}
+
 // Remount a floppy drive (close old FILE*, re-open from MEMFS)
 // Unit N uses "/FLOPPYN.IMG" (absolute path for MEMFS compatibility)
 EMSCRIPTEN_EXPORT int RemountFloppy(int unit)
@@ -673,6 +720,8 @@ EMSCRIPTEN_EXPORT int Dbg_ReadSMDSectors(int unit, int lba, int count)
     MountedDriveInfo_t *entry = &drives[unit];
     if (!entry->is_mounted) return 0;
 
+    machine_writeback_drives();
+
     size_t sector_size = entry->block_size ? entry->block_size : 1024;
     size_t byte_offset = (size_t)lba * sector_size;
     size_t byte_count  = (size_t)count * sector_size;
@@ -1212,7 +1261,9 @@ EMSCRIPTEN_EXPORT void Dbg_SetRegX(int val)  { gX   = (ushort)(val & 0xFFFF); }
 EMSCRIPTEN_EXPORT void Dbg_SetSTS(int val)   {
     /* STS MSB is shared, LSB is per-level */
     gReg->reg_STS = (ushort)(val & 0xFF00);
-    gReg->reg[gPIL][_STS] = (ushort)(val & 0x00FF);
+    SyncLevelRegs();
+    gLevelRegs[_STS] = (ushort)(val & 0x00FF);
+    FlushTLB(); /* PONI/SEXI may have changed */
 }
 
 // --- Register access for any runlevel ---
@@ -1307,7 +1358,7 @@ EMSCRIPTEN_EXPORT void Dbg_WriteMemory(int addr, int val)
 
 EMSCRIPTEN_EXPORT int Dbg_DumpPhysicalMemory(int wordCount)
 {
-    if (wordCount <= 0 || wordCount > (int)(sizeof(VolatileMemory) / sizeof(ushort)))
+    if (wordCount <= 0 || wordCount > (int)ND_Memsize)
         wordCount = 256 * 1024;
 
     FILE *f = fopen("/nd100_physmem.bin", "wb");
@@ -1326,7 +1377,7 @@ EMSCRIPTEN_EXPORT int Dbg_DumpPhysicalMemory(int wordCount)
 
 EMSCRIPTEN_EXPORT int Dbg_GetPhysMemWords(void)
 {
-    return (int)(sizeof(VolatileMemory) / sizeof(ushort));
+    return (int)ND_Memsize;
 }
 
 // --- Breakpoints ---
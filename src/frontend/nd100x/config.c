@@ -58,6 +58,15 @@ static struct option long_options[] = {
     {"hdlc",       required_argument, 0, 'H'},
     {"throttle",   optional_argument, 0, 'Z'},
     {"ring-dump",  optional_argument, 0, 'R'},
+    {"save-snapshot",    required_argument, 0, 0x111},
+    {"restore-snapshot", required_argument, 0, 0x112},
+    {"checkpoint", required_argument, 0, 0x113},
+    {"memory",     required_argument, 0, 0x114},
+    {"disk-flush", required_argument, 0, 0x115},
+    {"disk-io",    required_argument, 0, 0x116},
+    {"disk-cache", required_argument, 0, 0x117},
+    {"overlay-commit",  required_argument, 0, 0x118},
+    {"overlay-discard", required_argument, 0, 0x119},
     {"overlay-deposit", no_argument, 0, 'O'},
     {"smd0",       required_argument, 0, 0x100},
     {"smd1",       required_argument, 0, 0x101},
@@ -90,6 +99,17 @@ void Config_Init(Config_t *config) {
     config->tapeDir = NULL;
     config->tapeFile = NULL;
     for (int i = 0; i < 4; i++) config->smdFile[i] = NULL;
+    for (int i = 0; i < 4; i++) config->smdOverlay[i] = NULL;
+    config->overlayCommit = NULL;
+    config->overlayDiscard = NULL;
+    config->saveSnapshot = NULL;
+    config->restoreSnapshot = NULL;
+    config->checkpointInterval = 0;
+    config->diskFlush = DRIVE_FLUSH_SHUTDOWN;
+    config->diskFlushInterval = 0;
+    config->diskAsync = true;
+    config->diskCacheKB = DRIVE_CACHE_DEFAULT_KB;
+    config->memoryKW = MEMPAGES_DEFAULT;
     config->telnetEnabled = false;
     config->telnetPort = 9000;
     config->watchCount = 0;
@@ -379,6 +399,75 @@ bool Config_ParseCommandLine(Config_t *config, int argc, char *argv[]) {
                 }
                 break;
 
+            case 0x111:
+                config->saveSnapshot = strdup(optarg);
+                break;
+
+            case 0x112:
+                config->restoreSnapshot = strdup(optarg);
+                break;
+
+            case 0x113:
+                config->checkpointInterval = atoi(optarg);
+                if (config->checkpointInterval <= 0) {
+                    fprintf(stderr, "Error: --checkpoint needs a number of seconds\n");
+                    return false;
+                }
+                break;
+
+            case 0x114:
+                config->memoryKW = atoi(optarg);
+                if ((config->memoryKW <= 0) || (config->memoryKW > MEMPTSIZE)) {
+                    fprintf(stderr, "Error: --memory must be 1 to %d KW\n", MEMPTSIZE);
+                    return false;
+                }
+                break;
+
+            case 0x115:
+                if (strcmp(optarg, "shutdown") == 0) {
+                    config->diskFlush = DRIVE_FLUSH_SHUTDOWN;
+                } else if (strcmp(optarg, "immediate") == 0) {
+                    config->diskFlush = DRIVE_FLUSH_IMMEDIATE;
+                } else {
+                    config->diskFlushInterval = atoi(optarg);
+                    if (config->diskFlushInterval <= 0) {
+                        fprintf(stderr, "Error: --disk-flush must be immediate, shutdown or a number of seconds\n");
+                        return false;
+                    }
+                    config->diskFlush = DRIVE_FLUSH_PERIODIC;
+                }
+                break;
+
+            case 0x116:
+                if (strcmp(optarg, "async") == 0) {
+                    config->diskAsync = true;
+                } else if (strcmp(optarg, "sync") == 0) {
+                    config->diskAsync = false;
+                } else {
+                    fprintf(stderr, "Error: --disk-io must be async or sync\n");
+                    return false;
+                }
+                break;
+
+            case 0x117: {
+                char *end;
+                long kb = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || kb < 0 || kb > 1024 * 1024) {
+                    fprintf(stderr, "Error: --disk-cache must be a size in KB, 0 to 1048576\n");
+                    return false;
+                }
+                config->diskCacheKB = (int)kb;
+                break;
+            }
+
+            case 0x118:
+                config->overlayCommit = strdup(optarg);
+                break;
+
+            case 0x119:
+                config->overlayDiscard = strdup(optarg);
+                break;
+
             case 'R': {
                 int n = 50; // default
                 if (optarg) {
@@ -447,6 +536,16 @@ bool Config_ParseCommandLine(Config_t *config, int argc, char *argv[]) {
                     fprintf(stderr, "Failed to allocate memory for SMD%d file\n", unit);
                     return false;
                 }
+                // FILE,overlay=DELTA: FILE is only read, the writes go to DELTA
+                char *opt = strchr(config->smdFile[unit], ',');
+                if (opt) {
+                    *opt++ = '\0';
+                    if (strncmp(opt, "overlay=", 8) != 0 || opt[8] == '\0') {
+                        fprintf(stderr, "Error: --smd%d options must be overlay=FILE\n", unit);
+                        return false;
+                    }
+                    config->smdOverlay[unit] = opt + 8;
+                }
                 break;
             }
 
@@ -459,8 +558,20 @@ bool Config_ParseCommandLine(Config_t *config, int argc, char *argv[]) {
         }
     }
     
+    if (config->checkpointInterval && !config->saveSnapshot) {
+        fprintf(stderr, "Error: --checkpoint needs --save-snapshot=FILE\n");
+        return false;
+    }
+
+    if (config->overlayCommit && config->overlayDiscard) {
+        fprintf(stderr, "Error: --overlay-commit and --overlay-discard can not be combined\n");
+        return false;
+    }
+    bool overlayTool = config->overlayCommit || config->overlayDiscard;
+
     // Check required arguments
-    if ((!config->showHelp && !config->debuggerEnabled)) {
+    // A restored snapshot is already booted, the overlay tools do not run a machine
+    if ((!config->showHelp && !config->debuggerEnabled && !config->restoreSnapshot && !overlayTool)) {
         if (config->bootType == BOOT_NONE) {
             config->bootType = BOOT_SMD;
 
@@ -489,7 +600,9 @@ bool Config_ParseCommandLine(Config_t *config, int argc, char *argv[]) {
         printf("  Image file: %s\n", config->imageFile);
         for (int i = 0; i < 4; i++) {
             if (config->smdFile[i])
-                printf("  SMD%d image: %s\n", i, config->smdFile[i]);
+                printf("  SMD%d image: %s%s%s\n", i, config->smdFile[i],
+                       config->smdOverlay[i] ? ", overlay " : "",
+                       config->smdOverlay[i] ? config->smdOverlay[i] : "");
         }
         printf("  Start address: 0x%x\n", config->startAddress);
         printf("  Disassembly: %s\n", config->disasmEnabled ? "enabled" : "disabled");
@@ -518,6 +631,7 @@ void Config_PrintHelp(const char *progName) {
     printf("           --smd1=FILE    SMD unit 1 disk image (default: SMD1.IMG)\n");
     printf("           --smd2=FILE    SMD unit 2 disk image (default: SMD2.IMG)\n");
     printf("           --smd3=FILE    SMD unit 3 disk image (default: SMD3.IMG)\n");
+    printf("           --smdN=FILE,overlay=DELTA  Only read FILE, write to the copy-on-write overlay DELTA\n");
     printf("  -s,      --start=ADDR   Start address (default: 0)\n");
     printf("  -a,      --disasm       Enable disassembly output\n");
     printf("  -d,      --debugger     Enable DAP debugger\n");
@@ -545,6 +659,17 @@ void Config_PrintHelp(const char *progName) {
     printf("  -O,      --overlay-deposit Deposit data_click at phys word 1 for kernel boot-info\n");
     printf("  -R[N],   --ring-dump[=N]  Dump last N instructions on halt/crash (default: 50, max: 512)\n");
     printf("  -Z[MHZ], --throttle[=MHZ] Throttle CPU to real-time speed (default: 0.5275 MHz)\n");
+    printf("           --memory=KW    Physical memory size in K words (default: %d, max: %d)\n", MEMPAGES_DEFAULT, MEMPTSIZE);
+    printf("           --disk-flush=WHEN       Sync written SMD blocks to the image files: shutdown (default),\n");
+    printf("                                   immediate (after every write) or every SEC seconds\n");
+    printf("           --disk-io=MODE          Disk transfers: async (default, host I/O on worker threads)\n");
+    printf("                                   or sync (in the CPU thread)\n");
+    printf("           --disk-cache=KB         Drive block cache for unmapped floppy and SMD images (default: %d, 0: off)\n", DRIVE_CACHE_DEFAULT_KB);
+    printf("           --overlay-commit=DELTA  Write the blocks of an overlay into its image, delete it and exit\n");
+    printf("           --overlay-discard=DELTA Delete an overlay, leaving its image as it was, and exit\n");
+    printf("           --save-snapshot=FILE    Save machine state to FILE on Ctrl-C and from the F12 menu\n");
+    printf("           --restore-snapshot=FILE Resume from a saved machine state instead of booting\n");
+    printf("           --checkpoint=SEC        Append changed memory and state to the snapshot every SEC seconds\n");
     printf("  -h,      --help         Show this help message\n\n");
     printf("Examples:\n");
     printf("  %s --boot=bpun --image=test.bpun\n", progName);
@@ -553,5 +678,6 @@ void Config_PrintHelp(const char *progName) {
     printf("  %s --hdlc=1:%d                  # HDLC 1 server on port %d\n", progName, HDLC_DEFAULT_PORT, HDLC_DEFAULT_PORT);
     printf("  %s --hdlc=1:192.168.1.10:%d     # HDLC 1 client\n", progName, HDLC_DEFAULT_PORT);
     printf("  %s --boot=smd --smd0=myboot.img --smd1=data.img\n", progName);
+    printf("  %s --boot=smd --smd0=myboot.img,overlay=run1.ovl  # myboot.img stays as it is\n", progName);
     printf("  %s --hdlc=1:5000 --hdlc=2:5001  # Two HDLC devices\n", progName);
 } 
\ No newline at end of file
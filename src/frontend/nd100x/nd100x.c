@@ -108,8 +108,19 @@ static void set_terminal_carrier(Device *dev, bool missing)
 }
 #endif
 
+// Set by the signal handler on Ctrl-C or SIGTERM. The main loop stops the machine between two
+// machine_run() slices, where the CPU state is consistent, saves it if --save-snapshot is
+// given, and shuts down the normal way: the drives are unmounted and their cached blocks
+// written to the images.
+static volatile sig_atomic_t exitRequested = 0;
+
 void handle_sigint(int sig) {
-    printf("\nCaught signal %d (Ctrl-C). Cleaning up...\n", sig);
+    if (sig != SIGABRT) {
+        exitRequested = sig;
+        return;
+    }
+
+    printf("\nCaught signal %d (abort). Cleaning up...\n", sig);
 
 #if !defined(PLATFORM_WASM) && !defined(__EMSCRIPTEN__)
     if (telnetServer) {
@@ -189,6 +200,16 @@ void dump_stats()
 
     printf("Number of instructions run: %llu, time used: %f\n", (unsigned long long)instr_counter, totaltime);
     printf("usertime: %f  systemtime: %f\n", usertime, systemtime);
+
+    DriveCacheStats cache;
+    drive_cache_get_stats(&cache);
+    if (cache.hits + cache.misses + cache.writes > 0) {
+        printf("Drive cache: %llu hits, %llu misses, %llu read ahead (%llu used), %llu writes, %llu written back, %llu evicted\n",
+               (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+               (unsigned long long)cache.prefetched, (unsigned long long)cache.prefetchHits,
+               (unsigned long long)cache.writes, (unsigned long long)cache.writebacks,
+               (unsigned long long)cache.evictions);
+    }
     if (instr_counter > 0) {
         printf("Current cpu cycle time is:%f microsecs\n",
                (totaltime / ((double)instr_counter / 1000000.0)));
@@ -211,6 +232,11 @@ void initialize()
 	if (DISASM) disasm_init();
 
 	machine_init(config.debuggerEnabled, config.debuggerPort);
+	cpu_memory_set_size(config.memoryKW);
+	machine_set_drive_flush(config.diskFlush);
+	machine_set_disk_async(config.diskAsync);
+	machine_set_drive_cache(config.diskCacheKB);
+	STARTADDR = config.startAddress;
 
     //     {0340, 044, 044, "TERMINAL 5/ TET12"},
     DeviceManager_AddDevice(DEVICE_TYPE_TERMINAL, 5);
@@ -239,12 +265,15 @@ void initialize()
 	// (autoMountDrives will skip already-mounted units)
 	for (int i = 0; i < 4; i++) {
 		if (config.smdFile[i]) {
-			mount_smd(config.smdFile[i], i);
+			mount_smd_overlay(config.smdFile[i], config.smdOverlay[i], i);
 		}
 	}
 
-	program_load(config.bootType, config.imageFile, config.verbose, (uint16_t)config.textStart, config.overlayDeposit);
-	gPC = STARTADDR;
+	// A restored snapshot is already booted, main() restores it once all devices exist
+	if (!config.restoreSnapshot) {
+		program_load(config.bootType, config.imageFile, config.verbose, (uint16_t)config.textStart, config.overlayDeposit);
+		gPC = STARTADDR;
+	}
 
 	/* Direct input/output enabled */
 	setcbreak ();
@@ -480,6 +509,14 @@ int main(int argc, char *argv[])
         Config_PrintHelp(argv[0]);
         return EXIT_SUCCESS;
     }
+
+    // Overlay tools: no machine is run
+    if (config.overlayCommit) {
+        return drive_overlay_commit(config.overlayCommit) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (config.overlayDiscard) {
+        return drive_overlay_discard(config.overlayDiscard) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
     
     if (config.debuggerEnabled) {
         printf("DAP Debugger enabled on port %d\n", config.debuggerPort);
@@ -487,7 +524,6 @@ int main(int argc, char *argv[])
 
     // Set global variables from config
     DISASM = config.disasmEnabled;
-    STARTADDR = config.startAddress;
     smd_debug_enabled = config.smdDebug;
     CPU_TRACE = config.traceEnabled;
     BSD_DEBUG = config.bsdDebug;
@@ -534,6 +570,13 @@ int main(int argc, char *argv[])
                          config.hdlc[i].port);
     }
 
+    // Resume a saved machine instead of booting. Needs the same devices as when it was saved.
+    if (config.restoreSnapshot && !machine_restore_snapshot(config.restoreSnapshot)) {
+        fprintf(stderr, "Failed to restore snapshot %s\n", config.restoreSnapshot);
+        cleanup();
+        return EXIT_FAILURE;
+    }
+
     // =========================================================
     // Set up terminal devices with VScreen output handlers
     // =========================================================
@@ -662,15 +705,54 @@ int main(int argc, char *argv[])
 
     // Initialize the menu state machine
     menu_init(&menuState, screens, screenCount, &activeScreen);
+    menuState.snapshotPath = config.saveSnapshot;
 
     // Run the machine until it stops
     CPURunMode runMode = get_cpu_run_mode();
+    time_t lastCheckpointTime = time(NULL);
+    time_t lastDiskFlushTime = lastCheckpointTime;
+    time_t lastWritebackTime = lastCheckpointTime;
 
     while (runMode != CPU_SHUTDOWN)
     {
         runMode = get_cpu_run_mode();
         machine_run(5000);
 
+        if (exitRequested) {
+            machine_stop();
+            if (config.saveSnapshot) {
+                printf("\nSaving snapshot to %s...\n", config.saveSnapshot);
+                machine_save_snapshot(config.saveSnapshot);
+            } else {
+                printf("\nCaught signal %d. Cleaning up...\n", (int)exitRequested);
+            }
+            break;
+        }
+
+        // Periodic crash recovery checkpoint, only the pages written since the last one
+        if (config.checkpointInterval) {
+            time_t now = time(NULL);
+            if (now - lastCheckpointTime >= config.checkpointInterval) {
+                machine_checkpoint_snapshot(config.saveSnapshot);
+                lastCheckpointTime = now;
+            }
+        }
+
+        // Write the blocks held dirty in the drive cache back to the images
+        if (time(NULL) - lastWritebackTime >= DRIVE_CACHE_WRITEBACK_SECONDS) {
+            machine_writeback_drives();
+            lastWritebackTime = time(NULL);
+        }
+
+        // Make the written SMD blocks durable
+        if (config.diskFlush == DRIVE_FLUSH_PERIODIC) {
+            time_t now = time(NULL);
+            if (now - lastDiskFlushTime >= config.diskFlushInterval) {
+                machine_flush_drives();
+                lastDiskFlushTime = now;
+            }
+        }
+
         runMode = get_cpu_run_mode();
 
         // Check for print job timeout
@@ -800,8 +882,9 @@ int main(int argc, char *argv[])
         disasm_dump();
 
     dump_stats();
-    cleanup();
 
     // exit with A register value from WAIT instruction
-    return(gCpuExitCode);
+    int exitCode = gCpuExitCode;
+    cleanup();
+    return(exitCode);
 }
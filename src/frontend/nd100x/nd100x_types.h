@@ -69,6 +69,17 @@ typedef struct {
     char *tapeDir;       // Output directory for punched tape (default: ./tapes/)
     char *tapeFile;      // Input file for paper tape reader
     char *smdFile[4];    // SMD disk image files (--smd0 through --smd3)
+    char *smdOverlay[4]; // Copy-on-write overlay of each SMD image (--smdN=FILE,overlay=DELTA), or NULL
+    char *overlayCommit;    // --overlay-commit: write this overlay into its image and exit
+    char *overlayDiscard;   // --overlay-discard: delete this overlay and exit
+    char *saveSnapshot;     // --save-snapshot: snapshot written on Ctrl-C and from the F12 menu
+    char *restoreSnapshot;  // --restore-snapshot: resume from this snapshot instead of booting
+    int checkpointInterval; // --checkpoint: seconds between checkpoints appended to saveSnapshot (0 = off)
+    DRIVE_FLUSH diskFlush;  // --disk-flush: when written SMD blocks are synced to the image files
+    int diskFlushInterval;  // Seconds between syncs with DRIVE_FLUSH_PERIODIC
+    bool diskAsync;         // --disk-io: SMD and floppy host I/O on the block I/O workers
+    int diskCacheKB;        // --disk-cache: size of the drive block cache (0 = off)
+    int memoryKW;           // --memory: physical memory size in K words
     bool telnetEnabled;  // --telnet flag
     int telnetPort;      // Default: 9000
     // CLI memory watchpoints (--watch). Run at full native speed (no DAP needed).
@@ -23,6 +23,8 @@
 #include "../../devices/hdlc/deviceHDLC.h"
 #include "../../cpu/cpu_types.h"
 #include "../../cpu/cpu_protos.h"
+#include "../../machine/machine_types.h"
+#include "../../machine/machine_protos.h"
 
 // Forward declaration for floppy menu (conditionally available).
 // The floppy-DB browser in menu.c depends on ncurses + libcurl and is not
@@ -35,7 +37,7 @@ extern int show_floppy_menu(void);
 // Internal: set mode and draw the appropriate screen
 // =========================================================
 
-static void draw_f12(void);
+static void draw_f12(MenuState *state);
 static void draw_screen_select(MenuState *state, void *telnetServer);
 static void draw_release_prompt(MenuState *state);
 static void draw_hdlc_status(void);
@@ -65,7 +67,7 @@ static void menu_set_mode(MenuState *state, MenuMode mode, void *telnetServer)
         VScreen_Redraw(&state->screens[*state->activeScreen]);
         break;
     case MENU_F12:
-        draw_f12();
+        draw_f12(state);
         break;
     case MENU_SCREEN_SELECT:
         draw_screen_select(state, telnetServer);
@@ -227,7 +229,7 @@ static void draw_charset(void)
     fflush(stdout);
 }
 
-static void draw_f12(void)
+static void draw_f12(MenuState *state)
 {
     printf("\033[2J\033[H");
     printf("=== ND100X Menu ===\n\n");
@@ -236,8 +238,10 @@ static void draw_f12(void)
     printf("  [3] HDLC Status\n");
     printf("  [4] CPU Speed\n");
     printf("  [5] Character Set  (local console: %s)\n", charset_name(charset_get()));
+    if (state->snapshotPath)
+        printf("  [6] Save Snapshot  (%s)\n", state->snapshotPath);
     printf("  [A] About\n");
-    printf("\nPress 1-5/A to select, ESC to cancel: ");
+    printf("\nPress %s/A to select, ESC to cancel: ", state->snapshotPath ? "1-6" : "1-5");
     fflush(stdout);
 }
 
@@ -642,6 +646,10 @@ void menu_process_key(MenuState *state, const KeyEvent *key, void *telnetServer)
             menu_set_mode(state, MENU_CPU_SPEED, telnetServer);
         } else if (ch == '5') {
             menu_set_mode(state, MENU_CHARSET, telnetServer);
+        } else if (ch == '6' && state->snapshotPath) {
+            // The menu runs between machine_run() slices, so the machine can be saved as is
+            bool saved = machine_save_snapshot(state->snapshotPath);
+            menu_show_message(state, saved ? "Snapshot saved." : "Snapshot failed, see the Log screen.", MENU_NONE);
         } else if (ch == 'a' || ch == 'A') {
             menu_set_mode(state, MENU_ABOUT, telnetServer);
         }
@@ -44,6 +44,7 @@ typedef struct {
     VScreen *screens;
     int screenCount;
     int *activeScreen;
+    const char *snapshotPath;   // --save-snapshot file, NULL hides the save entry
 } MenuState;
 
 // Initialize menu state (call once at startup)
@@ -0,0 +1,538 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Drive block cache
+//
+// An LRU cache of image blocks between machine_block_read/machine_block_write and the
+// drive images, shared by all SMD and floppy units of all machines. It only takes drives
+// whose blocks are not in memory already: image files without a mapping and, in WASM,
+// OPFS and gateway drives, where every transfer is a round trip to JavaScript or to the
+// gateway server.
+//
+// Writes stay in the cache until the drive is written back (machine_writeback_drives(),
+// machine_flush_drives()), the block is evicted or the drive is unmounted. With
+// DRIVE_FLUSH_IMMEDIATE they also go to the image at once. A block the image refuses
+// stays dirty, is not evicted, and is tried again at the next write back.
+//
+// A read that misses also fetches the rest of the 1K word page it ends in, which is how
+// SINTRAN moves file and swap data, and a sequential stream fetches the next pages too.
+//
+// The block I/O workers and the machine thread both come here. One mutex covers the
+// cache and the image transfers it does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+typedef struct DriveCacheLine {
+    MountedDriveInfo_t *entry;
+    uint8_t type;                   // DRIVE_TYPE, for the image transfer
+    uint8_t unit;
+    bool dirty;                     // Written, the image has older data
+    bool prefetched;                // Read ahead and not read since
+    uint32_t block;
+    uint32_t size;                  // Bytes in data
+    uint8_t *data;
+    struct DriveCacheLine *hashNext;
+    struct DriveCacheLine *prev;    // LRU list, most recently used first
+    struct DriveCacheLine *next;
+} DriveCacheLine;
+
+static pthread_mutex_t cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t cacheCapacity = (size_t)DRIVE_CACHE_DEFAULT_KB * 1024;  // Bytes of block data, 0 = off
+static size_t cacheUsed = 0;
+static DriveCacheLine **buckets = NULL;
+static size_t bucketMask = 0;
+static DriveCacheLine *lruHead = NULL;
+static DriveCacheLine *lruTail = NULL;
+static DriveCacheStats stats;
+
+static size_t line_hash(const MountedDriveInfo_t *entry, uint32_t block)
+{
+    uintptr_t key = ((uintptr_t)entry >> 4) ^ ((uintptr_t)block * 0x9E3779B1u);
+    return (size_t)(key ^ (key >> 15)) & bucketMask;
+}
+
+static bool ensure_buckets(void)
+{
+    if (buckets)
+        return true;
+
+    // About one bucket per 1 KB block the cache can hold
+    size_t count = 64;
+    while (count < cacheCapacity / 1024)
+        count <<= 1;
+    buckets = (DriveCacheLine **)calloc(count, sizeof(DriveCacheLine *));
+    bucketMask = buckets ? count - 1 : 0;
+    return buckets != NULL;
+}
+
+static DriveCacheLine *lookup(const MountedDriveInfo_t *entry, uint32_t block)
+{
+    if (!buckets)
+        return NULL;
+
+    for (DriveCacheLine *line = buckets[line_hash(entry, block)]; line; line = line->hashNext)
+    {
+        if (line->entry == entry && line->block == block)
+            return line;
+    }
+    return NULL;
+}
+
+static void lru_unlink(DriveCacheLine *line)
+{
+    if (line->prev)
+        line->prev->next = line->next;
+    else
+        lruHead = line->next;
+    if (line->next)
+        line->next->prev = line->prev;
+    else
+        lruTail = line->prev;
+    line->prev = line->next = NULL;
+}
+
+static void lru_push(DriveCacheLine *line)
+{
+    line->prev = NULL;
+    line->next = lruHead;
+    if (lruHead)
+        lruHead->prev = line;
+    else
+        lruTail = line;
+    lruHead = line;
+}
+
+static void touch(DriveCacheLine *line)
+{
+    if (line != lruHead)
+    {
+        lru_unlink(line);
+        lru_push(line);
+    }
+}
+
+static void remove_line(DriveCacheLine *line)
+{
+    DriveCacheLine **link = &buckets[line_hash(line->entry, line->block)];
+    while (*link != line)
+        link = &(*link)->hashNext;
+    *link = line->hashNext;
+
+    lru_unlink(line);
+    cacheUsed -= line->size;
+    free(line->data);
+    free(line);
+}
+
+// Write a dirty line to its image. A line that fails to write stays dirty.
+// Returns 0, or -1 if the image could not be written.
+static int write_back(DriveCacheLine *line)
+{
+    if (!line->dirty)
+        return 0;
+
+    if (drive_image_write(line->entry, (DRIVE_TYPE)line->type, line->unit, line->data, line->size,
+                          (size_t)line->block * line->size) < 0)
+    {
+        fprintf(stderr, "Drive cache: write back of block %u to %s failed\n", line->block, line->entry->name);
+        return -1;
+    }
+
+    line->dirty = false;
+    stats.writebacks++;
+    return 0;
+}
+
+// Add a block, evicting the least recently used ones to make room. Dirty blocks that
+// cannot be written back are kept.
+// Returns NULL if the block is larger than the whole cache or no room could be made.
+static DriveCacheLine *insert(MountedDriveInfo_t *entry, DRIVE_TYPE type, int unit, uint32_t block,
+                              uint32_t size, const uint8_t *data, bool dirty)
+{
+    if (size > cacheCapacity || !ensure_buckets())
+        return NULL;
+
+    DriveCacheLine *victim = lruTail;
+    while (victim && cacheUsed + size > cacheCapacity)
+    {
+        DriveCacheLine *prev = victim->prev;
+        if (write_back(victim) == 0)
+        {
+            remove_line(victim);
+            stats.evictions++;
+        }
+        victim = prev;
+    }
+    if (cacheUsed + size > cacheCapacity)
+        return NULL;
+
+    DriveCacheLine *line = (DriveCacheLine *)calloc(1, sizeof(DriveCacheLine));
+    uint8_t *copy = (uint8_t *)malloc(size);
+    if (!line || !copy)
+    {
+        free(line);
+        free(copy);
+        return NULL;
+    }
+
+    memcpy(copy, data, size);
+    line->entry = entry;
+    line->type = (uint8_t)type;
+    line->unit = (uint8_t)unit;
+    line->dirty = dirty;
+    line->block = block;
+    line->size = size;
+    line->data = copy;
+
+    size_t bucket = line_hash(entry, block);
+    line->hashNext = buckets[bucket];
+    buckets[bucket] = line;
+    lru_push(line);
+    cacheUsed += size;
+    return line;
+}
+
+static int compare_lines(const void *a, const void *b)
+{
+    uint32_t blockA = (*(DriveCacheLine *const *)a)->block;
+    uint32_t blockB = (*(DriveCacheLine *const *)b)->block;
+    return (blockA > blockB) - (blockA < blockB);
+}
+
+// Write back the dirty blocks of a drive, runs of adjacent blocks in one image transfer.
+// Returns 0, or -1 if some could not be written; those stay dirty.
+static int flush_entry(MountedDriveInfo_t *entry)
+{
+    int result = 0;
+    size_t count = 0;
+    for (DriveCacheLine *line = lruHead; line; line = line->next)
+    {
+        if (line->entry == entry && line->dirty)
+            count++;
+    }
+    if (count == 0)
+        return 0;
+
+    DriveCacheLine **dirty = (DriveCacheLine **)malloc(count * sizeof(DriveCacheLine *));
+    uint8_t *run = (uint8_t *)malloc((size_t)DRIVE_CACHE_FLUSH_BLOCKS * entry->cache_block_size);
+    if (!dirty || !run)
+    {
+        // No memory for batching, one block at a time then
+        free(dirty);
+        free(run);
+        for (DriveCacheLine *line = lruHead; line; line = line->next)
+        {
+            if (line->entry == entry && write_back(line) < 0)
+                result = -1;
+        }
+        return result;
+    }
+
+    count = 0;
+    for (DriveCacheLine *line = lruHead; line; line = line->next)
+    {
+        if (line->entry == entry && line->dirty)
+            dirty[count++] = line;
+    }
+    qsort(dirty, count, sizeof(DriveCacheLine *), compare_lines);
+
+    for (size_t i = 0; i < count;)
+    {
+        DriveCacheLine *first = dirty[i];
+        size_t n = 0;
+        while (i + n < count && n < DRIVE_CACHE_FLUSH_BLOCKS &&
+               dirty[i + n]->block == first->block + n)
+        {
+            memcpy(run + n * first->size, dirty[i + n]->data, first->size);
+            n++;
+        }
+
+        if (drive_image_write(entry, (DRIVE_TYPE)first->type, first->unit, run, n * first->size,
+                              (size_t)first->block * first->size) < 0)
+        {
+            fprintf(stderr, "Drive cache: write back of blocks %u-%u to %s failed\n",
+                    first->block, first->block + (uint32_t)n - 1, entry->name);
+            result = -1;
+        }
+        else
+        {
+            for (size_t b = 0; b < n; b++)
+                dirty[i + b]->dirty = false;
+            stats.writebacks += n;
+        }
+        i += n;
+    }
+
+    free(dirty);
+    free(run);
+    return result;
+}
+
+// Write back and forget all blocks of a drive. Blocks the image refused are lost with it,
+// the drive is going away.
+// Returns 0, or -1 if some written blocks could not be saved.
+static int drop_entry(MountedDriveInfo_t *entry)
+{
+    int result = flush_entry(entry);
+    size_t lost = 0;
+
+    DriveCacheLine *line = lruHead;
+    while (line)
+    {
+        DriveCacheLine *next = line->next;
+        if (line->entry == entry)
+        {
+            lost += line->dirty;
+            remove_line(line);
+        }
+        line = next;
+    }
+    if (lost)
+        fprintf(stderr, "Drive cache: %zu written blocks of %s could not be saved\n", lost, entry->name);
+
+    entry->cache_block_size = 0;
+    entry->cache_next_block = 0;
+    return result;
+}
+
+// The controllers change the block size with the disk format; a drive's blocks are all
+// held in the size of its last transfer
+static void use_block_size(MountedDriveInfo_t *entry, uint32_t size)
+{
+    if (entry->cache_block_size != size)
+    {
+        drop_entry(entry);
+        entry->cache_block_size = size;
+    }
+}
+
+// Blocks to read ahead of 'next', the block after a read that missed: up to the end of
+// the SINTRAN page it is in, and for a sequential stream the next pages as well. Stops at
+// the end of the image and at a block already in the cache (it may be dirty).
+static size_t readahead_blocks(MountedDriveInfo_t *entry, uint32_t next, uint32_t size, bool sequential)
+{
+    size_t start = (size_t)next * size;
+    size_t end = (start + DRIVE_CACHE_PAGE_BYTES - 1) / DRIVE_CACHE_PAGE_BYTES * DRIVE_CACHE_PAGE_BYTES;
+    if (sequential)
+        end += (size_t)DRIVE_CACHE_READAHEAD_PAGES * DRIVE_CACHE_PAGE_BYTES;
+    if (end > entry->data_size)
+        end = entry->data_size;
+    if (end <= start)
+        return 0;
+
+    size_t count = (end - start) / size;
+    size_t limit = cacheCapacity / 4 / size;
+    if (count > limit)
+        count = limit;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (lookup(entry, next + (uint32_t)i))
+            return i;
+    }
+    return count;
+}
+
+/// @brief Set the size of the cache in bytes, 0 turns it off
+/// @details Writes back and drops everything cached. Call before drives are mounted.
+void drive_cache_set_size(size_t bytes)
+{
+    pthread_mutex_lock(&cacheMutex);
+    while (lruHead)
+    {
+        if (write_back(lruHead) < 0)
+            fprintf(stderr, "Drive cache: block %u of %s could not be saved\n", lruHead->block, lruHead->entry->name);
+        remove_line(lruHead);
+    }
+    free(buckets);
+    buckets = NULL;
+    bucketMask = 0;
+    cacheCapacity = bytes;
+    pthread_mutex_unlock(&cacheMutex);
+}
+
+/// @brief True if block I/O of the drive goes through the cache
+bool drive_cache_enabled(const MountedDriveInfo_t *entry)
+{
+    if (cacheCapacity == 0)
+        return false;
+#ifdef __EMSCRIPTEN__
+    // MEMFS image files are in memory, and the frontend replaces them under a mounted drive
+    return entry->is_opfs || entry->is_gateway;
+#else
+    return !entry->mapped && !entry->is_remote;
+#endif
+}
+
+/// @brief Read blocks of a drive through the cache
+/// @return The number of blocks read, or -1 if the image could not be read
+int drive_cache_read(MountedDriveInfo_t *entry, DRIVE_TYPE type, int unit, uint8_t *buffer, size_t blocks,
+                     uint32_t blockAddress, uint32_t size)
+{
+    int result = (int)blocks;
+
+    pthread_mutex_lock(&cacheMutex);
+    use_block_size(entry, size);
+    bool sequential = (blockAddress == entry->cache_next_block);
+
+    size_t i = 0;
+    while (i < blocks)
+    {
+        uint32_t block = blockAddress + (uint32_t)i;
+        DriveCacheLine *line = lookup(entry, block);
+        if (line)
+        {
+            memcpy(buffer + i * size, line->data, size);
+            touch(line);
+            stats.hits++;
+            if (line->prefetched)
+            {
+                line->prefetched = false;
+                stats.prefetchHits++;
+            }
+            i++;
+            continue;
+        }
+
+        // The missing blocks in a row come in one image transfer, with the read-ahead if they end the request
+        size_t count = 1;
+        while (i + count < blocks && !lookup(entry, block + (uint32_t)count))
+            count++;
+        size_t ahead = (i + count == blocks) ? readahead_blocks(entry, block + (uint32_t)count, size, sequential) : 0;
+
+        uint8_t *data = buffer + i * size;
+        if (ahead)
+        {
+            data = (uint8_t *)malloc((count + ahead) * size);
+            if (!data)
+            {
+                data = buffer + i * size;
+                ahead = 0;
+            }
+        }
+
+        if (drive_image_read(entry, type, unit, data, (count + ahead) * size, (size_t)block * size) < 0)
+        {
+            if (ahead)
+                free(data);
+            result = -1;
+            break;
+        }
+
+        for (size_t b = 0; b < count + ahead; b++)
+        {
+            line = insert(entry, type, unit, block + (uint32_t)b, size, data + b * size, false);
+            if (line && b >= count)
+                line->prefetched = true;
+        }
+        stats.misses += count;
+        stats.prefetched += ahead;
+
+        if (ahead)
+        {
+            memcpy(buffer + i * size, data, count * size);
+            free(data);
+        }
+        i += count;
+    }
+
+    entry->cache_next_block = blockAddress + (uint32_t)blocks;
+    pthread_mutex_unlock(&cacheMutex);
+    return result;
+}
+
+/// @brief Write blocks of a drive through the cache
+/// @param writeThrough Also write them to the image now (DRIVE_FLUSH_IMMEDIATE)
+/// @return The number of blocks written, or -1 if the image could not be written
+int drive_cache_write(MountedDriveInfo_t *entry, DRIVE_TYPE type, int unit, const uint8_t *buffer, size_t blocks,
+                      uint32_t blockAddress, uint32_t size, bool writeThrough)
+{
+    int result = (int)blocks;
+
+    pthread_mutex_lock(&cacheMutex);
+    use_block_size(entry, size);
+
+    if (writeThrough &&
+        drive_image_write(entry, type, unit, buffer, blocks * size, (size_t)blockAddress * size) < 0)
+    {
+        result = -1;
+    }
+
+    for (size_t i = 0; i < blocks && result >= 0; i++)
+    {
+        uint32_t block = blockAddress + (uint32_t)i;
+        const uint8_t *data = buffer + i * size;
+        DriveCacheLine *line = lookup(entry, block);
+        if (line)
+        {
+            memcpy(line->data, data, size);
+            line->dirty = !writeThrough;
+            line->prefetched = false;
+            touch(line);
+        }
+        else if (!insert(entry, type, unit, block, size, data, !writeThrough) && !writeThrough)
+        {
+            // Not cached, it goes to the image directly
+            if (drive_image_write(entry, type, unit, data, size, (size_t)block * size) < 0)
+                result = -1;
+        }
+    }
+    if (result >= 0)
+        stats.writes += blocks;
+
+    pthread_mutex_unlock(&cacheMutex);
+    return result;
+}
+
+/// @brief Write the dirty blocks of a drive to its image
+/// @return 0, or -1 if some could not be written; they stay dirty for the next try
+int drive_cache_flush(MountedDriveInfo_t *entry)
+{
+    pthread_mutex_lock(&cacheMutex);
+    int result = flush_entry(entry);
+    pthread_mutex_unlock(&cacheMutex);
+    return result;
+}
+
+/// @brief Write back and forget the blocks of a drive, before it is unmounted
+/// @return 0, or -1 if some written blocks could not be saved
+int drive_cache_drop(MountedDriveInfo_t *entry)
+{
+    pthread_mutex_lock(&cacheMutex);
+    int result = drop_entry(entry);
+    pthread_mutex_unlock(&cacheMutex);
+    return result;
+}
+
+/// @brief Get the hit, miss and write-back counts since the start
+void drive_cache_get_stats(DriveCacheStats *out)
+{
+    pthread_mutex_lock(&cacheMutex);
+    *out = stats;
+    pthread_mutex_unlock(&cacheMutex);
+}
@@ -27,6 +27,9 @@
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+#elif !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#define DRIVE_MMAP
 #endif
 
 #include "machine_types.h"
@@ -44,9 +47,13 @@
 #endif
 
 
-// Global arrays for mounted drive information
-MountedDriveInfo_t* floppy_drives = NULL;
-MountedDriveInfo_t* smd_drives = NULL;
+// Machine of the calling thread, see machine_context.h
+_Thread_local Machine *gMachine = NULL;
+
+// Mounted drive information of the current machine
+#define floppy_drives (gMachine->drives->floppy)
+#define smd_drives    (gMachine->drives->smd)
+#define driveFlush    (gMachine->drives->flush)
 
 
 const char* boot_type_str[] = {
@@ -81,9 +88,32 @@ static void cleanup_drive_arrays() {
     }
 }
 
-void
+/// @brief Make a machine the current machine of the calling thread
+/// @details A machine runs on one thread at a time. Other threads that need its state
+/// (the debugger thread) bind it too. NULL unbinds the thread.
+/// @param machine Machine created by machine_init()
+void machine_bind(Machine *machine)
+{
+    gMachine = machine;
+    gCpu = machine ? machine->cpu : NULL;
+}
+
+/// @brief Create and initialize a machine and make it current on the calling thread
+/// @details Several machines can run in one process, each on its own thread: create
+/// each one with machine_init() (or bind it with machine_bind()) on the thread that runs it.
+/// @return The new machine
+Machine *
 machine_init (bool debuggerEnabled, int debuggerPort)
 {
+    Machine *machine = calloc(1, sizeof(Machine));
+    if (machine)
+        machine->drives = calloc(1, sizeof(struct MachineDrives));
+    if (!machine || !machine->drives)
+    {
+        fprintf(stderr, "Unable to allocate the machine\n");
+        exit(EXIT_FAILURE);
+    }
+    machine_bind(machine);
 
     // Initialize drive arrays
     init_drive_arrays();
@@ -99,6 +129,8 @@ machine_init (bool debuggerEnabled, int debuggerPort)
 
     // Set the CPU to RUN mode
     set_cpu_run_mode(CPU_RUNNING);
+
+    return machine;
 }
 
 void machine_add_hdlc(int deviceNum, bool isServer, const char *address, int port)
@@ -119,6 +151,8 @@ void machine_add_hdlc(int deviceNum, bool isServer, const char *address, int por
 void 
 cleanup_machine (void)
 {
+    if (!gMachine) return;
+
     cleanup_cpu();
     IO_Destroy();    
 
@@ -145,6 +179,12 @@ cleanup_machine (void)
 	// Clean up drive arrays
 	cleanup_drive_arrays();
 
+	// Free the machine itself
+	Machine *machine = gMachine;
+	machine_bind(NULL);
+	free(machine->snapshot);
+	free(machine->drives);
+	free(machine);
 }
 
 
@@ -193,6 +233,9 @@ void  machine_run (int ticks)
 
 void machine_stop()
 {
+    // Called from signal handlers, which may run on a thread without a machine
+    if (!gCpu) return;
+
     // Stop the CPU
     set_cpu_run_mode(CPU_STOPPED);
 }
@@ -252,6 +295,14 @@ void mount_floppy(const char *imageFile, int unit)
 
 
 void mount_smd(const char *imageFile, int unit)
+{
+    mount_smd_overlay(imageFile, NULL, unit);
+}
+
+
+/// @brief Mount an SMD image, with the writes going to a copy-on-write overlay if one is given
+/// @details The overlay file is created if it does not exist. The image itself is only read.
+void mount_smd_overlay(const char *imageFile, const char *overlayFile, int unit)
 {
     char path[256];
     sprintf(path,"SMD%d.IMG",unit);
@@ -264,11 +315,11 @@ void mount_smd(const char *imageFile, int unit)
         fclose(ftmp2);
         if (unit ==0)
         {
-            mount_drive(DRIVE_SMD, unit, "md5-unknown", "Boot SMD", "Boot SMD image", smd_img);
+            mount_drive_overlay(DRIVE_SMD, unit, "md5-unknown", "Boot SMD", "Boot SMD image", smd_img, overlayFile);
         }
         else
         {
-            mount_drive(DRIVE_SMD, unit, "md5-unknown", "DATA SMD", "DATA SMD image", smd_img);
+            mount_drive_overlay(DRIVE_SMD, unit, "md5-unknown", "DATA SMD", "DATA SMD image", smd_img, overlayFile);
         }
     }
 }
@@ -366,7 +417,7 @@ void autoMountDrives()
          //gPC = (CONFIG_OK) ? bootaddress : 0;
 
          /*
-         result = sectorread(0, 0, 1, (ushort *)&VolatileMemory);
+         result = sectorread(0, 0, 1, VolatileMemory.n_Array);
          if (result < 0) {
              printf("Error reading from floppy\n");
              exit(1);
@@ -434,8 +485,116 @@ void autoMountDrives()
     return drives[unit].is_mounted;
  }
 
+/// @brief Set when writes to memory mapped drive images are synced to their files
+void machine_set_drive_flush(DRIVE_FLUSH policy)
+{
+    driveFlush = policy;
+}
+
+/// @brief Choose where the disk controllers do their host I/O
+/// @details Async (default) hands transfers to the block I/O workers, sync keeps them
+/// in the machine thread so completion timing only depends on virtual time.
+void machine_set_disk_async(bool async)
+{
+    BlockIO_SetEnabled(async);
+}
+
+/// @brief Set the size of the drive block cache in KB, 0 turns it off
+/// @details Call before drives are mounted.
+void machine_set_drive_cache(int kb)
+{
+    drive_cache_set_size(kb > 0 ? (size_t)kb * 1024 : 0);
+}
+
+// Map a local image file shared, so block I/O is a copy to or from the host page cache.
+// Without a mapping (no mmap, empty file, mmap failed) the drive uses local_file.
+static void map_drive(MountedDriveInfo_t *entry)
+{
+    entry->mapped = NULL;
+    atomic_store(&entry->mapped_dirty, false);
+#ifdef DRIVE_MMAP
+    if (!entry->data.local_file || entry->data_size == 0)
+        return;
+
+    // The image under an overlay is never written, and stays shared with other machines
+    int prot = PROT_READ | (entry->is_writeprotected || entry->overlay ? 0 : PROT_WRITE);
+    void *map = mmap(NULL, entry->data_size, prot, MAP_SHARED, fileno(entry->data.local_file), 0);
+    if (map != MAP_FAILED) {
+        entry->mapped = (uint8_t *)map;
+        // Transfers past the end of the mapping still use the FILE; it must not buffer
+        // stale copies of mapped blocks
+        setvbuf(entry->data.local_file, NULL, _IONBF, 0);
+    }
+#endif
+}
+
+// Sync the written pages of a mapped image, or the overlay, to its file
+static void sync_drive(MountedDriveInfo_t *entry)
+{
+    if (entry->overlay) {
+        drive_overlay_sync(entry->overlay);
+    }
+#ifdef DRIVE_MMAP
+    // Cleared before the msync, a block I/O worker may write again meanwhile
+    if (entry->mapped && atomic_exchange(&entry->mapped_dirty, false)) {
+        msync(entry->mapped, entry->data_size, MS_SYNC);
+    }
+#endif
+}
+
+static void unmap_drive(MountedDriveInfo_t *entry)
+{
+#ifdef DRIVE_MMAP
+    if (entry->mapped) {
+        sync_drive(entry);
+        munmap(entry->mapped, entry->data_size);
+        entry->mapped = NULL;
+    }
+#endif
+}
+
+/// @brief Write the blocks held dirty in the drive cache to the images of the current machine
+/// @details The frontend calls this every DRIVE_CACHE_WRITEBACK_SECONDS, like the kernel
+/// writes back dirty pages of the mapped images on its own.
+/// @return 0, or -1 if some blocks could not be written; they stay in the cache
+int machine_writeback_drives(void)
+{
+    if (!gMachine) return 0;
+
+    int result = 0;
+    for (int i = 0; floppy_drives && i < 3; i++) {
+        if (drive_cache_flush(&floppy_drives[i]) < 0) result = -1;
+    }
+    for (int i = 0; smd_drives && i < 4; i++) {
+        if (drive_cache_flush(&smd_drives[i]) < 0) result = -1;
+    }
+    return result;
+}
+
+/// @brief Sync the written blocks of all drive images to their files
+/// @details For DRIVE_FLUSH_PERIODIC, the frontend calls this on its own schedule.
+void machine_flush_drives(void)
+{
+    if (!gMachine) return;
+
+    machine_writeback_drives();
+    for (int i = 0; floppy_drives && i < 3; i++) {
+        sync_drive(&floppy_drives[i]);
+    }
+    for (int i = 0; smd_drives && i < 4; i++) {
+        sync_drive(&smd_drives[i]);
+    }
+}
+
  // Mount a drive to the specified unit
 void mount_drive(DRIVE_TYPE drive_type, int unit, const char *md5, const char *name, const char *description, const char *image_path) {
+    mount_drive_overlay(drive_type, unit, md5, name, description, image_path, NULL);
+}
+
+/// @brief Mount a drive, with the writes going to a copy-on-write overlay if overlay_path is given
+/// @details The image is then opened read only and can be shared by several machines.
+void mount_drive_overlay(DRIVE_TYPE drive_type, int unit, const char *md5, const char *name, const char *description,
+                         const char *image_path, const char *overlay_path) {
     MountedDriveInfo_t* drives = NULL;
     int max_units = 0;
 
@@ -463,6 +622,9 @@ void mount_drive(DRIVE_TYPE drive_type, int unit, const char *md5, const char *n
             return;
         }
     }
+
+    // No transfer may still be using the unit
+    BlockIO_Drain();
     
     // Handle image path (HTTP download or local file)
     if (image_path) {
@@ -480,6 +642,10 @@ void mount_drive(DRIVE_TYPE drive_type, int unit, const char *md5, const char *n
         
         // Check if it's an HTTP URL (case insensitive)
         if (strncasecmp(image_path, "http", 4) == 0) {
+            if (overlay_path) {
+                printf("mount_drive: An overlay needs a local image, not %s\n", image_path);
+                return;
+            }
             //printf("Downloading image from: %s\n", image_path);
             char* image_data = download_file(image_path);
             if (image_data) {
@@ -496,8 +662,8 @@ void mount_drive(DRIVE_TYPE drive_type, int unit, const char *md5, const char *n
             
             drives[unit].is_writeprotected = false;
 
-            // Local file - open for read-write binary
-            FILE* file = fopen(image_path, "rb+");
+            // Local file - open for read-write binary, under an overlay only for reading
+            FILE* file = fopen(image_path, overlay_path ? "rb" : "rb+");
             if (!file) {
                 int saved_errno = errno;
                 // If we dont have write access, try to open the file for read-only
@@ -518,6 +684,19 @@ void mount_drive(DRIVE_TYPE drive_type, int unit, const char *md5, const char *n
                 drives[unit].is_remote = false;
                 drives[unit].data.local_file = file;
                 drives[unit].data_size = (size_t)file_size;
+                if (overlay_path) {
+                    drives[unit].overlay = drive_overlay_open(overlay_path, image_path, (size_t)file_size);
+                    if (!drives[unit].overlay) {
+                        fclose(file);
+                        drives[unit].data.local_file = NULL;
+                        return;
+                    }
+                    strncpy(drives[unit].overlay_path, overlay_path, sizeof(drives[unit].overlay_path) - 1);
+                    drives[unit].overlay_path[sizeof(drives[unit].overlay_path) - 1] = '\0';
+                }
+                if (drive_type == DRIVE_SMD) {
+                    map_drive(&drives[unit]);
+                }
 
                 //printf("Opened local file: %s (size: %ld bytes)\n", image_path, file_size);
             } else {
@@ -589,6 +768,10 @@ void unmount_drive(DRIVE_TYPE drive_type, int unit) {
         return;
     }
     
+    // No transfer may still be using it, and its cached blocks go to the image before it closes
+    BlockIO_Drain();
+    drive_cache_drop(&drives[unit]);
+
     // Unmount the drive
     printf("Unmounting %s from %s unit %d:\n", 
            drives[unit].name,
@@ -606,7 +789,12 @@ void unmount_drive(DRIVE_TYPE drive_type, int unit) {
             drives[unit].data.remote_data = NULL;
         }
     } else {
-        // Close local file
+        // Close local file, the overlay first
+        if (drives[unit].overlay) {
+            drive_overlay_close(drives[unit].overlay);
+            drives[unit].overlay = NULL;
+        }
+        unmap_drive(&drives[unit]);
         if (drives[unit].data.local_file) {
             fclose(drives[unit].data.local_file);
             drives[unit].data.local_file = NULL;
@@ -621,6 +809,7 @@ void unmount_drive(DRIVE_TYPE drive_type, int unit) {
     drives[unit].name[0] = '\0';
     drives[unit].description[0] = '\0';
     drives[unit].image_path[0] = '\0';
+    drives[unit].overlay_path[0] = '\0';
     drives[unit].is_remote = false;
     drives[unit].data_size = 0;
     drives[unit].block_size = 0;
@@ -776,41 +965,10 @@ void mount_drive_gateway(DRIVE_TYPE drive_type, int unit, const char *name,
     drives[unit].image_path[0] = '\0';
 }
 
-// Callback-based block READ for block devices
-int machine_block_read(Device *device, uint8_t *buffer, size_t size, uint32_t blockAddress, int unit) {
-    if (!device || !buffer || size == 0) return -1;
-
-    DRIVE_TYPE drive_type = (device->type == DEVICE_TYPE_DISC_SMD) ? DRIVE_SMD : DRIVE_FLOPPY;
-    MountedDriveInfo_t *drives = (drive_type == DRIVE_SMD) ? smd_drives : floppy_drives;
-
-#ifdef FLOPPY_DIAG
-    // Diagnostic: log first floppy block read attempt
-    if (drive_type == DRIVE_FLOPPY) {
-        static int _floppy_read_log = 0;
-        if (_floppy_read_log < 5) {
-            _floppy_read_log++;
-            printf("[FLOPPY-DIAG] machine_block_read: unit=%d drives=%s mounted=%d gateway=%d opfs=%d remote=%d size=%d blkAddr=%u blkSize=%u\n",
-                unit,
-                drives ? "ok" : "NULL",
-                drives ? drives[unit].is_mounted : -1,
-                drives ? drives[unit].is_gateway : -1,
-                drives ? drives[unit].is_opfs : -1,
-                drives ? drives[unit].is_remote : -1,
-                drives ? (int)drives[unit].data_size : -1,
-                blockAddress, (unsigned)device->blockSizeBytes);
-        }
-    }
-#endif
-
-    if (!drives) return -1;
-
-    // block size is determined by the device; size is number of blocks
-    size_t bytes = size * device->blockSizeBytes;
-    size_t offset = (size_t)blockAddress * device->blockSizeBytes;
-
-    MountedDriveInfo_t *entry = &drives[unit];
-    if (!entry->is_mounted) return -1; // not mounted
-
+/// @brief Read bytes of a drive image, past its end reads as zeros
+/// @details The host side of machine_block_read(), and how the drive cache fills blocks.
+/// @return 0, or -1 on failure
+int drive_image_read(MountedDriveInfo_t *entry, DRIVE_TYPE drive_type, int unit, uint8_t *buffer, size_t bytes, size_t offset) {
 #ifdef __EMSCRIPTEN__
     if (entry->is_opfs && opfs_is_available_js(unit)) {
         int rc = opfs_block_read_js(unit, buffer, (int)bytes, (int)offset);
@@ -818,7 +976,7 @@ int machine_block_read(Device *device, uint8_t *buffer, size_t size, uint32_t bl
         if ((size_t)rc < bytes) {
             memset(buffer + rc, 0, bytes - rc);
         }
-        return (int)size;
+        return 0;
     }
 
     if (entry->is_gateway && gateway_is_available_js((int)drive_type, unit)) {
@@ -827,13 +985,20 @@ int machine_block_read(Device *device, uint8_t *buffer, size_t size, uint32_t bl
         if ((size_t)rc < bytes) {
             memset(buffer + rc, 0, bytes - rc);
         }
-        return (int)size;
+        return 0;
     }
+#else
+    (void)drive_type;
+    (void)unit;
 #endif
 
+    if (entry->overlay) {
+        return drive_overlay_read(entry, buffer, bytes, offset);
+    }
+
     if (entry->is_remote) {
         if (!entry->data.remote_data) return -1;
-        if (offset >= entry->data_size) return 0;
+        if (offset >= entry->data_size) return -1;
         size_t to_copy = bytes;
         if (offset + to_copy > entry->data_size) {
             to_copy = entry->data_size - offset;
@@ -842,6 +1007,8 @@ int machine_block_read(Device *device, uint8_t *buffer, size_t size, uint32_t bl
         if (to_copy < bytes) {
             memset(buffer + to_copy, 0, bytes - to_copy);
         }
+    } else if (entry->mapped && offset + bytes <= entry->data_size) {
+        memcpy(buffer, entry->mapped + offset, bytes);
     } else {
         if (!entry->data.local_file) return -1;
         if (fseek(entry->data.local_file, (long)offset, SEEK_SET) != 0) return -1;
@@ -850,47 +1017,121 @@ int machine_block_read(Device *device, uint8_t *buffer, size_t size, uint32_t bl
             memset(buffer + read_bytes, 0, bytes - read_bytes);
         }
     }
-    return (int)size; // number of blocks
+    return 0;
 }
 
-// Callback-based block WRITE for block devices
-int machine_block_write(Device *device, const uint8_t *buffer, size_t size, uint32_t blockAddress, int unit) {
-    if (!device || !buffer || size == 0) return -1;
-
-    DRIVE_TYPE drive_type = (device->type == DEVICE_TYPE_DISC_SMD) ? DRIVE_SMD : DRIVE_FLOPPY;
-    MountedDriveInfo_t *drives = (drive_type == DRIVE_SMD) ? smd_drives : floppy_drives;
-    if (!drives) return -1;
-
-    // block size is determined by the device; size is number of blocks
-    size_t bytes = size * device->blockSizeBytes;
-    size_t offset = (size_t)blockAddress * device->blockSizeBytes;
-
-    MountedDriveInfo_t *entry = &drives[unit];
-    if (!entry->is_mounted) return -1; // not mounted
-
+/// @brief Write bytes to a drive image
+/// @details The host side of machine_block_write(), and how the drive cache writes blocks back.
+/// @return 0, or -1 on failure
+int drive_image_write(MountedDriveInfo_t *entry, DRIVE_TYPE drive_type, int unit, const uint8_t *buffer, size_t bytes, size_t offset) {
 #ifdef __EMSCRIPTEN__
     if (entry->is_opfs && opfs_is_available_js(unit)) {
         int rc = opfs_block_write_js(unit, buffer, (int)bytes, (int)offset);
-        return (rc >= 0) ? (int)size : -1;
+        return (rc >= 0) ? 0 : -1;
     }
 
     if (entry->is_gateway && gateway_is_available_js((int)drive_type, unit)) {
         int rc = gateway_block_write_js((int)drive_type, unit, buffer, (int)bytes, (int)offset);
-        return (rc >= 0) ? (int)size : -1;
+        return (rc >= 0) ? 0 : -1;
     }
+#else
+    (void)drive_type;
+    (void)unit;
 #endif
 
+    if (entry->overlay) {
+        if (drive_overlay_write(entry, buffer, bytes, offset) < 0) return -1;
+        if (driveFlush == DRIVE_FLUSH_IMMEDIATE) {
+            sync_drive(entry);
+        }
+        return 0;
+    }
+
     if (entry->is_remote) {
         // For remote images in-memory, allow write if buffer exists and fits
         if (!entry->data.remote_data) return -1;
         if (offset + bytes > entry->data_size) return -1; // out of bounds
         memcpy(entry->data.remote_data + offset, buffer, bytes);
+    } else if (entry->mapped && !entry->is_writeprotected && offset + bytes <= entry->data_size) {
+        memcpy(entry->mapped + offset, buffer, bytes);
+        atomic_store(&entry->mapped_dirty, true);
+        if (driveFlush == DRIVE_FLUSH_IMMEDIATE) {
+            sync_drive(entry);
+        }
     } else {
         if (!entry->data.local_file) return -1;
         if (fseek(entry->data.local_file, (long)offset, SEEK_SET) != 0) return -1;
-        fwrite(buffer, 1, bytes, entry->data.local_file);
-        fflush(entry->data.local_file);
+        if (fwrite(buffer, 1, bytes, entry->data.local_file) != bytes) return -1;
+        if (fflush(entry->data.local_file) != 0) return -1;
+    }
+    return 0;
+}
+
+// Callback-based block READ for block devices
+int machine_block_read(Device *device, uint8_t *buffer, size_t size, uint32_t blockAddress, int unit) {
+    if (!device || !buffer || size == 0) return -1;
+
+    DRIVE_TYPE drive_type = (device->type == DEVICE_TYPE_DISC_SMD) ? DRIVE_SMD : DRIVE_FLOPPY;
+    MountedDriveInfo_t *drives = (drive_type == DRIVE_SMD) ? smd_drives : floppy_drives;
+
+#ifdef FLOPPY_DIAG
+    // Diagnostic: log first floppy block read attempt
+    if (drive_type == DRIVE_FLOPPY) {
+        static int _floppy_read_log = 0;
+        if (_floppy_read_log < 5) {
+            _floppy_read_log++;
+            printf("[FLOPPY-DIAG] machine_block_read: unit=%d drives=%s mounted=%d gateway=%d opfs=%d remote=%d size=%d blkAddr=%u blkSize=%u\n",
+                unit,
+                drives ? "ok" : "NULL",
+                drives ? drives[unit].is_mounted : -1,
+                drives ? drives[unit].is_gateway : -1,
+                drives ? drives[unit].is_opfs : -1,
+                drives ? drives[unit].is_remote : -1,
+                drives ? (int)drives[unit].data_size : -1,
+                blockAddress, (unsigned)device->blockSizeBytes);
+        }
     }
+#endif
+
+    if (!drives) return -1;
+
+    // block size is determined by the device; size is number of blocks
+    size_t bytes = size * device->blockSizeBytes;
+    size_t offset = (size_t)blockAddress * device->blockSizeBytes;
+
+    MountedDriveInfo_t *entry = &drives[unit];
+    if (!entry->is_mounted) return -1; // not mounted
+
+    if (drive_cache_enabled(entry)) {
+        return drive_cache_read(entry, drive_type, unit, buffer, size, blockAddress, (uint32_t)device->blockSizeBytes);
+    }
+
+    if (drive_image_read(entry, drive_type, unit, buffer, bytes, offset) < 0) return -1;
+    return (int)size; // number of blocks
+}
+
+// Callback-based block WRITE for block devices
+int machine_block_write(Device *device, const uint8_t *buffer, size_t size, uint32_t blockAddress, int unit) {
+    if (!device || !buffer || size == 0) return -1;
+
+    DRIVE_TYPE drive_type = (device->type == DEVICE_TYPE_DISC_SMD) ? DRIVE_SMD : DRIVE_FLOPPY;
+    MountedDriveInfo_t *drives = (drive_type == DRIVE_SMD) ? smd_drives : floppy_drives;
+    if (!drives) return -1;
+
+    // block size is determined by the device; size is number of blocks
+    size_t bytes = size * device->blockSizeBytes;
+    size_t offset = (size_t)blockAddress * device->blockSizeBytes;
+
+    MountedDriveInfo_t *entry = &drives[unit];
+    if (!entry->is_mounted) return -1; // not mounted
+
+    // A write protected image keeps its blocks, the cache must not pretend otherwise
+    if (drive_cache_enabled(entry) && !entry->is_writeprotected) {
+        return drive_cache_write(entry, drive_type, unit, buffer, size, blockAddress, (uint32_t)device->blockSizeBytes,
+                                 driveFlush == DRIVE_FLUSH_IMMEDIATE);
+    }
+
+    if (drive_image_write(entry, drive_type, unit, buffer, bytes, offset) < 0) return -1;
     return (int)size;
 }
 
@@ -0,0 +1,70 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MACHINE_CONTEXT_H
+#define MACHINE_CONTEXT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Machine context.
+//
+// All state of one emulated ND-100 hangs off a Machine, so one process can run several
+// machines, each on its own thread. gMachine is the machine of the calling thread.
+// machine_create() makes a new machine current, machine_bind() attaches another thread
+// to it (a machine thread, the debugger thread).
+//
+// The cpu, devices and machine code keep using the familiar names (instr_counter, gReg,
+// VolatileMemory, ...), which are macros on the current machine. Each layer keeps its
+// part behind its own pointer; the cpu part is also cached in gCpu (cpu_types.h).
+//
+// Threads that are not machine threads (telnet clients, HDLC modem workers) have no
+// machine. They only touch device data through their device pointer and HostWait_Signal().
+// The block I/O workers (devices/blockio.c) bind the machine of a request only while
+// they run its block callback.
+
+struct CpuState;            // cpu/cpu_types.h
+struct DeviceManager;       // devices/devices_types.h
+struct MachineDrives;       // machine/machine_types.h
+struct SnapshotChain;       // machine/snapshot.c
+
+typedef struct Machine {
+    // Virtual time (cpu.c). Devices are ticked when instr_counter reaches io_next_tick.
+    // io_next_event is the earliest deadline that is not just an input poll; an idle CPU
+    // may fast-forward instr_counter up to it.
+    uint64_t instrCounter;
+    uint64_t ioNextTick;
+    uint64_t ioNextEvent;
+
+    struct CpuState *cpu;
+    struct DeviceManager *devices;
+    struct MachineDrives *drives;
+    struct SnapshotChain *snapshot;     // NULL until the first snapshot is saved or restored
+} Machine;
+
+extern _Thread_local Machine *gMachine;
+
+#define instr_counter   (gMachine->instrCounter)
+#define io_next_tick    (gMachine->ioNextTick)
+#define io_next_event   (gMachine->ioNextEvent)
+
+#endif // MACHINE_CONTEXT_H
@@ -51,6 +51,32 @@ typedef enum {
     DRIVE_FLOPPY
 } DRIVE_TYPE;
 
+// When writes to memory mapped drive images are synced to the file. Written blocks are in
+// the host page cache at once in all modes; this only decides when msync() makes them durable.
+typedef enum {
+    DRIVE_FLUSH_SHUTDOWN,   // On unmount (the kernel also writes dirty pages back on its own)
+    DRIVE_FLUSH_IMMEDIATE,  // After every write
+    DRIVE_FLUSH_PERIODIC    // When the frontend calls machine_flush_drives()
+} DRIVE_FLUSH;
+
+// Copy-on-write overlay of a drive image (overlay.c): a sparse file holding the written
+// blocks, with a bitmap of which ones it has. Everything else is read from the base image.
+#define OVERLAY_MAGIC           "ND100OVL"
+#define OVERLAY_VERSION         1
+#define OVERLAY_BLOCK_BYTES     1024    // An SMD sector
+#define OVERLAY_BITMAP_OFFSET   4096    // The header is in front of it
+
+typedef struct {
+    char path[1024];
+    FILE *file;
+    uint8_t *map;           // Shared mapping of the whole overlay file, or NULL (file I/O)
+    size_t map_size;
+    uint8_t *bitmap;        // Bit n set: block n is in the overlay. In the mapping, or malloc'd
+    uint32_t blocks;        // Blocks in the base image
+    size_t data_offset;     // Block n is at data_offset + n * OVERLAY_BLOCK_BYTES
+    atomic_bool dirty;      // Written since the last sync (set by the block I/O workers)
+} DriveOverlay;
+
 // Mounted drive information structure
 typedef struct {
     char md5[33];
@@ -68,7 +94,37 @@ typedef struct {
         char* remote_data;  // Downloaded data for remote files
     } data;
     size_t data_size;       // Size of the data in bytes
+    uint8_t *mapped;        // Shared mapping of a local SMD image (data_size bytes), or NULL
+    atomic_bool mapped_dirty;   // Mapping written since the last msync (set by the block I/O workers)
+    DriveOverlay *overlay;  // Overlay the writes go to (the image is then only read), or NULL
+    char overlay_path[1024];    // Its file, or empty
     int block_size;         // Block size for this drive (256, 512, 1024 bytes)
+    uint32_t cache_block_size;  // Block size the drive cache holds this drive's blocks in, or 0
+    uint32_t cache_next_block;  // Block after the last read, to spot sequential reads
 } MountedDriveInfo_t;
 
+// Drive block cache (drivecache.c)
+#define DRIVE_CACHE_DEFAULT_KB          4096    // Default size, --disk-cache
+#define DRIVE_CACHE_PAGE_BYTES          2048    // A SINTRAN page (1K words), the unit it moves file and swap data in
+#define DRIVE_CACHE_READAHEAD_PAGES     4       // Pages read ahead of a sequential stream
+#define DRIVE_CACHE_FLUSH_BLOCKS        64      // Most dirty blocks written back in one image transfer
+#define DRIVE_CACHE_WRITEBACK_SECONDS   5       // How often the frontends write dirty blocks back
+
+typedef struct {
+    uint64_t hits;          // Blocks read from the cache
+    uint64_t misses;        // Blocks read from the image
+    uint64_t prefetched;    // Blocks read ahead
+    uint64_t prefetchHits;  // Blocks read ahead that were then read
+    uint64_t writes;        // Blocks written to the cache
+    uint64_t writebacks;    // Dirty blocks written to the image
+    uint64_t evictions;     // Blocks dropped to make room
+} DriveCacheStats;
+
+// Mounted drives of one machine (Machine.drives), allocated by init_drive_arrays()
+struct MachineDrives {
+    MountedDriveInfo_t *floppy;     // Units 0-2
+    MountedDriveInfo_t *smd;        // Units 0-3
+    DRIVE_FLUSH flush;              // Flush policy of memory mapped images, see machine_set_drive_flush()
+};
+
 #endif
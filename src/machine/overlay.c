@@ -0,0 +1,481 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Copy-on-write overlay images
+//
+// A drive mounted with an overlay only reads its image (the base), so any number of
+// machines can share one base image and its pages in the host page cache. Written blocks
+// go to the overlay file:
+//
+//   0                      header (OverlayHeader)
+//   OVERLAY_BITMAP_OFFSET  one bit per block of the base, set when the block is here
+//   data_offset            block n at data_offset + n * OVERLAY_BLOCK_BYTES
+//
+// The file is sparse: only the blocks written take space. drive_overlay_commit() writes
+// the blocks into the base image, drive_overlay_discard() throws them away.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#include <unistd.h>
+#define OVERLAY_MMAP
+#endif
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+typedef struct {
+    char magic[8];          // OVERLAY_MAGIC
+    uint32_t version;       // OVERLAY_VERSION
+    uint32_t blockBytes;    // OVERLAY_BLOCK_BYTES
+    uint64_t imageBytes;    // Size of the base image
+    uint64_t dataOffset;
+    int64_t baseMtime;      // Modification time of the base image when the overlay was made
+    char basePath[1024];    // Absolute path of the base image
+} OverlayHeader;
+
+static int64_t file_mtime(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    return (int64_t)st.st_mtime;
+}
+
+// False if the path does not fit, a cut path would name another file
+static bool absolute_path(const char *path, char *out, size_t size)
+{
+#ifdef _WIN32
+    if (_fullpath(out, path, size))
+        return true;
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved))
+        path = resolved;
+#endif
+    int n = snprintf(out, size, "%s", path);
+    return n >= 0 && (size_t)n < size;
+}
+
+static bool read_header(FILE *f, OverlayHeader *header, const char *path)
+{
+    if (fseek(f, 0, SEEK_SET) != 0 || fread(header, sizeof(*header), 1, f) != 1 ||
+        memcmp(header->magic, OVERLAY_MAGIC, sizeof(header->magic)) != 0)
+    {
+        fprintf(stderr, "Overlay: %s is not an overlay file\n", path);
+        return false;
+    }
+    if (header->version != OVERLAY_VERSION || header->blockBytes != OVERLAY_BLOCK_BYTES)
+    {
+        fprintf(stderr, "Overlay: %s has an unsupported format (version %u)\n", path, header->version);
+        return false;
+    }
+    header->basePath[sizeof(header->basePath) - 1] = '\0';
+    return true;
+}
+
+static uint32_t image_blocks(uint64_t imageBytes)
+{
+    return (uint32_t)((imageBytes + OVERLAY_BLOCK_BYTES - 1) / OVERLAY_BLOCK_BYTES);
+}
+
+static bool has_block(const DriveOverlay *ov, size_t block)
+{
+    return (ov->bitmap[block >> 3] >> (block & 7)) & 1;
+}
+
+// Read from the base image, past its end reads as zeros
+static int read_base(MountedDriveInfo_t *entry, uint8_t *buffer, size_t bytes, size_t offset)
+{
+    if (entry->mapped && offset + bytes <= entry->data_size)
+    {
+        memcpy(buffer, entry->mapped + offset, bytes);
+        return 0;
+    }
+
+    size_t got = 0;
+    if (offset < entry->data_size)
+    {
+        if (!entry->data.local_file || fseek(entry->data.local_file, (long)offset, SEEK_SET) != 0)
+            return -1;
+        got = fread(buffer, 1, bytes, entry->data.local_file);
+    }
+    memset(buffer + got, 0, bytes - got);
+    return 0;
+}
+
+static int read_block(DriveOverlay *ov, size_t block, size_t within, uint8_t *buffer, size_t bytes)
+{
+    size_t offset = ov->data_offset + block * OVERLAY_BLOCK_BYTES + within;
+    if (ov->map)
+    {
+        memcpy(buffer, ov->map + offset, bytes);
+        return 0;
+    }
+    if (fseek(ov->file, (long)offset, SEEK_SET) != 0 || fread(buffer, 1, bytes, ov->file) != bytes)
+        return -1;
+    return 0;
+}
+
+static int write_block(DriveOverlay *ov, size_t block, const uint8_t *data)
+{
+    size_t offset = ov->data_offset + block * OVERLAY_BLOCK_BYTES;
+    uint8_t bit = (uint8_t)(1 << (block & 7));
+
+    if (ov->map)
+    {
+        memcpy(ov->map + offset, data, OVERLAY_BLOCK_BYTES);
+        ov->bitmap[block >> 3] |= bit;
+        return 0;
+    }
+
+    // The data first, a set bit must never point at a block that is not there
+    if (fseek(ov->file, (long)offset, SEEK_SET) != 0 ||
+        fwrite(data, OVERLAY_BLOCK_BYTES, 1, ov->file) != 1)
+        return -1;
+    if (!(ov->bitmap[block >> 3] & bit))
+    {
+        ov->bitmap[block >> 3] |= bit;
+        if (fseek(ov->file, (long)(OVERLAY_BITMAP_OFFSET + (block >> 3)), SEEK_SET) != 0 ||
+            fputc(ov->bitmap[block >> 3], ov->file) == EOF)
+            return -1;
+    }
+    return 0;
+}
+
+/// @brief Open the overlay of a base image, creating an empty one if the file does not exist
+/// @param imageBytes Size of the base image
+/// @return The overlay, or NULL if it could not be opened or belongs to another image
+DriveOverlay *drive_overlay_open(const char *path, const char *basePath, size_t imageBytes)
+{
+    OverlayHeader header;
+    uint32_t blocks = image_blocks(imageBytes);
+    bool created = false;
+
+    FILE *f = fopen(path, "rb+");
+    if (f)
+    {
+        if (!read_header(f, &header, path))
+        {
+            fclose(f);
+            return NULL;
+        }
+        if (header.imageBytes != imageBytes)
+        {
+            fprintf(stderr, "Overlay: %s is for a %llu byte image, %s has %zu bytes\n", path,
+                    (unsigned long long)header.imageBytes, basePath, imageBytes);
+            fclose(f);
+            return NULL;
+        }
+        if (header.baseMtime && file_mtime(basePath) != header.baseMtime)
+        {
+            fprintf(stderr, "Overlay: warning, %s changed after the overlay %s was made\n", basePath, path);
+        }
+    }
+    else
+    {
+        f = fopen(path, "wb+");
+        if (!f)
+        {
+            fprintf(stderr, "Overlay: cannot create %s\n", path);
+            return NULL;
+        }
+        created = true;
+
+        size_t bitmapBytes = (blocks + 7) / 8;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, OVERLAY_MAGIC, sizeof(header.magic));
+        header.version = OVERLAY_VERSION;
+        header.blockBytes = OVERLAY_BLOCK_BYTES;
+        header.imageBytes = imageBytes;
+        header.dataOffset = (OVERLAY_BITMAP_OFFSET + bitmapBytes + 4095) & ~(uint64_t)4095;
+        header.baseMtime = file_mtime(basePath);
+        if (!absolute_path(basePath, header.basePath, sizeof(header.basePath)))
+        {
+            fprintf(stderr, "Overlay: the path of %s is too long to record in %s\n", basePath, path);
+            fclose(f);
+            remove(path);
+            return NULL;
+        }
+
+        uint8_t *zeros = (uint8_t *)calloc(1, bitmapBytes ? bitmapBytes : 1);
+        bool written = zeros &&
+                       fwrite(&header, sizeof(header), 1, f) == 1 &&
+                       fseek(f, OVERLAY_BITMAP_OFFSET, SEEK_SET) == 0 &&
+                       fwrite(zeros, 1, bitmapBytes, f) == bitmapBytes &&
+                       fflush(f) == 0;
+        free(zeros);
+        if (!written)
+        {
+            fprintf(stderr, "Overlay: cannot write %s\n", path);
+            fclose(f);
+            return NULL;
+        }
+    }
+
+    DriveOverlay *ov = (DriveOverlay *)calloc(1, sizeof(DriveOverlay));
+    if (!ov)
+    {
+        fclose(f);
+        return NULL;
+    }
+    snprintf(ov->path, sizeof(ov->path), "%s", path);
+    ov->file = f;
+    ov->blocks = blocks;
+    ov->data_offset = (size_t)header.dataOffset;
+
+#ifdef OVERLAY_MMAP
+    // Sized for every block up front; the blocks never written stay holes.
+    // Only a new overlay is extended, a truncate would touch the mtime snapshots check.
+    // An existing one of another size (written without a mapping) uses file I/O.
+    size_t size = ov->data_offset + (size_t)blocks * OVERLAY_BLOCK_BYTES;
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 &&
+        ((size_t)st.st_size == size || (created && ftruncate(fileno(f), (off_t)size) == 0)))
+    {
+        void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(f), 0);
+        if (map != MAP_FAILED)
+        {
+            ov->map = (uint8_t *)map;
+            ov->map_size = size;
+            ov->bitmap = ov->map + OVERLAY_BITMAP_OFFSET;
+            return ov;
+        }
+    }
+#endif
+
+    // No mapping: file I/O, unbuffered so reads see the blocks just written
+    size_t bitmapBytes = (blocks + 7) / 8;
+    ov->bitmap = (uint8_t *)calloc(1, bitmapBytes ? bitmapBytes : 1);
+    if (!ov->bitmap ||
+        fseek(f, OVERLAY_BITMAP_OFFSET, SEEK_SET) != 0 ||
+        fread(ov->bitmap, 1, bitmapBytes, f) != bitmapBytes)
+    {
+        fprintf(stderr, "Overlay: cannot read %s\n", path);
+        free(ov->bitmap);
+        free(ov);
+        fclose(f);
+        return NULL;
+    }
+    setvbuf(f, NULL, _IONBF, 0);
+    return ov;
+}
+
+/// @brief Read bytes of a drive with an overlay: its blocks from the overlay, the rest from the base
+/// @return 0, or -1 on failure
+int drive_overlay_read(MountedDriveInfo_t *entry, uint8_t *buffer, size_t bytes, size_t offset)
+{
+    DriveOverlay *ov = entry->overlay;
+
+    while (bytes > 0)
+    {
+        size_t block = offset / OVERLAY_BLOCK_BYTES;
+        size_t within = offset % OVERLAY_BLOCK_BYTES;
+        size_t n = OVERLAY_BLOCK_BYTES - within;
+        if (n > bytes)
+            n = bytes;
+
+        int rc = (block < ov->blocks && has_block(ov, block))
+                     ? read_block(ov, block, within, buffer, n)
+                     : read_base(entry, buffer, n, offset);
+        if (rc < 0)
+            return -1;
+
+        buffer += n;
+        offset += n;
+        bytes -= n;
+    }
+    return 0;
+}
+
+/// @brief Write bytes of a drive with an overlay, to the overlay
+/// @return 0, or -1 on failure or past the end of the image
+int drive_overlay_write(MountedDriveInfo_t *entry, const uint8_t *buffer, size_t bytes, size_t offset)
+{
+    DriveOverlay *ov = entry->overlay;
+    if (offset + bytes > (size_t)ov->blocks * OVERLAY_BLOCK_BYTES)
+        return -1;
+
+    while (bytes > 0)
+    {
+        size_t block = offset / OVERLAY_BLOCK_BYTES;
+        size_t within = offset % OVERLAY_BLOCK_BYTES;
+        size_t n = OVERLAY_BLOCK_BYTES - within;
+        if (n > bytes)
+            n = bytes;
+
+        const uint8_t *data = buffer;
+        uint8_t merged[OVERLAY_BLOCK_BYTES];
+        if (n < OVERLAY_BLOCK_BYTES)
+        {
+            // Part of a block (small floppy sectors): the rest as the drive has it now
+            if (drive_overlay_read(entry, merged, OVERLAY_BLOCK_BYTES, block * OVERLAY_BLOCK_BYTES) < 0)
+                return -1;
+            memcpy(merged + within, buffer, n);
+            data = merged;
+        }
+        if (write_block(ov, block, data) < 0)
+            return -1;
+
+        buffer += n;
+        offset += n;
+        bytes -= n;
+    }
+    atomic_store(&ov->dirty, true);
+    return 0;
+}
+
+/// @brief Make the blocks written to an overlay durable
+void drive_overlay_sync(DriveOverlay *ov)
+{
+    // Cleared before the sync, a block I/O worker may write again meanwhile
+    if (!atomic_exchange(&ov->dirty, false))
+        return;
+
+#ifdef OVERLAY_MMAP
+    if (ov->map)
+    {
+        msync(ov->map, ov->map_size, MS_SYNC);
+        return;
+    }
+#endif
+    fflush(ov->file);
+}
+
+/// @brief Sync and close an overlay
+void drive_overlay_close(DriveOverlay *ov)
+{
+    if (!ov)
+        return;
+
+    drive_overlay_sync(ov);
+#ifdef OVERLAY_MMAP
+    if (ov->map)
+        munmap(ov->map, ov->map_size);
+    else
+#endif
+        free(ov->bitmap);
+    fclose(ov->file);
+    free(ov);
+}
+
+/// @brief Write the blocks of an overlay into its base image, then delete the overlay
+/// @details No machine may have either file mounted. Other overlays of the same base no
+/// longer match it afterwards.
+/// @return true on success
+bool drive_overlay_commit(const char *path)
+{
+    OverlayHeader header;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Overlay: cannot open %s\n", path);
+        return false;
+    }
+    if (!read_header(f, &header, path))
+    {
+        fclose(f);
+        return false;
+    }
+
+    FILE *base = fopen(header.basePath, "rb+");
+    if (!base)
+    {
+        fprintf(stderr, "Overlay: cannot open the base image %s for writing\n", header.basePath);
+        fclose(f);
+        return false;
+    }
+    fseek(base, 0, SEEK_END);
+    if ((uint64_t)ftell(base) != header.imageBytes)
+    {
+        fprintf(stderr, "Overlay: %s is no longer the size %s was made for\n", header.basePath, path);
+        fclose(base);
+        fclose(f);
+        return false;
+    }
+
+    uint32_t blocks = image_blocks(header.imageBytes);
+    size_t bitmapBytes = (blocks + 7) / 8;
+    uint8_t *bitmap = (uint8_t *)malloc(bitmapBytes ? bitmapBytes : 1);
+    bool ok = bitmap &&
+              fseek(f, OVERLAY_BITMAP_OFFSET, SEEK_SET) == 0 &&
+              fread(bitmap, 1, bitmapBytes, f) == bitmapBytes;
+
+    uint32_t committed = 0;
+    for (uint32_t block = 0; ok && block < blocks; block++)
+    {
+        if (!((bitmap[block >> 3] >> (block & 7)) & 1))
+            continue;
+
+        uint8_t data[OVERLAY_BLOCK_BYTES];
+        uint64_t offset = (uint64_t)block * OVERLAY_BLOCK_BYTES;
+        size_t n = OVERLAY_BLOCK_BYTES;
+        if (offset + n > header.imageBytes)
+            n = (size_t)(header.imageBytes - offset);
+
+        ok = fseek(f, (long)(header.dataOffset + offset), SEEK_SET) == 0 &&
+             fread(data, 1, n, f) == n &&
+             fseek(base, (long)offset, SEEK_SET) == 0 &&
+             fwrite(data, 1, n, base) == n;
+        committed++;
+    }
+    free(bitmap);
+    fclose(f);
+    if (fclose(base) != 0)
+        ok = false;
+
+    if (!ok)
+    {
+        fprintf(stderr, "Overlay: committing %s to %s failed, the overlay is kept\n", path, header.basePath);
+        return false;
+    }
+
+    remove(path);
+    printf("Overlay: %u blocks of %s committed to %s\n", committed, path, header.basePath);
+    return true;
+}
+
+/// @brief Delete an overlay, dropping the blocks written to it
+/// @return true on success
+bool drive_overlay_discard(const char *path)
+{
+    OverlayHeader header;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Overlay: cannot open %s\n", path);
+        return false;
+    }
+    bool ok = read_header(f, &header, path);
+    fclose(f);
+
+    // Only ever delete a file that is an overlay
+    if (!ok || remove(path) != 0)
+        return false;
+    printf("Overlay: %s discarded, %s is as it was\n", path, header.basePath);
+    return true;
+}
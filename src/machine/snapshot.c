@@ -0,0 +1,795 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Machine snapshots.
+ *
+ * A snapshot holds everything needed to continue a running machine: CPU registers,
+ * physical memory, the page table shadow RAM, virtual time, the drive table and the
+ * state of every device including pending IO delays. Disk images are not part of the
+ * snapshot, they are remounted from the recorded paths and must not have changed.
+ *
+ * State is stored field by field in versioned records (StateRecord, device.c), all values
+ * little endian, so a snapshot does not depend on the build or host that wrote it. Pending
+ * device IO delays are stored by callback ID (Device.ioDelayCallbacks), not by address.
+ *
+ * Layout:
+ *   "ND100SNP", header record
+ *   'CPU ' CPU record with the registers, CPU state and shadow RAM
+ *   'MEM ' record with a bitmap of non-zero 1K pages, then those pages
+ *   'DRV ' one record per floppy and SMD unit
+ *   'DEV ' one identity record per device, followed by Device_SaveState()
+ *   'END '
+ *   checkpoint records, each with the same sections, see below
+ *
+ * Checkpoints: machine_checkpoint_snapshot() appends a 'DLTA' record to the file last
+ * written or restored, holding the CPU, drive and device state and only the memory pages
+ * written since the previous record (memDirtyPages). Restore applies the base and then
+ * every complete record in order. The record length is filled in last, so a record cut
+ * short by a crash is ignored and the machine comes back at the checkpoint before it.
+ *
+ * Snapshots must be taken and restored between instructions, i.e. outside cpu_run().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+#include "../devices/devices_types.h"
+#include "../devices/devices_protos.h"
+
+#include "../ndlib/ndlib_types.h"
+#include "../ndlib/ndlib_protos.h"
+
+#include "../cpu/cpu_types.h"
+#include "../cpu/cpu_protos.h"
+
+#define SNAPSHOT_MAGIC "ND100SNP"
+#define SNAPSHOT_MAGIC_BYTES 8
+#define SNAPSHOT_VERSION 2          // Version 1 was a raw image of host structures
+
+// Record versions, raised when the fields change
+#define SNAPSHOT_CPU_VERSION 1
+#define SNAPSHOT_MEM_VERSION 1
+#define SNAPSHOT_DRIVE_VERSION 1
+#define SNAPSHOT_DEVICE_ID_VERSION 1
+
+#define SNAPSHOT_TAG(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define TAG_CPU SNAPSHOT_TAG('C', 'P', 'U', ' ')
+#define TAG_MEM SNAPSHOT_TAG('M', 'E', 'M', ' ')
+#define TAG_DRV SNAPSHOT_TAG('D', 'R', 'V', ' ')
+#define TAG_DEV SNAPSHOT_TAG('D', 'E', 'V', ' ')
+#define TAG_END SNAPSHOT_TAG('E', 'N', 'D', ' ')
+#define TAG_DELTA SNAPSHOT_TAG('D', 'L', 'T', 'A')
+
+#define SNAPSHOT_PAGE_WORDS 1024
+
+#define FLOPPY_UNITS 3
+#define SMD_UNITS 4
+
+typedef struct {
+    uint32_t memoryPages;
+    uint32_t shadowRamSize;
+    int32_t deviceCount;
+} SnapshotHeader;
+
+typedef struct {
+    MountedDriveInfo_t info;    // Only the names, paths, flags and size are stored
+    int64_t mtime;              // Modification time of a local image file when the snapshot was taken
+} SnapshotDrive;
+
+// Written as fixed little endian fields, as the length is filled in afterwards
+typedef struct {
+    uint32_t tag;               // TAG_DELTA
+    uint32_t sequence;          // 1 for the first checkpoint after the base
+    uint64_t length;            // Bytes following this header, 0 until the record is complete
+} SnapshotDeltaHeader;
+
+#define SNAPSHOT_DELTA_BYTES 16     // SnapshotDeltaHeader in the file
+
+// File that checkpoints are appended to: the snapshot last written or restored (Machine.snapshot)
+struct SnapshotChain {
+    char path[1024];
+    uint32_t sequence;
+    bool valid;
+};
+
+#define chainPath     (gMachine->snapshot->path)
+#define chainSequence (gMachine->snapshot->sequence)
+#define chainValid    (gMachine->snapshot->valid)
+
+// Check that there is a machine, and allocate its chain state on first use
+static bool snapshot_machine_ready(void)
+{
+    if (!gCpu)
+        return false;
+
+    if (!gMachine->snapshot)
+        gMachine->snapshot = calloc(1, sizeof(struct SnapshotChain));
+    return gMachine->snapshot != NULL;
+}
+
+// Memory now matches the last record of 'path', further checkpoints go there
+static void chain_start(const char *path, uint32_t sequence)
+{
+    chainValid = strlen(path) < sizeof(chainPath);
+    if (chainValid)
+        strcpy(chainPath, path);
+    chainSequence = sequence;
+    memset(memDirtyPages, 0, sizeof(memDirtyPages));
+}
+
+static bool write_tag(FILE *f, uint32_t tag)
+{
+    return Device_WriteStateU32(f, tag);
+}
+
+static bool read_tag(FILE *f, uint32_t tag)
+{
+    uint32_t value;
+    return Device_ReadStateU32(f, &value) && (value == tag);
+}
+
+static bool write_delta_header(FILE *f, const SnapshotDeltaHeader *delta)
+{
+    return Device_WriteStateU32(f, delta->tag) &&
+           Device_WriteStateU32(f, delta->sequence) &&
+           Device_WriteStateU32(f, (uint32_t)delta->length) &&
+           Device_WriteStateU32(f, (uint32_t)(delta->length >> 32));
+}
+
+static bool read_delta_header(FILE *f, SnapshotDeltaHeader *delta)
+{
+    uint32_t low, high;
+    if (!Device_ReadStateU32(f, &delta->tag) ||
+        !Device_ReadStateU32(f, &delta->sequence) ||
+        !Device_ReadStateU32(f, &low) ||
+        !Device_ReadStateU32(f, &high))
+        return false;
+    delta->length = low | ((uint64_t)high << 32);
+    return true;
+}
+
+static int64_t image_mtime(const char *path)
+{
+    struct stat st;
+    if (!path || !path[0] || stat(path, &st) != 0)
+        return 0;
+    return (int64_t)st.st_mtime;
+}
+
+// A drive is remounted by path unless it is backed by OPFS or the gateway, which the frontend owns
+static bool drive_mounted_by_path(const MountedDriveInfo_t *info)
+{
+    return info->image_path[0] && !info->is_opfs && !info->is_gateway;
+}
+
+// The file the drive's writes go to: its overlay, or the image
+static const char *drive_state_path(const MountedDriveInfo_t *info)
+{
+    return info->overlay_path[0] ? info->overlay_path : info->image_path;
+}
+
+/*
+ * SAVE
+ */
+
+static bool save_cpu(FILE *f)
+{
+    StateRecord rec;
+
+    if (!write_tag(f, TAG_CPU))
+        return false;
+
+    StateRecord_Begin(&rec, SNAPSHOT_CPU_VERSION);
+    StateRecord_PutWords(&rec, &gReg->reg[0][0], 16 * 16);
+    StateRecord_PutU16(&rec, gReg->reg_STS);
+    StateRecord_PutU16(&rec, gReg->reg_PANS);
+    StateRecord_PutU16(&rec, gReg->reg_PANC);
+    StateRecord_PutU16(&rec, gReg->reg_OPR);
+    StateRecord_PutU16(&rec, gReg->reg_LMP);
+    StateRecord_PutU16(&rec, gReg->reg_PGS);
+    StateRecord_PutWords(&rec, gReg->reg_PCR, 16);
+    StateRecord_PutU16(&rec, gReg->reg_PVL);
+    StateRecord_PutU16(&rec, gReg->reg_IIC);
+    StateRecord_PutU16(&rec, gReg->reg_IID);
+    StateRecord_PutU16(&rec, gReg->reg_IIE);
+    StateRecord_PutU16(&rec, gReg->reg_PID);
+    StateRecord_PutU16(&rec, gReg->reg_PIE);
+    StateRecord_PutU16(&rec, gReg->reg_CSR);
+    StateRecord_PutU16(&rec, gReg->reg_CCL);
+    StateRecord_PutU16(&rec, gReg->reg_LCIL);
+    StateRecord_PutU16(&rec, gReg->reg_ALD);
+    StateRecord_PutU16(&rec, gReg->reg_UCIL);
+    StateRecord_PutU16(&rec, gReg->reg_PES);
+    StateRecord_PutU16(&rec, gReg->reg_PGC);
+    StateRecord_PutU16(&rec, gReg->reg_PEA);
+    StateRecord_PutU16(&rec, gReg->reg_ECCR);
+    StateRecord_PutU16(&rec, gReg->myreg_IR);
+    StateRecord_PutU16(&rec, gReg->myreg_PFB);
+    StateRecord_PutU16(&rec, gReg->effectiveAddress);
+    StateRecord_PutBool(&rec, gReg->useAPT);
+    StateRecord_PutBool(&rec, gReg->mylock_PEA);
+    StateRecord_PutBool(&rec, gReg->mylock_PES);
+    StateRecord_PutBool(&rec, gReg->mylock_PGS);
+    StateRecord_PutU16(&rec, gReg->myreg_PK);
+    StateRecord_PutBool(&rec, gReg->chkit);
+    StateRecord_PutBool(&rec, gReg->has_instr_cntr);
+    StateRecord_PutU16(&rec, gReg->instructioncounter);
+    StateRecord_PutBool(&rec, gReg->has_breakpoint);
+    StateRecord_PutU16(&rec, gReg->breakpoint);
+
+    StateRecord_PutU64(&rec, instr_counter);
+    StateRecord_PutBool(&rec, cpu_wait_idle);
+    StateRecord_PutBool(&rec, activateSleep);
+    StateRecord_PutWords(&rec, gPT.shadowRam, gPT.shadowRamSize);
+    return StateRecord_Write(&rec, f);
+}
+
+static bool page_is_zero(const ushort *page)
+{
+    for (int i = 0; i < 1024; i++)
+    {
+        if (page[i])
+            return false;
+    }
+    return true;
+}
+
+// Store the pages set in 'dirty', or all non-zero pages for a base snapshot (dirty == NULL)
+static bool save_memory(FILE *f, const uint8_t *dirty)
+{
+    // Most of memory is never touched by a booted system, so only non-zero pages are stored
+    uint8_t used[MEM_DIRTY_BYTES];
+    if (dirty)
+    {
+        memcpy(used, dirty, sizeof(used));
+    }
+    else
+    {
+        memset(used, 0, sizeof(used));
+        for (uint32_t p = 0; p < VolatileMemory.pages; p++)
+        {
+            if (!page_is_zero(ND_Page(p)))
+                used[p >> 3] |= (uint8_t)(1 << (p & 7));
+        }
+    }
+
+    StateRecord rec;
+    StateRecord_Begin(&rec, SNAPSHOT_MEM_VERSION);
+    StateRecord_PutBytes(&rec, used, sizeof(used));
+    if (!write_tag(f, TAG_MEM) || !StateRecord_Write(&rec, f))
+        return false;
+
+    for (uint32_t p = 0; p < VolatileMemory.pages; p++)
+    {
+        if ((used[p >> 3] & (1 << (p & 7))) &&
+            !Device_WriteStateWords(f, ND_Page(p), SNAPSHOT_PAGE_WORDS))
+            return false;
+    }
+    return true;
+}
+
+static bool save_drives(FILE *f, DRIVE_TYPE type, int units)
+{
+    MountedDriveInfo_t *drives = list_mount(type);
+    for (int unit = 0; unit < units; unit++)
+    {
+        static const MountedDriveInfo_t none;
+        const MountedDriveInfo_t *info = drives ? &drives[unit] : &none;
+        int64_t mtime = 0;
+        if (info->is_mounted && !info->is_remote && drive_mounted_by_path(info))
+            mtime = image_mtime(drive_state_path(info));
+
+        StateRecord rec;
+        StateRecord_Begin(&rec, SNAPSHOT_DRIVE_VERSION);
+        StateRecord_PutString(&rec, info->md5);
+        StateRecord_PutString(&rec, info->name);
+        StateRecord_PutString(&rec, info->description);
+        StateRecord_PutString(&rec, info->image_path);
+        StateRecord_PutString(&rec, info->overlay_path);
+        StateRecord_PutBool(&rec, info->is_mounted);
+        StateRecord_PutBool(&rec, info->is_remote);
+        StateRecord_PutBool(&rec, info->is_writeprotected);
+        StateRecord_PutBool(&rec, info->is_opfs);
+        StateRecord_PutBool(&rec, info->is_gateway);
+        StateRecord_PutU64(&rec, info->data_size);
+        StateRecord_PutInt(&rec, info->block_size);
+        StateRecord_PutU64(&rec, (uint64_t)mtime);
+        if (!StateRecord_Write(&rec, f))
+            return false;
+    }
+    return true;
+}
+
+static bool save_devices(FILE *f)
+{
+    if (!write_tag(f, TAG_DEV))
+        return false;
+
+    int count = DeviceManager_GetDeviceCount();
+    for (int i = 0; i < count; i++)
+    {
+        Device *dev = DeviceManager_GetDeviceByIndex(i);
+        StateRecord rec;
+        StateRecord_Begin(&rec, SNAPSHOT_DEVICE_ID_VERSION);
+        StateRecord_PutInt(&rec, dev ? (int32_t)dev->type : DEVICE_TYPE_NONE);
+        StateRecord_PutU16(&rec, dev ? dev->identCode : 0);
+        StateRecord_PutU32(&rec, dev ? dev->startAddress : 0);
+
+        if (!StateRecord_Write(&rec, f))
+            return false;
+        if (dev && !Device_SaveState(dev, f))
+        {
+            Log(LOG_ERROR, "Snapshot: failed to save device %s\n", dev->memoryName);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Everything after the header (base) or the record header (checkpoint)
+static bool save_state(FILE *f, const uint8_t *dirty)
+{
+    // The images get every block written so far, the drive table records their mtime
+    BlockIO_Drain();
+    if (machine_writeback_drives() < 0) {
+        Log(LOG_ERROR, "Snapshot: the drive images could not be written\n");
+        return false;
+    }
+
+    return save_cpu(f) &&
+           save_memory(f, dirty) &&
+           write_tag(f, TAG_DRV) &&
+           save_drives(f, DRIVE_FLOPPY, FLOPPY_UNITS) &&
+           save_drives(f, DRIVE_SMD, SMD_UNITS) &&
+           save_devices(f) &&
+           write_tag(f, TAG_END);
+}
+
+/// @brief Write the machine state to a snapshot file. Call between instructions only.
+/// @param path File to write
+/// @return true on success
+bool machine_save_snapshot(const char *path)
+{
+    if (!path || !snapshot_machine_ready())
+        return false;
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        Log(LOG_ERROR, "Snapshot: cannot create %s\n", path);
+        return false;
+    }
+
+    StateRecord header;
+    StateRecord_Begin(&header, SNAPSHOT_VERSION);
+    StateRecord_PutU32(&header, VolatileMemory.pages);
+    StateRecord_PutU32(&header, gPT.shadowRamSize);
+    StateRecord_PutInt(&header, DeviceManager_GetDeviceCount());
+
+    bool ok = (fwrite(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_BYTES, 1, f) == 1) &&
+              StateRecord_Write(&header, f) &&
+              save_state(f, NULL);
+
+    if (fclose(f) != 0)
+        ok = false;
+
+    if (ok)
+    {
+        chain_start(path, 0);
+        Log(LOG_INFO, "Snapshot saved to %s at instruction %llu\n", path, (unsigned long long)instr_counter);
+    }
+    else
+    {
+        chainValid = false;
+        Log(LOG_ERROR, "Snapshot: failed to write %s\n", path);
+    }
+    return ok;
+}
+
+/// @brief Append the changes since the last snapshot or checkpoint to the snapshot file.
+/// @details Only memory pages written since then are stored. If 'path' is not the file last
+///          saved or restored, or the previous checkpoint failed, a full snapshot is written.
+/// @param path Snapshot file
+/// @return true on success
+bool machine_checkpoint_snapshot(const char *path)
+{
+    if (!path || !snapshot_machine_ready())
+        return false;
+
+    if (!chainValid || strcmp(chainPath, path) != 0)
+        return machine_save_snapshot(path);
+
+    FILE *f = fopen(path, "r+b");
+    if (!f || fseek(f, 0, SEEK_END) != 0)
+    {
+        if (f)
+            fclose(f);
+        return machine_save_snapshot(path);
+    }
+
+    long start = ftell(f);
+    SnapshotDeltaHeader delta = {0};
+    delta.tag = TAG_DELTA;
+    delta.sequence = chainSequence + 1;
+
+    // Write the record with length 0, then fill in the length once the body is on disk
+    bool ok = (start >= 0) &&
+              write_delta_header(f, &delta) &&
+              save_state(f, memDirtyPages);
+    if (ok)
+    {
+        long end = ftell(f);
+        delta.length = (uint64_t)(end - start) - SNAPSHOT_DELTA_BYTES;
+        ok = (end > start) &&
+             (fflush(f) == 0) &&
+             (fseek(f, start, SEEK_SET) == 0) &&
+             write_delta_header(f, &delta);
+    }
+
+    if (fclose(f) != 0)
+        ok = false;
+
+    if (!ok)
+    {
+        // Restore stops at the broken record, so later records would be lost: start over next time
+        chainValid = false;
+        Log(LOG_ERROR, "Snapshot: failed to append checkpoint to %s\n", path);
+        return false;
+    }
+
+    chain_start(path, delta.sequence);
+    return true;
+}
+
+/*
+ * RESTORE
+ */
+
+static bool load_cpu(FILE *f)
+{
+    struct CpuRegs regs;
+    StateRecord rec;
+
+    if (!read_tag(f, TAG_CPU) || !StateRecord_Read(&rec, f, SNAPSHOT_CPU_VERSION))
+        return false;
+
+    // Debugger settings belong to this session, not to the snapshot
+    memset(&regs, 0, sizeof(regs));
+    regs.debugger_enabled = gReg->debugger_enabled;
+    regs.debugger_port = gReg->debugger_port;
+
+    StateRecord_GetWords(&rec, &regs.reg[0][0], 16 * 16);
+    regs.reg_STS = StateRecord_GetU16(&rec);
+    regs.reg_PANS = StateRecord_GetU16(&rec);
+    regs.reg_PANC = StateRecord_GetU16(&rec);
+    regs.reg_OPR = StateRecord_GetU16(&rec);
+    regs.reg_LMP = StateRecord_GetU16(&rec);
+    regs.reg_PGS = StateRecord_GetU16(&rec);
+    StateRecord_GetWords(&rec, regs.reg_PCR, 16);
+    regs.reg_PVL = StateRecord_GetU16(&rec);
+    regs.reg_IIC = StateRecord_GetU16(&rec);
+    regs.reg_IID = StateRecord_GetU16(&rec);
+    regs.reg_IIE = StateRecord_GetU16(&rec);
+    regs.reg_PID = StateRecord_GetU16(&rec);
+    regs.reg_PIE = StateRecord_GetU16(&rec);
+    regs.reg_CSR = StateRecord_GetU16(&rec);
+    regs.reg_CCL = StateRecord_GetU16(&rec);
+    regs.reg_LCIL = StateRecord_GetU16(&rec);
+    regs.reg_ALD = StateRecord_GetU16(&rec);
+    regs.reg_UCIL = StateRecord_GetU16(&rec);
+    regs.reg_PES = StateRecord_GetU16(&rec);
+    regs.reg_PGC = StateRecord_GetU16(&rec);
+    regs.reg_PEA = StateRecord_GetU16(&rec);
+    regs.reg_ECCR = StateRecord_GetU16(&rec);
+    regs.myreg_IR = StateRecord_GetU16(&rec);
+    regs.myreg_PFB = StateRecord_GetU16(&rec);
+    regs.effectiveAddress = StateRecord_GetU16(&rec);
+    regs.useAPT = StateRecord_GetBool(&rec);
+    regs.mylock_PEA = StateRecord_GetBool(&rec);
+    regs.mylock_PES = StateRecord_GetBool(&rec);
+    regs.mylock_PGS = StateRecord_GetBool(&rec);
+    regs.myreg_PK = StateRecord_GetU16(&rec);
+    regs.chkit = StateRecord_GetBool(&rec);
+    regs.has_instr_cntr = StateRecord_GetBool(&rec);
+    regs.instructioncounter = StateRecord_GetU16(&rec);
+    regs.has_breakpoint = StateRecord_GetBool(&rec);
+    regs.breakpoint = StateRecord_GetU16(&rec);
+
+    uint64_t instrCounter = StateRecord_GetU64(&rec);
+    bool waitIdle = StateRecord_GetBool(&rec);
+    bool sleepActivated = StateRecord_GetBool(&rec);
+    StateRecord_GetWords(&rec, gPT.shadowRam, gPT.shadowRamSize);
+    if (!StateRecord_End(&rec))
+        return false;
+
+    // Outside cpu_run the flags are in STS, nothing is pending
+    *gReg = regs;
+    memset(&gCpu->lazyFlags, 0, sizeof(LazyFlags));
+    SyncLevelRegs();
+
+    instr_counter = instrCounter;
+    cpu_wait_idle = waitIdle;
+    activateSleep = sleepActivated;
+    return true;
+}
+
+// A checkpoint only holds the pages written since the previous record, the rest is kept
+static bool load_memory(FILE *f, bool checkpoint)
+{
+    uint8_t used[MEM_DIRTY_BYTES];
+    StateRecord rec;
+    if (!read_tag(f, TAG_MEM) || !StateRecord_Read(&rec, f, SNAPSHOT_MEM_VERSION))
+        return false;
+    StateRecord_GetBytes(&rec, used, sizeof(used));
+    if (!StateRecord_End(&rec))
+        return false;
+
+    for (uint32_t p = 0; p < VolatileMemory.pages; p++)
+    {
+        if (used[p >> 3] & (1 << (p & 7)))
+        {
+            if (!Device_ReadStateWords(f, ND_Page(p), SNAPSHOT_PAGE_WORDS))
+                return false;
+        }
+        else if (!checkpoint)
+        {
+            memset(ND_Page(p), 0, SNAPSHOT_PAGE_WORDS * sizeof(ushort));
+        }
+    }
+    return true;
+}
+
+static bool read_drive(FILE *f, SnapshotDrive *saved)
+{
+    StateRecord rec;
+    if (!StateRecord_Read(&rec, f, SNAPSHOT_DRIVE_VERSION))
+        return false;
+
+    MountedDriveInfo_t *info = &saved->info;
+    memset(saved, 0, sizeof(*saved));
+    StateRecord_GetString(&rec, info->md5, sizeof(info->md5));
+    StateRecord_GetString(&rec, info->name, sizeof(info->name));
+    StateRecord_GetString(&rec, info->description, sizeof(info->description));
+    StateRecord_GetString(&rec, info->image_path, sizeof(info->image_path));
+    StateRecord_GetString(&rec, info->overlay_path, sizeof(info->overlay_path));
+    info->is_mounted = StateRecord_GetBool(&rec);
+    info->is_remote = StateRecord_GetBool(&rec);
+    info->is_writeprotected = StateRecord_GetBool(&rec);
+    info->is_opfs = StateRecord_GetBool(&rec);
+    info->is_gateway = StateRecord_GetBool(&rec);
+    info->data_size = (size_t)StateRecord_GetU64(&rec);
+    info->block_size = StateRecord_GetInt(&rec);
+    saved->mtime = (int64_t)StateRecord_GetU64(&rec);
+    return StateRecord_End(&rec);
+}
+
+static bool load_drives(FILE *f, DRIVE_TYPE type, int units)
+{
+    const char *typeName = (type == DRIVE_SMD) ? "SMD" : "floppy";
+
+    init_drive_arrays();
+    MountedDriveInfo_t *drives = list_mount(type);
+    if (!drives)
+        return false;
+
+    for (int unit = 0; unit < units; unit++)
+    {
+        SnapshotDrive saved;
+        if (!read_drive(f, &saved))
+            return false;
+
+        // A drive mounted now but not in the snapshot is left alone, the restored OS does not know it
+        if (!saved.info.is_mounted)
+            continue;
+
+        MountedDriveInfo_t *entry = &drives[unit];
+        if (drive_mounted_by_path(&saved.info) &&
+            (!entry->is_mounted || strcmp(entry->image_path, saved.info.image_path) != 0 ||
+             strcmp(entry->overlay_path, saved.info.overlay_path) != 0))
+        {
+            if (entry->is_mounted)
+                unmount_drive(type, unit);
+            mount_drive_overlay(type, unit, saved.info.md5, saved.info.name, saved.info.description,
+                                saved.info.image_path, saved.info.overlay_path[0] ? saved.info.overlay_path : NULL);
+        }
+
+        // Buffer, OPFS and gateway drives are mounted by the frontend before restoring
+        if (!entry->is_mounted || entry->data_size != saved.info.data_size)
+        {
+            Log(LOG_ERROR, "Snapshot: %s unit %d must hold %s (%zu bytes)\n",
+                typeName, unit, saved.info.name, saved.info.data_size);
+            return false;
+        }
+
+        if (saved.mtime && image_mtime(drive_state_path(entry)) != saved.mtime)
+        {
+            Log(LOG_WARNING, "Snapshot: %s unit %d image %s changed after the snapshot was taken\n",
+                typeName, unit, drive_state_path(entry));
+        }
+    }
+    return true;
+}
+
+static bool load_devices(FILE *f, int count)
+{
+    if (!read_tag(f, TAG_DEV))
+        return false;
+
+    for (int i = 0; i < count; i++)
+    {
+        Device *dev = DeviceManager_GetDeviceByIndex(i);
+        StateRecord rec;
+        if (!StateRecord_Read(&rec, f, SNAPSHOT_DEVICE_ID_VERSION))
+            return false;
+        int32_t type = StateRecord_GetInt(&rec);
+        uint16_t identCode = StateRecord_GetU16(&rec);
+        uint32_t startAddress = StateRecord_GetU32(&rec);
+        if (!StateRecord_End(&rec))
+            return false;
+
+        if (!dev || type != (int32_t)dev->type || identCode != dev->identCode ||
+            startAddress != dev->startAddress)
+        {
+            Log(LOG_ERROR, "Snapshot: device %d does not match the configured machine\n", i);
+            return false;
+        }
+        if (!Device_LoadState(dev, f))
+        {
+            Log(LOG_ERROR, "Snapshot: failed to restore device %s\n", dev->memoryName);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool load_state(FILE *f, int deviceCount, bool checkpoint)
+{
+    return load_cpu(f) &&
+           load_memory(f, checkpoint) &&
+           read_tag(f, TAG_DRV) &&
+           load_drives(f, DRIVE_FLOPPY, FLOPPY_UNITS) &&
+           load_drives(f, DRIVE_SMD, SMD_UNITS) &&
+           load_devices(f, deviceCount) &&
+           read_tag(f, TAG_END);
+}
+
+// Apply the checkpoint records after the base. Returns the last sequence applied, -1 on error.
+static int64_t load_checkpoints(FILE *f, const char *path, int deviceCount)
+{
+    long start = ftell(f);
+    if (start < 0 || fseek(f, 0, SEEK_END) != 0)
+        return -1;
+    long size = ftell(f);
+    if (fseek(f, start, SEEK_SET) != 0)
+        return -1;
+
+    uint32_t sequence = 0;
+    for (;;)
+    {
+        SnapshotDeltaHeader delta;
+        if (!read_delta_header(f, &delta))
+            break; // End of file
+
+        start += SNAPSHOT_DELTA_BYTES;
+        if (delta.tag != TAG_DELTA || delta.sequence != sequence + 1 ||
+            delta.length == 0 || delta.length > (uint64_t)(size - start))
+        {
+            Log(LOG_WARNING, "Snapshot: incomplete checkpoint %u in %s ignored\n", sequence + 1, path);
+            break;
+        }
+
+        if (!load_state(f, deviceCount, true) || ftell(f) != start + (long)delta.length)
+            return -1;
+
+        start += (long)delta.length;
+        sequence = delta.sequence;
+    }
+    return sequence;
+}
+
+/// @brief Replace the machine state with a snapshot written by machine_save_snapshot.
+/// @details The machine must have the same devices configured as when the snapshot was taken.
+///          Checkpoints appended to the file are applied, and later ones are appended to it.
+///          On failure the machine is reset, as a partly restored machine can not run.
+/// @param path Snapshot file
+/// @return true on success
+bool machine_restore_snapshot(const char *path)
+{
+    if (!path || !snapshot_machine_ready())
+        return false;
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        Log(LOG_ERROR, "Snapshot: cannot open %s\n", path);
+        return false;
+    }
+
+    char magic[SNAPSHOT_MAGIC_BYTES];
+    if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0)
+    {
+        Log(LOG_ERROR, "Snapshot: %s is not a snapshot file\n", path);
+        fclose(f);
+        return false;
+    }
+
+    SnapshotHeader header;
+    StateRecord rec;
+    bool known = StateRecord_Read(&rec, f, SNAPSHOT_VERSION);
+    if (known)
+    {
+        header.memoryPages = StateRecord_GetU32(&rec);
+        header.shadowRamSize = StateRecord_GetU32(&rec);
+        header.deviceCount = StateRecord_GetInt(&rec);
+        known = StateRecord_End(&rec);
+    }
+    if (!known)
+    {
+        Log(LOG_ERROR, "Snapshot: %s is in an older or newer format this nd100x does not read\n", path);
+        fclose(f);
+        return false;
+    }
+
+    if (header.memoryPages != VolatileMemory.pages || header.shadowRamSize != gPT.shadowRamSize ||
+        header.deviceCount != DeviceManager_GetDeviceCount())
+    {
+        Log(LOG_ERROR, "Snapshot: %s does not match the configured machine\n", path);
+        fclose(f);
+        return false;
+    }
+
+    // From here on the machine state is overwritten
+    int64_t sequence = -1;
+    if (load_state(f, header.deviceCount, false))
+        sequence = load_checkpoints(f, path, header.deviceCount);
+    bool ok = (sequence >= 0);
+    fclose(f);
+
+    // Cached translations and decoded code refer to the old memory contents
+    FlushTLB();
+    DecodeCache_Flush();
+
+    if (!ok)
+    {
+        Log(LOG_ERROR, "Snapshot: %s is damaged, machine reset\n", path);
+        chainValid = false;
+        cpu_reset();
+        DeviceManager_MasterClear();
+        return false;
+    }
+
+    // Let the device scheduler recompute its deadlines from the restored devices
+    io_next_tick = instr_counter;
+    io_next_event = instr_counter;
+
+    chain_start(path, (uint32_t)sequence);
+    Log(LOG_INFO, "Snapshot restored from %s at instruction %llu (%u checkpoints)\n", path,
+        (unsigned long long)instr_counter, (unsigned)sequence);
+    return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hostwait.h"
+
+#if defined(__EMSCRIPTEN__)
+
+// =============================================================================
+// WASM: the browser drives the emulator one frame at a time, never block.
+// =============================================================================
+
+void HostWait_Signal(void)
+{
+}
+
+bool HostWait_Sleep(uint64_t ns)
+{
+    (void)ns;
+    return false;
+}
+
+#else
+
+// =============================================================================
+// POSIX and Windows (winpthreads): condition variable with a signal generation.
+// Each sleeping thread (one per machine) remembers the last generation it saw,
+// so one signal wakes every machine and is kept for those that are not asleep.
+// =============================================================================
+
+#include <pthread.h>
+#include <time.h>
+
+static pthread_mutex_t waitMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t waitCond = PTHREAD_COND_INITIALIZER;
+static uint64_t waitGeneration = 0;
+static _Thread_local uint64_t seenGeneration = 0;
+
+void HostWait_Signal(void)
+{
+    pthread_mutex_lock(&waitMutex);
+    waitGeneration++;
+    pthread_cond_broadcast(&waitCond);
+    pthread_mutex_unlock(&waitMutex);
+}
+
+bool HostWait_Sleep(uint64_t ns)
+{
+    // pthread_cond_timedwait takes an absolute CLOCK_REALTIME deadline
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t)(ns / 1000000000ULL);
+    deadline.tv_nsec += (long)(ns % 1000000000ULL);
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&waitMutex);
+    while (seenGeneration == waitGeneration)
+    {
+        if (pthread_cond_timedwait(&waitCond, &waitMutex, &deadline) != 0)
+            break; // Timed out
+    }
+    bool woken = (seenGeneration != waitGeneration);
+    seenGeneration = waitGeneration;
+    pthread_mutex_unlock(&waitMutex);
+
+    return woken;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * nd100x - ND100 Virtual Machine
+ *
+ * Copyright (c) 2025 Ronny Hansen
+ *
+ * This file is originated from the nd100x project and the RetroCore project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the nd100em
+ * distribution in the file COPYING); if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOSTWAIT_H
+#define HOSTWAIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host side wake-up for the idle CPU.
+//
+// When the emulated CPU is idle, cpu_run() sleeps the host thread with
+// HostWait_Sleep() until the next device deadline. Anything that produces
+// input from outside the CPU thread (keyboard, telnet clients, HDLC modem
+// worker, disk completions) calls HostWait_Signal() so the sleep ends at once.
+//
+// A signal that arrives while a CPU thread is not sleeping is kept for that
+// thread, and makes its next HostWait_Sleep() return immediately. With several
+// machines in one process, a signal wakes all of them.
+//
+// WASM: single threaded, HostWait_Sleep() never blocks.
+
+// Wake the CPU threads sleeping in HostWait_Sleep(). Safe from any thread.
+void HostWait_Signal(void);
+
+// Sleep up to 'ns' nanoseconds. Returns true if woken by HostWait_Signal().
+bool HostWait_Sleep(uint64_t ns);
+
+#endif // HOSTWAIT_H
@@ -34,7 +34,7 @@ const char *level_str[] = {
     "ERROR"};
 
 
-LogLevel minLogLevel = LOG_DEBUG;
+_Atomic LogLevel minLogLevel = LOG_DEBUG;
 
 static LogOutputFunc logOutputFunc = NULL;
 
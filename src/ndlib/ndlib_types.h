@@ -68,8 +68,8 @@ typedef enum {
 } LogLevel;
 
 /// @brief Minimum log level for filtering messages
-/// @details Messages below this level will not be logged.
-extern LogLevel minLogLevel;
+/// @details Messages below this level will not be logged. Atomic, every machine sets it from its own thread.
+extern _Atomic LogLevel minLogLevel;
 
 
 /// @brief Array of log level strings for formatting output
@@ -829,6 +829,7 @@ onmessage = function(e) {
     case 'stop': {
       running = false;
       Module._Stop();
+      Module._FlushDrives();  // Blocks held in the drive cache
       postMessage({ type: 'stopped', snapshot: buildSnapshot() });
       break;
     }
@@ -1205,6 +1206,7 @@ onmessage = function(e) {
     }
 
     case 'ws-disconnect': {
+      Module._FlushDrives();  // Cached gateway blocks go out while the disk worker is still there
       wsDisconnect();
       closeDiskWorker();
       break;
@@ -1252,6 +1254,7 @@ onmessage = function(e) {
         postMessage({ type: 'full-image-data', id: msg.id, error: 'Disk worker not connected' });
         break;
       }
+      Module._FlushDrives();  // The image must hold the blocks still in the drive cache
       _fullReadRequestId = msg.id;
       _diskWorker.postMessage({ type: 'read-full', driveType: msg.driveType,
                                 unit: msg.unit, size: msg.size });
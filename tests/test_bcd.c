@@ -0,0 +1,371 @@
+/*
+ * Decimal instructions (src/cpu/bcd.c): ADDD, SUBD, COMD, SHDE, PACK, UPACK.
+ *
+ * Fields are written to memory, the descriptors set in A/D and X/T, and the
+ * instruction run. Each case checks the result field, the skip (success) or
+ * error return, and for PACK and UPACK the error code in D.
+ *
+ * BCD fields are written as strings of nibbles ("0123C"), ASCII fields as
+ * strings of characters.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+#define OP1  0100
+#define OP2  0200
+#define PC   01000
+
+/* D2 descriptor bits */
+#define LR         0100000
+#define UNSIGNED   0020000
+#define ROUND      0002000
+#define EMBEDDED_TRAILING  (0 << 11)
+#define SEPARATE_TRAILING  (1 << 11)
+#define EMBEDDED_LEADING   (2 << 11)
+#define SEPARATE_LEADING   (3 << 11)
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("  FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint16_t descriptor(int length, int point, int flags)
+{
+    return (uint16_t)(flags | (point << 5) | length);
+}
+
+static void clear(uint32_t addr)
+{
+    for (int i = 0; i < 8; i++)
+        write_memory(addr + i, 0);
+}
+
+/* Nibbles left to right from the left byte of 'addr' */
+static void put_bcd(uint32_t addr, const char *nibbles)
+{
+    clear(addr);
+    for (int k = 0; nibbles[k]; k++) {
+        char c = nibbles[k];
+        int v = (c >= 'A') ? c - 'A' + 10 : c - '0';
+        uint32_t a = addr + k / 4;
+        write_memory(a, (uint16_t)(ReadPhysicalMemory(a, false) | (v << ((3 - k % 4) * 4))));
+    }
+}
+
+static const char *get_bcd(uint32_t addr, int length)
+{
+    static char text[40];
+    for (int k = 0; k < length; k++)
+        text[k] = "0123456789ABCDEF"[(ReadPhysicalMemory(addr + k / 4, false) >> ((3 - k % 4) * 4)) & 0x0F];
+    text[length] = '\0';
+    return text;
+}
+
+/* Characters from byte 'first' of 'addr' (1: the right byte) */
+static void put_ascii(uint32_t addr, int first, const char *chars)
+{
+    for (int k = 0; chars[k]; k++) {
+        uint32_t a = addr + (k + first) / 2;
+        uint16_t w = ReadPhysicalMemory(a, false);
+        w = ((k + first) & 1) ? (uint16_t)((w & 0xFF00) | (uint8_t)chars[k])
+                              : (uint16_t)((w & 0x00FF) | ((uint8_t)chars[k] << 8));
+        write_memory(a, w);
+    }
+}
+
+static const char *get_ascii(uint32_t addr, int first, int length)
+{
+    static char text[40];
+    for (int k = 0; k < length; k++) {
+        uint16_t w = ReadPhysicalMemory(addr + (k + first) / 2, false);
+        text[k] = (char)(((k + first) & 1) ? (w & 0xFF) : (w >> 8));
+    }
+    text[length] = '\0';
+    return text;
+}
+
+/* Run an instruction on the two descriptors; true if it skipped (no error) */
+static bool run(void (*instr)(ushort), uint16_t d2op1, uint16_t d2op2)
+{
+    gA = OP1;
+    gD = d2op1;
+    gX = OP2;
+    gT = d2op2;
+    gPC = PC;
+    instr(0);
+    return gPC == PC + 1;
+}
+
+static void check_bcd(uint32_t addr, const char *expected, const char *what)
+{
+    const char *got = get_bcd(addr, (int)strlen(expected));
+    CHECK(strcmp(got, expected) == 0, "%s: %s, expected %s", what, got, expected);
+}
+
+static void check_ascii(uint32_t addr, int first, const char *expected, const char *what)
+{
+    const char *got = get_ascii(addr, first, (int)strlen(expected));
+    CHECK(strcmp(got, expected) == 0, "%s: \"%s\", expected \"%s\"", what, got, expected);
+}
+
+static void test_add_sub(void)
+{
+    printf("[add and subtract]\n");
+
+    put_bcd(OP1, "0999C");
+    put_bcd(OP2, "0001C");
+    CHECK(run(ndfunc_addd, descriptor(5, 0, 0), descriptor(5, 0, 0)), "ADDD 999 + 1");
+    check_bcd(OP1, "1000C", "ADDD carry through three digits");
+
+    // The carry goes from digit 18 to 19, over the 16 digit word of the engine
+    put_bcd(OP1, "000000000000999999999999999999C");
+    put_bcd(OP2, "000000000000000000000000000001C");
+    CHECK(run(ndfunc_addd, descriptor(31, 0, 0), descriptor(31, 0, 0)), "ADDD 30 digits");
+    check_bcd(OP1, "000000000001000000000000000000C", "ADDD carry across the engine's words");
+
+    put_bcd(OP1, "1000C");
+    put_bcd(OP2, "0001C");
+    CHECK(run(ndfunc_subd, descriptor(5, 0, 0), descriptor(5, 0, 0)), "SUBD 1000 - 1");
+    check_bcd(OP1, "0999C", "SUBD borrow through three digits");
+
+    put_bcd(OP1, "000000000001000000000000000000C");
+    put_bcd(OP2, "000000000000000000000000000001C");
+    CHECK(run(ndfunc_subd, descriptor(31, 0, 0), descriptor(31, 0, 0)), "SUBD 30 digits");
+    check_bcd(OP1, "000000000000999999999999999999C", "SUBD borrow across the engine's words");
+
+    // Operands at different decimal points are aligned: 1.5 + 0.25
+    put_bcd(OP1, "00150C");
+    put_bcd(OP2, "025C");
+    CHECK(run(ndfunc_addd, descriptor(6, 2, 0), descriptor(4, 2, 0)), "ADDD 1.50 + 0.25");
+    check_bcd(OP1, "00175C", "ADDD with decimals");
+
+    // A carry out of the top digit is an overflow: error return, the low digits are kept
+    put_bcd(OP1, "999C");
+    put_bcd(OP2, "001C");
+    CHECK(!run(ndfunc_addd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "ADDD overflow must take the error return");
+    check_bcd(OP1, "000C", "ADDD overflow");
+}
+
+static void test_signs(void)
+{
+    printf("[signs]\n");
+
+    put_bcd(OP1, "005C");
+    put_bcd(OP2, "008C");
+    CHECK(run(ndfunc_subd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "SUBD 5 - 8");
+    check_bcd(OP1, "003D", "SUBD to a negative result");
+
+    put_bcd(OP1, "005D");
+    put_bcd(OP2, "003D");
+    CHECK(run(ndfunc_addd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "ADDD -5 + -3");
+    check_bcd(OP1, "008D", "ADDD of two negatives");
+
+    put_bcd(OP1, "003D");
+    put_bcd(OP2, "003C");
+    CHECK(run(ndfunc_addd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "ADDD -3 + 3");
+    check_bcd(OP1, "000C", "a zero sum is positive");
+
+    // An unsigned operand counts as plus; bit 13 of the result's D2 writes it unsigned
+    put_bcd(OP1, "007F");
+    put_bcd(OP2, "002D");
+    CHECK(run(ndfunc_addd, descriptor(4, 0, UNSIGNED), descriptor(4, 0, 0)), "ADDD 7 + -2, unsigned");
+    check_bcd(OP1, "005F", "ADDD unsigned result");
+
+    put_bcd(OP1, "005D");
+    put_bcd(OP2, "003C");
+    CHECK(run(ndfunc_comd, descriptor(4, 0, 0), descriptor(4, 0, 0)) && gA == 0xFFFF, "COMD -5 < 3");
+    put_bcd(OP1, "0007C");
+    put_bcd(OP2, "006C");
+    CHECK(run(ndfunc_comd, descriptor(5, 0, 0), descriptor(4, 0, 0)) && gA == 1, "COMD 7 > 6, unequal lengths");
+    put_bcd(OP1, "000D");
+    put_bcd(OP2, "000C");
+    CHECK(run(ndfunc_comd, descriptor(4, 0, 0), descriptor(4, 0, 0)) && gA == 0, "COMD -0 = +0");
+    CHECK(!strcmp(get_bcd(OP1, 4), "000D") && !strcmp(get_bcd(OP2, 4), "000C"), "COMD changed an operand");
+}
+
+static void test_illegal_digits(void)
+{
+    printf("[illegal digits]\n");
+
+    put_bcd(OP1, "0A5C");
+    put_bcd(OP2, "001C");
+    CHECK(!run(ndfunc_addd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "ADDD with an A digit must take the error return");
+    check_bcd(OP1, "0A5C", "ADDD with an illegal digit changed its operand");
+
+    put_bcd(OP1, "001C");
+    put_bcd(OP2, "0B1C");
+    CHECK(!run(ndfunc_subd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "SUBD with a B digit must take the error return");
+    CHECK(!run(ndfunc_comd, descriptor(4, 0, 0), descriptor(4, 0, 0)), "COMD with a B digit must take the error return");
+
+    // SHDE checks that its operand has a sign
+    put_bcd(OP1, "1234");
+    clear(OP2);
+    CHECK(!run(ndfunc_shde, descriptor(4, 0, 0), descriptor(5, 0, 0)), "SHDE without a sign must take the error return");
+
+    put_bcd(OP1, "1E3C");
+    CHECK(!run(ndfunc_unpack, descriptor(4, 0, 0), descriptor(3, 0, UNSIGNED)), "UPACK of an E digit must take the error return");
+    CHECK((gD & 0x1F) == 2, "UPACK illegal code: error code %d, expected 2", gD & 0x1F);
+
+    clear(OP1);
+    put_ascii(OP1, 0, "12x4");
+    CHECK(!run(ndfunc_pack, descriptor(4, 0, UNSIGNED), descriptor(5, 0, 0)), "PACK of 'x' must take the error return");
+    CHECK((gD & 0x1F) == 2, "PACK illegal code: error code %d, expected 2", gD & 0x1F);
+
+    clear(OP1);
+    put_ascii(OP1, 0, "123*");
+    CHECK(!run(ndfunc_pack, descriptor(4, 0, SEPARATE_TRAILING), descriptor(5, 0, 0)), "PACK of a '*' sign must take the error return");
+    CHECK((gD & 0x1F) == 2, "PACK illegal sign: error code %d, expected 2", gD & 0x1F);
+}
+
+static void test_shift(void)
+{
+    printf("[shift]\n");
+
+    // Left: 123 with two more decimals
+    put_bcd(OP1, "00123C");
+    clear(OP2);
+    CHECK(run(ndfunc_shde, descriptor(6, 0, 0), descriptor(6, 2, 0)), "SHDE left");
+    check_bcd(OP2, "12300C", "SHDE left");
+    put_bcd(OP1, "00012C");
+    CHECK(run(ndfunc_shde, descriptor(6, 1, 0), descriptor(6, 3, 0)), "SHDE left with decimals");
+    check_bcd(OP2, "01200C", "SHDE 1.2 to three decimals");
+
+    // Left past the top digit loses a significant digit
+    put_bcd(OP1, "12345C");
+    CHECK(!run(ndfunc_shde, descriptor(6, 0, 0), descriptor(6, 2, 0)), "SHDE left losing a digit must take the error return");
+
+    // Right: 12345 with two decimals fewer, with and without rounding
+    put_bcd(OP1, "12345D");
+    clear(OP2);
+    CHECK(run(ndfunc_shde, descriptor(6, 2, 0), descriptor(6, 0, 0)), "SHDE right");
+    check_bcd(OP2, "00123D", "SHDE right, truncated");
+    put_bcd(OP1, "12355D");
+    CHECK(run(ndfunc_shde, descriptor(6, 2, 0), descriptor(6, 0, ROUND)), "SHDE right, rounded");
+    check_bcd(OP2, "00124D", "SHDE right, rounded");
+    put_bcd(OP1, "12345C");
+    CHECK(run(ndfunc_shde, descriptor(6, 2, 0), descriptor(6, 1, ROUND)), "SHDE right by one, rounded");
+    check_bcd(OP2, "01235C", "SHDE 123.45 to one decimal");
+
+    // An unsigned operand becomes plus, unless the result is unsigned too
+    put_bcd(OP1, "00042F");
+    CHECK(run(ndfunc_shde, descriptor(6, 0, 0), descriptor(6, 0, 0)), "SHDE unsigned");
+    check_bcd(OP2, "00042C", "SHDE unsigned to plus");
+    CHECK(run(ndfunc_shde, descriptor(6, 0, 0), descriptor(6, 0, UNSIGNED)), "SHDE unsigned");
+    check_bcd(OP2, "00042F", "SHDE unsigned kept");
+}
+
+static void test_pack(void)
+{
+    printf("[pack and unpack]\n");
+
+    clear(OP1);
+    put_ascii(OP1, 0, "0123-");
+    CHECK(run(ndfunc_pack, descriptor(5, 0, SEPARATE_TRAILING), descriptor(6, 0, 0)), "PACK separate trailing");
+    check_bcd(OP2, "00123D", "PACK separate trailing");
+
+    clear(OP1);
+    put_ascii(OP1, 0, "+45");
+    CHECK(run(ndfunc_pack, descriptor(3, 0, SEPARATE_LEADING), descriptor(5, 0, 0)), "PACK separate leading");
+    check_bcd(OP2, "0045C", "PACK separate leading");
+
+    // Embedded: the sign is the zone of the last (or first) digit, 0111 for minus
+    clear(OP1);
+    put_ascii(OP1, 0, "12s");
+    CHECK(run(ndfunc_pack, descriptor(3, 0, EMBEDDED_TRAILING), descriptor(4, 0, 0)), "PACK embedded trailing");
+    check_bcd(OP2, "123D", "PACK embedded trailing");
+    clear(OP1);
+    put_ascii(OP1, 0, "q23");
+    CHECK(run(ndfunc_pack, descriptor(3, 0, EMBEDDED_LEADING), descriptor(4, 0, 0)), "PACK embedded leading");
+    check_bcd(OP2, "123D", "PACK embedded leading");
+
+    // Starting in the right byte of a word
+    clear(OP1);
+    put_ascii(OP1, 1, "789");
+    CHECK(run(ndfunc_pack, descriptor(3, 0, LR | UNSIGNED), descriptor(4, 0, UNSIGNED)), "PACK from the right byte");
+    check_bcd(OP2, "789F", "PACK from the right byte, unsigned");
+
+    // Decimals are aligned and rounded to the destination: 1.235 to 1.24
+    clear(OP1);
+    put_ascii(OP1, 0, "1235");
+    CHECK(run(ndfunc_pack, descriptor(4, 3, UNSIGNED), descriptor(4, 2, 0)), "PACK with decimals");
+    check_bcd(OP2, "124C", "PACK rounds to the destination's decimal point");
+
+    // Too many digits for the destination: overflow, the low digits are stored
+    clear(OP1);
+    put_ascii(OP1, 0, "12345");
+    CHECK(!run(ndfunc_pack, descriptor(5, 0, UNSIGNED), descriptor(4, 0, 0)), "PACK overflow must take the error return");
+    CHECK((gD & 0x1F) == 3, "PACK overflow: error code %d, expected 3", gD & 0x1F);
+    check_bcd(OP2, "345C", "PACK overflow");
+
+    put_bcd(OP1, "00123D");
+    clear(OP2);
+    CHECK(run(ndfunc_unpack, descriptor(6, 0, 0), descriptor(5, 0, SEPARATE_TRAILING)), "UPACK separate trailing");
+    check_ascii(OP2, 0, "0123-", "UPACK separate trailing");
+    CHECK(run(ndfunc_unpack, descriptor(6, 0, 0), descriptor(5, 0, SEPARATE_LEADING)), "UPACK separate leading");
+    check_ascii(OP2, 0, "-0123", "UPACK separate leading");
+    CHECK(run(ndfunc_unpack, descriptor(6, 0, 0), descriptor(4, 0, EMBEDDED_TRAILING)), "UPACK embedded trailing");
+    check_ascii(OP2, 0, "012s", "UPACK embedded trailing");
+    CHECK(run(ndfunc_unpack, descriptor(6, 0, 0), descriptor(3, 0, UNSIGNED)), "UPACK unsigned");
+    check_ascii(OP2, 0, "123", "UPACK unsigned");
+
+    // Into a field starting in a right byte: the left byte of its first word is kept
+    clear(OP2);
+    put_ascii(OP2, 0, "A");
+    put_bcd(OP1, "042C");
+    CHECK(run(ndfunc_unpack, descriptor(4, 0, 0), descriptor(4, 0, LR | SEPARATE_LEADING)), "UPACK to the right byte");
+    check_ascii(OP2, 0, "A+042", "UPACK to the right byte");
+
+    put_bcd(OP1, "12345C");
+    clear(OP2);
+    CHECK(!run(ndfunc_unpack, descriptor(6, 0, 0), descriptor(3, 0, UNSIGNED)), "UPACK overflow must take the error return");
+    CHECK((gD & 0x1F) == 3, "UPACK overflow: error code %d, expected 3", gD & 0x1F);
+    check_ascii(OP2, 0, "345", "UPACK overflow");
+
+    // Back and forth over the widest field, 31 nibbles or bytes
+    put_bcd(OP1, "123456789012345678901234567890D");
+    clear(OP2);
+    CHECK(run(ndfunc_unpack, descriptor(31, 0, 0), descriptor(31, 0, SEPARATE_TRAILING)), "UPACK 30 digits");
+    check_ascii(OP2, 0, "123456789012345678901234567890-", "UPACK 30 digits");
+    gA = OP2;
+    gD = descriptor(31, 0, SEPARATE_TRAILING);
+    gX = OP1;
+    gT = descriptor(31, 0, 0);
+    gPC = PC;
+    clear(OP1);
+    ndfunc_pack(0);
+    CHECK(gPC == PC + 1, "PACK 30 digits");
+    check_bcd(OP1, "123456789012345678901234567890D", "PACK 30 digits");
+}
+
+int main(void)
+{
+    machine_init(false, 0);
+
+    test_add_sub();
+    test_signs();
+    test_illegal_digits();
+    test_shift();
+    test_pack();
+
+    cleanup_machine();
+
+    if (failures == 0) {
+        printf("All BCD tests PASSED.\n");
+    } else {
+        printf("%d BCD test(s) FAILED.\n", failures);
+    }
+    return failures ? 1 : 0;
+}
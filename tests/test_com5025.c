@@ -0,0 +1,49 @@
+/*
+ * Unit tests for the COM5025 multi-protocol controller chip.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../src/devices/hdlc/chipCOM5025.h"
+
+static int failures = 0;
+
+#define ASSERT_EQ(a, b, msg) do { \
+    if ((a) != (b)) { \
+        printf("  FAIL: %s: expected 0x%04X, got 0x%04X (line %d)\n", msg, (unsigned)(b), (unsigned)(a), __LINE__); \
+        failures++; \
+    } \
+} while(0)
+
+static void test_registers_per_chip(void)
+{
+    printf("  test_registers_per_chip...");
+    // Every HDLC device has its own chip; one must not see the registers of another
+    COM5025State a, b;
+    COM5025_Init(&a);
+    COM5025_Reset(&a);
+    COM5025_Init(&b);
+    COM5025_Reset(&b);
+
+    COM5025_WriteByte(&a, COM5025_REG_BYTE_SYNC_ADDRESS, 0x5A);
+    COM5025_WriteByte(&b, COM5025_REG_BYTE_SYNC_ADDRESS, 0xA5);
+    ASSERT_EQ(COM5025_ReadByte(&a, COM5025_REG_BYTE_SYNC_ADDRESS), 0x5A, "chip A keeps its sync address");
+    ASSERT_EQ(COM5025_ReadByte(&b, COM5025_REG_BYTE_SYNC_ADDRESS), 0xA5, "chip B keeps its sync address");
+
+    // A reset of one chip leaves the other alone
+    COM5025_Init(&b);
+    COM5025_Reset(&b);
+    ASSERT_EQ(COM5025_ReadByte(&a, COM5025_REG_BYTE_SYNC_ADDRESS), 0x5A, "chip A survives a reset of chip B");
+    ASSERT_EQ(COM5025_ReadByte(&b, COM5025_REG_BYTE_SYNC_ADDRESS), 0x00, "chip B is reset");
+    printf(" ok\n");
+}
+
+int run_com5025_tests(void)
+{
+    failures = 0;
+    test_registers_per_chip();
+    return failures;
+}
@@ -0,0 +1,179 @@
+/*
+ * Drive block cache (src/machine/drivecache.c).
+ *
+ * A small image is read and written through a cache of a few blocks.
+ * Written blocks must read back from the cache before they reach the
+ * image, an evicted dirty block must be written to the image, and
+ * unmounting must write back what is left. A block the image refuses
+ * must stay dirty until it can be written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+#define BLOCK_BYTES  512
+#define BLOCKS       32
+#define CACHE_BLOCKS 8
+
+static int failures = 0;
+static char imagePath[256];
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("  FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static void write_image(void)
+{
+    uint8_t block[BLOCK_BYTES];
+    FILE *f = fopen(imagePath, "wb");
+    for (int b = 0; b < BLOCKS; b++) {
+        memset(block, b, sizeof(block));
+        fwrite(block, 1, sizeof(block), f);
+    }
+    fclose(f);
+}
+
+// The first byte of a block as the image file holds it now
+static int image_byte(uint32_t block)
+{
+    FILE *f = fopen(imagePath, "rb");
+    fseek(f, (long)block * BLOCK_BYTES, SEEK_SET);
+    int value = fgetc(f);
+    fclose(f);
+    return value;
+}
+
+static void mount(MountedDriveInfo_t *entry, const char *mode)
+{
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->name, sizeof(entry->name), "test image");
+    entry->data.local_file = fopen(imagePath, mode);
+    entry->data_size = BLOCKS * BLOCK_BYTES;
+}
+
+static void unmount(MountedDriveInfo_t *entry)
+{
+    CHECK(drive_cache_drop(entry) == 0, "unmount could not save the written blocks");
+    fclose(entry->data.local_file);
+}
+
+static int write_block(MountedDriveInfo_t *entry, uint32_t block, uint8_t value)
+{
+    uint8_t data[BLOCK_BYTES];
+    memset(data, value, sizeof(data));
+    return drive_cache_write(entry, DRIVE_SMD, 0, data, 1, block, BLOCK_BYTES, false);
+}
+
+static int read_block(MountedDriveInfo_t *entry, uint32_t block)
+{
+    uint8_t data[BLOCK_BYTES];
+    if (drive_cache_read(entry, DRIVE_SMD, 0, data, 1, block, BLOCK_BYTES) < 0)
+        return -1;
+    return data[0];
+}
+
+static void test_read_after_write(void)
+{
+    MountedDriveInfo_t entry;
+
+    printf("[read after write]\n");
+    write_image();
+    mount(&entry, "rb+");
+    CHECK(write_block(&entry, 3, 0xA5) == 1, "write");
+    CHECK(read_block(&entry, 3) == 0xA5, "the written block does not read back");
+    CHECK(image_byte(3) == 3, "the write went to the image before a write back");
+    CHECK(drive_cache_flush(&entry) == 0, "write back");
+    CHECK(image_byte(3) == 0xA5, "the write back did not reach the image");
+    unmount(&entry);
+}
+
+static void test_evict_dirty(void)
+{
+    MountedDriveInfo_t entry;
+    DriveCacheStats before, after;
+
+    printf("[evict a dirty block]\n");
+    write_image();
+    mount(&entry, "rb+");
+    drive_cache_get_stats(&before);
+    CHECK(write_block(&entry, 1, 0x11) == 1, "write");
+
+    // Reading a cache full of other blocks pushes the written one out
+    for (uint32_t b = 16; b < 16 + CACHE_BLOCKS; b++)
+        CHECK(read_block(&entry, b) == (int)b, "read block %u", b);
+    drive_cache_get_stats(&after);
+    CHECK(after.evictions > before.evictions, "nothing was evicted");
+    CHECK(image_byte(1) == 0x11, "the evicted block was not written to the image");
+    CHECK(read_block(&entry, 1) == 0x11, "the evicted block does not read back");
+    unmount(&entry);
+}
+
+static void test_flush_on_unmount(void)
+{
+    MountedDriveInfo_t entry;
+
+    printf("[flush on unmount]\n");
+    write_image();
+    mount(&entry, "rb+");
+    for (uint32_t b = 4; b < 8; b++)
+        CHECK(write_block(&entry, b, (uint8_t)(0x40 + b)) == 1, "write block %u", b);
+    CHECK(image_byte(4) == 4, "the write went to the image before the unmount");
+    unmount(&entry);
+    for (uint32_t b = 4; b < 8; b++)
+        CHECK(image_byte(b) == (int)(0x40 + b), "block %u was not written on unmount", b);
+}
+
+static void test_failed_write_back(void)
+{
+    MountedDriveInfo_t entry;
+
+    printf("[failed write back]\n");
+    write_image();
+    mount(&entry, "rb");            // The image refuses every write
+    CHECK(write_block(&entry, 2, 0x22) == 1, "write");
+    CHECK(drive_cache_flush(&entry) < 0, "a failed write back was not reported");
+
+    // Not evicted while it cannot be written, and still there to read
+    for (uint32_t b = 16; b < 16 + 2 * CACHE_BLOCKS; b++)
+        CHECK(read_block(&entry, b) == (int)b, "read block %u", b);
+    CHECK(read_block(&entry, 2) == 0x22, "the unsaved block was dropped");
+
+    // Once the image takes writes again, the block gets there
+    fclose(entry.data.local_file);
+    entry.data.local_file = fopen(imagePath, "rb+");
+    CHECK(drive_cache_flush(&entry) == 0, "write back after the image became writable");
+    CHECK(image_byte(2) == 0x22, "the block kept dirty did not reach the image");
+    unmount(&entry);
+}
+
+int main(void)
+{
+    snprintf(imagePath, sizeof(imagePath), "/tmp/test_drivecache_%d.img", (int)getpid());
+    drive_cache_set_size(CACHE_BLOCKS * BLOCK_BYTES);
+
+    test_read_after_write();
+    test_evict_dirty();
+    test_flush_on_unmount();
+    test_failed_write_back();
+
+    remove(imagePath);
+
+    if (failures == 0) {
+        printf("All drive cache tests PASSED.\n");
+    } else {
+        printf("%d drive cache test(s) FAILED.\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,364 @@
+/*
+ * Differential tests for the 48-bit floating point (src/cpu/float48.h).
+ *
+ * The reference is the word array implementation float.c had before the
+ * 64-bit version (ported from the SIMH ND100 simulator). Random operands,
+ * biased towards the interesting cases, must give bit for bit the same
+ * results.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../src/cpu/float48.h"
+
+static int failures = 0;
+
+/* ================================================================ */
+/* Reference implementation                                         */
+/* ================================================================ */
+
+struct fp {
+    int s;
+    int e;
+    uint64_t m;
+};
+
+static void mkfp48(struct fp *fp, ushort w1, ushort w2, ushort w3)
+{
+    fp->s = (w1 >> 15) & 1;
+    fp->e = (w1 & 0x7FFF) - 16384;
+    fp->m = ((uint64_t)w2 << 16) + (uint64_t)w3;
+}
+
+static void add48(struct fp *f1, struct fp *f2, ushort *r)
+{
+    struct fp *ft;
+    uint64_t m3;
+    int scale, gbit;
+
+    if (f2->e > f1->e) {
+        ft = f1; f1 = f2; f2 = ft;
+    }
+
+    if ((scale = f1->e - f2->e) > 31) {
+        m3 = f1->m;
+        goto done;
+    }
+
+    gbit = scale ? (((1LL << scale) - 1) & f2->m) != 0 : 0;
+    f2->m >>= scale;
+    m3 = (f1->m + f2->m) | gbit;
+    if (m3 > 0xffffffffLL) {
+        m3 >>= 1;
+        f1->e++;
+    }
+
+done:
+    r[0] = (f1->e + 16384) | (f1->s << 15);
+    r[1] = (ushort)(m3 >> 16);
+    r[2] = (ushort)m3;
+}
+
+static void sub48(struct fp *f1, struct fp *f2, ushort *r)
+{
+    struct fp *ft;
+    uint64_t m3;
+    int scale, gbit;
+
+    if (f2->e > f1->e) {
+        ft = f1; f1 = f2; f2 = ft;
+    }
+
+    if ((scale = f1->e - f2->e) > 31) {
+        m3 = f1->m;
+        goto done;
+    }
+
+    gbit = scale ? (((1LL << scale) - 1) & f2->m) != 0 : 0;
+    f2->m >>= scale;
+    f2->e = f1->e;
+
+    if (f2->m > f1->m) {
+        ft = f1; f1 = f2; f2 = ft;
+    }
+    m3 = (f1->m - f2->m) | gbit;
+
+    if (m3 == 0) {
+        r[0] = r[1] = r[2] = 0;
+        return;
+    }
+
+    while ((m3 & 0x80000000LL) == 0) {
+        m3 <<= 1;
+        f1->e--;
+    }
+
+done:
+    r[0] = (f1->e + 16384) | (f1->s << 15);
+    r[1] = (ushort)(m3 >> 16);
+    r[2] = (ushort)m3;
+}
+
+static void ref_add(ushort *p_a, ushort *p_b, ushort *p_r)
+{
+    struct fp f1, f2;
+
+    mkfp48(&f1, p_a[0], p_a[1], p_a[2]);
+    mkfp48(&f2, p_b[0], p_b[1], p_b[2]);
+
+    if (f1.s ^ f2.s)
+        sub48(&f1, &f2, p_r);
+    else
+        add48(&f1, &f2, p_r);
+}
+
+static void ref_sub(ushort *p_a, ushort *p_b, ushort *p_r)
+{
+    struct fp f1, f2;
+
+    mkfp48(&f1, p_a[0], p_a[1], p_a[2]);
+    mkfp48(&f2, p_b[0], p_b[1], p_b[2]);
+    f2.s ^= 1;
+
+    if (f1.s ^ f2.s)
+        sub48(&f1, &f2, p_r);
+    else
+        add48(&f1, &f2, p_r);
+}
+
+static void ref_mul(ushort *p_a, ushort *p_b, ushort *p_r)
+{
+    struct fp f1, f2;
+    int s3, e3;
+    uint64_t m3;
+
+    mkfp48(&f1, p_a[0], p_a[1], p_a[2]);
+    mkfp48(&f2, p_b[0], p_b[1], p_b[2]);
+
+    m3 = f1.m * f2.m;
+    e3 = f1.e + f2.e;
+    s3 = f1.s ^ f2.s;
+
+    if ((m3 & (1ULL << 63)) == 0) {
+        m3 <<= 1;
+        e3--;
+    }
+
+    p_r[1] = (ushort)(m3 >> 48);
+    p_r[2] = (ushort)(m3 >> 32);
+    p_r[0] = (e3 + 16384) | (s3 << 15);
+    if (m3 == 0 || e3 < -16383)
+        p_r[0] = p_r[1] = p_r[2] = 0;
+}
+
+static int ref_div(ushort *p_a, ushort *p_b, ushort *p_r)
+{
+    struct fp f1, f2;
+    int s3, e3;
+    uint64_t m3;
+
+    mkfp48(&f1, p_b[0], p_b[1], p_b[2]);
+    mkfp48(&f2, p_a[0], p_a[1], p_a[2]);
+    f2.m <<= 32;
+
+    if (f1.m == 0) {
+        p_r[0] = p_a[0] | 0x7FFF;
+        p_r[1] = 0xFFFF;
+        p_r[2] = 0xFFFF;
+        return 1;
+    }
+
+    s3 = f1.s ^ f2.s;
+    e3 = f2.e - f1.e;
+    m3 = f2.m / f1.m;
+    if (f2.m % f1.m)
+        m3++;
+
+    if (m3 >= (1ULL << 32)) {
+        m3 >>= 1;
+        e3++;
+    }
+
+    p_r[1] = (ushort)(m3 >> 16);
+    p_r[2] = (ushort)m3;
+    p_r[0] = (e3 + 16384) | (s3 << 15);
+    if (f2.m == 0 || e3 < -16383)
+        p_r[0] = p_r[1] = p_r[2] = 0;
+    return 0;
+}
+
+/* ================================================================ */
+/* Operand generator                                                */
+/* ================================================================ */
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Random operand; 'near' is an operand whose exponent the result may stay close to */
+static uint64_t random_operand(uint64_t near)
+{
+    uint64_t r = rng();
+    uint16_t t = (uint16_t)(r >> 48);
+    uint32_t m = (uint32_t)r;
+
+    switch ((r >> 32) & 7) {
+    case 0:                                     /* any bit pattern */
+        break;
+    case 1:                                     /* zero, or a zero mantissa */
+        m = 0;
+        if (r & (1ull << 35)) t = 0;
+        break;
+    case 2:                                     /* exponent close to the other operand */
+        t = (uint16_t)((t & 0x8000) | ((ND48_T(near) + (int)((r >> 36) % 80) - 40) & 0x7FFF));
+        m |= 0x80000000u;
+        break;
+    case 3:                                     /* same exponent, mantissa close to the other operand */
+        t = (uint16_t)((t & 0x8000) | (ND48_T(near) & 0x7FFF));
+        m = (uint32_t)ND48_MANT(near) + (uint32_t)((r >> 36) & 0xFF) - 0x80;
+        break;
+    case 4:                                     /* exponent at the ends of the range */
+        t = (uint16_t)((t & 0x8000) | ((r & (1ull << 36)) ? (t & 0x3F) : (0x7FC0 | (t & 0x3F))));
+        m |= 0x80000000u;
+        break;
+    case 5:                                     /* few mantissa bits, unnormalized */
+        m >>= (r >> 40) & 31;
+        break;
+    default:                                    /* normalized, exponent around 0 */
+        t = (uint16_t)((t & 0x8000) | (16384 + (int)((r >> 40) % 200) - 100));
+        m |= 0x80000000u;
+        break;
+    }
+
+    return ND48(t, m >> 16, m);
+}
+
+/* ================================================================ */
+/* Tests                                                            */
+/* ================================================================ */
+
+#define ITERATIONS 2000000
+
+static bool check(const char *op, uint64_t a, uint64_t b, const ushort *expected, uint64_t got)
+{
+    if (ND48_T(got) == expected[0] && ND48_A(got) == expected[1] && ND48_D(got) == expected[2])
+        return true;
+
+    printf("  FAIL: %s %04X %04X %04X, %04X %04X %04X: expected %04X %04X %04X, got %04X %04X %04X\n",
+           op, ND48_T(a), ND48_A(a), ND48_D(a), ND48_T(b), ND48_A(b), ND48_D(b),
+           expected[0], expected[1], expected[2], ND48_T(got), ND48_A(got), ND48_D(got));
+    failures++;
+    return false;
+}
+
+static void test_random(const char *name, int op)
+{
+    printf("  test_%s...", name);
+    int before = failures;
+
+    for (int i = 0; i < ITERATIONS && failures - before < 10; i++) {
+        uint64_t a = random_operand(0);
+        uint64_t b = random_operand(a);
+        if (rng() & 1) {
+            uint64_t t = a; a = b; b = t;
+        }
+
+        ushort wa[3] = { ND48_T(a), ND48_A(a), ND48_D(a) };
+        ushort wb[3] = { ND48_T(b), ND48_A(b), ND48_D(b) };
+        ushort expected[3];
+        uint64_t got;
+
+        switch (op) {
+        case 0:
+            ref_add(wa, wb, expected);
+            got = NDFloat48_Add(a, b);
+            break;
+        case 1:
+            ref_sub(wa, wb, expected);
+            got = NDFloat48_Sub(a, b);
+            break;
+        case 2:
+            ref_mul(wa, wb, expected);
+            got = NDFloat48_Mul(a, b);
+            break;
+        default: {
+            int zero = ref_div(wa, wb, expected);
+            if (NDFloat48_Div(a, b, &got) != !zero) {
+                printf("  FAIL: div by zero flag for divisor %04X %04X %04X\n", wb[0], wb[1], wb[2]);
+                failures++;
+            }
+            break;
+        }
+        }
+
+        check(name, a, b, expected, got);
+    }
+
+    if (failures == before)
+        printf(" ok\n");
+}
+
+/* Every exponent distance and sign combination around the guard bit and normalization limits */
+static void test_exponent_distances(void)
+{
+    printf("  test_exponent_distances...");
+    int before = failures;
+
+    static const uint32_t mantissas[] = {
+        0x80000000u, 0x80000001u, 0xFFFFFFFFu, 0xC0000000u, 0x00000001u, 0x7FFFFFFFu
+    };
+    int n = (int)(sizeof(mantissas) / sizeof(mantissas[0]));
+
+    for (int d = -40; d <= 40; d++) {
+        for (int signs = 0; signs < 4; signs++) {
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    uint16_t ta = (uint16_t)(((signs & 1) << 15) | 16384);
+                    uint16_t tb = (uint16_t)(((signs & 2) << 14) | (16384 + d));
+                    uint64_t a = ND48(ta, mantissas[i] >> 16, mantissas[i]);
+                    uint64_t b = ND48(tb, mantissas[j] >> 16, mantissas[j]);
+                    ushort wa[3] = { ND48_T(a), ND48_A(a), ND48_D(a) };
+                    ushort wb[3] = { ND48_T(b), ND48_A(b), ND48_D(b) };
+                    ushort expected[3];
+
+                    ref_add(wa, wb, expected);
+                    check("add", a, b, expected, NDFloat48_Add(a, b));
+                    ref_sub(wa, wb, expected);
+                    check("sub", a, b, expected, NDFloat48_Sub(a, b));
+                }
+            }
+        }
+    }
+
+    if (failures == before)
+        printf(" ok\n");
+}
+
+int main(void)
+{
+    printf("[float48]\n");
+
+    test_exponent_distances();
+    test_random("add", 0);
+    test_random("sub", 1);
+    test_random("mul", 2);
+    test_random("div", 3);
+    printf("\n");
+
+    if (failures == 0) {
+        printf("All float tests PASSED.\n");
+    } else {
+        printf("%d float test(s) FAILED.\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -1,7 +1,7 @@
 /*
  * Main test runner for HDLC module unit tests.
  *
- * Runs: ring buffer, HDLC frame, CRC tests.
+ * Runs: ring buffer, HDLC frame, CRC, COM5025 tests.
  */
 
 #include <stdio.h>
@@ -28,6 +28,7 @@ void interrupt(uint16_t lvl, uint16_t sub)
 extern int run_tcp_receive_buffer_tests(void);
 extern int run_hdlc_frame_tests(void);
 extern int run_hdlc_crc_tests(void);
+extern int run_com5025_tests(void);
 
 int main(void)
 {
@@ -45,6 +46,10 @@ int main(void)
     total_failures += run_hdlc_frame_tests();
     printf("\n");
 
+    printf("[com5025]\n");
+    total_failures += run_com5025_tests();
+    printf("\n");
+
     if (total_failures == 0) {
         printf("All HDLC tests PASSED.\n");
     } else {
@@ -0,0 +1,125 @@
+/*
+ * Level 0 idle loop detection (cpu_idle_check in src/cpu/cpu.c).
+ *
+ * A loop that returns to the same address with nothing changed is idle,
+ * and its time is skipped with the host asleep at the throttle rate.
+ * A loop that only counts in D, or only fills memory with BFILL, does
+ * work and must run every instruction at full speed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+#define RUN_TICKS   1125000     /* One second of virtual time at 1.125 MHz */
+#define FILL_ADDR   0100        /* BFILL destination */
+#define FILL_BYTES  040
+
+static int failures = 0;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Load a program at 0 and run it on level 0, as after SINTRAN has been on a higher level
+static double run_level0(const uint16_t *program, int words)
+{
+    for (int i = 0; i < words; i++)
+        write_memory(i, program[i]);
+    gPC = 0;
+    activateSleep = true;
+
+    double start = now();
+    cpu_run(RUN_TICKS);
+    return now() - start;
+}
+
+static double test_idle(void)
+{
+    static const uint16_t program[] = {
+        0150402,            // 0: ION
+        0124000,            // 1: JMP *
+    };
+
+    printf("[idle loop]\n");
+    machine_init(false, 0);
+    double seconds = run_level0(program, 2);
+    printf("  %.3f s\n", seconds);
+    if (seconds < 0.5) {
+        printf("  FAIL: the idle loop was not detected\n");
+        failures++;
+    }
+    cleanup_machine();
+    return seconds;
+}
+
+static void test_count_in_d(void)
+{
+    static const uint16_t program[] = {
+        0150402,            // 0: ION
+        0146401,            // 1: RINC DD
+        0124377,            // 2: JMP *-1
+    };
+
+    printf("[loop changing only D]\n");
+    machine_init(false, 0);
+    uint64_t start = instr_counter;
+    run_level0(program, 3);
+
+    // ION, then one RINC per pass and none skipped; D wraps at 16 bits
+    uint64_t passes = (instr_counter - start) / 2;
+    if (gD != (uint16_t)passes) {
+        printf("  FAIL: D is %u after %llu passes\n", gD, (unsigned long long)passes);
+        failures++;
+    }
+    cleanup_machine();
+}
+
+static void test_bfill(double idleSeconds)
+{
+    static const uint16_t program[] = {
+        0150402,                    // 0: ION
+        0170400 | 0125,             // 1: SAA 125
+        0171400 | FILL_ADDR,        // 2: SAX FILL_ADDR
+        0171000 | FILL_BYTES,       // 3: SAT FILL_BYTES
+        0140130,                    // 4: BFILL
+        0,                          // 5: (skipped)
+        0124374,                    // 6: JMP *-4
+    };
+
+    printf("[loop doing only BFILL]\n");
+    machine_init(false, 0);
+    double seconds = run_level0(program, 7);
+    printf("  %.3f s\n", seconds);
+    if (seconds > idleSeconds / 2) {
+        printf("  FAIL: the BFILL loop was taken for idle\n");
+        failures++;
+    }
+    if (ReadPhysicalMemory(FILL_ADDR, false) != 0052525) {
+        printf("  FAIL: BFILL left %06o\n", ReadPhysicalMemory(FILL_ADDR, false));
+        failures++;
+    }
+    cleanup_machine();
+}
+
+int main(void)
+{
+    double idleSeconds = test_idle();
+    test_count_in_d();
+    test_bfill(idleSeconds);
+
+    if (failures == 0) {
+        printf("All idle tests PASSED.\n");
+    } else {
+        printf("%d idle test(s) FAILED.\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Several machines in one process, each on its own thread.
+ *
+ * Every thread creates a machine, runs a small program that leaves a
+ * result depending on its thread number, and checks it. The machines
+ * share no state, so the results must be exact while they run side by side.
+ * Each machine also gets its own memory size and drive flush policy, which
+ * must still be its own after the others have set theirs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+#define MACHINES 4
+#define RESULT_ADDR 10
+
+static pthread_barrier_t started;
+
+typedef struct {
+    int k;
+    int result;
+    uint64_t instructions;
+    uint32_t memoryPages;
+    DRIVE_FLUSH flush;
+} MachineRun;
+
+static void *run_machine(void *arg)
+{
+    MachineRun *run = (MachineRun *)arg;
+    int k = run->k;
+
+    machine_init(false, 0);
+    cpu_memory_set_size(64 * k);
+    machine_set_drive_flush((k & 1) ? DRIVE_FLUSH_IMMEDIATE : DRIVE_FLUSH_PERIODIC);
+
+    // A = 0, X = 25 * k; add k to A X times; store A, then loop on the spot
+    static const uint16_t program[] = {
+        0170400,            // 0: SAA 0
+        0,                  // 1: SAX 25 * k
+        0,                  // 2: AAA k
+        0173777,            // 3: AAX -1
+        0133002,            // 4: JXZ *+2
+        0124375,            // 5: JMP *-3
+        0004004,            // 6: STA *+4  (RESULT_ADDR)
+        0124000,            // 7: JMP *
+    };
+    for (uint32_t i = 0; i < sizeof(program) / sizeof(program[0]); i++)
+        write_memory(i, program[i]);
+    write_memory(1, (uint16_t)(0171400 | (25 * k)));
+    write_memory(2, (uint16_t)(0172400 | k));
+    gPC = 0;
+
+    // All machines run at the same time
+    pthread_barrier_wait(&started);
+    for (int i = 0; i < 100; i++)
+        cpu_run(1000);
+
+    run->result = ReadPhysicalMemory(RESULT_ADDR, false);
+    run->instructions = instr_counter;
+    run->memoryPages = VolatileMemory.pages;
+    run->flush = gMachine->drives->flush;
+    cleanup_machine();
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[MACHINES];
+    MachineRun runs[MACHINES];
+    int failures = 0;
+
+    pthread_barrier_init(&started, NULL, MACHINES);
+    for (int i = 0; i < MACHINES; i++) {
+        runs[i].k = i + 1;
+        if (pthread_create(&threads[i], NULL, run_machine, &runs[i]) != 0) {
+            printf("FAIL: cannot start machine thread %d\n", i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < MACHINES; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&started);
+
+    for (int i = 0; i < MACHINES; i++) {
+        int expected = 25 * runs[i].k * runs[i].k;
+        printf("  machine %d: result %d (expected %d), %llu instructions\n", i, runs[i].result, expected,
+               (unsigned long long)runs[i].instructions);
+        if (runs[i].result != expected)
+            failures++;
+        if (runs[i].memoryPages != (uint32_t)(64 * runs[i].k)) {
+            printf("FAIL: machine %d has %u KW of memory, set %d\n", i, runs[i].memoryPages, 64 * runs[i].k);
+            failures++;
+        }
+        if (runs[i].flush != ((runs[i].k & 1) ? DRIVE_FLUSH_IMMEDIATE : DRIVE_FLUSH_PERIODIC)) {
+            printf("FAIL: machine %d lost its drive flush policy\n", i);
+            failures++;
+        }
+    }
+
+    if (failures == 0) {
+        printf("All machine tests PASSED.\n");
+    } else {
+        printf("%d machine test(s) FAILED.\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copy-on-write overlay images (src/machine/overlay.c).
+ *
+ * A small base image is given an overlay. Partial block writes must be
+ * merged with what the drive holds, the base must never change, and
+ * commit and discard must leave the base as expected and remove the
+ * overlay. Reopening an existing overlay must not touch its mtime.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "machine_types.h"
+#include "machine_protos.h"
+
+#define BLOCKS      8
+#define IMAGE_BYTES (BLOCKS * OVERLAY_BLOCK_BYTES)
+
+static int failures = 0;
+static char basePath[256];
+static char overlayPath[256];
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("  FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint8_t base_byte(size_t offset)
+{
+    return (uint8_t)(offset * 7 + (offset >> 8));
+}
+
+static void write_base(void)
+{
+    FILE *f = fopen(basePath, "wb");
+    for (size_t i = 0; i < IMAGE_BYTES; i++)
+        fputc(base_byte(i), f);
+    fclose(f);
+}
+
+static bool base_is_unchanged(void)
+{
+    FILE *f = fopen(basePath, "rb");
+    bool same = f != NULL;
+    for (size_t i = 0; same && i < IMAGE_BYTES; i++)
+        same = fgetc(f) == base_byte(i);
+    if (f)
+        fclose(f);
+    return same;
+}
+
+// Mount the base read only with an overlay, as machine.c does
+static bool mount(MountedDriveInfo_t *entry)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->data.local_file = fopen(basePath, "rb");
+    entry->data_size = IMAGE_BYTES;
+    entry->overlay = drive_overlay_open(overlayPath, basePath, IMAGE_BYTES);
+    return entry->data.local_file && entry->overlay;
+}
+
+static void unmount(MountedDriveInfo_t *entry)
+{
+    drive_overlay_close(entry->overlay);
+    fclose(entry->data.local_file);
+}
+
+// The drive contents the writes below leave, next to the base bytes
+static void expected_drive(uint8_t *image)
+{
+    for (size_t i = 0; i < IMAGE_BYTES; i++)
+        image[i] = base_byte(i);
+    memset(image + 1 * OVERLAY_BLOCK_BYTES + 512, 0xA5, 256);      // Half a block
+    memset(image + 3 * OVERLAY_BLOCK_BYTES, 0x11, OVERLAY_BLOCK_BYTES);
+    memset(image + 3 * OVERLAY_BLOCK_BYTES + 100, 0x22, 10);       // Into an overlay block
+    memset(image + 5 * OVERLAY_BLOCK_BYTES - 200, 0x33, 400);      // Across two blocks
+}
+
+static void write_drive(MountedDriveInfo_t *entry)
+{
+    uint8_t data[OVERLAY_BLOCK_BYTES];
+
+    memset(data, 0xA5, 256);
+    CHECK(drive_overlay_write(entry, data, 256, 1 * OVERLAY_BLOCK_BYTES + 512) == 0, "partial write");
+    memset(data, 0x11, OVERLAY_BLOCK_BYTES);
+    CHECK(drive_overlay_write(entry, data, OVERLAY_BLOCK_BYTES, 3 * OVERLAY_BLOCK_BYTES) == 0, "block write");
+    memset(data, 0x22, 10);
+    CHECK(drive_overlay_write(entry, data, 10, 3 * OVERLAY_BLOCK_BYTES + 100) == 0, "write into an overlay block");
+    memset(data, 0x33, 400);
+    CHECK(drive_overlay_write(entry, data, 400, 5 * OVERLAY_BLOCK_BYTES - 200) == 0, "write across blocks");
+    CHECK(drive_overlay_write(entry, data, 400, IMAGE_BYTES - 200) < 0, "write past the end must fail");
+}
+
+static void check_drive(MountedDriveInfo_t *entry, const char *when)
+{
+    static uint8_t expected[IMAGE_BYTES], got[IMAGE_BYTES];
+    expected_drive(expected);
+    CHECK(drive_overlay_read(entry, got, IMAGE_BYTES, 0) == 0, "read %s", when);
+    for (size_t i = 0; i < IMAGE_BYTES; i++) {
+        if (got[i] != expected[i]) {
+            CHECK(false, "%s: byte %zu is %02X, expected %02X", when, i, got[i], expected[i]);
+            break;
+        }
+    }
+}
+
+static void test_merge(void)
+{
+    MountedDriveInfo_t entry;
+
+    printf("[merge]\n");
+    write_base();
+    remove(overlayPath);
+    CHECK(mount(&entry), "mount with a new overlay");
+    write_drive(&entry);
+    check_drive(&entry, "after the writes");
+    unmount(&entry);
+    CHECK(base_is_unchanged(), "the base image changed");
+
+    // Kept across a remount; reopening must not touch the overlay's mtime, even when the
+    // file is shorter than a mapping needs (as an overlay written without one can be)
+    CHECK(truncate(overlayPath, 8192 + 6 * OVERLAY_BLOCK_BYTES) == 0, "shorten the overlay");
+    struct utimbuf old = { 1000000000, 1000000000 };
+    utime(overlayPath, &old);
+    CHECK(mount(&entry), "remount");
+    check_drive(&entry, "after a remount");
+    unmount(&entry);
+    struct stat st;
+    CHECK(stat(overlayPath, &st) == 0 && st.st_mtime == old.modtime, "reopening touched the overlay mtime");
+}
+
+static void test_commit(void)
+{
+    MountedDriveInfo_t entry;
+    static uint8_t expected[IMAGE_BYTES], got[IMAGE_BYTES];
+
+    printf("[commit]\n");
+    write_base();
+    remove(overlayPath);
+    CHECK(mount(&entry), "mount with a new overlay");
+    write_drive(&entry);
+    unmount(&entry);
+
+    CHECK(drive_overlay_commit(overlayPath), "commit");
+    CHECK(access(overlayPath, F_OK) != 0, "the overlay is still there after a commit");
+
+    expected_drive(expected);
+    FILE *f = fopen(basePath, "rb");
+    CHECK(f && fread(got, 1, IMAGE_BYTES, f) == IMAGE_BYTES, "read the base image");
+    if (f)
+        fclose(f);
+    CHECK(memcmp(got, expected, IMAGE_BYTES) == 0, "the base image does not hold the committed blocks");
+}
+
+static void test_discard(void)
+{
+    MountedDriveInfo_t entry;
+
+    printf("[discard]\n");
+    write_base();
+    remove(overlayPath);
+    CHECK(mount(&entry), "mount with a new overlay");
+    write_drive(&entry);
+    unmount(&entry);
+
+    CHECK(drive_overlay_discard(overlayPath), "discard");
+    CHECK(access(overlayPath, F_OK) != 0, "the overlay is still there after a discard");
+    CHECK(base_is_unchanged(), "a discard changed the base image");
+
+    // Only an overlay is ever deleted
+    CHECK(!drive_overlay_discard(basePath), "discarded a file that is not an overlay");
+    CHECK(base_is_unchanged(), "a refused discard changed the base image");
+}
+
+int main(void)
+{
+    snprintf(basePath, sizeof(basePath), "/tmp/test_overlay_%d.img", (int)getpid());
+    snprintf(overlayPath, sizeof(overlayPath), "/tmp/test_overlay_%d.ovl", (int)getpid());
+
+    test_merge();
+    test_commit();
+    test_discard();
+
+    remove(overlayPath);
+    remove(basePath);
+
+    if (failures == 0) {
+        printf("All overlay tests PASSED.\n");
+    } else {
+        printf("%d overlay test(s) FAILED.\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Compare the threaded (computed goto) instruction dispatch with the function pointer dispatch.
+#
+# Builds two release trees that differ only in THREADED_DISPATCH, then runs the INSTRUCTION-B
+# test program on both, alternating, and prints the cpu cycle time reported at exit.
+#
+# Usage: tools/bench-dispatch.sh [seconds per run] [rounds]
+
+set -e
+
+SECONDS_PER_RUN=${1:-20}
+ROUNDS=${2:-3}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+IMAGE="$ROOT/images/INSTRUCTION-B.BPUN"
+JOBS=$(nproc 2>/dev/null || echo 4)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+build() {
+    local dir="$ROOT/build_bench_$1"
+    cmake -S "$ROOT" -B "$dir" -DCMAKE_BUILD_TYPE=Release -DDEBUGGER_ENABLED=OFF -DTHREADED_DISPATCH=$2 > /dev/null
+    cmake --build "$dir" -j"$JOBS" > /dev/null
+}
+
+# With --save-snapshot, Ctrl-C stops the machine cleanly and the run statistics are printed
+run() {
+    local bin="$ROOT/build_bench_$1/bin/nd100x"
+    (sleep 1; printf 'RUN\r'; sleep "$SECONDS_PER_RUN") |
+        timeout -s INT "$SECONDS_PER_RUN" "$bin" --boot=bpun --image="$IMAGE" \
+            --save-snapshot="$TMP/$1.snap" > "$TMP/$1.txt" 2>&1 || true
+    printf "%-10s %s\n" "$1" "$(grep -a "cycle time" "$TMP/$1.txt" | sed 's/.*is://')"
+}
+
+echo "Building..."
+build pointer OFF
+build threaded ON
+
+for i in $(seq "$ROUNDS"); do
+    echo "Round $i:"
+    run pointer
+    run threaded
+done